@@ -0,0 +1,20 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include "tests/file_util.h"
+
+/**
+ * Milliseconds since the given time.
+ */
+static inline double millisSince(const std::chrono::steady_clock::time_point start)
+{
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
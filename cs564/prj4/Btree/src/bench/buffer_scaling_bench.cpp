@@ -0,0 +1,168 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Measures how buffer pool throughput scales with threads.  1, 2, 4 and 8
+ * threads share one pool of 8000 frames: once each running full FileScans of
+ * a relation of 20000 tuples, once each running B+ tree range scans of 1000
+ * keys over it.  Every thread does the same amount of work, so with one core
+ * per thread the elapsed time would stay flat and pages/s grow linearly.
+ * Pages/s counts every page read through the pool, taken from its
+ * statistics.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench_util.h"
+#include "btree.h"
+#include "buffer.h"
+#include "filescan.h"
+#include "page.h"
+#include "exceptions/insufficient_space_exception.h"
+
+using namespace badgerdb;
+
+static const std::string relationName = "scaling_bench_rel";
+static const int relationSize = 20000;
+static const std::uint32_t numFrames = 8000;
+static const int scansPerThread = 20;
+static const int rangeScansPerThread = 2000;
+
+typedef struct tuple {
+	int i;
+	double d;
+	char s[64];
+} RECORD;
+
+static void createRelation()
+{
+  removeFile(relationName);
+  PageFile file(relationName, true);
+  RECORD record;
+  std::memset(&record, ' ', sizeof(record));
+  PageId pageNo;
+  Page page = file.allocatePage(pageNo);
+  for (int i = 0; i < relationSize; i++)
+  {
+    std::snprintf(record.s, sizeof(record.s), "%05d string record", i);
+    record.i = i;
+    record.d = (double)i;
+    const std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+    while (true)
+    {
+      try
+      {
+        page.insertRecord(data);
+        break;
+      }
+      catch (const InsufficientSpaceException&)
+      {
+        file.writePage(pageNo, page);
+        page = file.allocatePage(pageNo);
+      }
+    }
+  }
+  file.writePage(pageNo, page);
+}
+
+/**
+ * Full scans of the relation.  Each FileScan opens the relation itself, so
+ * the threads read pages of their own and flush them when done.
+ */
+static void scanWorker(BufMgr* bufMgr)
+{
+  for (int n = 0; n < scansPerThread; n++)
+  {
+    FileScan scan(relationName, bufMgr);
+    RecordId rid;
+    std::size_t bytes = 0;
+    while (scan.tryScanNext(rid))
+      bytes += scan.getRecord().size();
+    if (bytes != relationSize * sizeof(RECORD))
+      std::abort();
+  }
+}
+
+/**
+ * Range scans of 1000 keys through an index object of the thread's own.
+ */
+static void rangeScanWorker(BufMgr* bufMgr, const int threadNo)
+{
+  std::string indexName;
+  BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+  unsigned int seed = threadNo + 1;
+  for (int n = 0; n < rangeScansPerThread; n++)
+  {
+    int lowVal = rand_r(&seed) % (relationSize - 1000);
+    int highVal = lowVal + 1000;
+    index.startScan(&lowVal, GTE, &highVal, LT);
+    RecordId rid;
+    int found = 0;
+    while (index.tryScanNext(rid))
+      found++;
+    index.endScan();
+    if (found != 1000)
+      std::abort();
+  }
+}
+
+/**
+ * Runs the worker on the given number of threads and prints the pages read
+ * through the pool per second.
+ */
+static void run(BufMgr& bufMgr, const int threads, const bool index)
+{
+  bufMgr.clearBufStats();
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++)
+  {
+    if (index)
+      workers.push_back(std::thread(rangeScanWorker, &bufMgr, t));
+    else
+      workers.push_back(std::thread(scanWorker, &bufMgr));
+  }
+  for (std::size_t t = 0; t < workers.size(); t++)
+    workers[t].join();
+  const double millis = millisSince(start);
+
+  const BufStatsSnapshot stats = bufMgr.getStatsSnapshot();
+  std::printf("  %7d %10.1f %14.0f %10.3f\n", threads, millis, stats.accesses * 1000.0 / millis,
+              stats.accesses ? double(stats.hits) / stats.accesses : 0);
+}
+
+int main()
+{
+  createRelation();
+  BufMgr bufMgr(numFrames);
+  std::string indexName;
+  {
+    BTreeIndex index(relationName, indexName, &bufMgr, offsetof(tuple, i), INTEGER);
+  }
+
+  const int threadCounts[] = {1, 2, 4, 8};
+  const std::size_t numCounts = sizeof(threadCounts) / sizeof(threadCounts[0]);
+  std::printf("%u frames, %u hardware threads\n", numFrames, std::thread::hardware_concurrency());
+  std::printf("FileScan of %d tuples, %d per thread\n", relationSize, scansPerThread);
+  std::printf("  %7s %10s %14s %10s\n", "threads", "ms", "pages/s", "hit ratio");
+  for (std::size_t i = 0; i < numCounts; i++)
+    run(bufMgr, threadCounts[i], false);
+  std::printf("B+ tree range scan of 1000 keys, %d per thread\n", rangeScansPerThread);
+  std::printf("  %7s %10s %14s %10s\n", "threads", "ms", "pages/s", "hit ratio");
+  for (std::size_t i = 0; i < numCounts; i++)
+    run(bufMgr, threadCounts[i], true);
+
+  removeFile(indexName);
+  File::remove(relationName);
+  return 0;
+}
@@ -0,0 +1,287 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Times BufHashTbl lookups, inserts and removes for pools of 1K to 1M frames,
+ * with the table sized the way BufMgr sizes it, and inserts into a table
+ * which starts out small and has to grow.  Each size is run against the
+ * chained table BufHashTbl replaced as well, kept below as it was, so the two
+ * can be compared side by side.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "bench_util.h"
+#include "bufHashTbl.h"
+#include "file.h"
+#include "exceptions/hash_not_found_exception.h"
+
+using namespace badgerdb;
+
+/**
+ * The chained hash table BufHashTbl used to be: a fixed array of bucket
+ * lists, hashed on the File pointer truncated to an int plus the page number,
+ * with every insert allocating a bucket and a lookup miss throwing.
+ */
+class ChainedHashTbl
+{
+ public:
+  ChainedHashTbl(const int htSize)
+    : HTSIZE(htSize)
+  {
+    ht = new Bucket*[htSize];
+    for (int i = 0; i < HTSIZE; i++)
+      ht[i] = NULL;
+  }
+
+  ~ChainedHashTbl()
+  {
+    for (int i = 0; i < HTSIZE; i++)
+    {
+      while (ht[i])
+      {
+        Bucket* tmpBuc = ht[i];
+        ht[i] = ht[i]->next;
+        delete tmpBuc;
+      }
+    }
+    delete [] ht;
+  }
+
+  void insert(const File* file, const PageId pageNo, const FrameId frameNo)
+  {
+    int index = hash(file, pageNo);
+    for (Bucket* tmpBuc = ht[index]; tmpBuc; tmpBuc = tmpBuc->next)
+    {
+      if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+        std::abort();
+    }
+    Bucket* tmpBuc = new Bucket;
+    tmpBuc->file = file;
+    tmpBuc->pageNo = pageNo;
+    tmpBuc->frameNo = frameNo;
+    tmpBuc->next = ht[index];
+    ht[index] = tmpBuc;
+  }
+
+  void lookup(const File* file, const PageId pageNo, FrameId& frameNo)
+  {
+    int index = hash(file, pageNo);
+    for (Bucket* tmpBuc = ht[index]; tmpBuc; tmpBuc = tmpBuc->next)
+    {
+      if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+      {
+        frameNo = tmpBuc->frameNo;
+        return;
+      }
+    }
+    throw HashNotFoundException(file->filename(), pageNo);
+  }
+
+  void remove(const File* file, const PageId pageNo)
+  {
+    int index = hash(file, pageNo);
+    Bucket* prevBuc = NULL;
+    for (Bucket* tmpBuc = ht[index]; tmpBuc; prevBuc = tmpBuc, tmpBuc = tmpBuc->next)
+    {
+      if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+      {
+        if (prevBuc)
+          prevBuc->next = tmpBuc->next;
+        else
+          ht[index] = tmpBuc->next;
+        delete tmpBuc;
+        return;
+      }
+    }
+    throw HashNotFoundException(file->filename(), pageNo);
+  }
+
+ private:
+  struct Bucket {
+    const File* file;
+    PageId pageNo;
+    FrameId frameNo;
+    Bucket* next;
+  };
+
+  int hash(const File* file, const PageId pageNo)
+  {
+    int tmp, value;
+    tmp = (long)file;
+    value = (tmp + pageNo) % HTSIZE;
+    return value;
+  }
+
+  int HTSIZE;
+  Bucket** ht;
+};
+
+static double nanosPerOp(const std::chrono::steady_clock::time_point start, const std::size_t ops)
+{
+  const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / ops;
+}
+
+/**
+ * A page in the pool
+ */
+struct Key {
+  File* file;
+  PageId pageNo;
+};
+
+/**
+ * Times the chained table on the same operations as benchFrames().  It never
+ * grows, so there is no growing insert to time.
+ */
+static void benchChained(const std::uint32_t frames, const std::vector<Key>& keys,
+                         const std::vector<Key>& probes)
+{
+  ChainedHashTbl table(int(frames * 1.2) + 1);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (std::uint32_t i = 0; i < frames; i++)
+    table.insert(keys[i].file, keys[i].pageNo, i);
+  const double insert = nanosPerOp(start, frames);
+
+  FrameId frameNo = 0;
+  std::uint64_t sum = 0;
+  start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < probes.size(); i++)
+  {
+    table.lookup(probes[i].file, probes[i].pageNo, frameNo);
+    sum += frameNo;
+  }
+  const double hit = nanosPerOp(start, probes.size());
+
+  // BufMgr learned of a miss through the exception
+  start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < probes.size(); i++)
+  {
+    try
+    {
+      table.lookup(probes[i].file, probes[i].pageNo + frames, frameNo);
+    }
+    catch (const HashNotFoundException&)
+    {
+      sum++;
+    }
+  }
+  const double miss = nanosPerOp(start, probes.size());
+
+  start = std::chrono::steady_clock::now();
+  for (std::uint32_t i = 0; i < frames; i++)
+  {
+    table.remove(keys[i].file, keys[i].pageNo);
+    table.insert(keys[i].file, keys[i].pageNo + frames, i);
+  }
+  const double replace = nanosPerOp(start, frames);
+
+  std::printf("%8u %-8s %10.1f %10.1f %10.1f %14.1f %14s   (%llu)\n", frames, "chained", insert,
+              hit, miss, replace, "-", static_cast<unsigned long long>(sum % 10));
+}
+
+/**
+ * Times both tables for a pool of the given size, holding the first pages of
+ * the files in turn.
+ */
+static void benchFrames(const std::vector<File*>& files, const std::uint32_t frames)
+{
+  // the pages in the pool, in random order
+  std::vector<Key> keys(frames);
+  for (std::uint32_t i = 0; i < frames; i++)
+  {
+    keys[i].file = files[i % files.size()];
+    keys[i].pageNo = i / files.size() + 1;
+  }
+  std::mt19937 rng(frames);
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  const std::size_t lookups = std::max<std::size_t>(frames, 1000000);
+  std::vector<Key> probes(lookups);
+  for (std::size_t i = 0; i < lookups; i++)
+    probes[i] = keys[rng() % frames];
+
+  benchChained(frames, keys, probes);
+
+  BufHashTbl table(int(frames * 1.2) + 1);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (std::uint32_t i = 0; i < frames; i++)
+    table.insert(keys[i].file, keys[i].pageNo, i);
+  const double insert = nanosPerOp(start, frames);
+
+  FrameId frameNo;
+  std::uint64_t sum = 0;
+  start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < lookups; i++)
+  {
+    table.tryLookup(probes[i].file, probes[i].pageNo, frameNo);
+    sum += frameNo;
+  }
+  const double hit = nanosPerOp(start, lookups);
+
+  start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < lookups; i++)
+    sum += table.tryLookup(probes[i].file, probes[i].pageNo + frames, frameNo);
+  const double miss = nanosPerOp(start, lookups);
+
+  // replace pages one by one, as eviction does
+  start = std::chrono::steady_clock::now();
+  for (std::uint32_t i = 0; i < frames; i++)
+  {
+    table.remove(keys[i].file, keys[i].pageNo);
+    table.insert(keys[i].file, keys[i].pageNo + frames, i);
+  }
+  const double replace = nanosPerOp(start, frames);
+
+  // and the same number of inserts into a table which has to grow
+  BufHashTbl small(10);
+  start = std::chrono::steady_clock::now();
+  for (std::uint32_t i = 0; i < frames; i++)
+    small.insert(keys[i].file, keys[i].pageNo, i);
+  const double growing = nanosPerOp(start, frames);
+
+  std::printf("%8u %-8s %10.1f %10.1f %10.1f %14.1f %14.1f   (%llu)\n", frames, "open", insert,
+              hit, miss, replace, growing, static_cast<unsigned long long>(sum % 10));
+}
+
+int main()
+{
+  // a relation alone, then a relation with its indexes and temporary files
+  const std::size_t fileCounts[] = {1, 8};
+  std::vector<File*> files;
+  for (std::size_t i = 0; i < fileCounts[1]; i++)
+  {
+    const std::string name = "hashtbl_bench_file_" + std::to_string(i);
+    removeFile(name);
+    files.push_back(new BlobFile(name, true));
+  }
+
+  const std::uint32_t sizes[] = {1000, 10000, 100000, 1000000};
+  for (std::size_t f = 0; f < sizeof(fileCounts) / sizeof(fileCounts[0]); f++)
+  {
+    std::printf("ns per operation, pages of %zu file%s\n", fileCounts[f], fileCounts[f] > 1 ? "s" : "");
+    std::printf("%8s %-8s %10s %10s %10s %14s %14s\n", "frames", "table", "insert", "hit", "miss",
+                "remove+insert", "growing insert");
+    const std::vector<File*> used(files.begin(), files.begin() + fileCounts[f]);
+    for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+      benchFrames(used, sizes[i]);
+  }
+
+  for (std::size_t i = 0; i < files.size(); i++)
+  {
+    const std::string name = files[i]->filename();
+    delete files[i];
+    File::remove(name);
+  }
+  return 0;
+}
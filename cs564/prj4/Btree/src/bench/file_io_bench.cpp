@@ -0,0 +1,91 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Times random page reads and writes of a 64 MB file, which stays in the page
+ * cache, through each file backend: single pages and runs of 16 pages of a
+ * PageFile, and single pages of a BlobFile.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "bench_util.h"
+#include "file.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+static const PageId NUM_PAGES = 8192;
+static const int OPS = 50000;
+static const std::size_t RUN = 16;
+
+static double perSecond(const std::chrono::steady_clock::time_point start, const int ops)
+{
+  return ops * 1000.0 / millisSince(start);
+}
+
+static void bench(const FileIoType type, const char* name)
+{
+  unsigned int seed = 1;
+  Page page;
+
+  removeFile("io_bench_pages");
+  PageFile pageFile = PageFile::create("io_bench_pages", type);
+  for (PageId i = 0; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    pageFile.allocatePage(pageNo);
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < OPS; i++)
+    pageFile.readPage(1 + rand_r(&seed) % NUM_PAGES, page);
+  const double pageRead = perSecond(start, OPS);
+
+  std::vector<Page> run(RUN);
+  std::vector<Page*> runPages(RUN);
+  for (std::size_t i = 0; i < RUN; i++)
+    runPages[i] = &run[i];
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < OPS / int(RUN); i++)
+    pageFile.readPages(1 + rand_r(&seed) % (NUM_PAGES - RUN), runPages);
+  const double pagesRead = perSecond(start, OPS / RUN * RUN);
+
+  removeFile("io_bench_blob");
+  BlobFile blobFile = BlobFile::create("io_bench_blob", type);
+  for (PageId i = 0; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    blobFile.allocatePage(pageNo);
+  }
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < OPS; i++)
+    blobFile.readPage(1 + rand_r(&seed) % NUM_PAGES, page);
+  const double blobRead = perSecond(start, OPS);
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < OPS; i++)
+    blobFile.writePage(1 + rand_r(&seed) % NUM_PAGES, page);
+  const double blobWrite = perSecond(start, OPS);
+
+  std::printf("%-8s %14.0f %14.0f %14.0f %14.0f\n", name, pageRead, pagesRead, blobRead, blobWrite);
+}
+
+int main()
+{
+  std::printf("pages per second, %u pages of %u bytes\n", NUM_PAGES, unsigned(Page::SIZE));
+  std::printf("%-8s %14s %14s %14s %14s\n", "backend", "PageFile read", "16-page reads",
+              "BlobFile read", "BlobFile write");
+  bench(STREAM_IO, "fstream");
+  bench(POSIX_IO, "pread");
+  File::remove("io_bench_pages");
+  File::remove("io_bench_blob");
+  return 0;
+}
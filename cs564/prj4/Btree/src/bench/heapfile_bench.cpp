@@ -0,0 +1,140 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Loads 100000 records of 80 bytes, deletes half of them at random and loads
+ * half as many again, once the way main.cpp loads a relation, keeping one
+ * page in hand and writing it when it is full, and once through a HeapFile.
+ * Reports the time taken and the pages the relation ends up with.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file_iterator.h"
+#include "heapfile.h"
+#include "exceptions/insufficient_space_exception.h"
+
+using namespace badgerdb;
+
+static const int NUM_RECORDS = 100000;
+
+static int usedPages(const char* name)
+{
+  PageFile file = PageFile::open(name);
+  int pages = 0;
+  for (FileIterator it = file.begin(); it != file.end(); ++it)
+    pages++;
+  return pages;
+}
+
+/**
+ * Inserts records on a page kept in hand, moving to a new page when it is
+ * full, as main.cpp does.
+ */
+static void loadInHand(PageFile& file, const std::string& record, const int count,
+                       std::vector<RecordId>* rids)
+{
+  PageId pageNo;
+  Page page = file.allocatePage(pageNo);
+  for (int i = 0; i < count; i++)
+  {
+    while (true)
+    {
+      try
+      {
+        const RecordId rid = page.insertRecord(record);
+        if (rids != NULL)
+          rids->push_back(rid);
+        break;
+      }
+      catch (const InsufficientSpaceException&)
+      {
+        file.writePage(pageNo, page);
+        page = file.allocatePage(pageNo);
+      }
+    }
+  }
+  file.writePage(pageNo, page);
+}
+
+int main()
+{
+  const std::string record(80, 'r');
+  removeFile("heap_bench_hand");
+  removeFile("heap_bench_heap");
+
+  std::vector<RecordId> handRids;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  {
+    PageFile file = PageFile::create("heap_bench_hand");
+    loadInHand(file, record, NUM_RECORDS, &handRids);
+  }
+  const double handLoad = millisSince(start);
+  const int handLoadPages = usedPages("heap_bench_hand");
+
+  BufMgr* bufMgr = new BufMgr(1000);
+  std::vector<RecordId> heapRids;
+  start = std::chrono::steady_clock::now();
+  {
+    HeapFile heap("heap_bench_heap", bufMgr, true);
+    for (int i = 0; i < NUM_RECORDS; i++)
+      heapRids.push_back(heap.insertRecord(record));
+    heap.close();
+  }
+  const double heapLoad = millisSince(start);
+  const int heapLoadPages = usedPages("heap_bench_heap");
+
+  // the same half of both deleted
+  std::mt19937 rng(3);
+  std::vector<int> order(NUM_RECORDS);
+  for (int i = 0; i < NUM_RECORDS; i++)
+    order[i] = i;
+  std::shuffle(order.begin(), order.end(), rng);
+
+  start = std::chrono::steady_clock::now();
+  {
+    PageFile file = PageFile::open("heap_bench_hand");
+    for (int i = 0; i < NUM_RECORDS / 2; i++)
+    {
+      const RecordId& rid = handRids[order[i]];
+      Page page = file.readPage(rid.page_number);
+      page.deleteRecord(rid);
+      file.writePage(rid.page_number, page);
+    }
+    loadInHand(file, record, NUM_RECORDS / 2, NULL);
+  }
+  const double handChurn = millisSince(start);
+
+  start = std::chrono::steady_clock::now();
+  {
+    HeapFile heap("heap_bench_heap", bufMgr);
+    for (int i = 0; i < NUM_RECORDS / 2; i++)
+      heap.deleteRecord(heapRids[order[i]]);
+    for (int i = 0; i < NUM_RECORDS / 2; i++)
+      heap.insertRecord(record);
+    heap.close();
+  }
+  const double heapChurn = millisSince(start);
+  delete bufMgr;
+
+  std::printf("%d records of %u bytes\n", NUM_RECORDS, unsigned(record.size()));
+  std::printf("%-30s %20s %20s\n", "operation", "page in hand", "HeapFile");
+  std::printf("%-30s %9.1f ms %4d pg %9.1f ms %4d pg\n", "load", handLoad, handLoadPages,
+              heapLoad, heapLoadPages);
+  std::printf("%-30s %9.1f ms %4d pg %9.1f ms %4d pg\n", "delete half, then load half", handChurn,
+              usedPages("heap_bench_hand"), heapChurn, usedPages("heap_bench_heap"));
+
+  File::remove("heap_bench_hand");
+  HeapFile::remove("heap_bench_heap");
+  return 0;
+}
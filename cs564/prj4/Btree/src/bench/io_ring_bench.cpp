@@ -0,0 +1,118 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Times readPages() of batches of 64 random pages of a 20000-page BlobFile
+ * opened with O_DIRECT, so that every miss goes to the device, and
+ * checkpoints of 1500 dirty pages of a file in the page cache, for several
+ * numbers of requests in flight on an io_uring.  Depth 0 is the synchronous
+ * path.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+#include "io_ring.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+static const PageId NUM_PAGES = 20000;
+static const std::uint32_t NUM_FRAMES = 2000;
+static const std::size_t BATCH = 64;
+static const int BATCHES = 200;
+static const int DIRTY_PAGES = 1500;
+
+/**
+ * Average time of a batch of random reads, in milliseconds.
+ */
+static double readBatches(const std::uint32_t depth)
+{
+  BlobFile file = BlobFile::open("ring_bench_file", DIRECT_IO);
+  BufMgr bufMgr(NUM_FRAMES);
+  bufMgr.setIoDepth(depth);
+
+  unsigned int seed = 1;
+  std::vector<PageId> pageIds;
+  std::vector<Page*> pages;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int b = 0; b < BATCHES; b++)
+  {
+    pageIds.clear();
+    while (pageIds.size() < BATCH)
+    {
+      const PageId pageNo = 1 + rand_r(&seed) % NUM_PAGES;
+      if (std::find(pageIds.begin(), pageIds.end(), pageNo) == pageIds.end())
+        pageIds.push_back(pageNo);
+    }
+    bufMgr.readPages(&file, pageIds, pages);
+    for (std::size_t i = 0; i < pageIds.size(); i++)
+      bufMgr.unPinPage(&file, pageIds[i], false);
+  }
+  return millisSince(start) / BATCHES;
+}
+
+/**
+ * Best time of a few checkpoints of the same dirty pages, in milliseconds.
+ */
+static double checkpointTime(const std::uint32_t depth)
+{
+  BlobFile file = BlobFile::open("ring_bench_file", POSIX_IO);
+  BufMgr bufMgr(NUM_FRAMES);
+  bufMgr.setIoDepth(depth);
+
+  double best = 0;
+  for (int round = 0; round < 5; round++)
+  {
+    for (PageId pageNo = 1; pageNo <= PageId(DIRTY_PAGES); pageNo++)
+    {
+      Page* page;
+      bufMgr.readPage(&file, pageNo, page);
+      bufMgr.unPinPage(&file, pageNo, true);
+    }
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bufMgr.checkpoint();
+    const double millis = millisSince(start);
+    if (round == 0 || millis < best)
+      best = millis;
+  }
+  return best;
+}
+
+int main()
+{
+  if (!IoRing::supported())
+  {
+    std::printf("no io_uring on this system\n");
+    return 0;
+  }
+
+  removeFile("ring_bench_file");
+  {
+    BlobFile file = BlobFile::create("ring_bench_file");
+    Page page;
+    for (PageId i = 0; i < NUM_PAGES; i++)
+    {
+      PageId pageNo;
+      file.allocatePage(pageNo, page);
+    }
+  }
+
+  std::printf("%u frames, %u pages of %u bytes\n", NUM_FRAMES, NUM_PAGES, unsigned(Page::SIZE));
+  std::printf("%-6s %18s %25s\n", "depth", "64-page batch, ms", "1500-page checkpoint, ms");
+  const std::uint32_t depths[] = {0, 4, 16, 64};
+  for (std::size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+    std::printf("%-6u %18.2f %25.2f\n", depths[i], readBatches(depths[i]), checkpointTime(depths[i]));
+
+  File::remove("ring_bench_file");
+  return 0;
+}
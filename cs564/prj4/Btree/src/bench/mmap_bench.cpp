@@ -0,0 +1,147 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Times full FileScans of a relation of 200000 tuples, and B+ tree range
+ * scans of about 1000 keys over it, reading the pages through the buffer pool
+ * and in place from a read only mapping.  The pool of 4000 frames is warmed
+ * up first, so the scans through the pool do no I/O either.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "bench_util.h"
+#include "btree.h"
+#include "buffer.h"
+#include "filescan.h"
+#include "page.h"
+#include "exceptions/insufficient_space_exception.h"
+
+using namespace badgerdb;
+
+static const std::string relationName = "mmap_bench_rel";
+static const int relationSize = 200000;
+
+typedef struct tuple {
+	int i;
+	double d;
+	char s[64];
+} RECORD;
+
+static void createRelation()
+{
+  removeFile(relationName);
+  PageFile file(relationName, true);
+  RECORD record;
+  std::memset(&record, ' ', sizeof(record));
+  PageId pageNo;
+  Page page = file.allocatePage(pageNo);
+  for (int i = 0; i < relationSize; i++)
+  {
+    std::snprintf(record.s, sizeof(record.s), "%05d string record", i);
+    record.i = i;
+    record.d = (double)i;
+    const std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+    while (true)
+    {
+      try
+      {
+        page.insertRecord(data);
+        break;
+      }
+      catch (const InsufficientSpaceException&)
+      {
+        file.writePage(pageNo, page);
+        page = file.allocatePage(pageNo);
+      }
+    }
+  }
+  file.writePage(pageNo, page);
+}
+
+/**
+ * Best of a few full scans, in milliseconds.
+ */
+static double scanTime(BufMgr& bufMgr, const BufferAccessStrategy strategy)
+{
+  double best = 0;
+  for (int round = 0; round < 5; round++)
+  {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    FileScan scan(relationName, &bufMgr, strategy);
+    RecordId rid;
+    std::size_t bytes = 0;
+    while (scan.tryScanNext(rid))
+      bytes += scan.getRecord().size();
+    const double millis = millisSince(start);
+    if (bytes != relationSize * sizeof(RECORD))
+      std::abort();
+    if (round == 0 || millis < best)
+      best = millis;
+  }
+  return best;
+}
+
+/**
+ * Average time of a range scan of about 1000 keys, in microseconds.
+ */
+static double rangeScanTime(BTreeIndex& index)
+{
+  const int scans = 2000;
+  unsigned int seed = 1;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int n = 0; n < scans; n++)
+  {
+    int lowVal = rand_r(&seed) % (relationSize - 1000);
+    int highVal = lowVal + 1000;
+    index.startScan(&lowVal, GTE, &highVal, LT);
+    RecordId rid;
+    int found = 0;
+    while (index.tryScanNext(rid))
+      found++;
+    index.endScan();
+    if (found != 1000)
+      std::abort();
+  }
+  return millisSince(start) * 1000 / scans;
+}
+
+int main()
+{
+  createRelation();
+  BufMgr bufMgr(4000);
+
+  std::string indexName;
+  {
+    BTreeIndex index(relationName, indexName, &bufMgr, offsetof(tuple, i), INTEGER);
+  }
+
+  scanTime(bufMgr, NORMAL_ACCESS);
+  std::printf("full FileScan of %d tuples, best of 5, ms\n", relationSize);
+  std::printf("  %-14s %8.1f\n", "NORMAL_ACCESS", scanTime(bufMgr, NORMAL_ACCESS));
+  std::printf("  %-14s %8.1f\n", "BULK_READ", scanTime(bufMgr, BULK_READ));
+  std::printf("  %-14s %8.1f\n", "MAPPED_READ", scanTime(bufMgr, MAPPED_READ));
+
+  std::printf("B+ tree range scan of 1000 keys, average of 2000, us\n");
+  {
+    BTreeIndex index(relationName, indexName, &bufMgr, offsetof(tuple, i), INTEGER);
+    rangeScanTime(index);
+    std::printf("  %-14s %8.1f\n", "NORMAL_ACCESS", rangeScanTime(index));
+  }
+  {
+    BTreeIndex index(relationName, indexName, &bufMgr, offsetof(tuple, i), INTEGER, MAPPED_READ);
+    std::printf("  %-14s %8.1f\n", "MAPPED_READ", rangeScanTime(index));
+  }
+
+  removeFile(indexName);
+  File::remove(relationName);
+  return 0;
+}
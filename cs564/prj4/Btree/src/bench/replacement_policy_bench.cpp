@@ -0,0 +1,204 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Compares the page replacement policies on the workloads of main.cpp: a
+ * B+ tree index is built over a relation of tuples, range scans fetch the
+ * records they match, and record lookups go to a hot set of pages while a
+ * sequential scan runs through the relation.  For each policy and workload
+ * the hit ratio, the pages read from disk and the page accesses per second
+ * are printed, with a pool of 100 frames as main.cpp uses.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "bench_util.h"
+#include "btree.h"
+#include "buffer.h"
+#include "page.h"
+#include "exceptions/insufficient_space_exception.h"
+
+using namespace badgerdb;
+
+static const std::string relationName = "policy_bench_rel";
+static const int relationSize = 100000;
+static const std::uint32_t numFrames = 100;
+
+typedef struct tuple {
+	int i;
+	double d;
+	char s[64];
+} RECORD;
+
+/**
+ * Writes the relation straight to its file, as createRelationForward() in
+ * main.cpp does, and returns the record ids in key order.
+ */
+static void createRelation(std::vector<RecordId>& rids)
+{
+  removeFile(relationName);
+  PageFile file(relationName, true);
+  RECORD record;
+  std::memset(&record, ' ', sizeof(record));
+  PageId pageNo;
+  Page page = file.allocatePage(pageNo);
+  for (int i = 0; i < relationSize; i++)
+  {
+    std::snprintf(record.s, sizeof(record.s), "%05d string record", i);
+    record.i = i;
+    record.d = (double)i;
+    const std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+    while (true)
+    {
+      try
+      {
+        rids.push_back(page.insertRecord(data));
+        break;
+      }
+      catch (const InsufficientSpaceException&)
+      {
+        file.writePage(pageNo, page);
+        page = file.allocatePage(pageNo);
+      }
+    }
+  }
+  file.writePage(pageNo, page);
+}
+
+/**
+ * Results of one workload under one policy.
+ */
+struct Result
+{
+  double hitRatio;
+  std::uint64_t diskreads;
+  double accessesPerSec;
+};
+
+/**
+ * Turns the statistics gathered since the last clearBufStats() into a result.
+ */
+static Result finish(BufMgr& bufMgr, const std::chrono::steady_clock::time_point start)
+{
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  const BufStatsSnapshot stats = bufMgr.getStatsSnapshot();
+  Result result;
+  result.hitRatio = stats.accesses ? double(stats.hits) / stats.accesses : 0;
+  result.diskreads = stats.diskreads;
+  result.accessesPerSec = stats.accesses / elapsed.count();
+  return result;
+}
+
+/**
+ * Range scans over the index which fetch every record they match, as
+ * intScan() in main.cpp does.  Four scans in five fall into the lowest tenth
+ * of the keys.
+ */
+static void rangeScans(BufMgr& bufMgr, PageFile* file, BTreeIndex& index)
+{
+  unsigned int seed = 1;
+  for (int n = 0; n < 2000; n++)
+  {
+    const int range = rand_r(&seed) % 5 == 0 ? relationSize : relationSize / 10;
+    int lowVal = rand_r(&seed) % (range - 100);
+    int highVal = lowVal + 100;
+    index.startScan(&lowVal, GTE, &highVal, LT);
+    RecordId rid;
+    while (index.tryScanNext(rid))
+    {
+      Page* page;
+      bufMgr.readPage(file, rid.page_number, page);
+      const std::string record = page->getRecord(rid);
+      if (reinterpret_cast<const RECORD*>(record.data())->i < lowVal)
+        std::abort();
+      bufMgr.unPinPage(file, rid.page_number, false);
+    }
+    index.endScan();
+  }
+}
+
+/**
+ * Lookups of records on a hot set of pages, three in five, while the rest of
+ * the accesses scan through the relation again and again.
+ */
+static void hotSetAndScan(BufMgr& bufMgr, PageFile* file, const std::vector<RecordId>& rids)
+{
+  const PageId numPages = rids.back().page_number;
+  const PageId hotPages = numFrames * 2 / 5;
+  unsigned int seed = 1;
+  PageId scanPos = 0;
+  for (int n = 0; n < 300000; n++)
+  {
+    const PageId pageNo = rand_r(&seed) % 5 < 3 ? 1 + rand_r(&seed) % hotPages
+                                                : 1 + scanPos++ % numPages;
+    Page* page;
+    bufMgr.readPage(file, pageNo, page);
+    bufMgr.unPinPage(file, pageNo, false);
+  }
+}
+
+int main()
+{
+  std::vector<RecordId> rids;
+  createRelation(rids);
+
+  const char* workloads[] = {"index build", "range scans", "hot set + scan"};
+  const ReplacementPolicyType policies[] = {CLOCK, LRU_K, TWO_Q, ARC, CLOCK_PRO};
+  const std::size_t numPolicies = sizeof(policies) / sizeof(policies[0]);
+  std::vector<std::string> names;
+  std::vector<std::vector<Result> > results(numPolicies);
+
+  for (std::size_t p = 0; p < numPolicies; p++)
+  {
+    BufMgr bufMgr(numFrames, policies[p]);
+    names.push_back(bufMgr.policyName());
+    PageFile* file = new PageFile(relationName, false);
+    std::string indexName;
+    {
+      bufMgr.clearBufStats();
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      BTreeIndex index(relationName, indexName, &bufMgr, offsetof(tuple, i), INTEGER);
+      results[p].push_back(finish(bufMgr, start));
+
+      bufMgr.clearBufStats();
+      start = std::chrono::steady_clock::now();
+      rangeScans(bufMgr, file, index);
+      results[p].push_back(finish(bufMgr, start));
+    }
+    removeFile(indexName);
+
+    bufMgr.clearBufStats();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    hotSetAndScan(bufMgr, file, rids);
+    results[p].push_back(finish(bufMgr, start));
+
+    bufMgr.flushFile(file);
+    delete file;
+  }
+
+  std::printf("%u frames, relation of %d tuples on %u pages\n", numFrames, relationSize,
+              rids.back().page_number);
+  for (std::size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++)
+  {
+    std::printf("%s\n", workloads[w]);
+    std::printf("  %-10s %10s %10s %14s\n", "policy", "hit ratio", "diskreads", "accesses/s");
+    for (std::size_t p = 0; p < numPolicies; p++)
+    {
+      const Result& r = results[p][w];
+      std::printf("  %-10s %10.3f %10llu %14.0f\n", names[p].c_str(), r.hitRatio,
+                  static_cast<unsigned long long>(r.diskreads), r.accessesPerSec);
+    }
+  }
+
+  File::remove(relationName);
+  return 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Times allocating and deleting pages of a PageFile in the page cache, each
+ * of which links the page into the used or free list after the page before
+ * it: appends to a file of 5000 pages, random deletes from it, allocations
+ * which reuse the pages deleted, and appends to a file of 50000 pages.  That
+ * file is then emptied but for its first and last page, deleting from the
+ * front, and pages are allocated and deleted again near its end, so that the
+ * used page before each is far below it.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+#include "bench_util.h"
+#include "file.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+static double append(PageFile& file, const int pages)
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < pages; i++)
+  {
+    PageId pageNo;
+    file.allocatePage(pageNo);
+  }
+  return millisSince(start);
+}
+
+int main()
+{
+  const int pages = 5000;
+  const int deletes = 500;
+  removeFile("space_map_bench_file");
+  PageFile* file = new PageFile("space_map_bench_file", true);
+  const double appends = append(*file, pages);
+
+  // random pages, each deleted once
+  std::vector<PageId> order(pages);
+  for (int i = 0; i < pages; i++)
+    order[i] = i + 1;
+  unsigned int seed = 1;
+  for (int i = 0; i < deletes; i++)
+    std::swap(order[i], order[i + rand_r(&seed) % (pages - i)]);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < deletes; i++)
+    file->deletePage(order[i]);
+  const double deleting = millisSince(start);
+
+  const double reusing = append(*file, deletes);
+  delete file;
+  File::remove("space_map_bench_file");
+
+  file = new PageFile("space_map_bench_file", true);
+  const double manyAppends = append(*file, 10 * pages);
+
+  start = std::chrono::steady_clock::now();
+  for (PageId pageNo = 2; pageNo < PageId(10 * pages); pageNo++)
+    file->deletePage(pageNo);
+  const double emptying = millisSince(start);
+
+  // each allocation takes the page deleted last, near the end
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < deletes; i++)
+  {
+    PageId pageNo;
+    file->allocatePage(pageNo);
+    file->deletePage(pageNo);
+  }
+  const double sparse = millisSince(start);
+  delete file;
+  File::remove("space_map_bench_file");
+
+  std::printf("%-36s %10s\n", "operation", "ms");
+  std::printf("%-36s %10.1f\n", "5000 appends", appends);
+  std::printf("%-36s %10.1f\n", "500 random deletes of 5000 pages", deleting);
+  std::printf("%-36s %10.1f\n", "500 allocates reusing them", reusing);
+  std::printf("%-36s %10.1f\n", "50000 appends", manyAppends);
+  std::printf("%-36s %10.1f\n", "49998 deletes from the front", emptying);
+  std::printf("%-36s %10.1f\n", "500 allocate/delete in sparse file", sparse);
+  return 0;
+}
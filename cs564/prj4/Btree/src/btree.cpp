@@ -16,8 +16,10 @@
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/end_of_file_exception.h"
 #include "exceptions/bad_scan_param_exception.h"
+#include "exceptions/read_only_file_exception.h"
 
 #include <cassert>
+#include <vector>
 
 
 //#define DEBUG
@@ -33,7 +35,8 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType):
+		const Datatype attrType,
+		const BufferAccessStrategy strategy):
 		bufMgr(bufMgrIn),
 		attributeType(attrType),
 		attrByteOffset(attrByteOffset)
@@ -54,14 +57,13 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		assert(file != NULL);
 		// write the IndexMetaInfo into the file
 		// file->allocPage(headerPageNum);
-		Page* pagePtr;
-		bufMgr->allocPage(file, headerPageNum, pagePtr);
+		PageHandle headerPage = bufMgr->newPage(file, headerPageNum);
 		assert(headerPageNum == 1);
 		// std::cout << "header(indexMeta) pageId = " << headerPageNum << std::endl;
 		rootPageNum = 0;
 
 		// TODO: change outIndexName from string to char[20]
-		IndexMetaInfo* indexMeta = reinterpret_cast<IndexMetaInfo*> (pagePtr);
+		IndexMetaInfo* indexMeta = reinterpret_cast<IndexMetaInfo*> (headerPage.page());
 		assert(outIndexName.length() + 1 <= 20);
 		strcpy(indexMeta->relationName, outIndexName.c_str());
 		indexMeta->attrByteOffset = attrByteOffset;
@@ -69,8 +71,8 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		indexMeta->rootPageNo = rootPageNum;
 		indexMeta->hasNonLeaf = false;
 		// unpin the header page
-		// std::cout << "before unPinPage headerPage in BTreeIndex" << std::endl;
-		bufMgr->unPinPage(file, headerPageNum, true);
+		headerPage.markDirty();
+		headerPage.release();
 
 		// std::cout << "rootPageNum = " << rootPageNum << std::endl;
 		// Page* indexMetaPage = reinterpret_cast<Page*> (&indexMeta);
@@ -79,44 +81,51 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		// at start has no non-leaf nodes
 		hasNonLeaf = false;
 		
-		// scan the relation & insert tuples
-		FileScan filescanner = FileScan(relationName, bufMgr);
-		bool scanComplete = false;
-		while(!scanComplete)
+		// scan the relation & insert tuples; the relation goes through a buffer
+		// ring, or is mapped, so that the index pages being built stay in the pool
+		FileScan filescanner(relationName, bufMgr, strategy == MAPPED_READ ? MAPPED_READ : BULK_READ);
+		RecordId curRecId;
+		while(filescanner.tryScanNext(curRecId))
 		{
-			try {
-				RecordId curRecId;
-				filescanner.scanNext(curRecId);
-				std::string recordData = filescanner.getRecord();
-				// std::string keyData = recordData.substr(attrByteOffset, sizeof(int));
-				const char* data_str = recordData.c_str();
-				// key type is integer by default
-				// int* key = reinterpret_cast<int*> (&keyData);
-				insertEntry(static_cast<const void*> (data_str + attrByteOffset), curRecId);
-			}
-			catch (EndOfFileException) {
-				scanComplete = true;
-			}
+			std::string recordData = filescanner.getRecord();
+			// std::string keyData = recordData.substr(attrByteOffset, sizeof(int));
+			const char* data_str = recordData.c_str();
+			// key type is integer by default
+			// int* key = reinterpret_cast<int*> (&keyData);
+			insertEntry(static_cast<const void*> (data_str + attrByteOffset), curRecId);
+		}
+
+		if (strategy == MAPPED_READ)
+		{
+			// the index is complete, from now on read it in place
+			bufMgr->flushFile(file);
+			delete file;
+			file = new MmapFile(outIndexName, BLOB_FILE_LAYOUT);
 		}
 	}
 	else
 	{
-		BlobFile* indexFile = new BlobFile(outIndexName, false);
-		assert(indexFile != NULL);
-		file = dynamic_cast<File*> (indexFile);
+		if (strategy == MAPPED_READ)
+		{
+			file = new MmapFile(outIndexName, BLOB_FILE_LAYOUT);
+		}
+		else
+		{
+			BlobFile* indexFile = new BlobFile(outIndexName, false);
+			assert(indexFile != NULL);
+			file = dynamic_cast<File*> (indexFile);
+		}
 		// retrieve the IndexMetaInfo from the index header page
 		headerPageNum = 1; /* by default */
 		// Page indexMetaPage = file->readPage(headerPageNum);
-		Page* indexMetaPage;
-		bufMgr->readPage(file, headerPageNum, indexMetaPage);
-		IndexMetaInfo* indexMeta = reinterpret_cast<IndexMetaInfo*> (indexMetaPage);
+		PageHandle indexMetaPage = bufMgr->fetchPage(file, headerPageNum);
+		IndexMetaInfo* indexMeta = reinterpret_cast<IndexMetaInfo*> (indexMetaPage.page());
 		assert(indexMeta->attrByteOffset == attrByteOffset);
 		assert(indexMeta->attrType == attributeType);
 		rootPageNum = indexMeta->rootPageNo;
 		hasNonLeaf = indexMeta->hasNonLeaf;
 		// unpin the header page
-		// std::cout << "before unPinPage headerPage 2 in BTreeIndex" << std::endl;
-		bufMgr->unPinPage(file, headerPageNum, false);
+		indexMetaPage.release();
 	}
 
 	scanExecuting = false;
@@ -131,7 +140,9 @@ BTreeIndex::~BTreeIndex()
 {
 	// do not delete the index file in this function
 	// TODO construct a test case that destructs a B+ tree index and then reuse the file
-	// all pages should be unpinned right after use. only need to flush here
+	// all pages should be unpinned right after use, except the leaf of a scan
+	// still executing. only need to flush here
+	currentPage.release();
 	bufMgr->flushFile(file);
 	delete file;
 }
@@ -142,6 +153,10 @@ BTreeIndex::~BTreeIndex()
 
 const void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
 {
+	if (file->mapped())
+	{
+		throw ReadOnlyFileException(file->filename());
+	}
 	// interpret the key as integer by default
 	// be sure to update the IndexMetaInfo
 	int intKey = *(static_cast< const int*> (key));
@@ -177,11 +192,9 @@ const void BTreeIndex::startScan(const void* lowValParm,
 
 	if(hasNonLeaf)
 	{
-		Page* page;
 		NonLeafNodeInt* node;
-		PageId pageId = rootPageNum;
-		bufMgr->readPage(file, pageId, page);
-		node = reinterpret_cast<NonLeafNodeInt*> (page);
+		PageHandle page = bufMgr->fetchPage(file, rootPageNum);
+		node = reinterpret_cast<NonLeafNodeInt*> (page.page());
 		while(node->level == 0)
 		{	
 			int i;
@@ -222,12 +235,11 @@ const void BTreeIndex::startScan(const void* lowValParm,
 			// }
 			// std::cout << std::endl << std::endl;
 
-			PageId oriPid = pageId;
-			pageId = node->pageNoArray[i];
+			PageId pageId = node->pageNoArray[i];
 			// unpin the non-leaf page
-			bufMgr->unPinPage(file, oriPid, false);
-			bufMgr->readPage(file, pageId, page);
-			node = reinterpret_cast<NonLeafNodeInt*> (page);
+			page.release();
+			page = bufMgr->fetchPage(file, pageId);
+			node = reinterpret_cast<NonLeafNodeInt*> (page.page());
 		}
 
 		// search the level-1 non-leaf node for the leaf node
@@ -270,11 +282,9 @@ const void BTreeIndex::startScan(const void* lowValParm,
 		// }
 		// std::cout << std::endl << std::endl;
 
-		PageId oriPid = pageId;
-		pageId = node->pageNoArray[pos];
-		bufMgr->unPinPage(file, oriPid, false);
-		currentPageNum = pageId;
-		bufMgr->readPage(file, currentPageNum, currentPageData);
+		PageId pageId = node->pageNoArray[pos];
+		page.release();
+		currentPage = bufMgr->fetchPage(file, pageId);
 		nextEntry = 0;
 	}
 	else
@@ -283,8 +293,7 @@ const void BTreeIndex::startScan(const void* lowValParm,
 		// only set b+ tree fileds when there are records ever inserted
 		if(rootPageNum != 0)
 		{
-			currentPageNum = rootPageNum;
-			bufMgr->readPage(file, currentPageNum, currentPageData);
+			currentPage = bufMgr->fetchPage(file, rootPageNum);
 			nextEntry = 0;
 		}
 	}
@@ -295,6 +304,16 @@ const void BTreeIndex::startScan(const void* lowValParm,
 // -----------------------------------------------------------------------------
 
 const void BTreeIndex::scanNext(RecordId& outRid) 
+{
+	if(!tryScanNext(outRid))
+		throw IndexScanCompletedException();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::tryScanNext
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::tryScanNext(RecordId& outRid) 
 {
 
 	assert(scanExecuting);
@@ -303,12 +322,12 @@ const void BTreeIndex::scanNext(RecordId& outRid)
 	if(rootPageNum == 0)
 	{
 		assert(!hasNonLeaf);
-		throw IndexScanCompletedException();
+		return false;
 	}
 
 	while(1)
 	{
-		LeafNodeInt* node = reinterpret_cast<LeafNodeInt*> (currentPageData);
+		LeafNodeInt* node = reinterpret_cast<LeafNodeInt*> (currentPage.page());
 		// for(int i = 0; i < INTARRAYLEAFSIZE; ++i)
 		// {
 		// 	if(node->validArray[i])
@@ -330,7 +349,7 @@ const void BTreeIndex::scanNext(RecordId& outRid)
 					end = (node->keyArray[i] > highValInt);
 
 				if(end)
-					throw IndexScanCompletedException();
+					return false;
 
 				if(lowOp == Operator::GT)
 					sat = sat && (node->keyArray[i] > lowValInt);
@@ -350,7 +369,7 @@ const void BTreeIndex::scanNext(RecordId& outRid)
 					nextEntry = i + 1;
 					// std::cout << "nextEntry = " << nextEntry << std::endl;
 					// std::cout << "rightSibPageNo = " << node->rightSibPageNo << std::endl << std::endl;
-					return;
+					return true;
 				}
 			}
 		}
@@ -358,15 +377,18 @@ const void BTreeIndex::scanNext(RecordId& outRid)
 		// std::cout << "out of page loop" << std::endl;
 
 		if(node->rightSibPageNo == 0)
-			throw IndexScanCompletedException();
+			return false;
 
 		nextEntry = 0;
 		// unpin the current page
-		PageId oriPid = currentPageNum;
-		currentPageNum = node->rightSibPageNo;
-		bufMgr->unPinPage(file, oriPid, false);
+		PageId nextPageNum = node->rightSibPageNo;
+		currentPage.release();
 		// read the next page in
-		bufMgr->readPage(file, currentPageNum, currentPageData);
+		currentPage = bufMgr->fetchPage(file, nextPageNum);
+		// leaves are not in page order, so ask for the one after it explicitly
+		PageId nextSibPageNo = reinterpret_cast<LeafNodeInt*> (currentPage.page())->rightSibPageNo;
+		if(nextSibPageNo != 0)
+			bufMgr->prefetch(file, std::vector<PageId>(1, nextSibPageNo));
 	}
 }
 
@@ -380,10 +402,9 @@ const void BTreeIndex::endScan()
 		throw ScanNotInitializedException();
 
 	// need to unpin the last page here
-	bufMgr->unPinPage(file, currentPageNum, false);
+	currentPage.release();
 	scanExecuting = false;
 	nextEntry = 0;
-	currentPageData = NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -489,9 +510,9 @@ void BTreeIndex::leafNodeInsertSplit(LeafNodeInt* curNode, int key, RecordId rid
 
 	// allocate a new page
 	PageId newPid;
-	Page* newPage;
-	bufMgr->allocPage(file, newPid, newPage);
-	LeafNodeInt* newNode = reinterpret_cast<LeafNodeInt*> (newPage);
+	PageHandle newPage = bufMgr->newPage(file, newPid);
+	newPage.markDirty();
+	LeafNodeInt* newNode = reinterpret_cast<LeafNodeInt*> (newPage.page());
 	int k;
 	for(k = 0; k < (INTARRAYLEAFSIZE + 1)/2; ++k)
 	{
@@ -536,7 +557,6 @@ void BTreeIndex::leafNodeInsertSplit(LeafNodeInt* curNode, int key, RecordId rid
 	// std::cout << "in leaf node feedbackTuple.newPid = " << newPid << std::endl;
 	// std::cout << std::endl << std::endl;
 
-	bufMgr->unPinPage(file, newPid, true);
 	// std::cout << "key = " << key << " inserted" << std::endl;
 }
 
@@ -657,10 +677,10 @@ void BTreeIndex::nonLeafNodeInsertSplit(NonLeafNodeInt* curNode, const PageKeyPa
 
 	// allocate a new page
 	PageId newPid;
-	Page* newPage;
-	bufMgr->allocPage(file, newPid, newPage);
+	PageHandle newPage = bufMgr->newPage(file, newPid);
+	newPage.markDirty();
 
-	NonLeafNodeInt* newNode = reinterpret_cast<NonLeafNodeInt*> (newPage);
+	NonLeafNodeInt* newNode = reinterpret_cast<NonLeafNodeInt*> (newPage.page());
 	int updateKey = keyBuffer[(INTARRAYNONLEAFSIZE + 1)/2];	// key used for upper level updates
 	int k;
 	for(k = 0; k < (INTARRAYNONLEAFSIZE + 1)/2; ++k)
@@ -717,9 +737,7 @@ void BTreeIndex::nonLeafNodeInsertSplit(NonLeafNodeInt* curNode, const PageKeyPa
 
 	// update feedback tuple
 	feedbackTuple.set(newPid, updateKey);
-	// only unpin the newly allocated page
-	// std::cout << "before unPinPage in nonLeafNodeInsertSplit" << std::endl;
-	bufMgr->unPinPage(file, newPid, true);
+	// only the newly allocated page is unpinned, by newPage going away
 }
 
 void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoot, bool& needsUpate, PageKeyPair<int>& feedbackTuple)
@@ -733,26 +751,22 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 		// the first record inserted ever, need to allocate page
 		if(rootPageNum == 0)
 		{
-			Page* rootPage;
-			bufMgr->allocPage(file, rootPageNum, rootPage);
+			PageHandle rootPage = bufMgr->newPage(file, rootPageNum);
+			rootPage.markDirty();
 			assert(rootPageNum > 0);
-			LeafNodeInt* node = reinterpret_cast<LeafNodeInt*> (rootPage);
+			LeafNodeInt* node = reinterpret_cast<LeafNodeInt*> (rootPage.page());
 			node->rightSibPageNo = 0; // 0 represents end of leaf node chain
 			for(int i = 0; i < INTARRAYLEAFSIZE; ++i)
 				node->validArray[i] = false;
 			leafNodeInsert(node, key, rid);
 				
 			// update the header page
-			Page* headerPage;
-			bufMgr->readPage(file, headerPageNum, headerPage);
-			IndexMetaInfo* indexMeta = reinterpret_cast<IndexMetaInfo*> (headerPage);
+			PageHandle headerPage = bufMgr->fetchPage(file, headerPageNum);
+			headerPage.markDirty();
+			IndexMetaInfo* indexMeta = reinterpret_cast<IndexMetaInfo*> (headerPage.page());
 			indexMeta->rootPageNo = rootPageNum;
 
-			// unpin the root & header pages
-			// std::cout << "before unPinPage headerPage in insertEntryUpdate" << std::endl;
-			bufMgr->unPinPage(file, headerPageNum, true);
-			// std::cout << "before unPinPage rootPageNum in insertEntryUpdate" << std::endl;
-			bufMgr->unPinPage(file, rootPageNum, true);
+			// the root & header pages are unpinned on return
 
 			needsUpate = false;
 			return;
@@ -761,9 +775,9 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 		{
 			// TODO: remember to update headerPage & unpin pages!!!
 			// the leaf page already exists and is not full
-			Page* rootPage;
-			bufMgr->readPage(file, rootPageNum, rootPage);
-			LeafNodeInt* node = reinterpret_cast<LeafNodeInt*> (rootPage);
+			PageHandle rootPage = bufMgr->fetchPage(file, rootPageNum);
+			rootPage.markDirty();
+			LeafNodeInt* node = reinterpret_cast<LeafNodeInt*> (rootPage.page());
 			int vldCnt = 0;
 			for(int i = 0; i < INTARRAYLEAFSIZE; ++i)
 			{
@@ -777,10 +791,10 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 				PageKeyPair<int> tuple;
 				leafNodeInsertSplit(node, key, rid, tuple);
 				// create a new root node, the key is in ftuple, and the 2 ptrs are in original root page number & tuple (right side)
-				Page* newRootPage;
 				PageId newRootPid;
-				bufMgr->allocPage(file, newRootPid, newRootPage);
-				NonLeafNodeInt* rootNode = reinterpret_cast<NonLeafNodeInt*> (newRootPage);
+				PageHandle newRootPage = bufMgr->newPage(file, newRootPid);
+				newRootPage.markDirty();
+				NonLeafNodeInt* rootNode = reinterpret_cast<NonLeafNodeInt*> (newRootPage.page());
 				rootNode->level = 1;	// just above the leaf nodes
 				for(int i = 1; i < INTARRAYNONLEAFSIZE; ++i)
 					rootNode->validArray[i] = false;
@@ -790,25 +804,20 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 				rootNode->pageNoArray[1] = tuple.pageNo;
 
 				// update the header page
-				Page* headerPage;
-				bufMgr->readPage(file, headerPageNum, headerPage);
-				IndexMetaInfo* indexMeta = reinterpret_cast<IndexMetaInfo*> (headerPage);
+				PageHandle headerPage = bufMgr->fetchPage(file, headerPageNum);
+				headerPage.markDirty();
+				IndexMetaInfo* indexMeta = reinterpret_cast<IndexMetaInfo*> (headerPage.page());
 				indexMeta->rootPageNo = newRootPid;
 				indexMeta->hasNonLeaf = true;
 
-				// std::cout << "before unPinPage rootPage 2 in insertEntryUpdate" << std::endl;
 				// unpin the original root page
-				bufMgr->unPinPage(file, rootPageNum, true);
+				rootPage.release();
 
 				// update the b+ tree fields
 				rootPageNum = newRootPid;
 				hasNonLeaf = true;
 
-				// unpin pages (the original root page, new root page & header page)
-				// std::cout << "before unPinPage headerPage 2 in insertEntryUpdate" << std::endl;
-				bufMgr->unPinPage(file, headerPageNum, true);
-				// std::cout << "before unPinPage new rootPage 2 in insertEntryUpdate" << std::endl;
-				bufMgr->unPinPage(file, newRootPid, true);
+				// the new root page & header page are unpinned on return
 				return;
 			}
 			else
@@ -816,9 +825,7 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 				// the leaf node is not full, only need to update the leaf node
 				assert(vldCnt < INTARRAYLEAFSIZE);
 				leafNodeInsert(node, key, rid);
-				// unpin the root page
-				// std::cout << "before unPinPage rootPage 3 in insertEntryUpdate" << std::endl;
-				bufMgr->unPinPage(file, rootPageNum, true);
+				// the root page is unpinned on return
 				return;
 			}
 		}
@@ -827,9 +834,9 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 	// conditions below must have non-leaf nodes
 	// pid is the PageId of the current page
 	// Remember to upin pages!!!
-	Page* page;
-	bufMgr->readPage(file, pid, page);	
-	NonLeafNodeInt* node = reinterpret_cast<NonLeafNodeInt*> (page);
+	PageHandle page = bufMgr->fetchPage(file, pid);
+	page.markDirty();
+	NonLeafNodeInt* node = reinterpret_cast<NonLeafNodeInt*> (page.page());
 
 	// check if node is full
 	int sum = 0;
@@ -886,10 +893,10 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 		PageId leafPid = node->pageNoArray[pos];
 
 		// read the leaf page
-		Page* leafPage;
-		bufMgr->readPage(file, leafPid, leafPage);
+		PageHandle leafPage = bufMgr->fetchPage(file, leafPid);
+		leafPage.markDirty();
 
-		LeafNodeInt* leafNode = reinterpret_cast<LeafNodeInt*> (leafPage);
+		LeafNodeInt* leafNode = reinterpret_cast<LeafNodeInt*> (leafPage.page());
 		int vldCnt = 0;
 		for(int k = 0; k < INTARRAYLEAFSIZE; ++k)
 		{
@@ -926,7 +933,6 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 			}
 		}
 
-		bufMgr->unPinPage(file, leafPid, true);
 	}
 	else
 	{
@@ -973,8 +979,7 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 		}
 	}
 
-	// std::cout << "before unPinPage 3 in insertEntryUpdate" << std::endl;
-	bufMgr->unPinPage(file, pid, true);
+	page.release();
 
 	// std::cout << "at non-root node, needsUpate = " << needsUpate <<", ";
 	// std::cout << "feedbackTuple.pageNo = " << feedbackTuple.pageNo << ", feedbackTuple.key = " << feedbackTuple.key << std::endl;
@@ -989,10 +994,10 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 		{
 			// std::cout << "one more level of node created" << std::endl;
 			PageId newRootPid;
-			Page* newRootPage;
-			bufMgr->allocPage(file, newRootPid, newRootPage);
+			PageHandle newRootPage = bufMgr->newPage(file, newRootPid);
+			newRootPage.markDirty();
 
-			NonLeafNodeInt* rootNode = reinterpret_cast<NonLeafNodeInt*> (newRootPage);
+			NonLeafNodeInt* rootNode = reinterpret_cast<NonLeafNodeInt*> (newRootPage.page());
 			rootNode->level = 0;
 			for(int i = 1; i < INTARRAYNONLEAFSIZE; ++i)
 				rootNode->validArray[i] = false;
@@ -1002,9 +1007,9 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 			rootNode->pageNoArray[1] = feedbackTuple.pageNo;
 
 			// update the header page
-			Page* headerPage;
-			bufMgr->readPage(file, headerPageNum, headerPage);
-			IndexMetaInfo* indexMeta = reinterpret_cast<IndexMetaInfo*> (headerPage);
+			PageHandle headerPage = bufMgr->fetchPage(file, headerPageNum);
+			headerPage.markDirty();
+			IndexMetaInfo* indexMeta = reinterpret_cast<IndexMetaInfo*> (headerPage.page());
 			indexMeta->rootPageNo = newRootPid;
 			assert(indexMeta->hasNonLeaf);
 
@@ -1027,11 +1032,7 @@ void BTreeIndex::insertEntryUpdate(int key, RecordId rid, PageId pid, bool isRoo
 			// 	std::cout << "ptr = " << rootNode->pageNoArray[ii] << std::endl;
 			// std::cout << std::endl;
 
-			// unpin pages (the original root page, new root page & header page)
-			// std::cout << "before unPinPage 6 in insertEntryUpdate" << std::endl;
-			bufMgr->unPinPage(file, headerPageNum, true);
-			// std::cout << "before unPinPage headerPage 7 in insertEntryUpdate" << std::endl;
-			bufMgr->unPinPage(file, newRootPid, true);
+			// the new root page & header page are unpinned by their handles
 		}
 	}
 
@@ -1047,16 +1048,9 @@ void BTreeIndex::showLeavesKey()
 	
 	startScan(static_cast<const void*> (& lowVal), Operator::GT, static_cast<const void*> (& highVal), Operator::LT);
 
-	bool end = false;
-	while(!end)
+	RecordId id;
+	while(tryScanNext(id))
 	{
-		RecordId id;
-		try {
-			scanNext(id);
-		} catch (IndexScanCompletedException)
-		{
-			end = true;
-		}
 	}
 	endScan();
 }
@@ -263,14 +263,9 @@ class BTreeIndex {
 	int			nextEntry;
 
   /**
-   * Page number of current page being scanned.
+   * Current Page being scanned, pinned until the scan moves off it.
    */
-	PageId	currentPageNum;
-
-  /**
-   * Current Page being scanned.
-   */
-	Page		*currentPageData;
+	PageHandle	currentPage;
 
   /**
    * Low INTEGER value for scan.
@@ -383,10 +378,14 @@ class BTreeIndex {
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
+   * @param strategy						MAPPED_READ to read the index, once it exists, in place from a read only mapping of the file
+   *													instead of through the buffer pool; entries cannot be inserted then.  Other strategies
+   *													read it through the pool.
    * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const BufferAccessStrategy strategy = NORMAL_ACCESS);
 	
 
   /**
@@ -406,6 +405,7 @@ class BTreeIndex {
 	 * Make sure to unpin pages as soon as you can.
    * @param key			Key to insert, pointer to integer/double/char string
    * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   * @throws  ReadOnlyFileException	If the index was opened with strategy MAPPED_READ
 	**/
 	const void insertEntry(const void* key, const RecordId rid);
 
@@ -438,6 +438,16 @@ class BTreeIndex {
 	const void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+	 * Same as scanNext(), but reports the end of the scan through the return value instead of
+	 * throwing IndexScanCompletedException.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @return False if no more records, satisfying the scan criteria, are left to be scanned.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	bool tryScanNext(RecordId& outRid);
+
+
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
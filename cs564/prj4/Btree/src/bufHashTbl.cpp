@@ -5,7 +5,9 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <cstdlib>
 #include <memory>
+#include <new>
 #include <iostream>
 #include "buffer.h"
 #include "bufHashTbl.h"
@@ -15,100 +17,205 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+const std::uint32_t BufHashTbl::MIGRATE_STEP;
+
+std::uint32_t BufHashTbl::slotsFor(const std::uint32_t htSize)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // size every partition for a load factor of at most 1/2
+  std::uint32_t slots = 8;
+  while (slots * NUM_PARTITIONS < htSize * 2)
+    slots <<= 1;
+  return slots;
 }
 
 BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
-  for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+  std::uint32_t slots = slotsFor(htSize);
+
+  for(int i = 0; i < NUM_PARTITIONS; i++) {
+    partitions[i].slots = static_cast<hashBucket*>(std::calloc(slots, sizeof(hashBucket)));
+    if (!partitions[i].slots)
+      throw HashTableException();
+    partitions[i].mask = slots - 1;
+    partitions[i].count = 0;
+    partitions[i].oldSlots = NULL;
+    partitions[i].oldMask = 0;
+    partitions[i].oldCount = 0;
+    partitions[i].migrated = 0;
+  }
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
+  for(int i = 0; i < NUM_PARTITIONS; i++) {
+    std::free(partitions[i].slots);
+    std::free(partitions[i].oldSlots);
+  }
+}
+
+hashBucket* BufHashTbl::probe(hashBucket* slots, const std::uint32_t mask, const std::uint64_t h,
+                              const File* file, const PageId pageNo)
+{
+  std::uint32_t index = h & mask;
+  while (slots[index].file != NULL &&
+         (slots[index].file != file || slots[index].pageNo != pageNo))
+    index = (index + 1) & mask;
+  return &slots[index];
+}
+
+void BufHashTbl::removeAt(hashBucket* slots, const std::uint32_t mask, std::uint32_t hole)
+{
+  std::uint32_t next = (hole + 1) & mask;
+  while (slots[next].file != NULL)
+	{
+    std::uint32_t home = hash(slots[next].file, slots[next].pageNo) & mask;
+    // the entry may move into the hole unless its home lies cyclically in (hole, next]
+    if (((next - home) & mask) >= ((next - hole) & mask))
+		{
+      slots[hole] = slots[next];
+      hole = next;
     }
+    next = (next + 1) & mask;
   }
-  delete [] ht;
+  slots[hole].file = NULL;
 }
 
-void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+void BufHashTbl::grow(Partition& part, const std::uint32_t size)
 {
-  int index = hash(file, pageNo);
+  if (part.oldSlots)
+    migrate(part, part.oldMask + 1);
+
+  // calloc hands out large arrays as fresh zero pages, so allocating does not
+  // touch every slot while the latch is held
+  hashBucket* newSlots = static_cast<hashBucket*>(std::calloc(size, sizeof(hashBucket)));
+  if (!newSlots)
+    throw HashTableException();
+
+  part.oldSlots = part.slots;
+  part.oldMask = part.mask;
+  part.oldCount = part.count;
+  part.migrated = 0;
+  part.slots = newSlots;
+  part.mask = size - 1;
+  part.count = 0;
+}
 
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
+void BufHashTbl::migrate(Partition& part, std::uint32_t steps)
+{
+  for (; steps > 0 && part.oldCount > 0 && part.migrated <= part.oldMask; steps--)
+  {
+    // removing an entry may shift the next one of its probe sequence into
+    // the same slot, so empty the slot completely before moving on
+    hashBucket& slot = part.oldSlots[part.migrated];
+    while (slot.file != NULL)
+    {
+      *probe(part.slots, part.mask, hash(slot.file, slot.pageNo), slot.file, slot.pageNo) = slot;
+      part.count++;
+      removeAt(part.oldSlots, part.oldMask, part.migrated);
+      part.oldCount--;
+    }
+    part.migrated++;
   }
 
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
-  	throw HashTableException();
+  if (part.oldCount == 0)
+  {
+    std::free(part.oldSlots);
+    part.oldSlots = NULL;
+  }
+}
+
+void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  std::uint64_t h = hash(file, pageNo);
+  Partition& part = partitionOf(h);
+  if (part.oldSlots)
+    migrate(part, MIGRATE_STEP);
+
+  hashBucket* tmpBuc = probe(part.slots, part.mask, h, file, pageNo);
+  if (tmpBuc->file == NULL && part.oldSlots)
+  {
+    hashBucket* oldBuc = probe(part.oldSlots, part.oldMask, h, file, pageNo);
+    if (oldBuc->file != NULL)
+      tmpBuc = oldBuc;
+  }
+  if (tmpBuc->file != NULL)
+    throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
 
-  tmpBuc->file = (File*) file;
+  if ((part.count + part.oldCount + 1) * 4 > (part.mask + 1) * 3) {
+    grow(part, (part.mask + 1) * 2);
+    migrate(part, MIGRATE_STEP);
+    tmpBuc = probe(part.slots, part.mask, h, file, pageNo);
+  }
+
+  tmpBuc->file = file;
   tmpBuc->pageNo = pageNo;
   tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  part.count++;
 }
 
 void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-    {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
+  if (!tryLookup(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+bool BufHashTbl::tryLookup(const File* file, const PageId pageNo, FrameId &frameNo)
+{
+  std::uint64_t h = hash(file, pageNo);
+  Partition& part = partitionOf(h);
+  hashBucket* tmpBuc = probe(part.slots, part.mask, h, file, pageNo);
+  if (tmpBuc->file == NULL && part.oldSlots)
+  {
+    migrate(part, MIGRATE_STEP);
+    tmpBuc = probe(part.slots, part.mask, h, file, pageNo);
+    if (tmpBuc->file == NULL && part.oldSlots)
+      tmpBuc = probe(part.oldSlots, part.oldMask, h, file, pageNo);
   }
+  if (tmpBuc->file == NULL)
+    return false;
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  frameNo = tmpBuc->frameNo; // return frameNo by reference
+  return true;
 }
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
-
-  while (tmpBuc)
-	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
+  std::uint64_t h = hash(file, pageNo);
+  Partition& part = partitionOf(h);
+  if (part.oldSlots)
+    migrate(part, MIGRATE_STEP);
+
+  hashBucket* tmpBuc = probe(part.slots, part.mask, h, file, pageNo);
+  if (tmpBuc->file != NULL)
+  {
+    removeAt(part.slots, part.mask, tmpBuc - part.slots);
+    part.count--;
+    return;
+  }
 
-      delete tmpBuc;
+  if (part.oldSlots)
+  {
+    tmpBuc = probe(part.oldSlots, part.oldMask, h, file, pageNo);
+    if (tmpBuc->file != NULL)
+    {
+      removeAt(part.oldSlots, part.oldMask, tmpBuc - part.oldSlots);
+      part.oldCount--;
+      migrate(part, 0);
       return;
-    }
-		else
-		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
     }
   }
-
   throw HashNotFoundException(file->filename(), pageNo);
 }
 
+void BufHashTbl::reserve(const std::uint32_t htSize)
+{
+  std::uint32_t slots = slotsFor(htSize);
+  for (int i = 0; i < NUM_PARTITIONS; i++)
+  {
+    std::lock_guard<std::mutex> lock(partitions[i].latch);
+    if (partitions[i].mask + 1 < slots)
+      grow(partitions[i], slots);
+  }
+}
+
 }
@@ -7,18 +7,23 @@
 
 #pragma once
 
+#include <cstdint>
+#include <mutex>
 #include "file.h"
 
 namespace badgerdb {
 
 /**
 * @brief Declarations for buffer pool hash table
+*
+* One slot of the open addressing table.  Slots are stored inline in an array,
+* a slot whose file is NULL is empty.
 */
 struct hashBucket {
 	/**
 	 * pointer a file object (more on this below)
 	 */
-	File *file;
+	const File *file;
 
 	/**
 	 * page number within a file
@@ -29,43 +34,158 @@ struct hashBucket {
 	 * frame number of page in the buffer pool
 	 */
 	FrameId frameNo;
-
-	/**
-	 * Next node in the hash table
-	 */
-	hashBucket*   next;
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
-* @warning This class is not threadsafe.
+* The table is split into NUM_PARTITIONS independent linear probing tables,
+* each guarded by its own latch.  The top bits of the hash of (file, pageNo)
+* select the partition and the low bits the home slot inside it.  Each
+* partition has a power of two number of slots and only reallocates when its
+* load factor passes 3/4, so inserts normally do not allocate.
+*
+* A partition grows incrementally: it allocates a slot array twice the size
+* and from then on every operation on the partition moves the entries of a
+* few old slots across, while lookups look in both arrays.  No single
+* operation pays for rehashing the whole partition.
+*
+* insert(), lookup() and remove() do not take any latch themselves; callers
+* must hold partitionLatch() for the (file, pageNo) they operate on.
 */
 class BufHashTbl
 {
+ public:
+	/**
+	 * Number of latch partitions the table is divided into
+	 */
+  static const int NUM_PARTITIONS = 16;
+
+	/**
+	 * Number of old slots every operation moves across while a partition grows
+	 */
+  static const std::uint32_t MIGRATE_STEP = 8;
+
  private:
 	/**
-	 *	Size of Hash Table
+	 * One linear probing table together with the latch guarding it
 	 */
-  int HTSIZE;
+  struct Partition {
+		/**
+		 * Slot array, size is always a power of two
+		 */
+    hashBucket* slots;
+
+		/**
+		 * Number of slots minus one
+		 */
+    std::uint32_t mask;
+
+		/**
+		 * Number of used slots
+		 */
+    std::uint32_t count;
+
+		/**
+		 * Slot array being moved into slots while the partition grows, NULL
+		 * otherwise.  Old slots below migrated are empty.
+		 */
+    hashBucket* oldSlots;
+
+		/**
+		 * Number of old slots minus one
+		 */
+    std::uint32_t oldMask;
+
+		/**
+		 * Number of used old slots
+		 */
+    std::uint32_t oldCount;
+
+		/**
+		 * Next old slot to move across
+		 */
+    std::uint32_t migrated;
+
+		/**
+		 * Latch guarding this partition
+		 */
+    std::mutex latch;
+  };
+
 	/**
-	 * Actual Hash table object
+	 * Partitions of the table
 	 */
-  hashBucket**  ht;
+  Partition partitions[NUM_PARTITIONS];
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * Returns a well mixed 64 bit hash of file and pageNo
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  static std::uint64_t hash(const File* file, const PageId pageNo)
+  {
+    std::uint64_t h = reinterpret_cast<std::uintptr_t>(file);
+    h ^= (static_cast<std::uint64_t>(pageNo) << 32) | pageNo;
+    // finalizer of MurmurHash3
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb3fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+	/**
+	 * Returns the partition an already computed hash value belongs to
+	 */
+  Partition& partitionOf(const std::uint64_t h)
+  {
+    static_assert(NUM_PARTITIONS == 16, "partition is taken from the top 4 bits of the hash");
+    return partitions[h >> 60];
+  }
+
+	/**
+	 * Returns the slot holding (file, pageNo) in a slot array, or the empty
+	 * slot which ends its probe sequence if it is not present.
+	 */
+  static hashBucket* probe(hashBucket* slots, const std::uint32_t mask, const std::uint64_t h,
+                           const File* file, const PageId pageNo);
+
+	/**
+	 * Empties a slot, shifting later entries of its probe sequence back so that
+	 * lookups never need tombstones.
+	 */
+  static void removeAt(hashBucket* slots, const std::uint32_t mask, std::uint32_t hole);
+
+	/**
+	 * Allocates a slot array of the given size for a partition and starts
+	 * moving its entries across.  A move still in progress is finished first.
+	 *
+	 * @throws  HashTableException if the new slot array could not be allocated
+	 */
+  static void grow(Partition& part, const std::uint32_t size);
+
+	/**
+	 * Moves the entries of up to steps old slots of a growing partition across,
+	 * and frees the old slot array once it is empty.
+	 */
+  static void migrate(Partition& part, std::uint32_t steps);
+
+	/**
+	 * Returns the number of slots a partition needs for htSize entries in the
+	 * whole table.
+	 */
+  static std::uint32_t slotsFor(const std::uint32_t htSize);
 
  public:
 	/**
    * Constructor of BufHashTbl class
+	 *
+	 * @param htSize	Expected number of entries, used to size the partitions
 	 */
 	BufHashTbl(const int htSize);  // constructor
 
@@ -73,7 +193,43 @@ class BufHashTbl
    * Destructor of BufHashTbl class
 	 */
   ~BufHashTbl(); // destructor
-	
+
+	/**
+   * Returns the latch guarding the partition of (file, pageNo).
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Latch of the partition the entry hashes to.
+	 */
+  std::mutex& partitionLatch(const File* file, const PageId pageNo)
+  {
+    return partitionOf(hash(file, pageNo)).latch;
+  }
+
+	/**
+   * Returns the latch guarding the given partition.
+	 *
+	 * @param partitionNo	Partition number, see partitionNo()
+	 * @return  			Latch of the partition.
+	 */
+  std::mutex& partitionLatch(const int partitionNo)
+  {
+    return partitions[partitionNo].latch;
+  }
+
+	/**
+   * Returns the number of the partition (file, pageNo) belongs to, for callers
+   * which keep data of their own under partitionLatch().
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Partition number, below NUM_PARTITIONS
+	 */
+  static int partitionNo(const File* file, const PageId pageNo)
+  {
+    return hash(file, pageNo) >> 60;
+  }
+
 	/**
    * Insert entry into hash table mapping (file, pageNo) to frameNo.
 	 *
@@ -92,18 +248,41 @@ class BufHashTbl
 	 * @param file  	File object
 	 * @param pageNo	Page number in the file
 	 * @param frameNo Frame number reference
-   * @throws HashNotFoundException if the page entry is not found in the hash table 
+   * @throws HashNotFoundException if the page entry is not found in the hash table
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool (ie. in
+   * the hash table).  Same as lookup() but reports a miss through the return
+   * value, for callers where a miss is an expected outcome.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, only set if the entry was found
+	 * @return  			True if the entry was found
+	 */
+  bool tryLookup(const File* file, const PageId pageNo, FrameId &frameNo);
+
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
-   * @throws HashNotFoundException if the page entry is not found in the hash table 
+   * @throws HashNotFoundException if the page entry is not found in the hash table
+	 */
+  void remove(const File* file, const PageId pageNo);
+
+	/**
+   * Make room for the given number of entries, so that inserting them causes
+   * no further growth.  Partitions which are too small start growing
+   * incrementally; the table never shrinks.  Takes the partition latches
+   * itself, so the caller must hold none of them.
+	 *
+	 * @param htSize	Expected number of entries
+   * @throws  HashTableException if a new slot array could not be allocated
 	 */
-  void remove(const File* file, const PageId pageNo);  
+  void reserve(const std::uint32_t htSize);
 };
 
 }
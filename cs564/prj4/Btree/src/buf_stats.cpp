@@ -0,0 +1,243 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdio>
+#include "buf_stats.h"
+
+namespace badgerdb {
+
+const int Histogram::NUM_BUCKETS;
+
+//----------------------------------------
+// Histograms
+//----------------------------------------
+
+int Histogram::bucketOf(const std::uint64_t value)
+{
+  if (value == 0)
+    return 0;
+
+  int bucket = 64 - __builtin_clzll(value);
+  return bucket < NUM_BUCKETS ? bucket : NUM_BUCKETS - 1;
+}
+
+void Histogram::clear()
+{
+  for (int i = 0; i < NUM_BUCKETS; i++)
+    buckets[i] = 0;
+  sum = 0;
+}
+
+void Histogram::snapshot(HistogramSnapshot& snapshot) const
+{
+  snapshot.buckets.resize(NUM_BUCKETS);
+  snapshot.count = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++)
+  {
+    snapshot.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    snapshot.count += snapshot.buckets[i];
+  }
+  snapshot.sum = sum.load(std::memory_order_relaxed);
+}
+
+std::uint64_t HistogramSnapshot::percentile(const double fraction) const
+{
+  if (count == 0)
+    return 0;
+
+  // the rank of the value sought, counting from 1
+  std::uint64_t rank = static_cast<std::uint64_t>(fraction * count);
+  if (rank < fraction * count || rank == 0)
+    rank++;
+
+  std::uint64_t seen = 0;
+  std::size_t bucket = 0;
+  for (; bucket + 1 < buckets.size(); bucket++)
+  {
+    seen += buckets[bucket];
+    if (seen >= rank)
+      break;
+  }
+  return bucket == 0 ? 0 : (std::uint64_t(1) << bucket) - 1;
+}
+
+//----------------------------------------
+// Striped counters
+//----------------------------------------
+
+std::atomic<unsigned> StripedCounter::nextStripe(0);
+
+std::uint64_t StripedCounter::load() const
+{
+  std::uint64_t sum = 0;
+  for (int i = 0; i < NUM_STRIPES; i++)
+    sum += stripes[i].value.load(std::memory_order_relaxed);
+  return sum;
+}
+
+void StripedCounter::clear()
+{
+  for (int i = 0; i < NUM_STRIPES; i++)
+    stripes[i].value.store(0, std::memory_order_relaxed);
+}
+
+//----------------------------------------
+// Buffer pool statistics
+//----------------------------------------
+
+void BufStats::clear()
+{
+  accesses.clear();
+  hits.clear();
+  misses.clear();
+  mappedReads = 0;
+  diskreads = diskwrites = bgwrites = prefetchreads = asyncRequests = 0;
+  cleanEvictions = dirtyEvictions = 0;
+  pinWaits = allocWaits = allocFailures = lostPins = 0;
+  sweepLength.clear();
+  readPageLatency.clear();
+  allocPageLatency.clear();
+  writePageLatency.clear();
+  allocWaitTime.clear();
+}
+
+void BufStats::snapshot(BufStatsSnapshot& snapshot) const
+{
+  snapshot.accesses = accesses.load();
+  snapshot.hits = hits.load();
+  snapshot.misses = misses.load();
+  snapshot.mappedReads = mappedReads;
+  snapshot.diskreads = diskreads;
+  snapshot.diskwrites = diskwrites;
+  snapshot.bgwrites = bgwrites;
+  snapshot.prefetchreads = prefetchreads;
+  snapshot.asyncRequests = asyncRequests;
+  snapshot.cleanEvictions = cleanEvictions;
+  snapshot.dirtyEvictions = dirtyEvictions;
+  snapshot.pinWaits = pinWaits;
+  snapshot.allocWaits = allocWaits;
+  snapshot.allocFailures = allocFailures;
+  snapshot.lostPins = lostPins;
+  sweepLength.snapshot(snapshot.sweepLength);
+  readPageLatency.snapshot(snapshot.readPageLatency);
+  allocPageLatency.snapshot(snapshot.allocPageLatency);
+  writePageLatency.snapshot(snapshot.writePageLatency);
+  allocWaitTime.snapshot(snapshot.allocWaitTime);
+}
+
+/**
+ * Print the summary of a histogram on one line.
+ */
+static void printHistogram(std::ostream& os, const char* name, const HistogramSnapshot& h)
+{
+  os << name << ": count " << h.count << "  mean " << h.mean()
+     << "  p50 <= " << h.percentile(0.5) << "  p99 <= " << h.percentile(0.99)
+     << "  max <= " << h.percentile(1.0) << "\n";
+}
+
+void BufStatsSnapshot::print(std::ostream& os) const
+{
+  os << "accesses: " << accesses << "  hits: " << hits << "  misses: " << misses
+     << "  mapped: " << mappedReads << "\n";
+  os << "disk reads: " << diskreads << " (prefetch " << prefetchreads << ")"
+     << "  disk writes: " << diskwrites << " (background " << bgwrites << ")"
+     << "  async requests: " << asyncRequests << "\n";
+  os << "evictions: clean " << cleanEvictions << "  dirty " << dirtyEvictions << "\n";
+  os << "pin waits: " << pinWaits << "  allocation waits: " << allocWaits
+     << "  allocation failures: " << allocFailures << "  lost pins: " << lostPins << "\n";
+  printHistogram(os, "sweep length (frames)", sweepLength);
+  printHistogram(os, "readPage latency (ns)", readPageLatency);
+  printHistogram(os, "allocPage latency (ns)", allocPageLatency);
+  printHistogram(os, "disk write latency (ns)", writePageLatency);
+  printHistogram(os, "allocation wait (ns)", allocWaitTime);
+  for (std::size_t i = 0; i < files.size(); i++)
+  {
+    os << "file " << files[i].filename << ": hits " << files[i].hits
+       << "  misses " << files[i].misses << "\n";
+  }
+  for (std::size_t i = 0; i < pools.size(); i++)
+  {
+    os << "pool " << pools[i].name << ": frames " << pools[i].resident
+       << " (min " << pools[i].minFrames << ", max " << pools[i].maxFrames << ")\n";
+  }
+}
+
+/**
+ * Print a string as a JSON string literal.
+ */
+static void printJsonString(std::ostream& os, const std::string& s)
+{
+  os << '"';
+  for (std::size_t i = 0; i < s.size(); i++)
+  {
+    unsigned char c = s[i];
+    if (c == '"' || c == '\\')
+      os << '\\' << c;
+    else if (c < 0x20)
+    {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      os << escaped;
+    }
+    else
+      os << c;
+  }
+  os << '"';
+}
+
+/**
+ * Print a histogram as a JSON object.
+ */
+static void printJsonHistogram(std::ostream& os, const HistogramSnapshot& h)
+{
+  os << "{\"count\":" << h.count << ",\"sum\":" << h.sum
+     << ",\"p50\":" << h.percentile(0.5) << ",\"p99\":" << h.percentile(0.99)
+     << ",\"buckets\":[";
+  for (std::size_t i = 0; i < h.buckets.size(); i++)
+    os << (i ? "," : "") << h.buckets[i];
+  os << "]}";
+}
+
+void BufStatsSnapshot::printJson(std::ostream& os) const
+{
+  os << "{\"accesses\":" << accesses << ",\"hits\":" << hits << ",\"misses\":" << misses
+     << ",\"mappedReads\":" << mappedReads
+     << ",\"diskreads\":" << diskreads << ",\"diskwrites\":" << diskwrites
+     << ",\"bgwrites\":" << bgwrites << ",\"prefetchreads\":" << prefetchreads
+     << ",\"asyncRequests\":" << asyncRequests
+     << ",\"cleanEvictions\":" << cleanEvictions << ",\"dirtyEvictions\":" << dirtyEvictions
+     << ",\"pinWaits\":" << pinWaits << ",\"allocWaits\":" << allocWaits
+     << ",\"allocFailures\":" << allocFailures << ",\"lostPins\":" << lostPins;
+  os << ",\"sweepLength\":";
+  printJsonHistogram(os, sweepLength);
+  os << ",\"readPageLatencyNs\":";
+  printJsonHistogram(os, readPageLatency);
+  os << ",\"allocPageLatencyNs\":";
+  printJsonHistogram(os, allocPageLatency);
+  os << ",\"writePageLatencyNs\":";
+  printJsonHistogram(os, writePageLatency);
+  os << ",\"allocWaitTimeNs\":";
+  printJsonHistogram(os, allocWaitTime);
+  os << ",\"files\":[";
+  for (std::size_t i = 0; i < files.size(); i++)
+  {
+    os << (i ? "," : "") << "{\"filename\":";
+    printJsonString(os, files[i].filename);
+    os << ",\"hits\":" << files[i].hits << ",\"misses\":" << files[i].misses << "}";
+  }
+  os << "],\"pools\":[";
+  for (std::size_t i = 0; i < pools.size(); i++)
+  {
+    os << (i ? "," : "") << "{\"name\":";
+    printJsonString(os, pools[i].name);
+    os << ",\"minFrames\":" << pools[i].minFrames << ",\"maxFrames\":" << pools[i].maxFrames
+       << ",\"resident\":" << pools[i].resident << "}";
+  }
+  os << "]}";
+}
+
+}
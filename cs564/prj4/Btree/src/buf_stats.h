@@ -0,0 +1,452 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+* @brief Values of a histogram at one moment
+*/
+struct HistogramSnapshot
+{
+	/**
+   * Number of values in each bucket, see Histogram
+	 */
+  std::vector<std::uint64_t> buckets;
+
+	/**
+   * Number of values recorded
+	 */
+  std::uint64_t count;
+
+	/**
+   * Sum of the values recorded
+	 */
+  std::uint64_t sum;
+
+	/**
+	 * Upper bound of the bucket which the given fraction of the values does not
+	 * exceed, e.g. 0.99 for the 99th percentile.
+	 *
+	 * @param fraction	Fraction between 0 and 1
+	 * @return  				Bucket bound, 0 if nothing was recorded
+	 */
+  std::uint64_t percentile(const double fraction) const;
+
+	/**
+   * Mean of the values recorded, 0 if none
+	 */
+  std::uint64_t mean() const
+  {
+    return count == 0 ? 0 : sum / count;
+  }
+};
+
+
+/**
+* @brief Histogram with power of two buckets
+*
+* Bucket 0 counts zeros and bucket i counts values from 2^(i-1) to 2^i - 1;
+* the last bucket also takes everything larger.  Recording a value costs two
+* relaxed atomic additions, so histograms can be left on.
+*/
+class Histogram
+{
+ public:
+	/**
+   * Number of buckets, enough for nanosecond values up to about 9 minutes
+	 */
+  static const int NUM_BUCKETS = 40;
+
+	/**
+   * Constructor of Histogram class
+	 */
+  Histogram()
+  {
+    clear();
+  }
+
+	/**
+	 * Add a value to the histogram.
+	 *
+	 * @param value		Value to record
+	 */
+  void record(const std::uint64_t value)
+  {
+    buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+  }
+
+	/**
+   * Clear all buckets
+	 */
+  void clear();
+
+	/**
+	 * Copy the histogram.  Values recorded meanwhile may or may not be included.
+	 *
+	 * @param snapshot	Filled in with the current values
+	 */
+  void snapshot(HistogramSnapshot& snapshot) const;
+
+	/**
+	 * Bucket a value falls in.
+	 *
+	 * @param value		Value
+	 * @return  			Bucket number
+	 */
+  static int bucketOf(const std::uint64_t value);
+
+ private:
+	/**
+   * Number of values recorded in each bucket
+	 */
+  std::atomic<std::uint64_t> buckets[NUM_BUCKETS];
+
+	/**
+   * Sum of the values recorded
+	 */
+  std::atomic<std::uint64_t> sum;
+};
+
+
+/**
+* @brief Counter bumped on every page access, split into stripes
+*
+* Each thread adds to a stripe of its own, picked round robin when the thread
+* first counts, with a relaxed addition; reading the counter sums the
+* stripes.  Stripes are a cache line apart, so threads on different stripes
+* never write the same line, however the counter itself is aligned.
+*/
+class StripedCounter
+{
+ public:
+	/**
+   * Number of stripes, as many as BufHashTbl has partitions
+	 */
+  static const int NUM_STRIPES = 16;
+
+	/**
+   * Size of a cache line in bytes
+	 */
+  static const std::size_t CACHE_LINE = 64;
+
+	/**
+   * Constructor of StripedCounter class
+	 */
+  StripedCounter()
+  {
+    clear();
+  }
+
+	/**
+	 * Add to the counter.
+	 *
+	 * @param n				Amount to add
+	 */
+  void add(const std::uint64_t n = 1)
+  {
+    stripes[threadStripe()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+	/**
+	 * Sum of the stripes.  Additions made meanwhile may or may not be included.
+	 *
+	 * @return  			Counter value
+	 */
+  std::uint64_t load() const;
+
+	/**
+   * Set the counter to zero
+	 */
+  void clear();
+
+ private:
+	/**
+   * One stripe, padded out to a cache line.  Not aligned to one, which new
+   * does not do before C++17; the stride alone keeps the values apart.
+	 */
+  struct Stripe {
+    std::atomic<std::uint64_t> value;
+    char padding[CACHE_LINE - sizeof(std::atomic<std::uint64_t>)];
+  };
+
+	/**
+	 * Stripe of the calling thread.
+	 *
+	 * @return  			Stripe number
+	 */
+  static int threadStripe()
+  {
+    static thread_local const int stripe =
+      nextStripe.fetch_add(1, std::memory_order_relaxed) % NUM_STRIPES;
+    return stripe;
+  }
+
+	/**
+   * Stripe the next thread to count is given
+	 */
+  static std::atomic<unsigned> nextStripe;
+
+	/**
+   * The stripes
+	 */
+  Stripe stripes[NUM_STRIPES];
+};
+
+
+/**
+* @brief Hit and miss counts of one file
+*/
+struct FileStats
+{
+	/**
+   * Name of the file
+	 */
+  std::string filename;
+
+	/**
+   * Number of readPage() calls which found the page in the pool
+	 */
+  std::uint64_t hits;
+
+	/**
+   * Number of readPage() calls which had to read the page from disk
+	 */
+  std::uint64_t misses;
+
+	/**
+   * Constructor of FileStats class
+	 */
+  FileStats() : hits(0), misses(0) {}
+};
+
+
+/**
+* @brief Size and use of one named pool of frames, see BufMgr::createPool()
+*/
+struct PoolStats
+{
+	/**
+   * Name of the pool
+	 */
+  std::string name;
+
+	/**
+   * Frames the pool keeps for itself, and the most it may use
+	 */
+  std::uint32_t minFrames, maxFrames;
+
+	/**
+   * Number of frames holding pages of the pool
+	 */
+  std::uint32_t resident;
+
+	/**
+   * Constructor of PoolStats class
+	 */
+  PoolStats() : minFrames(0), maxFrames(0), resident(0) {}
+};
+
+
+/**
+* @brief Buffer pool usage statistics at one moment, see BufMgr::getStatsSnapshot()
+*/
+struct BufStatsSnapshot
+{
+	/**
+   * Counters, as described in BufStats
+	 */
+  std::uint64_t accesses;
+  std::uint64_t hits;
+  std::uint64_t misses;
+  std::uint64_t mappedReads;
+  std::uint64_t diskreads;
+  std::uint64_t diskwrites;
+  std::uint64_t bgwrites;
+  std::uint64_t prefetchreads;
+  std::uint64_t asyncRequests;
+  std::uint64_t cleanEvictions;
+  std::uint64_t dirtyEvictions;
+  std::uint64_t pinWaits;
+  std::uint64_t allocWaits;
+  std::uint64_t allocFailures;
+  std::uint64_t lostPins;
+
+	/**
+   * Number of frames the replacement policy looked at per victim search
+	 */
+  HistogramSnapshot sweepLength;
+
+	/**
+   * Latencies in nanoseconds of BufMgr::readPage(), BufMgr::allocPage() and of
+   * writes to disk
+	 */
+  HistogramSnapshot readPageLatency, allocPageLatency, writePageLatency;
+
+	/**
+   * Nanoseconds allocations spent waiting for a frame to be unpinned
+	 */
+  HistogramSnapshot allocWaitTime;
+
+	/**
+   * Hits and misses of every file read through the pool, by name
+	 */
+  std::vector<FileStats> files;
+
+	/**
+   * Named pools the frames are divided into, the default pool first
+	 */
+  std::vector<PoolStats> pools;
+
+	/**
+	 * Print the statistics in human readable form, one item per line.
+	 *
+	 * @param os			Stream to print to
+	 */
+  void print(std::ostream& os) const;
+
+	/**
+	 * Print the statistics as one JSON object.
+	 *
+	 * @param os			Stream to print to
+	 */
+  void printJson(std::ostream& os) const;
+};
+
+
+/**
+* @brief Class to maintain statistics of buffer usage
+*
+* All counters are atomic and may be updated by any thread.  The three bumped
+* on every page access are striped, see StripedCounter, so that threads
+* hitting the pool do not contend on them.  Counts per file are kept by the
+* buffer manager itself, see BufMgr::getStatsSnapshot().
+*/
+struct BufStats
+{
+	/**
+   * Total number of readPage() calls
+	 */
+  StripedCounter accesses;
+
+	/**
+   * Number of readPage() calls which found the page in the pool
+	 */
+  StripedCounter hits;
+
+	/**
+   * Number of readPage() calls which had to read the page from disk
+	 */
+  StripedCounter misses;
+
+	/**
+   * Number of readPage() calls served from the mapping of a file, see MmapFile
+	 */
+  std::atomic<std::uint64_t> mappedReads;
+
+	/**
+   * Number of pages read from disk (including allocs)
+	 */
+  std::atomic<std::uint64_t> diskreads;
+
+	/**
+   * Number of pages written back to disk
+	 */
+  std::atomic<std::uint64_t> diskwrites;
+
+	/**
+   * Number of those writes done by the background writer
+	 */
+  std::atomic<std::uint64_t> bgwrites;
+
+	/**
+   * Number of the disk reads done by prefetch or readahead
+	 */
+  std::atomic<std::uint64_t> prefetchreads;
+
+	/**
+   * Number of reads and writes of runs of pages queued on io_uring, see
+   * BufMgr::setIoDepth()
+	 */
+  std::atomic<std::uint64_t> asyncRequests;
+
+	/**
+   * Number of pages evicted without, and after, writing them back
+	 */
+  std::atomic<std::uint64_t> cleanEvictions, dirtyEvictions;
+
+	/**
+   * Number of times a thread waited for a frame another thread held: for a
+   * read in progress, or for the background writer
+	 */
+  std::atomic<std::uint64_t> pinWaits;
+
+	/**
+   * Number of allocations which found every frame pinned and waited for one
+   * to be unpinned, see BufMgr::setAllocWaitTimeout()
+	 */
+  std::atomic<std::uint64_t> allocWaits;
+
+	/**
+   * Number of times no frame could be allocated because all were pinned
+	 */
+  std::atomic<std::uint64_t> allocFailures;
+
+	/**
+   * Number of PageHandles whose pin was already gone when they were destroyed,
+   * dropped by a stray unPinPage() of the same page
+	 */
+  std::atomic<std::uint64_t> lostPins;
+
+	/**
+   * Number of frames the replacement policy looked at per victim search
+	 */
+  Histogram sweepLength;
+
+	/**
+   * Latencies in nanoseconds of readPage(), allocPage() and disk writes.
+   * Only a sample of readPage() calls is timed, see
+   * BufMgr::LATENCY_SAMPLE_INTERVAL.
+	 */
+  Histogram readPageLatency, allocPageLatency, writePageLatency;
+
+	/**
+   * Nanoseconds each of the allocWaits waited, until it got a frame or gave up
+	 */
+  Histogram allocWaitTime;
+
+	/**
+   * Clear all values
+	 */
+  void clear();
+
+	/**
+	 * Copy the counters and histograms.
+	 *
+	 * @param snapshot	Filled in with the current values, except for files
+	 */
+  void snapshot(BufStatsSnapshot& snapshot) const;
+
+	/**
+   * Constructor of BufStats class
+	 */
+  BufStats()
+  {
+		clear();
+  }
+};
+
+}
@@ -5,205 +5,2406 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <iostream>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "buffer.h"
+#include "io_ring.h"
+#include "exceptions/bad_pool_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/io_error_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
-#include "exceptions/bad_buffer_exception.h"
-#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/read_only_file_exception.h"
 
 namespace badgerdb { 
 
+const int BufMgr::WRITER_INTERVAL_MS;
+const std::uint32_t BufMgr::DEFAULT_READAHEAD_PAGES;
+const std::uint32_t BufMgr::READAHEAD_TRIGGER;
+const std::size_t BufMgr::MAX_READAHEAD_STREAMS;
+const FrameId BufMgr::NO_FRAME;
+const std::uint32_t BufMgr::MAX_WRITE_RUN;
+const std::uint32_t BufMgr::MAX_READ_RUN;
+const std::uint32_t BufMgr::MAX_POOLS;
+const char* const BufMgr::DEFAULT_POOL = "default";
+const std::uint32_t BufMgr::LATENCY_SAMPLE_INTERVAL;
+const std::uint32_t BufMgr::MAX_FRAMES;
+const int BufMgr::RESIZE_WAIT_MS;
+const int BufMgr::STALE_PIN_WAIT_MS;
+const std::uint32_t BufMgr::MAX_IO_DEPTH;
+
+/**
+ * Number of readPage() calls made by this thread, to pick the ones to time
+ */
+static thread_local std::uint32_t readPageCalls = 0;
+
+/**
+ * Nanoseconds elapsed since the given time, for the latency histograms
+ */
+static std::uint64_t nanosSince(const std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
+BufMgr::BufMgr(std::uint32_t bufs, ReplacementPolicyType policyType, const std::uint32_t maxFrames)
+	: numBufs(bufs),
+	  maxBufs(std::max<std::uint64_t>(bufs, maxFrames > 0 ? maxFrames
+	          : std::min<std::uint64_t>(std::uint64_t(bufs) * DEFAULT_GROWTH, MAX_FRAMES))),
+	  descsBuilt(0), descBytesCommitted(0), pinBytesCommitted(0),
+	  dirtyFrames(0), dirtyHead(NO_FRAME), dirtyTail(NO_FRAME), numPools(1),
+	  allocWaitTimeout(0), allocWaiters(0), frameWaiters(0), unpinEpoch(0), lowWatermark(0),
+	  highWatermark(std::numeric_limits<std::uint32_t>::max()), writerStop(false),
+	  prefetchCurrent(NULL), prefetchStop(false), warmPending(false), ioDepth(0) {
+  // reserve room to grow into, see resize()
+  reserveTables(bufs);
+  buildDescs(bufs);
+  for (FrameId i = 0; i < bufs; i++) 
+  	pinCounts[i] = 0;
+  commitRegion(reinterpret_cast<char*>(bufPool), std::size_t(bufs) * sizeof(Page), true);
+
+  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
+  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+
+  policy = ReplacementPolicy::create(policyType, bufs);
+
+  pools[0].name = DEFAULT_POOL;
+  pools[0].minFrames = 0;
+  pools[0].maxFrames = bufs;
+  for (std::uint32_t i = 0; i < MAX_POOLS; i++)
+    pools[i].resident = 0;
+
+  setReadahead(DEFAULT_READAHEAD_PAGES);
+}
+
+
+BufMgr::~BufMgr() {
+  stopPrefetcher();
+  stopBackgroundWriter();
+
+  //Flush out all unwritten pages, file by file in page number order
+  std::vector<FramePage> dirty;
+  listDirtyByPage(dirty);
+  for (std::size_t i = 0; i < dirty.size(); i++)
+  {
+  	BufDesc* tmpbuf = &bufDescTable[dirty[i].frame];
+  	// pages written along with an earlier one are clean by now
+  	if (tmpbuf->valid == true && takeDirty(dirty[i].frame))
+		{
+      try
+      {
+        writeRun(dirty[i].frame);
+      }
+      catch (...)
+      {
+        // nowhere to report it from a destructor; the other pages may still
+        // make it to disk
+      }
+  	}
+  }
+
+  for (FrameId i = 0; i < descsBuilt; i++)
+    bufDescTable[i].~BufDesc();
+  munmap(bufDescTable, descTableBytes);
+  munmap(pinCounts, pinTableBytes);
+  munmap(bufPool, bufPoolBytes);
+  delete hashTable;
+  delete policy;
+  for (std::size_t i = 0; i < idleRings.size(); i++)
+    delete idleRings[i];
+}
+
+//----------------------------------------
+// Frame memory
+//----------------------------------------
+
+// Frames are never constructed: each is filled by a read from its file or by
+// Page::initialize() before it is handed out, and never destroyed.  That also
+// lets resize() commit and drop frame memory freely.
+static_assert(std::is_trivially_copyable<Page>::value &&
+              std::is_trivially_destructible<Page>::value,
+              "frames hold Page objects without constructing them");
+
+/**
+ * Size of a transparent huge page, which large pools are aligned to
+ */
+static const std::size_t HUGE_PAGE_BYTES = 2 * 1024 * 1024;
+
+char* BufMgr::reserveRegion(const std::size_t bytes, const bool huge)
+{
+  const bool aligned = huge && bytes >= HUGE_PAGE_BYTES;
+  // map a huge page more than needed, so an aligned region fits inside
+  const std::size_t mapped = aligned ? bytes + HUGE_PAGE_BYTES : bytes;
+  void* region = mmap(NULL, mapped, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (region == MAP_FAILED)
+    throw std::bad_alloc();
+
+  char* start = static_cast<char*>(region);
+  if (aligned)
+  {
+    const std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(region);
+    const std::size_t head = (HUGE_PAGE_BYTES - addr % HUGE_PAGE_BYTES) % HUGE_PAGE_BYTES;
+    if (head > 0)
+      munmap(start, head);
+    munmap(start + head + bytes, mapped - head - bytes);
+    start += head;
+  }
+  return start;
+}
+
+void BufMgr::reserveTables(const std::uint32_t bufs)
+{
+  while (true)
+  {
+    descTableBytes = std::size_t(maxBufs) * sizeof(BufDesc);
+    pinTableBytes = std::size_t(maxBufs) * sizeof(std::atomic<int>);
+    bufPoolBytes = std::size_t(maxBufs) * sizeof(Page);
+    bufDescTable = NULL;
+    pinCounts = NULL;
+    try
+    {
+      bufDescTable = reinterpret_cast<BufDesc*>(reserveRegion(descTableBytes, false));
+      pinCounts = reinterpret_cast<std::atomic<int>*>(reserveRegion(pinTableBytes, false));
+      bufPool = reinterpret_cast<Page*>(reserveRegion(bufPoolBytes, true));
+      return;
+    }
+    catch (const std::bad_alloc&)
+    {
+      if (bufDescTable != NULL)
+        munmap(bufDescTable, descTableBytes);
+      if (pinCounts != NULL)
+        munmap(pinCounts, pinTableBytes);
+      // a limit on address space, or overcommit turned off
+      if (maxBufs == bufs)
+        throw;
+      maxBufs = std::max(bufs, maxBufs / 2);
+    }
+  }
+}
+
+void BufMgr::commitRegion(char* start, const std::size_t bytes, const bool huge)
+{
+  if (bytes == 0)
+    return;
+  if (mprotect(start, bytes, PROT_READ | PROT_WRITE) != 0)
+    throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+  // only a hint; the pool works the same without huge pages
+  if (huge && bytes >= HUGE_PAGE_BYTES)
+    madvise(start, bytes, MADV_HUGEPAGE);
+#endif
+}
+
+void BufMgr::decommitRegion(char* start, const std::size_t bytes)
+{
+  // mapping fresh inaccessible pages over the part drops its memory at once
+  if (bytes > 0)
+    mmap(start, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+}
+
+void BufMgr::buildDescs(const std::uint32_t bufs)
+{
+  if (bufs <= descsBuilt)
+    return;
+
+  const std::size_t pageBytes = sysconf(_SC_PAGESIZE);
+  const std::size_t needed = (std::size_t(bufs) * sizeof(BufDesc) + pageBytes - 1) / pageBytes * pageBytes;
+  if (needed > descBytesCommitted)
+  {
+    commitRegion(reinterpret_cast<char*>(bufDescTable) + descBytesCommitted,
+                 std::min(needed, descTableBytes) - descBytesCommitted, false);
+    descBytesCommitted = std::min(needed, descTableBytes);
+  }
+  const std::size_t pinNeeded = (std::size_t(bufs) * sizeof(std::atomic<int>) + pageBytes - 1) / pageBytes * pageBytes;
+  if (pinNeeded > pinBytesCommitted)
+  {
+    commitRegion(reinterpret_cast<char*>(pinCounts) + pinBytesCommitted,
+                 std::min(pinNeeded, pinTableBytes) - pinBytesCommitted, false);
+    pinBytesCommitted = std::min(pinNeeded, pinTableBytes);
+  }
+
+  for (FrameId i = descsBuilt; i < bufs; i++)
+  {
+    new (&bufDescTable[i]) BufDesc();
+    bufDescTable[i].frameNo = i;
+    new (&pinCounts[i]) std::atomic<int>(1);
+  }
+  descsBuilt = bufs;
+}
+
+//----------------------------------------
+// Resizing the pool
+//----------------------------------------
+
+void BufMgr::resize(const std::uint32_t bufs)
+{
+  std::lock_guard<std::mutex> lock(resizeLatch);
+  if (bufs == 0 || bufs > maxBufs)
+    throw BadPoolException(DEFAULT_POOL, "size out of range");
+
+  if (bufs > numBufs)
+    growFrames(bufs);
+  else if (bufs < numBufs)
+    shrinkFrames(bufs);
+}
+
+void BufMgr::growFrames(const std::uint32_t bufs)
+{
+  const std::uint32_t current = numBufs;
+  commitRegion(reinterpret_cast<char*>(&bufPool[current]), std::size_t(bufs - current) * sizeof(Page), true);
+  buildDescs(bufs);
+  hashTable->reserve(((int) (bufs * 1.2)) + 1);
+
+  // the policy offers the new frames from now on, but they stay claimed
+  // until they are ready to be used
+  policy->resize(bufs);
+  for (FrameId i = current; i < bufs; i++)
+  {
+    bufDescTable[i].Reset();
+    pinCounts[i] = 0;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(poolsLatch);
+    pools[0].maxFrames = bufs;
+  }
+  numBufs = bufs;
+  frameReleased();
+}
+
+void BufMgr::shrinkFrames(const std::uint32_t bufs)
+{
+  const std::uint32_t current = numBufs;
+  {
+    std::lock_guard<std::mutex> lock(poolsLatch);
+    std::uint32_t reserved = 0;
+    for (std::uint32_t i = 0; i < numPools; i++)
+      reserved += pools[i].minFrames;
+    if (reserved > bufs)
+      throw BadPoolException(DEFAULT_POOL, "minimums of the pools add up to more frames than are left");
+  }
+
+  const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+    + std::max<std::chrono::microseconds>(std::chrono::microseconds(allocWaitTimeout),
+                                          std::chrono::milliseconds(RESIZE_WAIT_MS));
+
+  // registered as a waiter, so unpins wake us up
+  std::uint64_t epoch;
+  {
+    std::lock_guard<std::mutex> lock(unpinLatch);
+    allocWaiters++;
+    epoch = unpinEpoch;
+  }
+
+  // claim every frame to remove and evict its page; a claimed frame without
+  // a page can no longer be handed out
+  FrameId frame = bufs;
+  try
+  {
+    while (frame < current)
+    {
+      BufDesc* tmpbuf = &bufDescTable[frame];
+      if (claimVictim(frame))
+      {
+        // otherwise pinned again while being written, try again
+        bool evicted;
+        try
+        {
+          evicted = evictClaimed(frame, false);
+        }
+        catch (...)
+        {
+          endEviction(frame);
+          throw;
+        }
+        endEviction(frame);
+        if (evicted)
+          frame++;
+        continue;
+      }
+
+      // pins dropped without an unpin, as by an allocation which claimed the
+      // frame and let it go again, do not wake us, so look again now and then
+      std::unique_lock<std::mutex> lock(unpinLatch);
+      unpinned.wait_for(lock, std::chrono::milliseconds(1), [this, epoch]() { return unpinEpoch != epoch; });
+      epoch = unpinEpoch;
+      if (std::chrono::steady_clock::now() < deadline)
+        continue;
+
+      const File* file = tmpbuf->valid ? tmpbuf->file : NULL;
+      throw PagePinnedException(file ? file->filename() : "", tmpbuf->pageNo, frame);
+    }
+  }
+  catch (...)
+  {
+    allocWaiters--;
+    for (FrameId i = bufs; i < frame; i++)
+      releaseBuf(i);
+    throw;
+  }
+  allocWaiters--;
+
+  policy->resize(bufs);
+  {
+    std::lock_guard<std::mutex> lock(poolsLatch);
+    pools[0].maxFrames = bufs;
+    for (std::uint32_t i = 1; i < numPools; i++)
+    {
+      if (pools[i].maxFrames > bufs)
+        pools[i].maxFrames = bufs;
+    }
+  }
+  numBufs = bufs;
+
+  // nothing points into the frames any more, as their pages have no pins
+  decommitRegion(reinterpret_cast<char*>(&bufPool[bufs]), std::size_t(current - bufs) * sizeof(Page));
+}
+
+void BufMgr::allocBuf(const File* file, FrameId & frame) 
+{
+  if (!tryAllocBuf(file, frame, true))
+    throw BufferExceededException();
+}
+
+bool BufMgr::tryAllocBuf(const File* file, FrameId & frame, const bool wait) 
+{
+  // the policy offers candidates, a frame is ours once we take its first pin
+  ReplacementPolicy::ClaimFunction claim = [this](FrameId frameNo) {
+    return claimVictim(frameNo);
+  };
+
+  // with named pools, frames the pool sizes keep from us are let go again
+  if (numPools > 1)
+  {
+    const std::uint32_t poolNo = poolOf(file);
+    claim = [this, poolNo](FrameId frameNo) {
+      if (!claimVictim(frameNo))
+        return false;
+      if (poolMayTake(poolNo, frameNo))
+        return true;
+      pinCounts[frameNo]--;
+      endEviction(frameNo);
+      return false;
+    };
+  }
+
+  std::chrono::steady_clock::time_point start, deadline;
+  bool waiting = false;
+  std::uint64_t epoch = 0;
+  while (true)
+  {
+    // evictions are abandoned when the victim gets pinned again meanwhile, so
+    // bound the attempts like the two sweeps of the clock
+    for (std::uint32_t attempts = 0; attempts < 2*numBufs; attempts++)
+    {
+      FrameId frameNo;
+      std::uint32_t scanned;
+      bool picked = policy->pickVictim(claim, frameNo, scanned);
+      bufStats.sweepLength.record(scanned);
+      if (!picked)
+      {
+        break;
+      }
+      bool evicted;
+      try
+      {
+        evicted = evictClaimed(frameNo, true);
+      }
+      catch (...)
+      {
+        endEviction(frameNo);
+        if (waiting)
+        {
+          allocWaiters--;
+          bufStats.allocWaitTime.record(nanosSince(start));
+        }
+        throw;
+      }
+      endEviction(frameNo);
+      if (evicted)
+      {
+        frame = frameNo;
+        if (waiting)
+        {
+          allocWaiters--;
+          bufStats.allocWaitTime.record(nanosSince(start));
+        }
+        return true;
+      }
+    }
+
+    // every frame is pinned: wait for an unpin, if allowed and time is left
+    if (!waiting)
+    {
+      const std::uint32_t timeout = allocWaitTimeout;
+      if (!wait || timeout == 0)
+        break;
+      start = std::chrono::steady_clock::now();
+      deadline = start + std::chrono::microseconds(timeout);
+      bufStats.allocWaits++;
+      waiting = true;
+
+      // registered before sweeping again, so an unpin from now on wakes us
+      std::lock_guard<std::mutex> lock(unpinLatch);
+      allocWaiters++;
+      epoch = unpinEpoch;
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(unpinLatch);
+    if (!unpinned.wait_until(lock, deadline, [this, epoch]() { return unpinEpoch != epoch; }))
+      break;
+    epoch = unpinEpoch;
+  }
+
+  if (waiting)
+  {
+    allocWaiters--;
+    bufStats.allocWaitTime.record(nanosSince(start));
+  }
+
+  // full buffer pool
+  bufStats.allocFailures++;
+  return false;
+} // end tryAllocBuf
+
+
+bool BufMgr::evictClaimed(const FrameId frameNo, const bool evicted)
+{
+  BufDesc* tmpbuf = &bufDescTable[frameNo];
+
+  // if invalid, use frame
+  if (!tmpbuf->valid)
+  {
+    return true;
+  }
+
+  // flush any existing changes to disk if necessary. The page is still in
+  // the hash table, so nobody can read a stale copy from disk meanwhile.
+  const bool wasDirty = takeDirty(frameNo);
+  if (wasDirty)
+  {
+    try
+    {
+      writeRun(frameNo);
+    }
+    catch (...)
+    {
+      markDirty(frameNo);
+      pinCounts[frameNo]--;
+      throw;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(hashTable->partitionLatch(tmpbuf->file, tmpbuf->pageNo));
+
+    // somebody pinned or dirtied the page while it was being written
+    if (pinCounts[frameNo] != 1 || tmpbuf->dirty)
+    {
+      pinCounts[frameNo]--;
+      return false;
+    }
+
+    // not pinned, use it
+    // remove previous entry from hash table
+    hashTable->remove(tmpbuf->file, tmpbuf->pageNo);
+    removeFileFrame(tmpbuf->file, tmpbuf->pageNo);
+  }
+  policy->pageRemoved(frameNo, evicted);
+  if (wasDirty)
+    bufStats.dirtyEvictions++;
+  else
+    bufStats.cleanEvictions++;
+
+  //Reset all the BufDesc entry for the frame before returning the frame,
+  //keeping the pin that makes it ours
+  tmpbuf->Reset();
+  return true;
+}
+
+
+bool BufMgr::allocRingBuf(BufferRing* ring, const File* file, const PageId pageNo, FrameId& frame,
+                          const bool wait)
+{
+  std::lock_guard<std::mutex> lock(ring->latch);
+
+  std::uint32_t size = ringSize(ring);
+  BufferRing::Slot& slot = ring->slots[ring->next % size];
+  ring->next = (ring->next + 1) % size;
+
+  // reuse the frame this slot got last time round, unless it is in use or
+  // has been given to another page since
+  if (slot.file != NULL)
+  {
+    BufDesc* tmpbuf = &bufDescTable[slot.frame];
+    if (claimVictim(slot.frame))
+    {
+      bool ours = !tmpbuf->valid
+        || (tmpbuf->file == slot.file && tmpbuf->pageNo == slot.pageNo);
+
+      // the scan is done with the page, so it leaves no history in the policy
+      bool evicted = false;
+      if (ours)
+      {
+        try
+        {
+          evicted = evictClaimed(slot.frame, false);
+        }
+        catch (...)
+        {
+          endEviction(slot.frame);
+          throw;
+        }
+      }
+      else
+        pinCounts[slot.frame]--;
+      endEviction(slot.frame);
+      if (evicted)
+      {
+        frame = slot.frame;
+        slot.file = file;
+        slot.pageNo = pageNo;
+        return true;
+      }
+    }
+  }
+
+  if (!tryAllocBuf(file, frame, wait))
+    return false;
+
+  slot.frame = frame;
+  slot.file = file;
+  slot.pageNo = pageNo;
+  return true;
+}
+
+
+std::uint32_t BufMgr::ringSize(const BufferRing* ring) const
+{
+  // a ring may not take up more than a small part of the pool
+  return std::min<std::uint32_t>(ring->slots.size(), std::max<std::uint32_t>(numBufs / 8, 1));
+}
+
+
+void BufMgr::releaseBuf(const FrameId frame)
+{
+  // hand the frame to the policy before dropping the pin, so nobody can claim
+  // and load it in between
+  bufDescTable[frame].Reset();
+  policy->frameFreed(frame);
+  pinCounts[frame] = 0;
+  frameReleased();
+}
+
+
+void BufMgr::waitUntil(const std::function<bool()>& done)
+{
+  // registered before the condition is checked, so a change made from now
+  // on wakes us
+  std::unique_lock<std::mutex> lock(unpinLatch);
+  frameWaiters++;
+  unpinned.wait(lock, done);
+  frameWaiters--;
+}
+
+
+bool BufMgr::waitUntil(const std::function<bool()>& done,
+                       const std::chrono::steady_clock::time_point deadline)
+{
+  std::unique_lock<std::mutex> lock(unpinLatch);
+  frameWaiters++;
+  const bool held = unpinned.wait_until(lock, deadline, done);
+  frameWaiters--;
+  return held;
+}
+
+
+bool BufMgr::waitForIo(const FrameId frame)
+{
+  BufDesc* tmpbuf = &bufDescTable[frame];
+  if (tmpbuf->ioInProgress)
+  {
+    bufStats.pinWaits++;
+    waitUntil([tmpbuf]() { return !tmpbuf->ioInProgress; });
+  }
+  return tmpbuf->valid;
+}
+
+
+void BufMgr::markDirty(const FrameId frame)
+{
+  BufDesc* tmpbuf = &bufDescTable[frame];
+  if (tmpbuf->dirty)
+    return;
+
+  std::uint32_t count;
+  {
+    std::lock_guard<std::mutex> lock(dirtyLatch);
+    if (tmpbuf->dirty.exchange(true))
+      return;
+
+    // append to the dirty list
+    tmpbuf->dirtyPrev = dirtyTail;
+    tmpbuf->dirtyNext = NO_FRAME;
+    if (dirtyTail == NO_FRAME)
+      dirtyHead = frame;
+    else
+      bufDescTable[dirtyTail].dirtyNext = frame;
+    dirtyTail = frame;
+    count = ++dirtyFrames;
+  }
+
+  if (count == highWatermark)
+    writerWakeup.notify_one();
+}
+
+
+bool BufMgr::takeDirty(const FrameId frame)
+{
+  BufDesc* tmpbuf = &bufDescTable[frame];
+  if (!tmpbuf->dirty)
+    return false;
+
+  std::lock_guard<std::mutex> lock(dirtyLatch);
+  if (!tmpbuf->dirty.exchange(false))
+    return false;
+
+  // unlink from the dirty list
+  if (tmpbuf->dirtyPrev == NO_FRAME)
+    dirtyHead = tmpbuf->dirtyNext;
+  else
+    bufDescTable[tmpbuf->dirtyPrev].dirtyNext = tmpbuf->dirtyNext;
+  if (tmpbuf->dirtyNext == NO_FRAME)
+    dirtyTail = tmpbuf->dirtyPrev;
+  else
+    bufDescTable[tmpbuf->dirtyNext].dirtyPrev = tmpbuf->dirtyPrev;
+  dirtyFrames--;
+  return true;
+}
+
+
+FileStats& BufMgr::fileStatsOf(const File* file, const PageId pageNo)
+{
+  std::unordered_map<const File*, FileStats>& stats = fileStats[BufHashTbl::partitionNo(file, pageNo)];
+  std::unordered_map<const File*, FileStats>::iterator it = stats.find(file);
+  if (it != stats.end())
+    return it->second;
+
+  FileStats& counts = stats[file];
+  counts.filename = file->filename();
+  return counts;
+}
+
+
+void BufMgr::retireFileStats(const File* file)
+{
+  FileStats total;
+  bool found = false;
+  for (int i = 0; i < BufHashTbl::NUM_PARTITIONS; i++)
+  {
+    std::lock_guard<std::mutex> lock(hashTable->partitionLatch(i));
+    std::unordered_map<const File*, FileStats>::iterator it = fileStats[i].find(file);
+    if (it == fileStats[i].end())
+      continue;
+    total.filename = it->second.filename;
+    total.hits += it->second.hits;
+    total.misses += it->second.misses;
+    fileStats[i].erase(it);
+    found = true;
+  }
+  if (!found)
+    return;
+
+  std::lock_guard<std::mutex> lock(statsLatch);
+  FileStats& closed = closedFileStats[total.filename];
+  closed.filename = total.filename;
+  closed.hits += total.hits;
+  closed.misses += total.misses;
+}
+
+
+BufStatsSnapshot BufMgr::getStatsSnapshot()
+{
+  BufStatsSnapshot snapshot;
+  bufStats.snapshot(snapshot);
+
+  std::map<std::string, FileStats> files;
+  {
+    std::lock_guard<std::mutex> lock(statsLatch);
+    files = closedFileStats;
+  }
+  for (int i = 0; i < BufHashTbl::NUM_PARTITIONS; i++)
+  {
+    std::lock_guard<std::mutex> lock(hashTable->partitionLatch(i));
+    for (std::unordered_map<const File*, FileStats>::const_iterator it = fileStats[i].begin();
+         it != fileStats[i].end(); ++it)
+    {
+      FileStats& counts = files[it->second.filename];
+      counts.filename = it->second.filename;
+      counts.hits += it->second.hits;
+      counts.misses += it->second.misses;
+    }
+  }
+  for (std::map<std::string, FileStats>::const_iterator it = files.begin(); it != files.end(); ++it)
+    snapshot.files.push_back(it->second);
+
+  const std::uint32_t count = numPools;
+  for (std::uint32_t i = 0; i < count; i++)
+  {
+    PoolStats pool;
+    pool.name = pools[i].name;
+    pool.minFrames = pools[i].minFrames;
+    pool.maxFrames = pools[i].maxFrames;
+    pool.resident = pools[i].resident;
+    snapshot.pools.push_back(pool);
+  }
+  return snapshot;
+}
+
+
+void BufMgr::clearBufStats()
+{
+  bufStats.clear();
+  for (int i = 0; i < BufHashTbl::NUM_PARTITIONS; i++)
+  {
+    std::lock_guard<std::mutex> lock(hashTable->partitionLatch(i));
+    fileStats[i].clear();
+  }
+  std::lock_guard<std::mutex> lock(statsLatch);
+  closedFileStats.clear();
+}
+
+
+void BufMgr::listDirty(std::vector<FrameId>& frames)
+{
+  std::lock_guard<std::mutex> lock(dirtyLatch);
+  for (FrameId frame = dirtyHead; frame != NO_FRAME; frame = bufDescTable[frame].dirtyNext)
+    frames.push_back(frame);
+}
+
+
+void BufMgr::listDirtyByPage(std::vector<FramePage>& pages)
+{
+  std::lock_guard<std::mutex> lock(dirtyLatch);
+  for (FrameId frame = dirtyHead; frame != NO_FRAME; frame = bufDescTable[frame].dirtyNext)
+  {
+    FramePage page = {bufDescTable[frame].file, bufDescTable[frame].pageNo, frame};
+    pages.push_back(page);
+  }
+  std::sort(pages.begin(), pages.end());
+}
+
+
+std::uint32_t BufMgr::writeRun(const FrameId frame)
+{
+  WriteRun run;
+  prepareRun(frame, run);
+  try
+  {
+    run.file->writePages(run.first, run.pages);
+  }
+  catch (...)
+  {
+    finishRun(run, false);
+    throw;
+  }
+  finishRun(run, true);
+  return run.pages.size();
+}
+
+
+void BufMgr::prepareRun(const FrameId frame, WriteRun& run)
+{
+  File* file = bufDescTable[frame].file;
+  const PageId pageNo = bufDescTable[frame].pageNo;
+
+  // dirty pages right after and right before the page, nearest first
+  std::vector<std::pair<PageId, FrameId> > after, before;
+  {
+    std::lock_guard<std::mutex> lock(fileFramesLatch);
+    std::unordered_map<const File*, FileFrames>::const_iterator it = fileFrames.find(file);
+    FileFrames::const_iterator pos;
+    if (it != fileFrames.end() && (pos = it->second.find(pageNo)) != it->second.end())
+    {
+      const FileFrames& frames = it->second;
+      FileFrames::const_iterator next = pos;
+      for (++next; next != frames.end() && after.size() + 1 < MAX_WRITE_RUN; ++next)
+      {
+        if (next->first != pageNo + after.size() + 1 || !bufDescTable[next->second].dirty)
+          break;
+        after.push_back(*next);
+      }
+      for (FileFrames::const_iterator prev = pos;
+           prev != frames.begin() && after.size() + before.size() + 1 < MAX_WRITE_RUN; )
+      {
+        --prev;
+        if (prev->first != pageNo - before.size() - 1 || !bufDescTable[prev->second].dirty)
+          break;
+        before.push_back(*prev);
+      }
+    }
+  }
+
+  // the run ends at the first neighbour which cannot be taken
+  std::size_t numAfter = 0, numBefore = 0;
+  while (numAfter < after.size() && claimForWrite(after[numAfter].second, file, after[numAfter].first))
+    numAfter++;
+  while (numBefore < before.size() && claimForWrite(before[numBefore].second, file, before[numBefore].first))
+    numBefore++;
+
+  run.frame = frame;
+  run.file = file;
+  run.first = pageNo - numBefore;
+  for (std::size_t i = numBefore; i > 0; i--)
+  {
+    run.pages.push_back(&bufPool[before[i - 1].second]);
+    run.neighbours.push_back(before[i - 1].second);
+  }
+  run.pages.push_back(&bufPool[frame]);
+  for (std::size_t i = 0; i < numAfter; i++)
+  {
+    run.pages.push_back(&bufPool[after[i].second]);
+    run.neighbours.push_back(after[i].second);
+  }
+  run.start = std::chrono::steady_clock::now();
+}
+
+
+void BufMgr::finishRun(const WriteRun& run, const bool written)
+{
+  if (written)
+  {
+    bufStats.writePageLatency.record(nanosSince(run.start));
+    bufStats.diskwrites += run.pages.size();
+  }
+  for (std::size_t i = 0; i < run.neighbours.size(); i++)
+  {
+    if (!written)
+      markDirty(run.neighbours[i]);
+    releaseForWrite(run.neighbours[i]);
+  }
+}
+
+
+bool BufMgr::claimForWrite(const FrameId frame, const File* file, const PageId pageNo)
+{
+  BufDesc* tmpbuf = &bufDescTable[frame];
+
+  // announce ourselves before taking the pin, see BufDesc::cleaning
+  tmpbuf->cleaning++;
+  if (tryClaim(frame))
+  {
+    if (tmpbuf->valid && tmpbuf->file == file && tmpbuf->pageNo == pageNo && takeDirty(frame))
+      return true;
+    pinCounts[frame]--;
+  }
+  tmpbuf->cleaning--;
+  frameReleased();
+  return false;
+}
+
+
+void BufMgr::releaseForWrite(const FrameId frame)
+{
+  pinCounts[frame]--;
+  bufDescTable[frame].cleaning--;
+  frameReleased();
+}
+
+
+void BufMgr::addFileFrame(const File* file, const PageId pageNo, const FrameId frame)
+{
+  const std::uint32_t poolNo = poolOf(file);
+  bufDescTable[frame].pool = poolNo;
+  pools[poolNo].resident++;
+
+  std::lock_guard<std::mutex> lock(fileFramesLatch);
+  fileFrames[file][pageNo] = frame;
+}
+
+
+void BufMgr::removeFileFrame(const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> lock(fileFramesLatch);
+  std::unordered_map<const File*, FileFrames>::iterator it = fileFrames.find(file);
+  if (it == fileFrames.end())
+    return;
+
+  FileFrames::iterator page = it->second.find(pageNo);
+  if (page == it->second.end())
+    return;
+  pools[bufDescTable[page->second].pool].resident--;
+
+  it->second.erase(page);
+  if (it->second.empty())
+    fileFrames.erase(it);
+}
+
+
+std::uint32_t BufMgr::poolOf(const File* file)
+{
+  if (numPools == 1)
+    return 0;
+
+  std::lock_guard<std::mutex> lock(poolsLatch);
+  std::unordered_map<std::string, std::uint32_t>::const_iterator it = filePools.find(file->filename());
+  return it == filePools.end() ? 0 : it->second;
+}
+
+
+bool BufMgr::poolMayTake(const std::uint32_t poolNo, const FrameId frameNo)
+{
+  const BufDesc& desc = bufDescTable[frameNo];
+  const BufPool& pool = pools[poolNo];
+
+  // replacing a page of the same pool leaves the sizes as they are
+  if (desc.valid && desc.pool == poolNo)
+    return true;
+
+  // a pool at its maximum only replaces its own pages
+  if (pool.resident >= pool.maxFrames)
+    return false;
+
+  // other pools give up pages only down to their minimum
+  return !desc.valid || pools[desc.pool].resident > pools[desc.pool].minFrames;
+}
+
+
+void BufMgr::createPool(const std::string& name, const std::uint32_t minFrames, const std::uint32_t maxFrames)
+{
+  // the number of frames must not change while the minimums are checked
+  std::lock_guard<std::mutex> resizing(resizeLatch);
+  std::lock_guard<std::mutex> lock(poolsLatch);
+  const std::uint32_t count = numPools;
+
+  std::uint32_t reserved = minFrames;
+  for (std::uint32_t i = 0; i < count; i++)
+  {
+    if (pools[i].name == name)
+      throw BadPoolException(name, "exists already");
+    reserved += pools[i].minFrames;
+  }
+  if (count == MAX_POOLS)
+    throw BadPoolException(name, "too many pools");
+  if (maxFrames == 0 || minFrames > maxFrames)
+    throw BadPoolException(name, "minimum larger than maximum");
+  if (reserved > numBufs)
+    throw BadPoolException(name, "minimums add up to more frames than there are");
+
+  pools[count].name = name;
+  pools[count].minFrames = minFrames;
+  pools[count].maxFrames = std::min<std::uint32_t>(maxFrames, numBufs);
+  pools[count].resident = 0;
+  numPools = count + 1;
+}
+
+
+void BufMgr::bindFile(const std::string& filename, const std::string& pool)
+{
+  std::lock_guard<std::mutex> lock(poolsLatch);
+  for (std::uint32_t i = 0; i < numPools; i++)
+  {
+    if (pools[i].name == pool)
+    {
+      if (i == 0)
+        filePools.erase(filename);
+      else
+        filePools[filename] = i;
+      return;
+    }
+  }
+  throw BadPoolException(pool, "no such pool");
+}
+
+
+void BufMgr::bindFile(const File* file, const std::string& pool)
+{
+  bindFile(file->filename(), pool);
+}
+
+
+void BufMgr::waitForCleaning(const FrameId frame)
+{
+  BufDesc* tmpbuf = &bufDescTable[frame];
+  if (tmpbuf->cleaning)
+  {
+    bufStats.pinWaits++;
+    waitUntil([tmpbuf]() { return !tmpbuf->cleaning; });
+  }
+}
+
+
+bool BufMgr::cleanFrame(const FrameId frame)
+{
+  BufDesc* tmpbuf = &bufDescTable[frame];
+  if (!tmpbuf->dirty || pinCounts[frame] != 0)
+    return false;
+
+  // announce ourselves before taking the pin, see BufDesc::cleaning
+  tmpbuf->cleaning++;
+  if (!tryClaim(frame))
+  {
+    tmpbuf->cleaning--;
+    frameReleased();
+    return false;
+  }
+
+  // Nobody can evict the page while we hold the pin.  Other threads may still
+  // pin and change it meanwhile, in which case they mark it dirty again.
+  bool written = false;
+  if (tmpbuf->valid && takeDirty(frame))
+  {
+    try
+    {
+      bufStats.bgwrites += writeRun(frame);
+      written = true;
+    }
+    catch (...)
+    {
+      // leave the page to eviction, which reports the error to its caller
+      markDirty(frame);
+    }
+  }
+
+  pinCounts[frame]--;
+  tmpbuf->cleaning--;
+  frameReleased();
+  return written;
+}
+
+
+void BufMgr::cleanToLowWatermark()
+{
+  std::vector<FrameId> candidates;
+
+  while (dirtyFrames > lowWatermark && !writerStop)
+  {
+    std::uint32_t cleaned = 0;
+
+    // pages the policy is about to evict first
+    candidates.clear();
+    policy->nextVictims(candidates, numBufs / 4 + 1);
+    for (std::size_t i = 0; i < candidates.size() && dirtyFrames > lowWatermark; i++)
+    {
+      if (cleanFrame(candidates[i]))
+        cleaned++;
+    }
+
+    // then whatever has been dirty longest
+    if (cleaned == 0)
+    {
+      candidates.clear();
+      listDirty(candidates);
+      for (std::size_t i = 0; i < candidates.size() && dirtyFrames > lowWatermark; i++)
+      {
+        if (cleanFrame(candidates[i]))
+          cleaned++;
+      }
+    }
+
+    // every dirty page is pinned
+    if (cleaned == 0)
+      break;
+  }
+}
+
+
+void BufMgr::runWriter()
+{
+  std::unique_lock<std::mutex> lock(writerLatch);
+  while (!writerStop)
+  {
+    if (dirtyFrames < highWatermark)
+    {
+      // wakeups from markDirty() are not synchronised with this check, so
+      // never sleep for long
+      writerWakeup.wait_for(lock, std::chrono::milliseconds(WRITER_INTERVAL_MS));
+      continue;
+    }
+
+    lock.unlock();
+    cleanToLowWatermark();
+    lock.lock();
+
+    // what is left dirty is pinned, give its users some time
+    if (dirtyFrames >= highWatermark && !writerStop)
+      writerWakeup.wait_for(lock, std::chrono::milliseconds(WRITER_INTERVAL_MS));
+  }
+}
+
+
+void BufMgr::startBackgroundWriter(std::uint32_t low, std::uint32_t high)
+{
+  stopBackgroundWriter();
+
+  highWatermark = std::min<std::uint32_t>(high, numBufs);
+  lowWatermark = std::min<std::uint32_t>(low, highWatermark);
+  writerStop = false;
+  writer = std::thread(&BufMgr::runWriter, this);
+}
+
+
+void BufMgr::stopBackgroundWriter()
+{
+  if (!writer.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(writerLatch);
+    writerStop = true;
+  }
+  writerWakeup.notify_all();
+  writer.join();
+
+  lowWatermark = 0;
+  highWatermark = std::numeric_limits<std::uint32_t>::max();
+}
+
+	
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page, BufferRing* ring)
+{
+  if (!tryReadPage(file, pageNo, page, ring))
+    throw BufferExceededException();
+}
+
+
+bool BufMgr::tryReadPage(File* file, const PageId pageNo, Page*& page, BufferRing* ring)
+{
+  if (file->mapped())
+  {
+    page = readMapped(file, pageNo);
+    return true;
+  }
+
+  FrameId frameNo = 0;
+  if (!readFrame(file, pageNo, ring, frameNo))
+    return false;
+  page = &bufPool[frameNo];
+  return true;
+}
+
+
+PageHandle BufMgr::fetchPage(File* file, const PageId pageNo, BufferRing* ring)
+{
+  if (file->mapped())
+    return PageHandle(this, file, NO_FRAME, pageNo, readMapped(file, pageNo));
+
+  FrameId frameNo = 0;
+  if (!readFrame(file, pageNo, ring, frameNo))
+    throw BufferExceededException();
+  return PageHandle(this, file, frameNo, pageNo, &bufPool[frameNo]);
+}
+
+
+Page* BufMgr::readMapped(File* file, const PageId pageNo)
+{
+  bufStats.accesses.add();
+  bufStats.mappedReads++;
+  return static_cast<MmapFile*>(file)->mappedPage(pageNo);
+}
+
+
+bool BufMgr::readFrame(File* file, const PageId pageNo, BufferRing* ring, FrameId& frameNo)
+{
+  // reading the clock costs about as much as a hit, so only some calls are timed
+  const bool timed = ++readPageCalls % LATENCY_SAMPLE_INTERVAL == 0;
+  std::chrono::steady_clock::time_point start;
+  if (timed)
+    start = std::chrono::steady_clock::now();
+  bufStats.accesses.add();
+
+  bool loaded = false;
+  if (!pinPage(file, pageNo, false, ring, frameNo, loaded))
+    return false;
+
+  // the first miss on a file tells us it is open, to warm up from a snapshot
+  if (loaded && warmPending)
+    warmFile(file);
+
+  // a miss, or the first use of a page read ahead, moves the readahead window
+  if (loaded || (bufDescTable[frameNo].prefetched && bufDescTable[frameNo].prefetched.exchange(false)))
+    readahead(file, pageNo, ring);
+
+  if (timed)
+    bufStats.readPageLatency.record(nanosSince(start));
+  return true;
+}
+
+
+bool BufMgr::pinPage(File* file, const PageId pageNo, const bool prefetch,
+                     BufferRing* ring, FrameId& frameNo, bool& loaded, const bool defer)
+{
+  std::mutex& latch = hashTable->partitionLatch(file, pageNo);
+  FrameId newFrame = 0;
+  bool haveNewFrame = false;
+  loaded = false;
+
+  while (true)
+  {
+    // check to see if it is already in the buffer pool
+    std::unique_lock<std::mutex> lock(latch);
+    if (hashTable->tryLookup(file, pageNo, frameNo))
+    {
+      // nothing to prefetch
+      if (prefetch)
+      {
+        lock.unlock();
+        if (haveNewFrame)
+          releaseBuf(newFrame);
+        return false;
+      }
+
+      // our pin keeps the page in the frame, so the policy can be told
+      // without holding the latch
+      pinCounts[frameNo]++;
+      fileStatsOf(file, pageNo).hits++;
+      lock.unlock();
+      bufStats.hits.add();
+      policy->pageAccessed(frameNo);
+
+      // another thread brought the page in while we were looking for a frame
+      if (haveNewFrame)
+      {
+        releaseBuf(newFrame);
+        haveNewFrame = false;
+      }
+
+      if (waitForIo(frameNo))
+      {
+        return true;
+      }
+
+      // the read which was filling this frame failed, try again ourselves
+      pinCounts[frameNo]--;
+      continue;
+    }
+
+    //not in the buffer pool, must allocate a new page
+    if (!haveNewFrame)
+    {
+      // alloc a new frame without holding the latch, then look again
+      lock.unlock();
+      if (!(ring ? allocRingBuf(ring, file, pageNo, newFrame, !prefetch)
+                   : tryAllocBuf(file, newFrame, !prefetch)))
+        return false;
+      haveNewFrame = true;
+      continue;
+    }
+
+    // set up the entry properly and insert in the hash table, so that
+    // other readers of the page wait for us instead of reading it again
+    bufDescTable[newFrame].Set(file, pageNo);
+    bufDescTable[newFrame].ioInProgress = true;
+    hashTable->insert(file, pageNo, newFrame);
+    addFileFrame(file, pageNo, newFrame);
+    if (!prefetch)
+    {
+      fileStatsOf(file, pageNo).misses++;
+      bufStats.misses.add();
+    }
+    policy->pageLoaded(newFrame, file, pageNo);
+    break;
+  }
+
+  frameNo = newFrame;
+  loaded = true;
+  if (defer)
+    return true;
+
+  // read the page into the new frame
+  try
+  {
+    bufStats.diskreads++;
+    file->readPage(pageNo, bufPool[newFrame]);
+  }
+  catch (...)
+  {
+    abandonRead(file, pageNo, newFrame);
+    throw;
+  }
+
+  if (prefetch)
+  {
+    bufStats.prefetchreads++;
+    bufDescTable[newFrame].prefetched = true;
+  }
+  bufDescTable[newFrame].ioInProgress = false;
+  frameReleased();
+  return true;
+}
+
+
+void BufMgr::loadRuns(File* file, const std::vector<FramePage>& reads, std::vector<bool>& loaded)
+{
+  loaded.assign(reads.size(), false);
+
+  // the pages of each run of neighbours, and where in reads it starts
+  std::vector<std::vector<Page*> > runs;
+  std::vector<std::size_t> starts;
+  for (std::size_t r = 0; r < reads.size(); r++)
+  {
+    if (runs.empty() || runs.back().size() == MAX_READ_RUN
+        || reads[r].pageNo != reads[r - 1].pageNo + 1)
+    {
+      runs.push_back(std::vector<Page*>());
+      starts.push_back(r);
+    }
+    runs.back().push_back(&bufPool[reads[r].frame]);
+  }
+
+  IoRing* ring = runs.size() > 1 ? takeRing() : NULL;
+  if (ring == NULL)
+  {
+    for (std::size_t k = 0; k < runs.size(); k++)
+    {
+      bufStats.diskreads += runs[k].size();
+      file->readPages(reads[starts[k]].pageNo, runs[k]);
+      for (std::size_t r = starts[k]; r < starts[k] + runs[k].size(); r++)
+      {
+        bufDescTable[reads[r].frame].ioInProgress = false;
+        loaded[r] = true;
+      }
+      frameReleased();
+    }
+    return;
+  }
+
+  // keep the ring full until every run is in, or one has failed
+  std::exception_ptr error;
+  std::size_t next = 0;
+  while (ring->outstanding() > 0 || (next < runs.size() && !error))
+  {
+    for (; next < runs.size() && !error && !ring->full(); next++)
+    {
+      try
+      {
+        bufStats.diskreads += runs[next].size();
+        bufStats.asyncRequests++;
+        file->queueReadPages(*ring, next, reads[starts[next]].pageNo, runs[next]);
+      }
+      catch (...)
+      {
+        error = std::current_exception();
+      }
+    }
+
+    IoCompletion done;
+    if (!ring->complete(done, true))
+      continue;
+    const std::size_t k = done.tag;
+    try
+    {
+      file->finishReadPages(reads[starts[k]].pageNo, runs[k], done.result);
+      for (std::size_t r = starts[k]; r < starts[k] + runs[k].size(); r++)
+      {
+        bufDescTable[reads[r].frame].ioInProgress = false;
+        loaded[r] = true;
+      }
+      frameReleased();
+    }
+    catch (...)
+    {
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+  returnRing(ring);
+  if (error)
+    std::rethrow_exception(error);
+}
+
+
+bool BufMgr::pinResident(File* file, const PageId pageNo, FrameId& frameNo)
+{
+  {
+    std::lock_guard<std::mutex> lock(hashTable->partitionLatch(file, pageNo));
+    if (!hashTable->tryLookup(file, pageNo, frameNo))
+      return false;
+    pinCounts[frameNo]++;
+    fileStatsOf(file, pageNo).hits++;
+  }
+  bufStats.hits.add();
+  policy->pageAccessed(frameNo);
+  return true;
+}
+
+
+void BufMgr::abandonRead(File* file, const PageId pageNo, const FrameId frame)
+{
+  {
+    std::lock_guard<std::mutex> lock(hashTable->partitionLatch(file, pageNo));
+    hashTable->remove(file, pageNo);
+    removeFileFrame(file, pageNo);
+    bufDescTable[frame].Reset();
+  }
+  policy->pageRemoved(frame, false);
+  policy->frameFreed(frame);
+  pinCounts[frame]--;
+  frameReleased();
+}
+
+
+void BufMgr::readPages(File* file, const std::vector<PageId>& pageIds, std::vector<Page*>& pages)
+{
+  if (file->mapped())
+  {
+    pages.resize(pageIds.size());
+    for (std::size_t i = 0; i < pageIds.size(); i++)
+      pages[i] = readMapped(file, pageIds[i]);
+    return;
+  }
+
+  bufStats.accesses.add(pageIds.size());
+
+  // frame pinned for each page asked for, NO_FRAME while none is
+  std::vector<FrameId> frames(pageIds.size(), NO_FRAME);
+  // requests found in the pool, which may still be being read by another thread
+  std::vector<std::size_t> hits;
+  // the other requests, by page number
+  std::vector<std::pair<PageId, std::size_t> > misses;
+  try
+  {
+    for (std::size_t i = 0; i < pageIds.size(); i++)
+    {
+      if (pinResident(file, pageIds[i], frames[i]))
+        hits.push_back(i);
+      else
+        misses.push_back(std::make_pair(pageIds[i], i));
+    }
+    std::sort(misses.begin(), misses.end());
+
+    // allocate frames for all the pages missing before reading any of them
+    std::vector<FrameId> newFrames;
+    try
+    {
+      for (std::size_t j = 0; j < misses.size(); j++)
+      {
+        if (j > 0 && misses[j].first == misses[j - 1].first)
+          continue;
+        FrameId newFrame = 0;
+        if (!tryAllocBuf(file, newFrame, true))
+          throw BufferExceededException();
+        newFrames.push_back(newFrame);
+      }
+    }
+    catch (...)
+    {
+      // also when writing out a dirty victim failed
+      for (std::size_t k = 0; k < newFrames.size(); k++)
+        releaseBuf(newFrames[k]);
+      throw;
+    }
+
+    // insert the pages in the hash table, so that other readers of them wait
+    // for us instead of reading them again
+    std::vector<FramePage> reads;
+    std::vector<std::size_t> readers;
+    std::size_t next = 0;
+    for (std::size_t j = 0; j < misses.size(); j++)
+    {
+      if (j > 0 && misses[j].first == misses[j - 1].first)
+        continue;
+      const PageId pageNo = misses[j].first;
+      const std::size_t i = misses[j].second;
+      const FrameId newFrame = newFrames[next++];
+
+      std::unique_lock<std::mutex> lock(hashTable->partitionLatch(file, pageNo));
+      FrameId frameNo = 0;
+      if (hashTable->tryLookup(file, pageNo, frameNo))
+      {
+        // another thread brought the page in since we looked
+        pinCounts[frameNo]++;
+        fileStatsOf(file, pageNo).hits++;
+        lock.unlock();
+        bufStats.hits.add();
+        policy->pageAccessed(frameNo);
+        releaseBuf(newFrame);
+        frames[i] = frameNo;
+        hits.push_back(i);
+        continue;
+      }
+      bufDescTable[newFrame].Set(file, pageNo);
+      bufDescTable[newFrame].ioInProgress = true;
+      hashTable->insert(file, pageNo, newFrame);
+      addFileFrame(file, pageNo, newFrame);
+      fileStatsOf(file, pageNo).misses++;
+      bufStats.misses.add();
+      policy->pageLoaded(newFrame, file, pageNo);
+      lock.unlock();
+
+      frames[i] = newFrame;
+      FramePage read = { file, pageNo, newFrame };
+      reads.push_back(read);
+      readers.push_back(i);
+    }
+
+    // read them in page number order, each run of neighbours at once
+    std::vector<bool> loaded;
+    try
+    {
+      loadRuns(file, reads, loaded);
+    }
+    catch (...)
+    {
+      for (std::size_t r = 0; r < reads.size(); r++)
+      {
+        if (loaded[r])
+          continue;
+        abandonRead(file, reads[r].pageNo, reads[r].frame);
+        frames[readers[r]] = NO_FRAME;
+      }
+      throw;
+    }
+    if (!reads.empty() && warmPending)
+      warmFile(file);
+
+    // the hits were left until now, so that our reads were not held up by
+    // reads of other threads
+    for (std::size_t k = 0; k < hits.size(); k++)
+    {
+      const std::size_t i = hits[k];
+      if (waitForIo(frames[i]))
+        continue;
+
+      // the read which was filling this frame failed, try again ourselves
+      pinCounts[frames[i]]--;
+      frames[i] = NO_FRAME;
+      bool loaded = false;
+      FrameId frameNo = 0;
+      if (!pinPage(file, pageIds[i], false, NULL, frameNo, loaded))
+        throw BufferExceededException();
+      frames[i] = frameNo;
+    }
+  }
+  catch (...)
+  {
+    for (std::size_t i = 0; i < frames.size(); i++)
+    {
+      if (frames[i] != NO_FRAME)
+        pinCounts[frames[i]]--;
+    }
+    frameReleased();
+    throw;
+  }
+
+  // a page asked for more than once is pinned once for every time
+  for (std::size_t j = 1; j < misses.size(); j++)
+  {
+    if (misses[j].first != misses[j - 1].first)
+      continue;
+    frames[misses[j].second] = frames[misses[j - 1].second];
+    pinCounts[frames[misses[j].second]]++;
+  }
+
+  pages.resize(pageIds.size());
+  for (std::size_t i = 0; i < pageIds.size(); i++)
+    pages[i] = &bufPool[frames[i]];
+}
+
+
+void BufMgr::prefetch(File* file, const std::vector<PageId>& pageIds)
+{
+  // pages of a mapped file are read by the kernel where they are used
+  if (file->mapped())
+    return;
+  queuePrefetch(file, pageIds, false, NULL);
+}
+
+
+void BufMgr::queuePrefetch(File* file, const std::vector<PageId>& pageIds, const bool readahead, BufferRing* ring)
+{
+  if (pageIds.empty())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(prefetchLatch);
+    if (!prefetcher.joinable())
+    {
+      prefetchStop = false;
+      prefetcher = std::thread(&BufMgr::runPrefetcher, this);
+    }
+
+    // requests beyond what the pool could hold would only evict each other
+    for (std::size_t i = 0; i < pageIds.size() && prefetchQueue.size() < numBufs; i++)
+    {
+      PrefetchRequest request = {file, pageIds[i], readahead, ring};
+      prefetchQueue.push_back(request);
+    }
+  }
+  prefetchWakeup.notify_one();
+}
+
+
+void BufMgr::setReadahead(const std::uint32_t pages)
+{
+  readaheadPages = std::min<std::uint32_t>(pages, numBufs / 8);
+}
+
+
+bool BufMgr::setIoDepth(const std::uint32_t depth)
+{
+  if (depth > 0 && !IoRing::supported())
+    return false;
+  ioDepth = std::min(depth, MAX_IO_DEPTH);
+
+  // rings in use are dropped when they are given back, see returnRing()
+  std::lock_guard<std::mutex> lock(ringsLatch);
+  for (std::size_t i = 0; i < idleRings.size(); i++)
+    delete idleRings[i];
+  idleRings.clear();
+  return true;
+}
+
+
+IoRing* BufMgr::takeRing()
+{
+  const std::uint32_t depth = ioDepth;
+  if (depth == 0)
+    return NULL;
+  {
+    std::lock_guard<std::mutex> lock(ringsLatch);
+    if (!idleRings.empty())
+    {
+      IoRing* ring = idleRings.back();
+      idleRings.pop_back();
+      return ring;
+    }
+  }
+  return IoRing::create(depth);
+}
+
+
+void BufMgr::returnRing(IoRing* ring)
+{
+  {
+    std::lock_guard<std::mutex> lock(ringsLatch);
+    if (ring->depth() == ioDepth)
+    {
+      idleRings.push_back(ring);
+      return;
+    }
+  }
+  delete ring;
+}
+
+
+void BufMgr::setAllocWaitTimeout(const std::uint32_t micros)
+{
+  allocWaitTimeout = micros;
+}
+
+
+void BufMgr::readahead(File* file, const PageId pageNo, BufferRing* ring)
+{
+  std::uint32_t window = readaheadPages;
+
+  // pages read ahead into a ring must not wrap around onto the reader
+  if (ring != NULL)
+    window = std::min(window, ringSize(ring) / 2);
+  if (window == 0)
+    return;
+
+  std::vector<PageId> pageIds;
+  {
+    std::lock_guard<std::mutex> lock(readaheadLatch);
+
+    // forget old streams rather than let the table grow without bound
+    if (readaheads.size() >= MAX_READAHEAD_STREAMS && readaheads.find(file) == readaheads.end())
+      readaheads.clear();
+
+    Readahead& ra = readaheads[file];
+    if (ra.run > 0 && pageNo == ra.next)
+    {
+      ra.run++;
+    }
+    else
+    {
+      ra.run = 1;
+      ra.end = pageNo + 1;
+    }
+    ra.next = pageNo + 1;
+
+    // start the next window once the reader is half way through the last one
+    if (ra.run < READAHEAD_TRIGGER || ra.end > pageNo + window / 2)
+      return;
+
+    for (PageId p = std::max(ra.end, pageNo + 1); p <= pageNo + window; p++)
+      pageIds.push_back(p);
+    ra.end = pageNo + window + 1;
+  }
+
+  queuePrefetch(file, pageIds, true, ring);
+}
+
+
+bool BufMgr::readerPassed(const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> lock(readaheadLatch);
+  std::unordered_map<const File*, Readahead>::iterator it = readaheads.find(file);
+  return it != readaheads.end() && pageNo < it->second.next;
+}
+
+
+/**
+ * First line of a residency snapshot, see BufMgr::saveResidency()
+ */
+static const char residencyHeader[] = "badgerdb residency 1";
+
+/**
+ * Writes all of the data to a new file and syncs it to disk.
+ *
+ * @return  False if any of it failed
+ */
+static bool writeDurably(const std::string& path, const std::string& data)
+{
+  const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+  std::size_t written = 0;
+  while (written < data.size())
+  {
+    const ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    written += n;
+  }
+  const bool synced = written == data.size() && ::fsync(fd) == 0;
+  return ::close(fd) == 0 && synced;
+}
+
+/**
+ * Syncs the directory holding the file to disk, which makes a rename of the
+ * file into it durable.
+ */
+static bool syncDirectory(const std::string& path)
+{
+  const std::string::size_type slash = path.rfind('/');
+  const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+  const int fd = ::open(dir.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  const bool synced = ::fsync(fd) == 0;
+  ::close(fd);
+  return synced;
+}
 
-  for (FrameId i = 0; i < bufs; i++) 
+void BufMgr::saveResidency(const std::string& path)
+{
+  std::vector<std::pair<std::string, PageId> > pages;
   {
-  	bufDescTable[i].frameNo = i;
-  	bufDescTable[i].valid = false;
+    std::lock_guard<std::mutex> lock(fileFramesLatch);
+    for (std::unordered_map<const File*, FileFrames>::const_iterator file = fileFrames.begin();
+         file != fileFrames.end(); ++file)
+    {
+      for (FileFrames::const_iterator page = file->second.begin();
+           page != file->second.end(); ++page)
+        pages.push_back(std::make_pair(file->first->filename(), page->first));
+    }
   }
+  std::sort(pages.begin(), pages.end());
 
-  bufPool = new Page[bufs];
-
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  // one page per line, the page number first as file names may hold spaces
+  std::ostringstream out;
+  out << residencyHeader << '\n';
+  for (std::size_t i = 0; i < pages.size(); i++)
+    out << pages[i].second << ' ' << pages[i].first << '\n';
 
-  clockHand = bufs - 1;
+  // the new snapshot is on disk before it replaces the old one, and the
+  // rename is on disk before we return
+  const std::string tmpPath = path + ".tmp";
+  if (!writeDurably(tmpPath, out.str()) || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+  {
+    std::remove(tmpPath.c_str());
+    throw FileNotFoundException(path);
+  }
+  if (!syncDirectory(path))
+    throw FileNotFoundException(path);
 }
 
 
-BufMgr::~BufMgr() {
-  //Flush out all unwritten pages
-  for (std::uint32_t i = 0; i < numBufs; i++) 
+bool BufMgr::loadResidency(const std::string& path)
+{
+  std::ifstream in(path.c_str());
+  std::string header;
+  if (!std::getline(in, header) || header != residencyHeader)
+    return false;
+
+  // a snapshot cut short, by a full disk or a copy gone wrong, still has
+  // its lines up to the cut; a line without its newline or not of the form
+  // written is where it ends
+  std::map<std::string, std::vector<PageId> > pages;
+  std::uint32_t count = 0;
+  std::string line;
+  while (count < numBufs && std::getline(in, line) && !in.eof())
   {
-  	BufDesc* tmpbuf = &bufDescTable[i];
-  	if (tmpbuf->valid == true && tmpbuf->dirty == true)
-		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-  	}
+    const std::string::size_type space = line.find(' ');
+    if (space == std::string::npos || space == 0 || space + 1 == line.size()
+        || line.find_first_not_of("0123456789") != space)
+      break;
+    const unsigned long long pageNo = std::strtoull(line.c_str(), NULL, 10);
+    if (pageNo > std::numeric_limits<PageId>::max())
+      break;
+    pages[line.substr(space + 1)].push_back(PageId(pageNo));
+    count++;
+  }
+  for (std::map<std::string, std::vector<PageId> >::iterator file = pages.begin();
+       file != pages.end(); ++file)
+  {
+    std::sort(file->second.begin(), file->second.end());
+    file->second.erase(std::unique(file->second.begin(), file->second.end()), file->second.end());
   }
 
-  delete [] bufDescTable;
-  delete [] bufPool;
+  std::lock_guard<std::mutex> lock(warmLatch);
+  warmPages.swap(pages);
+  warmPending = !warmPages.empty();
+  return true;
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+
+void BufMgr::warmFile(File* file)
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+  std::vector<PageId> pageIds;
+  {
+    std::lock_guard<std::mutex> lock(warmLatch);
+    std::map<std::string, std::vector<PageId> >::iterator it = warmPages.find(file->filename());
+    if (it == warmPages.end())
+      return;
+    pageIds.swap(it->second);
+    warmPages.erase(it);
+    warmPending = !warmPages.empty();
+  }
+  queuePrefetch(file, pageIds, false, NULL);
+}
+
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+void BufMgr::runPrefetcher()
+{
+  std::unique_lock<std::mutex> lock(prefetchLatch);
+  while (true)
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    while (!prefetchStop && prefetchQueue.empty())
+      prefetchWakeup.wait(lock);
+    if (prefetchStop)
+      break;
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+    PrefetchRequest request = prefetchQueue.front();
+    prefetchQueue.pop_front();
+    prefetchCurrent = request.file;
+
+    // with io_uring, the requests for the file queued next go together
+    std::vector<PrefetchRequest> batch(1, request);
+    const std::uint32_t depth = ioDepth;
+    while (depth > 0 && batch.size() < depth * MAX_READ_RUN && !prefetchQueue.empty()
+           && prefetchQueue.front().file == request.file)
     {
-      break;
+      batch.push_back(prefetchQueue.front());
+      prefetchQueue.pop_front();
     }
+    for (std::size_t i = 0; i < batch.size(); i++)
+      prefetchPages.push_back(batch[i].pageNo);
+    lock.unlock();
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+    if (batch.size() > 1)
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
-      {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
-      }
+      prefetchBatch(batch);
     }
     else
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      try
+      {
+        FrameId frameNo;
+        bool loaded;
+        if (!(request.readahead && readerPassed(request.file, request.pageNo))
+            && pinPage(request.file, request.pageNo, true, request.ring, frameNo, loaded))
+        {
+          pinCounts[frameNo]--;
+          frameReleased();
+        }
+      }
+      catch (...)
+      {
+        // past the end of the file or unreadable; a reader asking for the page
+        // gets the error itself
+      }
     }
+
+    lock.lock();
+    prefetchCurrent = NULL;
+    prefetchPages.clear();
+    prefetchDone.notify_all();
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+}
+
+
+void BufMgr::prefetchBatch(const std::vector<PrefetchRequest>& requests)
+{
+  File* file = requests[0].file;
+
+  // take frames for the pages not in the pool, leaving the reads to us
+  std::vector<FramePage> reads;
+  for (std::size_t i = 0; i < requests.size(); i++)
   {
-    throw BufferExceededException();
+    const PrefetchRequest& request = requests[i];
+    if (request.readahead && readerPassed(file, request.pageNo))
+      continue;
+    FrameId frameNo;
+    bool loaded;
+    if (!pinPage(file, request.pageNo, true, request.ring, frameNo, loaded, true))
+      continue;
+    // set before the read ends, so that a reader who gets the page at once
+    // still moves the readahead window on
+    bufDescTable[frameNo].prefetched = true;
+    FramePage read = {file, request.pageNo, frameNo};
+    reads.push_back(read);
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+  std::sort(reads.begin(), reads.end());
+
+  std::vector<bool> loaded;
+  try
+  {
+    loadRuns(file, reads, loaded);
+  }
+  catch (...)
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    // past the end of the file or unreadable; a reader asking for a page
+    // gets the error itself
   }
 
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  for (std::size_t r = 0; r < reads.size(); r++)
+  {
+    if (loaded[r])
+    {
+      bufStats.prefetchreads++;
+      pinCounts[reads[r].frame]--;
+    }
+    else
+    {
+      abandonRead(file, reads[r].pageNo, reads[r].frame);
+    }
+  }
+  frameReleased();
+}
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
 
-	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+void BufMgr::cancelPrefetch(const File* file)
 {
-  // check to see if it is already in the buffer pool
-  // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
-  FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
-
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+  {
+    std::lock_guard<std::mutex> lock(readaheadLatch);
+    readaheads.erase(file);
   }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
+
+  std::unique_lock<std::mutex> lock(prefetchLatch);
+  for (std::deque<PrefetchRequest>::iterator it = prefetchQueue.begin(); it != prefetchQueue.end(); )
   {
-    // alloc a new frame
-    allocBuf(frameNo);
+    if (it->file == file)
+      it = prefetchQueue.erase(it);
+    else
+      ++it;
+  }
+  while (prefetchCurrent == file)
+    prefetchDone.wait(lock);
+}
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+void BufMgr::cancelPrefetch(const File* file, const PageId pageNo)
+{
+  std::unique_lock<std::mutex> lock(prefetchLatch);
+  for (std::deque<PrefetchRequest>::iterator it = prefetchQueue.begin(); it != prefetchQueue.end(); )
+  {
+    if (it->file == file && it->pageNo == pageNo)
+      it = prefetchQueue.erase(it);
+    else
+      ++it;
+  }
+  while (prefetchCurrent == file
+         && std::find(prefetchPages.begin(), prefetchPages.end(), pageNo) != prefetchPages.end())
+    prefetchDone.wait(lock);
+}
+
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+void BufMgr::stopPrefetcher()
+{
+  {
+    std::lock_guard<std::mutex> lock(prefetchLatch);
+    if (!prefetcher.joinable())
+      return;
+    prefetchStop = true;
+    prefetchQueue.clear();
   }
+  prefetchWakeup.notify_all();
+  prefetcher.join();
 }
 
 
 void BufMgr::unPinPage(File* file, const PageId pageNo, 
 			     const bool dirty) 
 {
+  // pages of a mapped file hold no frame
+  if (file->mapped())
+  {
+    if (dirty)
+      throw ReadOnlyFileException(file->filename());
+    return;
+  }
+
   // lookup in hashtable
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  {
+    std::lock_guard<std::mutex> lock(hashTable->partitionLatch(file, pageNo));
+    hashTable->lookup(file, pageNo, frameNo);
+  }
 
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+  unPinFrame(frameNo, dirty);
+}
 
-  // make sure the page is actually pinned
-  if (bufDescTable[frameNo].pinCnt == 0)
+
+void BufMgr::unPinFrame(const FrameId frameNo, const bool dirty)
+{
+  if (!tryUnPinFrame(frameNo, dirty))
   {
-  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+    const BufDesc& desc = bufDescTable[frameNo];
+    throw PageNotPinnedException(desc.file->filename(), desc.pageNo, frameNo);
   }
-  else bufDescTable[frameNo].pinCnt--;
+}
+
+
+bool BufMgr::tryUnPinFrame(const FrameId frameNo, const bool dirty)
+{
+  // make sure the page is actually pinned
+  if (pinCounts[frameNo] == 0)
+    return false;
+
+  // must be set before the pin is dropped, so an evicting thread sees it
+  if (dirty == true) markDirty(frameNo);
+
+  int pinCnt = pinCounts[frameNo];
+  do
+  {
+    if (pinCnt == 0)
+      return false;
+  } while (!pinCounts[frameNo].compare_exchange_weak(pinCnt, pinCnt - 1));
+
+  if (pinCnt == 1)
+    frameReleased();
+  return true;
 }
 
 void BufMgr::flushFile(const File* file) 
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
+  // no prefetch may bring pages of the file back in behind us
+  cancelPrefetch(file);
+
+  // the pages of the file in ascending order, as they were a moment ago
+  std::vector<std::pair<PageId, FrameId> > frames;
+  {
+    std::lock_guard<std::mutex> lock(fileFramesLatch);
+    std::unordered_map<const File*, FileFrames>::const_iterator it = fileFrames.find(file);
+    if (it != fileFrames.end())
+      frames.assign(it->second.begin(), it->second.end());
+  }
+
+  for (std::size_t i = 0; i < frames.size(); i++)
 	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
-		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
-
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
-
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
-  	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+    const PageId pageNo = frames[i].first;
+    const FrameId frameNo = frames[i].second;
+  	BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+    std::mutex& latch = hashTable->partitionLatch(file, pageNo);
+
+    // the frame has to be ours alone, as for eviction; only the pins of
+    // writers and evicting threads go away by themselves
+    bool waited = false;
+    while (true)
+    {
+      if (!tryClaim(frameNo))
+      {
+        if (tmpbuf->cleaning)
+        {
+          if (!waited)
+            bufStats.pinWaits++;
+          waited = true;
+          waitUntil([tmpbuf]() { return !tmpbuf->cleaning; });
+          continue;
+        }
+
+        // the page may have been evicted since the list was copied
+        FrameId current;
+        std::lock_guard<std::mutex> lock(latch);
+        if (hashTable->tryLookup(file, pageNo, current) && current == frameNo)
+          throw PagePinnedException(file->filename(), pageNo, frameNo);
+        break;
+      }
+
+      // the frame may have been given to another page before we claimed it
+      if (!tmpbuf->valid || tmpbuf->file != file || tmpbuf->pageNo != pageNo)
+      {
+        pinCounts[frameNo]--;
+        frameReleased();
+        break;
+      }
+
+      // pages of the file right after this one go out in the same write
+      if (takeDirty(frameNo))
+      {
+        try
+        {
+          writeRun(frameNo);
+        }
+        catch (...)
+        {
+          markDirty(frameNo);
+          pinCounts[frameNo]--;
+          throw;
+        }
+      }
+
+      bool alone;
+      {
+        std::lock_guard<std::mutex> lock(latch);
+        alone = pinCounts[frameNo] == 1 && !tmpbuf->dirty;
+        if (alone)
+        {
+          hashTable->remove(file, pageNo);
+          removeFileFrame(file, pageNo);
+        }
+      }
+      if (alone)
+      {
+        policy->pageRemoved(frameNo, false);
+        releaseBuf(frameNo);
+        break;
+      }
+
+      // somebody pinned the page through the hash table while it was being
+      // written: a reader, whose pin makes us throw above, or a checkpoint
+      pinCounts[frameNo]--;
+      frameReleased();
+    }
+  }
+
+  // and its header, which the File objects keep in memory
+  file->sync();
+
+  // the File object may go away now, and another take its address
+  policy->fileDropped(file);
+  retireFileStats(file);
+}
+
+void BufMgr::checkpoint()
+{
+  std::vector<FramePage> dirty;
+  listDirtyByPage(dirty);
+
+  // runs in flight on the ring, by tag; NULL ring if I/O is synchronous
+  IoRing* ring = takeRing();
+  std::vector<WriteRun> runs;
+  std::exception_ptr error;
+  const File* synced = NULL;
+
+  for (std::size_t i = 0; i < dirty.size() && !error; i++)
+  {
+    const FrameId frameNo = dirty[i].frame;
+    BufDesc* tmpbuf = &bufDescTable[frameNo];
+
+    // pin the page if it is still where it was, like a reader would; pinned
+    // pages are written too
+    {
+      FrameId current;
+      std::lock_guard<std::mutex> lock(hashTable->partitionLatch(dirty[i].file, dirty[i].pageNo));
+      if (!hashTable->tryLookup(dirty[i].file, dirty[i].pageNo, current) || current != frameNo)
+        continue;
+      tmpbuf->cleaning++;
+      pinCounts[frameNo]++;
+    }
+
+    // the header of the file goes out along with its first page, while the
+    // pin keeps the File object around
+    if (dirty[i].file != synced)
+    {
+      synced = dirty[i].file;
+      try
+      {
+        synced->sync();
+      }
+      catch (...)
+      {
+        releaseForWrite(frameNo);
+        if (ring == NULL)
+          throw;
+        error = std::current_exception();
+        continue;
+      }
+    }
+
+    if (tmpbuf->ioInProgress || !takeDirty(frameNo))
+    {
+      releaseForWrite(frameNo);
+      continue;
+    }
+
+    if (ring == NULL)
+    {
+      try
+      {
+        writeRun(frameNo);
+      }
+      catch (...)
+      {
+        markDirty(frameNo);
+        releaseForWrite(frameNo);
+        throw;
+      }
+      releaseForWrite(frameNo);
+      continue;
+    }
+
+    // with io_uring, the runs are written while we gather the next ones
+    while (ring->full())
+      reapRun(*ring, runs, error);
+    runs.push_back(WriteRun());
+    WriteRun& run = runs.back();
+    prepareRun(frameNo, run);
+    try
+    {
+      run.file->queueWritePages(*ring, runs.size() - 1, run.first, run.pages);
+      bufStats.asyncRequests++;
+    }
+    catch (...)
+    {
+      finishRun(run, false);
+      markDirty(frameNo);
+      releaseForWrite(frameNo);
+      error = std::current_exception();
+    }
+  }
+
+  if (ring != NULL)
+  {
+    while (ring->outstanding() > 0)
+      reapRun(*ring, runs, error);
+    returnRing(ring);
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
+
+
+void BufMgr::reapRun(IoRing& ring, const std::vector<WriteRun>& runs, std::exception_ptr& error)
+{
+  IoCompletion done;
+  ring.complete(done, true);
+  const WriteRun& run = runs[done.tag];
+
+  // a failed write leaves the pages dirty, for a later write to try again
+  const bool written = done.result == static_cast<std::int64_t>(run.pages.size() * Page::SIZE);
+  finishRun(run, written);
+  if (!written)
+  {
+    markDirty(run.frame);
+    if (!error)
+      error = std::make_exception_ptr(IoErrorException(run.file->filename(),
+                                                       done.result < 0 ? -done.result : ENOSPC));
   }
+  releaseForWrite(run.frame);
 }
 
 void BufMgr::disposePage(File* file, const PageId pageNo) 
 {
+  if (file->mapped())
+    throw ReadOnlyFileException(file->filename());
+
+  // a prefetch of the page in flight could bring it back in behind us
+  cancelPrefetch(file, pageNo);
+
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  std::mutex& latch = hashTable->partitionLatch(file, pageNo);
+  bool resident;
+  {
+    std::lock_guard<std::mutex> lock(latch);
+    resident = hashTable->tryLookup(file, pageNo, frameNo);
+  }
+  BufDesc* tmpbuf = &bufDescTable[frameNo];
+
+  // the frame has to be ours alone, like a victim of eviction; only the pins
+  // of writers and evicting threads go away by themselves
+  bool waited = false;
+  while (resident)
+  {
+    if (tryClaim(frameNo))
+    {
+      // the page may have been evicted before we claimed the frame
+      if (!tmpbuf->valid || tmpbuf->file != file || tmpbuf->pageNo != pageNo)
+      {
+        pinCounts[frameNo]--;
+        frameReleased();
+        break;
+      }
+
+      bool alone;
+      {
+        std::lock_guard<std::mutex> lock(latch);
+        alone = pinCounts[frameNo] == 1;
+        if (alone)
+        {
+          // the page is going away, no need to write it
+          takeDirty(frameNo);
+          hashTable->remove(file, pageNo);
+          removeFileFrame(file, pageNo);
+        }
+      }
+      if (alone)
+      {
+        policy->pageRemoved(frameNo, false);
+        releaseBuf(frameNo);
+        break;
+      }
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+      // a reader or a checkpoint pinned the page through the hash table
+      pinCounts[frameNo]--;
+    }
 
-	hashTable->remove(file, pageNo);
+    if (!tmpbuf->cleaning)
+    {
+      FrameId current;
+      std::lock_guard<std::mutex> lock(latch);
+      if (hashTable->tryLookup(file, pageNo, current) && current == frameNo)
+        throw PagePinnedException(file->filename(), pageNo, frameNo);
+      break;
+    }
+    if (!waited)
+      bufStats.pinWaits++;
+    waited = true;
+    waitUntil([tmpbuf]() { return !tmpbuf->cleaning; });
+  }
 
   // deallocate it in the file	
   file->deletePage(pageNo);
@@ -212,21 +2413,129 @@ void BufMgr::disposePage(File* file, const PageId pageNo)
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  page = &bufPool[allocFrame(file, pageNo)];
+}
+
+
+PageHandle BufMgr::newPage(File* file, PageId& pageNo)
+{
+  FrameId frameNo = allocFrame(file, pageNo);
+  return PageHandle(this, file, frameNo, pageNo, &bufPool[frameNo]);
+}
+
+
+FrameId BufMgr::allocFrame(File* file, PageId& pageNo)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
   FrameId frameNo;
 
   // alloc a new frame
-  allocBuf(frameNo);
+  allocBuf(file, frameNo);
 
   // allocate a new page in the file
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
+  try
+  {
+    file->allocatePage(pageNo, bufPool[frameNo]);
+  }
+  catch (...)
+  {
+    releaseBuf(frameNo);
+    throw;
+  }
+
+  // set up the entry properly and insert in the hash table.  The page number
+  // may have been disposed of a moment ago, and readahead may have read it in
+  // again since.  That copy is stale: it is dropped, without writing it, once
+  // nobody holds a pin on it, and our frame takes its place.
+  std::mutex& latch = hashTable->partitionLatch(file, pageNo);
+  bool waited = false;
+  std::chrono::steady_clock::time_point deadline;
+  while (true)
+  {
+    FrameId other = NO_FRAME;
+    bool published = false;
+    {
+      std::lock_guard<std::mutex> lock(latch);
+      if (!hashTable->tryLookup(file, pageNo, other))
+      {
+        other = NO_FRAME;
+        published = true;
+      }
+      else if (tryClaim(other))
+      {
+        // a frame being read into is pinned by its reader, so a claimed frame
+        // holds the stale page in full
+        if (bufDescTable[other].valid && bufDescTable[other].file == file
+            && bufDescTable[other].pageNo == pageNo)
+        {
+          takeDirty(other);
+          hashTable->remove(file, pageNo);
+          removeFileFrame(file, pageNo);
+          published = true;
+        }
+        else
+          pinCounts[other]--;
+      }
+
+      if (published)
+      {
+        bufDescTable[frameNo].Set(file, pageNo);
+        hashTable->insert(file, pageNo, frameNo);
+        addFileFrame(file, pageNo, frameNo);
+        policy->pageLoaded(frameNo, file, pageNo);
+      }
+    }
+
+    if (published)
+    {
+      if (other != NO_FRAME)
+      {
+        policy->pageRemoved(other, false);
+        releaseBuf(other);
+      }
+      break;
+    }
 
-  // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+    // somebody holds a pin on the stale page, wait for it to be dropped.
+    // Reads and writes of the page end by themselves; the pin of a caller,
+    // who may not drop it before we return, is only given so long.
+    if (!waited)
+    {
+      bufStats.pinWaits++;
+      deadline = std::chrono::steady_clock::now()
+        + std::max<std::chrono::microseconds>(std::chrono::microseconds(allocWaitTimeout),
+                                              std::chrono::milliseconds(STALE_PIN_WAIT_MS));
+    }
+    waited = true;
+    BufDesc* stale = &bufDescTable[other];
+    if (stale->ioInProgress || stale->cleaning)
+    {
+      waitUntil([this, stale, other]() {
+        return pinCounts[other] == 0 || !(stale->ioInProgress || stale->cleaning);
+      });
+      continue;
+    }
+    if (std::chrono::steady_clock::now() < deadline)
+    {
+      waitUntil([this, other]() { return pinCounts[other] == 0; }, deadline);
+      continue;
+    }
 
-  // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+    // give the page back to the file, which leaves things as they were
+    releaseBuf(frameNo);
+    try
+    {
+      file->deletePage(pageNo);
+    }
+    catch (...)
+    {
+      // the page stays allocated, unused; the pin is what to report
+    }
+    throw PagePinnedException(file->filename(), pageNo, other);
+  }
+  bufStats.allocPageLatency.record(nanosSince(start));
+  return frameNo;
 }
 
 void BufMgr::printSelf(void) 
@@ -238,13 +2547,81 @@ void BufMgr::printSelf(void)
 	{
   	tmpbuf = &(bufDescTable[i]);
 		std::cout << "FrameNo:" << i << " ";
-		tmpbuf->Print();
+		tmpbuf->Print(pinCounts[i]);
 
   	if (tmpbuf->valid == true)
     	validFrames++;
   }
 
 	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
+	std::cout << "Replacement Policy:" << policy->name() << "\n";
+}
+
+
+//----------------------------------------
+// Page handles
+//----------------------------------------
+
+PageHandle::PageHandle(PageHandle&& other)
+  : bufMgr(other.bufMgr), file(other.file), frame(other.frame), pageNo(other.pageNo),
+    page_(other.page_), dirty(other.dirty)
+{
+  other.page_ = NULL;
+  other.dirty = false;
+}
+
+PageHandle& PageHandle::operator=(PageHandle&& other)
+{
+  if (this != &other)
+  {
+    release();
+    bufMgr = other.bufMgr;
+    file = other.file;
+    frame = other.frame;
+    pageNo = other.pageNo;
+    page_ = other.page_;
+    dirty = other.dirty;
+    other.page_ = NULL;
+    other.dirty = false;
+  }
+  return *this;
+}
+
+PageHandle::~PageHandle()
+{
+  // a destructor must not throw, so a pin dropped behind our back is counted
+  unpin(false);
+}
+
+void PageHandle::markDirty()
+{
+  // pages of a mapped file hold no frame, and cannot be written back
+  if (frame == BufMgr::NO_FRAME)
+    throw ReadOnlyFileException(file->filename());
+  dirty = true;
+}
+
+void PageHandle::release()
+{
+  unpin(true);
+}
+
+void PageHandle::unpin(const bool check)
+{
+  if (page_ == NULL)
+    return;
+
+  // cleared first, so the pin is not dropped twice if unpinning throws
+  page_ = NULL;
+  const bool wasDirty = dirty;
+  dirty = false;
+  // a page of a mapped file holds no frame
+  if (frame == BufMgr::NO_FRAME)
+    return;
+  if (check)
+    bufMgr->unPinFrame(frame, wasDirty);
+  else if (!bufMgr->tryUnPinFrame(frame, wasDirty))
+    bufMgr->bufStats.lostPins++;
 }
 
 }
@@ -9,7 +9,22 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "buf_stats.h"
+#include "replacement_policy.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace badgerdb {
 
@@ -20,6 +35,13 @@ class BufMgr;
 
 /**
 * @brief Class for maintaining information about buffer pool frames
+*
+* dirty, valid and ioInProgress may be touched by several threads at once and
+* are atomic.  file and pageNo only change while the frame is exclusively
+* owned by one thread (pinned by it and absent from the hash table), so they
+* need no latch of their own.  What the clock sweep looks at lives apart from
+* the descriptors, in dense arrays indexed by the same frame number: pin counts
+* in BufMgr::pinCounts and reference information in the replacement policy.
 */
 class BufDesc {
 
@@ -42,41 +64,66 @@ class BufDesc {
   FrameId	frameNo;
 
 	/**
-   * Number of times this page has been pinned
+   * True if page is dirty;  false otherwise
 	 */
-  int pinCnt;
+  std::atomic<bool> dirty;
 
 	/**
-   * True if page is dirty;  false otherwise
+   * True if page is valid
 	 */
-  bool dirty;
+  std::atomic<bool> valid;
 
 	/**
-   * True if page is valid
+   * True while the page is being read from disk into the frame.  Threads which
+   * find the frame in the hash table wait for this to drop before using it.
+	 */
+  std::atomic<bool> ioInProgress;
+
+	/**
+   * Number of threads which hold, or are about to take, a pin on the frame
+   * only to write it out or evict it: the background writer, a thread writing
+   * the page along with a neighbour, or one looking for a victim.  Such a pin
+   * is not the caller's, so flushFile() and disposePage() wait for it instead
+   * of failing.
 	 */
-  bool valid;
+  std::atomic<int> cleaning;
 
 	/**
-   * Has this buffer frame been reference recently
+   * True if the page was brought in by a prefetch and has not been read by
+   * anybody since
 	 */
-  bool refbit;
+  std::atomic<bool> prefetched;
 
 	/**
-   * Initialize buffer frame for a new user
+   * Named pool the page held counts against, see BufMgr::createPool().
+   * Meaningful only while valid is set.
 	 */
-  void Clear()
+  std::uint32_t pool;
+
+	/**
+   * Neighbours of the frame in the buffer manager's list of dirty frames,
+   * guarded by its dirtyLatch.  Meaningful only while dirty is set.
+	 */
+  FrameId dirtyPrev, dirtyNext;
+
+	/**
+   * Forget the page held by the frame without dropping the pin of the thread
+   * which owns it
+	 */
+  void Reset()
 	{
-    pinCnt = 0;
 		file = NULL;
 		pageNo = Page::INVALID_NUMBER;
     dirty = false;
-    refbit = false;
 		valid = false;
-  };
+    ioInProgress = false;
+    prefetched = false;
+  }
 
 	/**
 	 * Set values of member variables corresponding to assignment of frame to a page in the file. Called when a frame 
-	 * in buffer pool is allocated to any page in the file through readPage() or allocPage()
+	 * in buffer pool is allocated to any page in the file through readPage() or allocPage(), by the thread
+	 * holding its only pin
 	 *
 	 * @param filePtr	File object
 	 * @param pageNum	Page number in the file
@@ -85,13 +132,17 @@ class BufDesc {
 	{ 
 		file = filePtr;
     pageNo = pageNum;
-    pinCnt = 1;
     dirty = false;
     valid = true;
-    refbit = true;
+    ioInProgress = false;
   }
 
-  void Print()
+	/**
+	 * Print the descriptor
+	 *
+	 * @param pinCnt	Pin count of the frame
+	 */
+  void Print(const int pinCnt)
 	{
 		if(file != NULL)
 		{
@@ -103,8 +154,7 @@ class BufDesc {
 
 		std::cout << "valid:" << valid << " ";
 		std::cout << "pinCnt:" << pinCnt << " ";
-		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "dirty:" << dirty << "\n";
   }
 
 	/**
@@ -112,64 +162,257 @@ class BufDesc {
 	 */
   BufDesc()
 	{
-  	Clear();
+  	Reset();
+    cleaning = 0;
+    pool = 0;
   }
 };
 
 
 /**
-* @brief Class to maintain statistics of buffer usage 
+* @brief How the pages read by an operation use the buffer pool
+*/
+enum BufferAccessStrategy
+{
+	NORMAL_ACCESS = 0,	/* pages compete for the whole pool */
+	BULK_READ = 1,			/* pages go through a small ring of frames, see BufferRing */
+	MAPPED_READ = 2			/* pages are used in place from a read only mapping of the file, see MmapFile */
+};
+
+
+/**
+* @brief A small ring of frames a large sequential operation reads its pages into
+*
+* Instead of asking the replacement policy for a victim on every miss, a read
+* through a ring reuses the frame the ring handed out size reads ago, as long
+* as that frame is unpinned and still holds the page read into it.  A scan of
+* a relation larger than the pool thus cycles through a few frames instead of
+* pushing every other page out.  A ring is used by one operation at a time and
+* only holds frame numbers; pages read through it are ordinary buffer pool
+* pages, which other readers can find and pin.
 */
-struct BufStats
+class BufferRing
 {
+	friend class BufMgr;
+
+ public:
+	/**
+   * Ring size used unless specified, 32 frames of 8KB
+	 */
+  static const std::uint32_t DEFAULT_SIZE = 32;
+
+	/**
+   * Constructor of BufferRing class
+	 *
+	 * @param size		Number of frames in the ring.  The buffer manager uses no
+	 *								more than an eighth of the pool for one ring.
+	 */
+  explicit BufferRing(const std::uint32_t size = DEFAULT_SIZE)
+    : slots(size > 0 ? size : 1), next(0)
+  {
+    for (std::size_t i = 0; i < slots.size(); i++)
+    {
+      slots[i].frame = 0;
+      slots[i].file = NULL;
+      slots[i].pageNo = Page::INVALID_NUMBER;
+    }
+  }
+
+ private:
 	/**
-   * Total number of accesses to buffer pool
+   * A frame handed out by the ring and the page it was handed out for.  file
+   * is NULL if the slot has not been used yet.
 	 */
-  int accesses;
+  struct Slot {
+    FrameId frame;
+    const File* file;
+    PageId pageNo;
+  };
 
 	/**
-   * Number of pages read from disk (including allocs)
+   * Slots of the ring
 	 */
-  int diskreads;
+  std::vector<Slot> slots;
 
 	/**
-   * Number of pages written back to disk
+   * Slot to use next
 	 */
-  int diskwrites;
+  std::uint32_t next;
 
 	/**
-   * Clear all values 
+   * Latch guarding the ring, which the prefetch thread fills as well
 	 */
-  void clear()
-  {
-		accesses = diskreads = diskwrites = 0;
-  }
-      
+  std::mutex latch;
+};
+
+
+/**
+* @brief A pin on one buffer pool page, dropped when the handle goes away
+*
+* Returned by BufMgr::fetchPage() and BufMgr::newPage().  The handle remembers
+* the frame holding the page, so unpinning it needs no hash table lookup, and
+* a page is unpinned even when an exception leaves the scope holding it.  A
+* handle can be moved but not copied; an empty handle holds no pin.  The
+* buffer manager must outlive its handles.
+*/
+class PageHandle
+{
+	friend class BufMgr;
+
+ public:
 	/**
-   * Constructor of BufStats class 
+   * Constructor of an empty PageHandle
 	 */
-  BufStats()
-  {
-		clear();
-  }
+  PageHandle() : bufMgr(NULL), file(NULL), frame(0), pageNo(Page::INVALID_NUMBER), page_(NULL), dirty(false) {}
+
+	/**
+	 * Take over the pin of another handle, which is left empty.
+	 *
+	 * @param other		Handle to move from
+	 */
+  PageHandle(PageHandle&& other);
+
+	/**
+	 * Drop the pin held, if any, and take over the pin of another handle.
+	 *
+	 * @param other		Handle to move from
+	 * @return  			This handle
+	 */
+  PageHandle& operator=(PageHandle&& other);
+
+  PageHandle(const PageHandle&) = delete;
+  PageHandle& operator=(const PageHandle&) = delete;
+
+	/**
+   * Destructor of PageHandle class, unpins the page.  Never throws: a pin
+   * already dropped behind the handle's back, through unPinPage(), is
+   * counted in BufStats::lostPins instead.
+	 */
+  ~PageHandle();
+
+	/**
+   * Page pinned, NULL for an empty handle
+	 */
+  Page* page() const { return page_; }
+
+  Page* operator->() const { return page_; }
+  Page& operator*() const { return *page_; }
+
+	/**
+   * Number of the page pinned in its file
+	 */
+  PageId pageNumber() const { return pageNo; }
+
+	/**
+   * True if the handle holds a pin
+	 */
+  explicit operator bool() const { return page_ != NULL; }
+
+	/**
+   * Have the page written back to disk once it is evicted or flushed. Takes
+   * effect when the pin is dropped.
+   *
+   * @throws  ReadOnlyFileException If the page is of a mapped file
+	 */
+  void markDirty();
+
+	/**
+	 * Unpin the page now, leaving the handle empty.  Does nothing on an empty
+	 * handle.
+	 *
+   * @throws  PageNotPinnedException If the pin was already dropped through
+   *                                 unPinPage()
+	 */
+  void release();
+
+ private:
+	/**
+	 * Unpin the page, leaving the handle empty.
+	 *
+	 * @param check		True to throw if the pin was already dropped, false to
+	 *								count it in BufStats::lostPins
+	 */
+  void unpin(const bool check);
+
+	/**
+	 * Constructor used by BufMgr, for a page it has just pinned.
+	 */
+  PageHandle(BufMgr* bufMgr, File* file, const FrameId frame, const PageId pageNo, Page* page)
+    : bufMgr(bufMgr), file(file), frame(frame), pageNo(pageNo), page_(page), dirty(false) {}
+
+	/**
+   * Buffer manager the page is pinned in
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * File the page belongs to
+	 */
+  File* file;
+
+	/**
+   * Frame holding the page
+	 */
+  FrameId frame;
+
+	/**
+   * Page number in its file
+	 */
+  PageId pageNo;
+
+	/**
+   * The page itself
+	 */
+  Page* page_;
+
+	/**
+   * True if the page is unpinned dirty
+	 */
+  bool dirty;
 };
 
 
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* All public methods may be called from several threads at once.  The hash
+* table is latched per partition and pin counts are atomic.  Which frame to
+* evict is decided by a ReplacementPolicy chosen at construction; the default
+* clock policy is latch free, so threads sweep different frames instead of
+* queueing on a single latch.
+*
+* The number of frames can be changed with resize() while the pool is in use.
+* Address space for the frames and their descriptors is reserved up front, so
+* neither array ever moves; memory is only committed for the frames in use.
 */
 class BufMgr 
 {
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Number of frames in the buffer pool
 	 */
-  FrameId clockHand;
+  std::atomic<std::uint32_t> numBufs;
 
 	/**
-   * Number of frames in the buffer pool
+   * Number of frames address space is reserved for, the most resize() allows
 	 */
-  std::uint32_t numBufs;
+  std::uint32_t maxBufs;
+
+	/**
+   * Number of descriptors constructed in bufDescTable so far.  Frames from
+   * numBufs up to here were removed by resize() and stay claimed by it.
+	 */
+  std::uint32_t descsBuilt;
+
+	/**
+   * Bytes of bufDescTable and of pinCounts committed so far
+	 */
+  std::size_t descBytesCommitted, pinBytesCommitted;
+
+	/**
+   * Latch serialising resize(), and pool creation with it
+	 */
+  std::mutex resizeLatch;
 	
 	/**
    * Hash table mapping (File, page) to frame
@@ -182,114 +425,1332 @@ class BufMgr
   BufDesc *bufDescTable;
 
 	/**
-   * Maintains Buffer pool usage statistics 
+   * Number of times the page in each frame has been pinned.  Kept out of
+   * bufDescTable so that a sweep past pinned frames reads sixteen of them per
+   * cache line instead of one.
 	 */
-  BufStats bufStats;
+  std::atomic<int>* pinCounts;
 
 	/**
-	 * Allocate a free frame.  
+	 * Try to take the first pin on an unpinned frame.  Succeeds only if nobody
+	 * else holds a pin, which gives the caller exclusive use of the frame.
+	 * Pinned frames are only read, so sweeping past them does not take their
+	 * cache lines away from the threads using them.
 	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 * @param frame 	Frame number
+	 * @return	True if the frame was unpinned and is now pinned by the caller
+	 */
+  bool tryClaim(const FrameId frame)
+  {
+    int expected = 0;
+    return pinCounts[frame].load(std::memory_order_relaxed) == 0
+      && pinCounts[frame].compare_exchange_strong(expected, 1);
+  }
+
+	/**
+	 * Same as tryClaim(), for a thread about to evict the page in the frame.
+	 * It counts as cleaning the frame until it calls evictClaimed() and then
+	 * endEviction(), so flushFile() and disposePage() wait for it.
+	 *
+	 * @param frame 	Frame number
+	 * @return	True if the frame was unpinned and is now pinned by the caller
 	 */
-  void allocBuf(FrameId & frame);
+  bool claimVictim(const FrameId frame)
+  {
+    if (pinCounts[frame].load(std::memory_order_relaxed) != 0)
+      return false;
+    bufDescTable[frame].cleaning++;
+    if (tryClaim(frame))
+      return true;
+    bufDescTable[frame].cleaning--;
+    frameReleased();
+    return false;
+  }
 
 	/**
-   * Advance clock to next frame in the buffer pool
+	 * Ends the eviction of a frame claimed with claimVictim().  An abandoned
+	 * eviction leaves the frame unpinned, so waiting allocations are woken.
+	 *
+	 * @param frame 	Frame number
 	 */
-  void advanceClock()
+  void endEviction(const FrameId frame)
   {
-		clockHand = (clockHand + 1) % numBufs;
+    bufDescTable[frame].cleaning--;
+    frameReleased();
   }
 
+	/**
+   * Decides which frame to evict
+	 */
+  ReplacementPolicy *policy;
 
- public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Maintains Buffer pool usage statistics 
 	 */
-  Page* bufPool;
+  BufStats bufStats;
 
 	/**
-   * Constructor of BufMgr class
+   * Hits and misses of the files read through the pool, split up like the
+   * hash table and guarded by its partition latches, so counting costs no
+   * latch of its own.  flushFile() moves a file's counts to closedFileStats.
 	 */
-  BufMgr(std::uint32_t bufs);
-	
+  std::unordered_map<const File*, FileStats> fileStats[BufHashTbl::NUM_PARTITIONS];
+
 	/**
-   * Destructor of BufMgr class
+   * Hits and misses of files flushed since, by name, and their latch
 	 */
-  ~BufMgr();
+  std::map<std::string, FileStats> closedFileStats;
+  std::mutex statsLatch;
 
 	/**
-	 * Reads the given page from the file into a frame and returns the pointer to page.
-	 * If the requested page is already present in the buffer pool pointer to that frame is returned
-	 * otherwise a new frame is allocated from the buffer pool for reading the page.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number in the file to be read
-	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+   * Number of frames whose dirty flag is set
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  std::atomic<std::uint32_t> dirtyFrames;
 
 	/**
-	 * Unpin a page from memory since it is no longer required for it to remain in memory.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
-	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
-   * @throws  PageNotPinnedException If the page is not already pinned
+   * Dirty frames in the order they were dirtied, linked through
+   * BufDesc::dirtyPrev and dirtyNext.  NO_FRAME if the list is empty.
 	 */
-  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+  FrameId dirtyHead, dirtyTail;
 
 	/**
-	 * Allocates a new, empty page in the file and returns the Page object.
-	 * The newly allocated page is also assigned a frame in the buffer pool.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
-	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+   * Latch guarding the dirty list and the dirty flags' transitions
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  std::mutex dirtyLatch;
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
-	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
-	 *
-	 * @param file   	File object
-   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
-   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+   * Marks the end of the dirty list
 	 */
-  void flushFile(const File* file);
+  static const FrameId NO_FRAME = 0xffffffff;
 
 	/**
-	 * Delete page from file and also from buffer pool if present.
-	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
+   * Frames holding pages of one file, by page number
 	 */
-  void disposePage(File* file, const PageId PageNo);
+  typedef std::map<PageId, FrameId> FileFrames;
 
 	/**
-   * Print member variable values. 
+   * Frames of every file with pages in the pool, so flushing a file need not
+   * look at the whole pool.  Kept in step with the hash table: entries are
+   * added and removed under the page's partition latch, then fileFramesLatch.
 	 */
-  void  printSelf();
+  std::unordered_map<const File*, FileFrames> fileFrames;
+  std::mutex fileFramesLatch;
 
 	/**
-   * Get buffer pool usage statistics
+   * Largest number of named pools, the default pool included
 	 */
-  BufStats & getBufStats()
-  {
-		return bufStats;
-  }
+  static const std::uint32_t MAX_POOLS = 16;
 
 	/**
-   * Clear buffer pool usage statistics
+   * A named share of the frames, see createPool().  Frames are not set aside:
+   * a pool below its minimum takes frames from pools above theirs, and a pool
+   * at its maximum replaces its own pages only.
 	 */
-  void clearBufStats() 
-  {
-		bufStats.clear();
-  }
+  struct BufPool {
+    std::string name;
+    std::uint32_t minFrames;
+
+		/**
+     * Most frames the pool may use, lowered by resize() when the pool shrinks
+     * below it
+		 */
+    std::atomic<std::uint32_t> maxFrames;
+
+		/**
+     * Number of frames holding pages of the pool
+		 */
+    std::atomic<std::uint32_t> resident;
+  };
+
+	/**
+   * The pools, pool 0 being the default one every file starts in.  Entries
+   * below numPools do not change once created.
+	 */
+  BufPool pools[MAX_POOLS];
+  std::atomic<std::uint32_t> numPools;
+
+	/**
+   * Pool of each file bound to one other than the default, by file name
+	 */
+  std::unordered_map<std::string, std::uint32_t> filePools;
+
+	/**
+   * Latch guarding the creation of pools and filePools
+	 */
+  std::mutex poolsLatch;
+
+	/**
+   * Microseconds an allocation waits for a frame to be unpinned, when every
+   * frame is pinned, before it gives up.  See setAllocWaitTimeout().
+	 */
+  std::atomic<std::uint32_t> allocWaitTimeout;
+
+	/**
+   * Number of threads waiting in tryAllocBuf() for a frame to be unpinned
+	 */
+  std::atomic<std::uint32_t> allocWaiters;
+
+	/**
+   * Number of threads waiting in waitUntil() for a read, a write or a pin
+   * of a frame to end
+	 */
+  std::atomic<std::uint32_t> frameWaiters;
+
+	/**
+   * Bumped, under unpinLatch, each time a frame may have become free while
+   * allocations are waiting
+	 */
+  std::uint64_t unpinEpoch;
+
+	/**
+   * Latch and condition waiting allocations, and threads in waitUntil(),
+   * park on
+	 */
+  std::mutex unpinLatch;
+  std::condition_variable unpinned;
+
+	/**
+   * The background writer starts cleaning once dirtyFrames reaches
+   * highWatermark and stops when it is down to lowWatermark
+	 */
+  std::atomic<std::uint32_t> lowWatermark, highWatermark;
+
+	/**
+   * Background writer thread, not joinable while it is not running
+	 */
+  std::thread writer;
+
+	/**
+   * Latch and condition the background writer sleeps on
+	 */
+  std::mutex writerLatch;
+  std::condition_variable writerWakeup;
+
+	/**
+   * Tells the background writer to exit
+	 */
+  std::atomic<bool> writerStop;
+
+	/**
+   * How long the background writer sleeps between checks of the watermarks
+	 */
+  static const int WRITER_INTERVAL_MS = 50;
+
+	/**
+   * A page waiting to be prefetched
+	 */
+  struct PrefetchRequest {
+    File* file;
+    PageId pageNo;
+
+		/**
+     * True if queued by readahead, which makes it pointless once the reader
+     * has got to the page
+		 */
+    bool readahead;
+
+		/**
+     * Ring the page is to be read into, NULL for none
+		 */
+    BufferRing* ring;
+  };
+
+	/**
+   * Pages waiting to be prefetched, served in order by the prefetch thread
+	 */
+  std::deque<PrefetchRequest> prefetchQueue;
+
+	/**
+   * Latch guarding prefetchQueue, prefetchCurrent, prefetchPages and
+   * prefetchStop
+	 */
+  std::mutex prefetchLatch;
+
+	/**
+   * Signalled when requests are queued, and when a prefetch has finished
+	 */
+  std::condition_variable prefetchWakeup, prefetchDone;
+
+	/**
+   * File of the page the prefetch thread is reading, NULL if idle
+	 */
+  const File* prefetchCurrent;
+
+	/**
+   * Pages of prefetchCurrent the prefetch thread is reading
+	 */
+  std::vector<PageId> prefetchPages;
+
+	/**
+   * Tells the prefetch thread to exit
+	 */
+  bool prefetchStop;
+
+	/**
+   * Prefetch thread, started by the first prefetch request
+	 */
+  std::thread prefetcher;
+
+	/**
+   * Pages of the residency snapshot given to loadResidency() which have not
+   * been queued for prefetching yet, by file name, in page number order.
+   * The pages of a file are queued on the first miss on it.
+	 */
+  std::map<std::string, std::vector<PageId> > warmPages;
+
+	/**
+   * Latch guarding warmPages
+	 */
+  std::mutex warmLatch;
+
+	/**
+   * True while warmPages is not empty, checked on every miss without the latch
+	 */
+  std::atomic<bool> warmPending;
+
+	/**
+   * Sequential access detection for one file
+	 */
+  struct Readahead {
+		/**
+     * Page a sequential reader would read next
+		 */
+    PageId next;
+
+		/**
+     * Number of pages read in sequence so far
+		 */
+    std::uint32_t run;
+
+		/**
+     * One past the last page read ahead
+		 */
+    PageId end;
+  };
+
+	/**
+   * Readahead state of every file read from recently, and its latch
+	 */
+  std::unordered_map<const File*, Readahead> readaheads;
+  std::mutex readaheadLatch;
+
+	/**
+   * Number of pages to read ahead of a sequential reader, 0 disables readahead
+	 */
+  std::atomic<std::uint32_t> readaheadPages;
+
+	/**
+   * Readahead window used unless changed with setReadahead()
+	 */
+  static const std::uint32_t DEFAULT_READAHEAD_PAGES = 16;
+
+	/**
+   * Number of pages a file has to be read in sequence before readahead starts
+	 */
+  static const std::uint32_t READAHEAD_TRIGGER = 2;
+
+	/**
+   * Number of files whose access pattern is tracked at once
+	 */
+  static const std::size_t MAX_READAHEAD_STREAMS = 64;
+
+	/**
+   * Largest number of pages written back with one write, 128KB
+	 */
+  static const std::uint32_t MAX_WRITE_RUN = 16;
+
+	/**
+   * Largest number of pages readPages() reads with one read, 128KB
+	 */
+  static const std::uint32_t MAX_READ_RUN = 16;
+
+	/**
+   * Requests in flight at once, set by setIoDepth(); 0 while I/O is synchronous
+	 */
+  std::atomic<std::uint32_t> ioDepth;
+
+	/**
+   * Rings not in use, each set up for ioDepth requests, and their latch.  A
+   * ring is used by one thread at a time, see takeRing().
+	 */
+  std::vector<IoRing*> idleRings;
+  std::mutex ringsLatch;
+
+	/**
+   * One readPage() call in this many is timed for BufStats::readPageLatency
+	 */
+  static const std::uint32_t LATENCY_SAMPLE_INTERVAL = 16;
+
+	/**
+   * A page held by a frame, as seen at one moment
+	 */
+  struct FramePage {
+    const File* file;
+    PageId pageNo;
+    FrameId frame;
+
+    bool operator<(const FramePage& other) const
+    {
+      if (file != other.file)
+        return std::less<const File*>()(file, other.file);
+      return pageNo < other.pageNo;
+    }
+  };
+
+	/**
+	 * Allocate a free frame.  The frame is returned pinned once by the caller and
+	 * is not in the hash table, so no other thread can reach it.
+	 *
+	 * @param file   	File the frame is for, which decides the pool it comes out of
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 */
+  void allocBuf(const File* file, FrameId & frame);
+
+	/**
+	 * Allocate a free frame like allocBuf(), but report a buffer pool in which
+	 * every frame is pinned through the return value.  If allowed, waits up to
+	 * allocWaitTimeout for a frame to be unpinned first.
+	 *
+	 * @param file   	File the frame is for
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param wait   	False to give up at once, as a prefetch does
+	 * @return  				False if no frame could be allocated
+	 */
+  bool tryAllocBuf(const File* file, FrameId & frame, const bool wait);
+
+	/**
+	 * Wake allocations waiting for a frame, after a pin was dropped or a frame
+	 * freed.  This includes the short-lived pins of the background writer,
+	 * prefetches and evictions: a waiting allocation may have swept the pool
+	 * while they held the only unpinned frame.  Also called when a read into
+	 * a frame or the cleaning of one ends, for the threads in waitUntil().
+	 * Costs two atomic loads when nobody waits.
+	 */
+  void frameReleased()
+  {
+    if (allocWaiters > 0 || frameWaiters > 0)
+    {
+      std::lock_guard<std::mutex> lock(unpinLatch);
+      unpinEpoch++;
+      unpinned.notify_all();
+    }
+  }
+
+	/**
+	 * Pool the pages of the file count against.
+	 *
+	 * @param file   	File object
+	 * @return  			Index in pools
+	 */
+  std::uint32_t poolOf(const File* file);
+
+	/**
+	 * Check whether a page of the given pool may be loaded into a frame the
+	 * caller has claimed, evicting the page held there.
+	 *
+	 * @param poolNo 	Pool the frame is wanted for
+	 * @param frameNo	Frame number, pinned once by the caller
+	 * @return  			True if the pools' sizes allow it
+	 */
+  bool poolMayTake(const std::uint32_t poolNo, const FrameId frameNo);
+
+	/**
+	 * Evict the page held by a frame the caller has claimed.
+	 *
+	 * @param frameNo 	Frame number, pinned once by the caller
+	 * @param evicted 	Passed on to ReplacementPolicy::pageRemoved()
+	 * @return  				True if the frame is now empty and still pinned by the
+	 *									caller, false if the eviction was abandoned because the page
+	 *									got pinned or dirtied again; the caller's pin is dropped then
+	 * @throws  Whatever writing the page throws, after dropping the pin
+	 */
+  bool evictClaimed(const FrameId frameNo, const bool evicted);
+
+	/**
+	 * Allocate a frame for a page read through a ring, reusing the frame of the
+	 * ring's next slot if possible and asking tryAllocBuf() otherwise.
+	 *
+	 * @param ring			Buffer ring
+	 * @param file   	File object the frame is for
+	 * @param pageNo  Page number the frame is for
+	 * @param frame   	Frame ID of allocated frame returned via this variable
+	 * @param wait   	Passed on to tryAllocBuf()
+	 * @return  				False if no frame could be allocated
+	 */
+  bool allocRingBuf(BufferRing* ring, const File* file, const PageId pageNo, FrameId& frame,
+                    const bool wait);
+
+	/**
+	 * Number of slots of the ring actually used with this pool.
+	 *
+	 * @param ring			Buffer ring
+	 * @return  				Ring size, at most an eighth of the pool
+	 */
+  std::uint32_t ringSize(const BufferRing* ring) const;
+
+	/**
+	 * Give back a frame obtained from allocBuf() which ended up not being used.
+	 *
+	 * @param frame   	Frame number
+	 */
+  void releaseBuf(const FrameId frame);
+
+	/**
+	 * Block until a condition on frames holds: the condition has to turn true
+	 * only by a change which is followed by frameReleased(), as the end of a
+	 * read or of cleaning, or a pin dropped, are.
+	 *
+	 * @param done   	Condition waited for, checked with unpinLatch held
+	 */
+  void waitUntil(const std::function<bool()>& done);
+
+	/**
+	 * Same as waitUntil(), giving up at a deadline.
+	 *
+	 * @param done   	Condition waited for, checked with unpinLatch held
+	 * @param deadline	Time to give up at
+	 * @return  				True if the condition holds, false if the deadline passed
+	 */
+  bool waitUntil(const std::function<bool()>& done,
+                 const std::chrono::steady_clock::time_point deadline);
+
+	/**
+	 * Wait until a pending read into the frame has finished.
+	 *
+	 * @param frame   	Frame number
+	 * @return  				True if the frame now holds a valid page, false if the read failed
+	 */
+  bool waitForIo(const FrameId frame);
+
+	/**
+	 * Set the dirty flag of a frame and wake the background writer if there
+	 * are too many dirty frames.
+	 *
+	 * @param frame   	Frame number
+	 */
+  void markDirty(const FrameId frame);
+
+	/**
+	 * Clear the dirty flag of a frame.
+	 *
+	 * @param frame   	Frame number
+	 * @return  				True if the frame was dirty, the caller now has to write it
+	 */
+  bool takeDirty(const FrameId frame);
+
+	/**
+	 * Counters of the file in the partition of (file, pageNo).  Called with the
+	 * partition latch held.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number
+	 * @return  			Counters to update
+	 */
+  FileStats& fileStatsOf(const File* file, const PageId pageNo);
+
+	/**
+	 * Move the counters of a file to closedFileStats, so they outlive the File
+	 * object.
+	 *
+	 * @param file   	File object
+	 */
+  void retireFileStats(const File* file);
+
+	/**
+	 * Copy the dirty list, oldest first.
+	 *
+	 * @param frames   	Dirty frames are appended here
+	 */
+  void listDirty(std::vector<FrameId>& frames);
+
+	/**
+	 * Copy the dirty list, sorted by file and page number.
+	 *
+	 * @param pages   	Dirty pages are appended here
+	 */
+  void listDirtyByPage(std::vector<FramePage>& pages);
+
+	/**
+	 * Write out a page together with the dirty, unpinned pages next to it in
+	 * the file, up to MAX_WRITE_RUN pages, using a single write.
+	 *
+	 * @param frame   	Frame holding the page.  The caller holds a pin on it and
+	 *									has taken its dirty flag.
+	 * @return  				Number of pages written
+	 * @throws  Whatever writing the pages throws, after marking the neighbours
+	 *					dirty again; the caller's frame is left to the caller
+	 */
+  std::uint32_t writeRun(const FrameId frame);
+
+	/**
+	 * A run of dirty pages written with one write, see prepareRun()
+	 */
+  struct WriteRun {
+		/**
+     * Frame the run was built around, pinned by the caller
+		 */
+    FrameId frame;
+    File* file;
+    PageId first;
+    std::vector<const Page*> pages;
+
+		/**
+     * Frames of the other pages, claimed with claimForWrite()
+		 */
+    std::vector<FrameId> neighbours;
+
+    std::chrono::steady_clock::time_point start;
+  };
+
+	/**
+	 * Gather the run writeRun() would write, claiming the neighbours, without
+	 * writing it.
+	 *
+	 * @param frame   	Frame holding the page, as for writeRun()
+	 * @param run   		Filled in with the run
+	 */
+  void prepareRun(const FrameId frame, WriteRun& run);
+
+	/**
+	 * Release the neighbours of a run once it has been written, or has failed;
+	 * they are marked dirty again then.  The caller's frame is left to the
+	 * caller.
+	 *
+	 * @param run   		Run from prepareRun()
+	 * @param written  	True if the pages were written
+	 */
+  void finishRun(const WriteRun& run, const bool written);
+
+	/**
+	 * Wait for a run queued on a ring by checkpoint() and release it and its
+	 * frame.  A run which was not written is left dirty.
+	 *
+	 * @param ring   		Ring with a write in flight
+	 * @param runs   		Runs queued, by tag
+	 * @param error   	Set to an IoErrorException if the run failed and it was
+	 *									not set yet
+	 */
+  void reapRun(IoRing& ring, const std::vector<WriteRun>& runs, std::exception_ptr& error);
+
+	/**
+	 * Pin a neighbour of a page being written so it can be written along, see
+	 * BufDesc::cleaning.
+	 *
+	 * @param frame   	Frame number
+	 * @param file   	File the frame should hold a page of
+	 * @param pageNo  Page the frame should hold
+	 * @return  				True if the frame was unpinned, still holds the page and
+	 *									was dirty; its dirty flag has been taken then
+	 */
+  bool claimForWrite(const FrameId frame, const File* file, const PageId pageNo);
+
+	/**
+	 * Drop a pin taken by claimForWrite().
+	 *
+	 * @param frame   	Frame number
+	 */
+  void releaseForWrite(const FrameId frame);
+
+	/**
+	 * Record that a page has been added to the pool.  Called with the page's
+	 * partition latch held, along with the hash table update.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number
+	 * @param frame   	Frame now holding the page
+	 */
+  void addFileFrame(const File* file, const PageId pageNo, const FrameId frame);
+
+	/**
+	 * Record that a page has left the pool, the counterpart of addFileFrame().
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number
+	 */
+  void removeFileFrame(const File* file, const PageId pageNo);
+
+	/**
+	 * Wait until the background writer is done with a frame.
+	 *
+	 * @param frame   	Frame number
+	 */
+  void waitForCleaning(const FrameId frame);
+
+	/**
+	 * Write out one dirty, unpinned frame on behalf of the background writer.
+	 *
+	 * @param frame   	Frame number
+	 * @return  				True if the frame was written
+	 */
+  bool cleanFrame(const FrameId frame);
+
+	/**
+	 * Write out dirty frames until no more than lowWatermark are left, those
+	 * the replacement policy would evict next first.
+	 */
+  void cleanToLowWatermark();
+
+	/**
+	 * Main loop of the background writer thread.
+	 */
+  void runWriter();
+
+	/**
+	 * Pin the given page, reading it into a frame if it is not in the pool.
+	 * This is the body of readPage() and of the prefetch thread.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param prefetch	True to only bring the page in: a page already in the pool
+	 *									is left alone, and a page read is marked as prefetched
+	 * @param ring		Ring to read the page into, NULL to use the whole pool
+	 * @param frameNo	Frame holding the page, pinned once by the caller
+	 * @param loaded	Set to true if the page was read from disk
+	 * @param defer		True to leave reading a page which is not in the pool to
+	 *									the caller, see loadRuns(); loaded is set all the same
+	 * @return  			False if no frame could be allocated, or if prefetching a
+	 *									page which is already in the pool
+	 */
+  bool pinPage(File* file, const PageId pageNo, const bool prefetch, BufferRing* ring,
+               FrameId& frameNo, bool& loaded, const bool defer = false);
+
+	/**
+	 * Read pages into the frames taken for them, each run of neighbours with
+	 * one read.  With io_uring, up to ioDepth runs are in flight at once.
+	 * Other threads waiting for a page may go on as soon as its run is in.
+	 *
+	 * @param file   	File object
+	 * @param reads		Pages and the frames to read them into, in page number
+	 *									order, with BufDesc::ioInProgress set
+	 * @param loaded	Set to true for each page read, whose ioInProgress is
+	 *									cleared; the others are left to the caller
+	 * @throws  Whatever reading the first failed run throws, once none of the
+	 *					reads is in flight any more
+	 */
+  void loadRuns(File* file, const std::vector<FramePage>& reads, std::vector<bool>& loaded);
+
+	/**
+	 * Bring in a batch of pages of one file for the prefetch thread, reading
+	 * them with loadRuns().
+	 *
+	 * @param requests	Requests for pages of the same file
+	 */
+  void prefetchBatch(const std::vector<PrefetchRequest>& requests);
+
+	/**
+	 * Take a ring for the calling thread, from the idle ones or a new one.
+	 *
+	 * @return  			The ring, NULL if I/O is synchronous
+	 */
+  IoRing* takeRing();
+
+	/**
+	 * Give back a ring from takeRing(), with nothing in flight.
+	 *
+	 * @param ring		The ring
+	 */
+  void returnRing(IoRing* ring);
+
+	/**
+	 * Pin the given page if it is in the pool, without waiting for a read of
+	 * it in progress.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo	Set to the frame holding the page
+	 * @return  			True if the page was found and pinned
+	 */
+  bool pinResident(File* file, const PageId pageNo, FrameId& frameNo);
+
+	/**
+	 * Give up a frame whose page could not be read: take the page out of the
+	 * hash table and drop the pin of the thread reading it.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frame		Frame the page was being read into
+	 */
+  void abandonRead(File* file, const PageId pageNo, const FrameId frame);
+
+	/**
+	 * Record a read of the page for sequential access detection and queue the
+	 * next pages for prefetching if the file is being read in order.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number just read
+	 * @param ring		Ring the page was read through, used for the pages read ahead
+	 */
+  void readahead(File* file, const PageId pageNo, BufferRing* ring);
+
+	/**
+	 * Queue pages for the prefetch thread, starting it if needed.
+	 *
+	 * @param file   	File object
+	 * @param pageIds Pages to read
+	 * @param readahead	True if the request comes from readahead
+	 * @param ring		Ring to read the pages into, NULL to use the whole pool
+	 */
+  void queuePrefetch(File* file, const std::vector<PageId>& pageIds, const bool readahead, BufferRing* ring);
+
+	/**
+	 * Check whether a sequential reader of the file has already got past the
+	 * page, so reading it ahead is no use any more.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number
+	 * @return  			True if the page is behind the reader
+	 */
+  bool readerPassed(const File* file, const PageId pageNo);
+
+	/**
+	 * Main loop of the prefetch thread.
+	 */
+  void runPrefetcher();
+
+	/**
+	 * Drop queued prefetches of the file and wait for one in progress.
+	 *
+	 * @param file   	File object
+	 */
+  void cancelPrefetch(const File* file);
+
+	/**
+	 * Drop queued prefetches of a page of the file and wait for one of it in
+	 * progress.  Those of the other pages of the file stay queued.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number
+	 */
+  void cancelPrefetch(const File* file, const PageId pageNo);
+
+	/**
+	 * Stop the prefetch thread if it is running, dropping queued requests.
+	 */
+  void stopPrefetcher();
+
+	/**
+	 * Queue the pages of the file listed in the residency snapshot for
+	 * prefetching, if there are any left.
+	 *
+	 * @param file   	File object
+	 */
+  void warmFile(File* file);
+
+	/**
+	 * Body of tryReadPage(), returning the frame the page is pinned in.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param ring		Buffer ring, as for readPage()
+	 * @param frameNo	Set to the frame holding the page
+	 * @return  			False if no frame could be allocated for the page
+	 */
+  bool readFrame(File* file, const PageId pageNo, BufferRing* ring, FrameId& frameNo);
+
+	/**
+	 * Page of a mapped file, used in place without a frame.
+	 *
+	 * @param file   	File object, for which File::mapped() is true
+	 * @param pageNo  Page number in the file
+	 * @return  			The page in the mapping
+	 */
+  Page* readMapped(File* file, const PageId pageNo);
+
+	/**
+	 * Body of allocPage(), returning the frame the new page is pinned in.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Set to the number of the new page
+	 * @return  			Frame holding the page
+	 */
+  FrameId allocFrame(File* file, PageId& pageNo);
+
+	/**
+	 * Drop one pin of a frame, known to hold the page the caller pinned.
+	 *
+	 * @param frameNo	Frame number
+	 * @param dirty		True if the page needs to be marked dirty
+   * @throws  PageNotPinnedException If the frame is not pinned
+	 */
+  void unPinFrame(const FrameId frameNo, const bool dirty);
+
+	/**
+	 * Drop one pin of a frame as unPinFrame() does, without throwing if there
+	 * is none.
+	 *
+	 * @param frameNo	Frame number
+	 * @param dirty		True if the page needs to be marked dirty
+	 * @return  			False if the frame was not pinned
+	 */
+  bool tryUnPinFrame(const FrameId frameNo, const bool dirty);
+
+	/**
+	 * Reserve address space without committing memory to it.  Large regions
+	 * are aligned to, and advised for, transparent huge pages where the system
+	 * has them.
+	 *
+	 * @param bytes		Size of the region
+	 * @param huge		True to align the region for huge pages
+	 * @return  			Start of the region
+	 * @throws  std::bad_alloc If the address space cannot be reserved
+	 */
+  static char* reserveRegion(const std::size_t bytes, const bool huge);
+
+	/**
+	 * Reserve bufDescTable, pinCounts and bufPool for maxBufs frames, halving
+	 * maxBufs down to bufs for as long as the system refuses.
+	 *
+	 * @param bufs   	Number of frames the pool starts out with
+   * @throws  std::bad_alloc If not even bufs frames can be reserved
+	 */
+  void reserveTables(const std::uint32_t bufs);
+
+	/**
+	 * Make part of a reserved region usable.  The memory is anonymous, so the
+	 * kernel supplies zeroed pages on first touch and committing does not
+	 * depend on the size of the part.
+	 *
+	 * @param start		Start of the part, page aligned
+	 * @param bytes		Size of the part
+	 * @param huge		True to advise the part for huge pages
+	 * @throws  std::bad_alloc If the memory cannot be committed
+	 */
+  static void commitRegion(char* start, const std::size_t bytes, const bool huge);
+
+	/**
+	 * Give the memory of part of a region back to the system, leaving the
+	 * address space reserved.
+	 *
+	 * @param start		Start of the part, page aligned
+	 * @param bytes		Size of the part
+	 */
+  static void decommitRegion(char* start, const std::size_t bytes);
+
+	/**
+	 * Construct the descriptors of bufDescTable and the pin counts up to the
+	 * given frame, committing memory for them.  New frames are claimed, like
+	 * those removed by resize().
+	 *
+	 * @param bufs  	Number of descriptors needed
+	 * @throws  std::bad_alloc If the memory cannot be committed
+	 */
+  void buildDescs(const std::uint32_t bufs);
+
+	/**
+	 * Add frames numBufs to bufs to the pool.
+	 *
+	 * @param bufs  	New number of frames
+	 * @throws  std::bad_alloc If memory for the frames cannot be committed
+	 */
+  void growFrames(const std::uint32_t bufs);
+
+	/**
+	 * Remove frames bufs to numBufs from the pool, evicting their pages and
+	 * giving their memory back.  Leaves the pool as it was on failure.
+	 *
+	 * @param bufs  	New number of frames
+   * @throws  PagePinnedException If a page stays pinned in one of the frames
+	 */
+  void shrinkFrames(const std::uint32_t bufs);
+
+	/**
+   * Size in bytes of the regions bufPool, bufDescTable and pinCounts point into
+	 */
+  std::size_t bufPoolBytes, descTableBytes, pinTableBytes;
+
+	friend class PageHandle;
+
+
+ public:
+	/**
+   * Actual buffer pool from which frames are allocated
+	 */
+  Page* bufPool;
+
+	/**
+   * Most frames a pool may grow to unless given more explicitly, 32GB worth
+	 */
+  static const std::uint32_t MAX_FRAMES = 1 << 22;
+
+	/**
+   * How many times its initial size a pool may grow to by default
+	 */
+  static const std::uint32_t DEFAULT_GROWTH = 8;
+
+	/**
+   * Milliseconds resize() waits at least for pages pinned in frames it
+   * removes to be unpinned
+	 */
+  static const int RESIZE_WAIT_MS = 100;
+
+	/**
+   * Least time in milliseconds allocPage() gives a pin on a stale copy of
+   * the page it allocates to go, when allocWaitTimeout is shorter: a
+   * prefetch keeps its pin for a moment after its read has finished
+	 */
+  static const int STALE_PIN_WAIT_MS = 1;
+
+	/**
+   * Most requests setIoDepth() lets be in flight at once
+	 */
+  static const std::uint32_t MAX_IO_DEPTH = 256;
+
+	/**
+   * Constructor of BufMgr class.  Address space for maxFrames frames is
+   * reserved up front, without committing memory to it, so that resize() can
+   * grow the pool in place.  If the system refuses that much, the reservation
+   * is halved until it succeeds, down to bufs; see getMaxFrames().
+	 *
+	 * @param bufs   	Number of frames in the buffer pool
+	 * @param policyType	Page replacement algorithm to use
+	 * @param maxFrames	Most frames resize() may grow the pool to, 0 for
+	 *								DEFAULT_GROWTH times bufs, at most MAX_FRAMES
+	 */
+  BufMgr(std::uint32_t bufs, ReplacementPolicyType policyType = CLOCK,
+         const std::uint32_t maxFrames = 0);
+	
+	/**
+   * Destructor of BufMgr class
+	 */
+  ~BufMgr();
+
+	/**
+	 * Reads the given page from the file into a frame and returns the pointer to page.
+	 * If the requested page is already present in the buffer pool pointer to that frame is returned
+	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 * Pages of a mapped file (see MmapFile) take no frame: the pointer returned
+	 * points into the mapping, the page must not be modified, and unpinning it
+	 * does nothing.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param ring		If not NULL, a miss reads the page into a frame of this ring
+	 *								rather than evicting a page chosen by the replacement policy
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page, BufferRing* ring = NULL);
+
+	/**
+	 * Same as readPage(), but returns false instead of throwing
+	 * BufferExceededException if every frame is pinned.  Neither a hit nor a
+	 * miss raises an exception internally.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer, set only if true is returned
+	 * @param ring		Buffer ring, as for readPage()
+	 * @return  			False if no frame could be allocated for the page
+	 */
+  bool tryReadPage(File* file, const PageId PageNo, Page*& page, BufferRing* ring = NULL);
+
+	/**
+	 * Reads many pages of a file at once, such as the pages holding the
+	 * records of a list of RecordIds.  Pages in the pool are pinned first;
+	 * frames are then allocated for all the others together, and these are
+	 * read in page number order, neighbouring pages with a single read.  Each
+	 * page is pinned once for every time it appears in pageIds, and must be
+	 * unpinned as often.  If an exception is thrown no page is left pinned.
+	 *
+	 * @param file   	File object
+	 * @param pageIds	Numbers of the pages to read, in any order
+	 * @param pages		Set to the pages, in the order of pageIds
+   * @throws  BufferExceededException If there are not enough frames for the
+   *                                  pages missing
+	 */
+  void readPages(File* file, const std::vector<PageId>& pageIds, std::vector<Page*>& pages);
+
+	/**
+	 * Unpin a page from memory since it is no longer required for it to remain in memory.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+   * @throws  PageNotPinnedException If the page is not already pinned
+   * @throws  ReadOnlyFileException If dirty is set for a page of a mapped file
+	 */
+  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Allocates a new, empty page in the file and returns the Page object.
+	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 * If the file hands out the number of a page disposed of a moment ago,
+	 * which readahead has read in again meanwhile, the stale copy is dropped
+	 * once nobody holds a pin on it.  A read or write of the copy is waited
+	 * for; a pin of a caller for as long as setAllocWaitTimeout() allows, and
+	 * at least STALE_PIN_WAIT_MS.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+   * @throws  PagePinnedException If a stale copy of the page stays pinned; the
+   *                              page is given back to the file then
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page); 
+
+	/**
+	 * Same as readPage(), but returns the page pinned in a handle, which
+	 * unpins it when it goes away.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param ring		Buffer ring, as for readPage()
+	 * @return  			Handle holding the page
+	 */
+  PageHandle fetchPage(File* file, const PageId pageNo, BufferRing* ring = NULL);
+
+	/**
+	 * Same as allocPage(), but returns the new page pinned in a handle, which
+	 * unpins it when it goes away.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Set to the number of the new page
+	 * @return  			Handle holding the page
+	 */
+  PageHandle newPage(File* file, PageId& pageNo);
+
+	/**
+	 * Writes out all dirty pages of the file to disk.
+	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
+	 * Otherwise Error returned.  Prefetches of the file still queued are dropped,
+	 * so the File object, and any BufferRing used to read it, may be deleted
+	 * afterwards.  Only the frames holding pages of the file are visited, in
+	 * ascending page number order, so the writes go to disk sequentially.
+	 * The file header is written too, see File::sync().  The replacement policy
+	 * forgets the pages of the file it remembers after their eviction.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws  IoErrorException If a page could not be written; it stays dirty
+	 */
+  void flushFile(const File* file);
+
+	/**
+	 * Writes out every dirty page in the buffer pool, file by file in page
+	 * number order, coalescing neighbouring pages into single writes, along
+	 * with the headers of their files.  Pages stay in the pool.  Pages
+	 * dirtied while this runs may or may not be written.
+	 *
+   * @throws  IoErrorException If a page could not be written; it stays dirty
+	 */
+  void checkpoint();
+
+	/**
+	 * Delete page from file and also from buffer pool if present.
+	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 * The page must not be pinned.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+   * @throws  PagePinnedException If the page is pinned in the buffer pool
+	 */
+  void disposePage(File* file, const PageId PageNo);
+
+	/**
+   * Print member variable values. 
+	 */
+  void  printSelf();
+
+	/**
+	 * Asynchronously bring pages of a file into the buffer pool, so that a
+	 * later readPage() finds them there.  Returns at once; pages already in the
+	 * pool are skipped and pages which cannot be read are ignored.  The pages
+	 * are not pinned and may be evicted again before they are used.
+	 *
+	 * @param file   	File object
+	 * @param pageIds Pages to read, in the order they should be read
+	 */
+  void prefetch(File* file, const std::vector<PageId>& pageIds);
+
+	/**
+	 * Set how many pages are read ahead of a reader going through a file in
+	 * page number order.  Capped at an eighth of the pool, so that several
+	 * readers can stream at once; 0 turns readahead off.
+	 *
+	 * @param pages  	Readahead window in pages
+	 */
+  void setReadahead(const std::uint32_t pages);
+
+	/**
+	 * Set how many reads or writes may be in flight at once, through io_uring,
+	 * for each readPages() call, for the prefetch thread and for
+	 * checkpoint().  Every run of neighbouring pages is one request, so a
+	 * device with a deep queue is kept busy.  Files opened with DIRECT_IO
+	 * are read around the page cache this way too; frames are page aligned.
+	 *
+	 * @param depth  	Requests in flight at once, 0 (the default) for one at a
+	 *								time without io_uring; capped at MAX_IO_DEPTH
+	 * @return  			False if the kernel offers no io_uring, in which case I/O
+	 *								stays as it was
+	 */
+  bool setIoDepth(const std::uint32_t depth);
+
+	/**
+	 * @return  			Requests in flight at once, see setIoDepth()
+	 */
+  std::uint32_t getIoDepth() const
+  {
+    return ioDepth;
+  }
+
+	/**
+	 * Set how long an allocation waits when every frame is pinned, for a
+	 * frame to be unpinned, before it gives up: readPage() and allocPage()
+	 * then throw BufferExceededException and tryReadPage() returns false.
+	 * A spike of pins thus delays a query instead of failing it.  Prefetches
+	 * never wait.  Waits are counted in BufStats::allocWaits.
+	 *
+	 * @param micros  	Timeout in microseconds, 0 (the default) to give up at once
+	 */
+  void setAllocWaitTimeout(const std::uint32_t micros);
+
+	/**
+	 * Write the pages resident in the pool, as file names and page numbers,
+	 * to a snapshot file which loadResidency() of a later buffer manager can
+	 * warm up from.  May be called at any time, at shutdown or periodically;
+	 * the new snapshot is synced to disk before it replaces the old one, and
+	 * the directory after, so a crash leaves one or the other whole.
+	 *
+	 * @param path   	Name of the snapshot file
+   * @throws  FileNotFoundException If the snapshot cannot be written
+	 */
+  void saveResidency(const std::string& path);
+
+	/**
+	 * Read a snapshot written by saveResidency() and prefetch the pages in it
+	 * in the background, file by file in page number order.  Pages of a file
+	 * are queued when the first page of the file is read from disk, since the
+	 * buffer manager only learns of a file when it is used.  At most as many
+	 * pages as there are frames are taken.  Of a snapshot cut short, the pages
+	 * of the lines before the cut are taken.
+	 *
+	 * @param path   	Name of the snapshot file
+	 * @return  			False if there is no snapshot, or it is not one
+	 */
+  bool loadResidency(const std::string& path);
+
+	/**
+	 * Name of the pool files belong to until bound to another one
+	 */
+  static const char* const DEFAULT_POOL;
+
+	/**
+	 * Create a named pool of frames, to which files can then be bound with
+	 * bindFile().  A pool is guaranteed minFrames frames, taken from pools
+	 * holding more than their own minimum as needed, and never uses more than
+	 * maxFrames; give both the same value for a pool of fixed size.  The
+	 * default pool has no minimum and may use every frame.  The limits are
+	 * checked as frames are allocated, so concurrent misses may overshoot a
+	 * maximum by up to a frame per thread allocating at the same moment.
+	 *
+	 * @param name   	Name of the new pool
+	 * @param minFrames	Frames kept for the pool
+	 * @param maxFrames	Most frames the pool may use
+   * @throws  BadPoolException If the name is taken, minFrames is larger than
+   *                           maxFrames, or the minimums of all pools would
+   *                           add up to more than the frames there are
+	 */
+  void createPool(const std::string& name, const std::uint32_t minFrames, const std::uint32_t maxFrames);
+
+	/**
+	 * Have the pages of a file use a pool.  Binding is by file name, so a file
+	 * can be bound before it is opened, as for the index file a BTreeIndex
+	 * opens itself.  Pages of the file already in the buffer pool keep
+	 * counting against the pool they were read into.
+	 *
+	 * @param filename	Name of the file
+	 * @param pool   	Name of the pool
+   * @throws  BadPoolException If there is no such pool
+	 */
+  void bindFile(const std::string& filename, const std::string& pool);
+
+	/**
+	 * Same as bindFile() above, for an open file.
+	 *
+	 * @param file   	File object
+	 * @param pool   	Name of the pool
+   * @throws  BadPoolException If there is no such pool
+	 */
+  void bindFile(const File* file, const std::string& pool);
+
+	/**
+	 * Start a background thread which writes out dirty, unpinned pages so that
+	 * eviction finds clean victims.  It starts cleaning once highWatermark
+	 * frames are dirty and stops when lowWatermark are left.  Watermarks are
+	 * capped at the number of frames.  A writer already running is restarted
+	 * with the new watermarks.
+	 *
+	 * @param lowWatermark   Number of dirty frames the writer cleans down to
+	 * @param highWatermark  Number of dirty frames which wakes the writer up
+	 */
+  void startBackgroundWriter(std::uint32_t lowWatermark, std::uint32_t highWatermark);
+
+	/**
+	 * Stop the background writer if it is running.  Pages it has not written
+	 * yet stay dirty in the buffer pool.
+	 */
+  void stopBackgroundWriter();
+
+	/**
+	 * Change the number of frames while the pool is in use.  Growing adds
+	 * empty frames and leaves resident pages alone.  Shrinking evicts the pages
+	 * of the frames removed, writing dirty ones back first, and gives their
+	 * memory back to the system.  Pages pinned in those frames are waited for
+	 * as long as allocations wait (see setAllocWaitTimeout()), but at least
+	 * RESIZE_WAIT_MS.  The hash table grows incrementally along with the pool.
+	 *
+	 * @param bufs   	New number of frames
+   * @throws  BadPoolException If bufs is 0 or above getMaxFrames(), or
+   *                           below the minimums of the named pools
+   * @throws  PagePinnedException If shrinking, and a page stays pinned in one
+   *                              of the frames to remove; nothing is removed
+	 */
+  void resize(const std::uint32_t bufs);
+
+	/**
+   * Most frames resize() can grow the pool to
+	 */
+  std::uint32_t getMaxFrames() const
+  {
+    return maxBufs;
+  }
+
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::uint32_t getNumFrames() const
+  {
+		return numBufs;
+  }
+
+	/**
+   * Name of the page replacement algorithm in use
+	 */
+  const char* policyName() const
+  {
+		return policy->name();
+  }
+
+	/**
+   * Get buffer pool usage statistics
+	 */
+  BufStats & getBufStats()
+  {
+		return bufStats;
+  }
+
+	/**
+	 * Copy all usage statistics, including the hits and misses of every file,
+	 * for printing with BufStatsSnapshot::print() or printJson().
+	 *
+	 * @return  			Statistics as of now
+	 */
+  BufStatsSnapshot getStatsSnapshot();
+
+	/**
+   * Clear buffer pool usage statistics
+	 */
+  void clearBufStats();
 };
 
 }
@@ -0,0 +1,22 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bad_pool_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+BadPoolException::BadPoolException(const std::string& name, const std::string& reason)
+    : BadgerDbException(""), pool_name_(name) {
+  std::stringstream ss;
+  ss << "Buffer pool " << pool_name_ << ": " << reason;
+  message_.assign(ss.str());
+}
+
+}
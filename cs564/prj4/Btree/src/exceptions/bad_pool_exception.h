@@ -0,0 +1,43 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a buffer pool is created with sizes
+ *        which do not fit in the frames left, or a pool is named which does
+ *        not exist.
+ */
+class BadPoolException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a bad pool exception for the given pool.
+   *
+   * @param name    Name of the pool.
+   * @param reason  What is wrong with it.
+   */
+  BadPoolException(const std::string& name, const std::string& reason);
+
+  /**
+   * Returns the name of the pool that caused this exception.
+   */
+  virtual const std::string& poolName() const { return pool_name_; }
+
+ protected:
+  /**
+   * Name of pool that caused this exception.
+   */
+  const std::string pool_name_;
+};
+
+}
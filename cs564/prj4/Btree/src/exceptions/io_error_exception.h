@@ -0,0 +1,58 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the operating system fails to
+ *        write to a file, for instance because the disk is full.
+ */
+class IoErrorException : public BadgerDbException {
+ public:
+  /**
+   * Constructs an I/O error exception for the given file and error.
+   *
+   * @param name   Name of file that could not be written.
+   * @param error  errno value describing the failure.
+   */
+  IoErrorException(const std::string& name, const int error);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~IoErrorException() throw() {}
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+  /**
+   * Returns the errno value describing the failure.
+   */
+  virtual int error() const { return error_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * errno value describing the failure.
+   */
+  const int error_;
+};
+
+}
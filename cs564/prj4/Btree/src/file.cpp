@@ -7,24 +7,57 @@
 
 #include "file.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/read_only_file_exception.h"
 #include "file_iterator.h"
+#include "io_ring.h"
 #include "page.h"
 
 namespace badgerdb {
 
+const std::uint32_t SpaceMapHeader::MAGIC;
+
+/**
+ * Checksum of a space map bitmap, FNV-1a over its words.
+ */
+static std::uint64_t spaceMapChecksum(const std::vector<std::uint64_t>& words) {
+  std::uint64_t checksum = 14695981039346656037ULL;
+  for (std::size_t i = 0; i < words.size(); ++i) {
+    checksum ^= words[i];
+    checksum *= 1099511628211ULL;
+  }
+  return checksum;
+}
+
+/**
+ * Number of words in the space map of a file with the given number of pages.
+ */
+static std::size_t spaceMapWords(const PageId num_pages) {
+  return num_pages / 64 + 1;
+}
+
 File::StreamMap File::open_streams_;
+File::LatchMap File::open_latches_;
 File::CountMap File::open_counts_;
+File::HeaderMap File::open_headers_;
+std::mutex File::open_files_latch_;
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -40,6 +73,7 @@ bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
+  std::lock_guard<std::mutex> lock(open_files_latch_);
   return open_counts_.find(filename) != open_counts_.end();
 }
 
@@ -64,8 +98,9 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
-  openIfNeeded(create_new);
+File::File(const std::string& name, const bool create_new,
+           const FileIoType io_type) : filename_(name) {
+  openIfNeeded(create_new, io_type);
 
   if (create_new) {
     // File starts with 1 page (the header).
@@ -75,73 +110,171 @@ File::File(const std::string& name, const bool create_new) : filename_(name) {
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
+void File::openIfNeeded(const bool create_new, const FileIoType io_type) {
+  std::lock_guard<std::mutex> lock(open_files_latch_);
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
     stream_ = open_streams_[filename_];
+    latch_ = open_latches_[filename_];
+    header_ = open_headers_[filename_];
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
       if (already_exists) {
         throw FileExistsException(filename_);
       }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
+    // New files have to be truncated on open.
+    stream_.reset(FileIo::open(io_type, filename_, create_new /* truncate */));
+    latch_.reset(new std::recursive_mutex());
+    // The header is read here once; new files get theirs from the constructor.
+    header_.reset(new CachedHeader());
+    header_->header = FileHeader();
+    header_->dirty = false;
+    header_->map_loaded = false;
+    header_->map_dirty = false;
+    if (!create_new) {
+      stream_->read(0 /* pos */, reinterpret_cast<char*>(&header_->header),
+                    sizeof(FileHeader));
+    }
     open_streams_[filename_] = stream_;
+    open_latches_[filename_] = latch_;
+    open_headers_[filename_] = header_;
     open_counts_[filename_] = 1;
   }
 }
 
 void File::close() {
+  std::lock_guard<std::mutex> lock(open_files_latch_);
+  if (open_counts_[filename_] == 1 && header_) {
+    // last one out writes the header back
+    try {
+      sync();
+    } catch (...) {
+      // nowhere to report it from a destructor
+    }
+  }
 	if(open_counts_[filename_] > 0)
   	--open_counts_[filename_];
 
   stream_.reset();
+  latch_.reset();
+  header_.reset();
 	assert(open_counts_[filename_] >= 0);
 
   if (open_counts_[filename_] == 0) {
     open_streams_.erase(filename_);
+    open_latches_.erase(filename_);
+    open_headers_.erase(filename_);
     open_counts_.erase(filename_);
   }
 }
 
-FileHeader File::readHeader() const {
+void File::sync() const {
+  // no other sync() may overtake this one with an older header
+  std::lock_guard<std::recursive_mutex> lock(*latch_);
+  writeSpaceMap();
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
-  return header;
+  {
+    std::lock_guard<std::mutex> header_lock(header_->latch);
+    if (!header_->dirty) {
+      return;
+    }
+    header = header_->header;
+  }
+  stream_->write(0 /* pos */, reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+  std::lock_guard<std::mutex> header_lock(header_->latch);
+  // it may have changed again while it was being written
+  if (header_->header == header) {
+    header_->dirty = false;
+  }
+}
+
+void File::writeSpaceMap() const {
+  if (!header_->map_loaded || !header_->map_dirty) {
+    return;
+  }
+  std::vector<std::uint64_t>& used = header_->used_pages;
+  SpaceMapHeader map_header;
+  map_header.magic = SpaceMapHeader::MAGIC;
+  map_header.file_header = readHeader();
+  used.resize(spaceMapWords(map_header.file_header.num_pages), 0);
+  map_header.num_words = used.size();
+  map_header.checksum = spaceMapChecksum(used);
+  struct iovec iov[2] = {{&map_header, sizeof(SpaceMapHeader)},
+                         {&used[0], used.size() * sizeof(std::uint64_t)}};
+  // right after the last page; a new page overwrites it until the next sync
+  stream_->writev(pagePosition(map_header.file_header.num_pages), iov, 2);
+  header_->map_dirty = false;
+}
+
+FileHeader File::readHeader() const {
+  std::lock_guard<std::mutex> lock(header_->latch);
+  return header_->header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  std::lock_guard<std::mutex> lock(header_->latch);
+  header_->header = header;
+  header_->dirty = true;
 }
 
+PageHeader File::readPageHeader(const PageId page_number) const {
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+  PageHeader header;
+  stream_->read(pagePosition(page_number),
+                reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  return header;
+}
+
+std::unique_lock<std::recursive_mutex> File::ioLatch() const {
+  if (stream_->positional()) {
+    return std::unique_lock<std::recursive_mutex>();
+  }
+  return std::unique_lock<std::recursive_mutex>(*latch_);
+}
+
+void File::queueReadPages(IoRing& ring, const std::uint64_t tag,
+                          const PageId first_page_number,
+                          const std::vector<Page*>& pages) const {
+  readPages(first_page_number, pages);
+  ring.post(tag, pages.size() * Page::SIZE);
+}
+
+void File::finishReadPages(const PageId first_page_number,
+                           const std::vector<Page*>& pages,
+                           const std::int64_t result) const {
+  // checked by readPages() already, see queueReadPages()
+}
+
+void File::queueWritePages(IoRing& ring, const std::uint64_t tag,
+                           const PageId first_page_number,
+                           const std::vector<const Page*>& pages) {
+  writePages(first_page_number, pages);
+  ring.post(tag, pages.size() * Page::SIZE);
+}
 
 
 
 
-PageFile PageFile::create(const std::string& filename) {
-  return PageFile(filename, true /* create_new */);
+
+PageFile PageFile::create(const std::string& filename, const FileIoType io_type) {
+  return PageFile(filename, true /* create_new */, io_type);
 }
 
-PageFile PageFile::open(const std::string& filename) {
-  return PageFile(filename, false /* create_new */);
+PageFile PageFile::open(const std::string& filename, const FileIoType io_type) {
+  return PageFile(filename, false /* create_new */, io_type);
 }
 
-PageFile::PageFile(const std::string& name, const bool create_new)
-: File(name, create_new)
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const FileIoType io_type)
+: File(name, create_new, io_type)
 {
 }
 
@@ -163,101 +296,157 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
+  allocatePage(new_page_number, new_page);
+  return new_page;
+}
+
+void PageFile::allocatePage(PageId &new_page_number, Page& new_page) {
+  std::lock_guard<std::recursive_mutex> lock(*latch_);
+  loadSpaceMap();
+  FileHeader header = readHeader();
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
+    // Free pages were cleared when they were deleted.
+    readPage(header.first_free_page, true /* allow_free */, new_page);
     new_page.set_page_number(header.first_free_page);
 		new_page_number = new_page.page_number();
     header.first_free_page = new_page.next_page_number();
     --header.num_free_pages;
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
-
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
   }
 	else
 	{
+    new_page.initialize();
     new_page.set_page_number(header.num_pages);
 		new_page_number = new_page.page_number();
-
-    if (header.first_used_page == Page::INVALID_NUMBER)
-		{
-      header.first_used_page = new_page.page_number();
-    }
-		else
-		{
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
     ++header.num_pages;
   }
+
+  // The space map finds the page preceding the new one in the used list, so
+  // the list is not walked.  Only the header of that page changes, so there
+  // is no need to read or rewrite its data.
+  const PageId previous_page_number = usedPageBefore(new_page_number);
+  PageHeader previous_header;
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    // Either have no pages used or the head of the used list is a page later
+    // than the one we just allocated, so add the new page to the head.
+    new_page.set_next_page_number(header.first_used_page);
+    header.first_used_page = new_page_number;
+  } else {
+    previous_header = readPageHeader(previous_page_number);
+    new_page.set_next_page_number(previous_header.next_page_number);
+    previous_header.next_page_number = new_page_number;
+  }
+
   writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
+  if (previous_page_number != Page::INVALID_NUMBER) {
     // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page.header_, existing_page);
+    // used list, we need to write out its header.
+    writePageHeader(previous_page_number, previous_header);
   }
+  markUsed(new_page_number, true);
   writeHeader(header);
-
-  return new_page;
 }
 
 Page PageFile::readPage(const PageId page_number) const {
+  Page page;
+  readPage(page_number, page);
+  return page;
+}
+
+void PageFile::readPage(const PageId page_number, Page& page) const {
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
   FileHeader header = readHeader();
 
 	if (page_number >= header.num_pages)
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
-	return readPage(page_number, false /* allow_free */);
+	readPage(page_number, false /* allow_free */, page);
 }
 
-Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
-  Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+void PageFile::readPage(const PageId page_number, const bool allow_free,
+                        Page& page) const {
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+  struct iovec iov[2] = {{&page.header_, sizeof(PageHeader)},
+                         {&page.data_[0], Page::DATA_SIZE}};
+  stream_->readv(pagePosition(page_number), iov, 2);
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
+}
 
-  return page;
+void PageFile::readPages(const PageId first_page_number,
+                         const std::vector<Page*>& pages) const {
+  if (pages.empty()) {
+    return;
+  }
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+  const FileHeader header = readHeader();
+  if (first_page_number + pages.size() > header.num_pages) {
+    throw InvalidPageException(std::max(first_page_number, header.num_pages),
+                               filename_);
+  }
+  // read straight into the pages, no staging buffer
+  std::vector<struct iovec> iov(2 * pages.size());
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    iov[2 * i].iov_base = &pages[i]->header_;
+    iov[2 * i].iov_len = sizeof(PageHeader);
+    iov[2 * i + 1].iov_base = &pages[i]->data_[0];
+    iov[2 * i + 1].iov_len = Page::DATA_SIZE;
+  }
+  const std::size_t read = stream_->readv(pagePosition(first_page_number),
+                                          &iov[0], iov.size());
+  if (read != pages.size() * Page::SIZE) {
+    throw InvalidPageException(first_page_number + read / Page::SIZE, filename_);
+  }
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    if (!pages[i]->isUsed()) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+  }
+}
+
+void PageFile::queueReadPages(IoRing& ring, const std::uint64_t tag,
+                              const PageId first_page_number,
+                              const std::vector<Page*>& pages) const {
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+  const FileHeader header = readHeader();
+  if (first_page_number + pages.size() > header.num_pages) {
+    throw InvalidPageException(std::max(first_page_number, header.num_pages),
+                               filename_);
+  }
+  std::vector<struct iovec> iov(2 * pages.size());
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    iov[2 * i].iov_base = &pages[i]->header_;
+    iov[2 * i].iov_len = sizeof(PageHeader);
+    iov[2 * i + 1].iov_base = &pages[i]->data_[0];
+    iov[2 * i + 1].iov_len = Page::DATA_SIZE;
+  }
+  stream_->queueReadv(ring, tag, pagePosition(first_page_number),
+                      &iov[0], iov.size());
+}
+
+void PageFile::finishReadPages(const PageId first_page_number,
+                               const std::vector<Page*>& pages,
+                               const std::int64_t result) const {
+  if (result != static_cast<std::int64_t>(pages.size() * Page::SIZE)) {
+    throw InvalidPageException(
+        first_page_number + std::max<std::int64_t>(result, 0) / Page::SIZE,
+        filename_);
+  }
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    if (!pages[i]->isUsed()) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+  }
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
+  // allocatePage() and deletePage() may change the next page pointer on disk
+  std::lock_guard<std::recursive_mutex> lock(*latch_);
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
 	{
@@ -273,39 +462,82 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	writePage(new_page_number, header, new_page);
 }
 
+void PageFile::writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) {
+  if (pages.empty()) {
+    return;
+  }
+  // allocatePage() and deletePage() may change the next page pointers on disk
+  std::lock_guard<std::recursive_mutex> lock(*latch_);
+  // Read the headers of the run as it is on disk, for the next page pointers
+  // which writePage() keeps; the data of every page goes to the same scratch
+  // buffer, as it is not needed.
+  std::vector<PageHeader> headers(pages.size());
+  std::vector<char> scratch(Page::DATA_SIZE);
+  std::vector<struct iovec> iov(2 * pages.size());
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    iov[2 * i].iov_base = &headers[i];
+    iov[2 * i].iov_len = sizeof(PageHeader);
+    iov[2 * i + 1].iov_base = &scratch[0];
+    iov[2 * i + 1].iov_len = Page::DATA_SIZE;
+  }
+  const std::size_t read = stream_->readv(pagePosition(first_page_number),
+                                          &iov[0], iov.size());
+  if (read != pages.size() * Page::SIZE) {
+    throw InvalidPageException(first_page_number + read / Page::SIZE, filename_);
+  }
+  // then write the new headers and the data straight from the pages
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    if (headers[i].current_page_number == Page::INVALID_NUMBER) {
+      // Page has been deleted since it was read.
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+    const PageId next_page_number = headers[i].next_page_number;
+    headers[i] = pages[i]->header_;
+    headers[i].next_page_number = next_page_number;
+    iov[2 * i + 1].iov_base = const_cast<char*>(&pages[i]->data_[0]);
+  }
+  stream_->writev(pagePosition(first_page_number), &iov[0], iov.size());
+}
+
 // added by yanqi CS564
 // void PageFile::writePage(const PageId new_page_number, const Page* new_page) {
 //   writePage(new_page_number, *new_page);
 // }
 
 void PageFile::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> lock(*latch_);
+  loadSpaceMap();
   FileHeader header = readHeader();
 
-  Page existing_page = readPage(page_number);
-  Page previous_page;
+  if (page_number >= header.num_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  const PageHeader existing_header = readPageHeader(page_number);
+  if (existing_header.current_page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(page_number, filename_);
+  }
   // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
-    header.first_used_page = existing_page.next_page_number();
+  // the next page in line; otherwise update the page which points to this
+  // one, as found by the space map.
+  const PageId previous_page_number = usedPageBefore(page_number);
+  PageHeader previous_header;
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = existing_header.next_page_number;
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    previous_header = readPageHeader(previous_page_number);
+    previous_header.next_page_number = existing_header.next_page_number;
   }
   // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
+  Page existing_page;
   existing_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page.header_, previous_page);
+  if (previous_page_number != Page::INVALID_NUMBER) {
+    writePageHeader(previous_page_number, previous_header);
   }
   writePage(page_number, existing_page.header_, existing_page);
+  markUsed(page_number, false);
   writeHeader(header);
 }
 
@@ -320,33 +552,176 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+  struct iovec iov[2] = {{const_cast<PageHeader*>(&header), sizeof(PageHeader)},
+                         {const_cast<char*>(&new_page.data_[0]), Page::DATA_SIZE}};
+  stream_->writev(pagePosition(page_number), iov, 2);
 }
 
-PageHeader PageFile::readPageHeader(PageId page_number) const {
-  PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
-  return header;
+void PageFile::writePageHeader(const PageId page_number,
+                               const PageHeader& header) {
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+  stream_->write(pagePosition(page_number),
+                 reinterpret_cast<const char*>(&header), sizeof(PageHeader));
 }
 
+/**
+ * Builds the summary levels over the words of a space map, see
+ * File::CachedHeader::used_summary.
+ */
+static void buildSummary(const std::vector<std::uint64_t>& words,
+                         std::vector<std::vector<std::uint64_t> >& summary) {
+  summary.clear();
+  do {
+    const std::vector<std::uint64_t>& below = summary.empty() ? words : summary.back();
+    std::vector<std::uint64_t> level((below.size() + 63) / 64, 0);
+    for (std::size_t i = 0; i < below.size(); ++i) {
+      if (below[i] != 0) {
+        level[i / 64] |= 1ULL << (i % 64);
+      }
+    }
+    summary.push_back(level);
+  } while (summary.back().size() > 1);
+}
 
+/**
+ * Finds the highest set bit at or below position in a level of a space map:
+ * level 0 is the map itself, level n + 1 summary level n.  Positions past
+ * the end of the level are searched from its last bit.
+ *
+ * @return  Position of the bit, or -1 if there is none.
+ */
+static std::int64_t highestSetBit(const std::vector<std::uint64_t>& words,
+                                  const std::vector<std::vector<std::uint64_t> >& summary,
+                                  const std::size_t level, const std::uint64_t position) {
+  const std::vector<std::uint64_t>& bits_of = level == 0 ? words : summary[level - 1];
+  if (bits_of.empty()) {
+    return -1;
+  }
+  std::size_t word = position / 64;
+  std::uint64_t bits;
+  if (word >= bits_of.size()) {
+    word = bits_of.size() - 1;
+    bits = bits_of[word];
+  } else {
+    const unsigned bit = position % 64;
+    bits = bits_of[word] & (bit == 63 ? ~0ULL : (1ULL << (bit + 1)) - 1);
+  }
+  if (bits != 0) {
+    return word * 64 + 63 - __builtin_clzll(bits);
+  }
+  // the level above says which word below this one is the next not empty;
+  // the top level is a single word, so word is 0 there
+  if (word == 0 || level == summary.size()) {
+    return -1;
+  }
+  const std::int64_t nonempty = highestSetBit(words, summary, level + 1, word - 1);
+  if (nonempty < 0) {
+    return -1;
+  }
+  return nonempty * 64 + 63 - __builtin_clzll(bits_of[nonempty]);
+}
 
+void PageFile::loadSpaceMap() const {
+  if (header_->map_loaded) {
+    return;
+  }
+  const FileHeader header = readHeader();
+  std::vector<std::uint64_t>& used = header_->used_pages;
+  used.assign(spaceMapWords(header.num_pages), 0);
+
+  SpaceMapHeader map_header;
+  struct iovec iov[2] = {{&map_header, sizeof(SpaceMapHeader)},
+                         {&used[0], used.size() * sizeof(std::uint64_t)}};
+  const std::size_t read = stream_->readv(pagePosition(header.num_pages), iov, 2);
+  std::size_t num_used = 0;
+  for (std::size_t i = 0; i < used.size(); ++i) {
+    num_used += __builtin_popcountll(used[i]);
+  }
+  const bool valid =
+      read == sizeof(SpaceMapHeader) + used.size() * sizeof(std::uint64_t) &&
+      map_header.magic == SpaceMapHeader::MAGIC &&
+      map_header.num_words == used.size() &&
+      map_header.file_header == header &&
+      map_header.checksum == spaceMapChecksum(used) &&
+      num_used + header.num_free_pages + 1 == header.num_pages;
+
+  if (!valid) {
+    // No map, or one left behind by an older header: build it from the used
+    // list, once, and write it out with the header.
+    used.assign(used.size(), 0);
+    PageId page_number = header.first_used_page;
+    for (PageId steps = 0; page_number != Page::INVALID_NUMBER &&
+         page_number < header.num_pages && steps < header.num_pages; ++steps) {
+      used[page_number / 64] |= 1ULL << (page_number % 64);
+      page_number = readPageHeader(page_number).next_page_number;
+    }
+    header_->map_dirty = true;
+  }
+  buildSummary(used, header_->used_summary);
+  header_->map_loaded = true;
+}
+
+void PageFile::markUsed(const PageId page_number, const bool used) {
+  std::vector<std::uint64_t>& words = header_->used_pages;
+  std::vector<std::vector<std::uint64_t> >& summary = header_->used_summary;
+  std::size_t word = page_number / 64;
+  if (word >= words.size()) {
+    words.resize(word + 1, 0);
+  }
+  if (used) {
+    words[word] |= 1ULL << (page_number % 64);
+  } else {
+    words[word] &= ~(1ULL << (page_number % 64));
+  }
+  header_->map_dirty = true;
+
+  // a map which grew past what the summary covers gets a new one
+  if (summary.empty() || summary[0].size() * 64 < words.size()) {
+    buildSummary(words, summary);
+    return;
+  }
+  // up the levels for as long as a word turns empty or stops being so
+  bool nonempty = words[word] != 0;
+  for (std::size_t level = 0; level < summary.size(); ++level) {
+    std::uint64_t& bits = summary[level][word / 64];
+    const bool was_nonempty = bits != 0;
+    if (nonempty) {
+      bits |= 1ULL << (word % 64);
+    } else {
+      bits &= ~(1ULL << (word % 64));
+    }
+    if ((bits != 0) == was_nonempty) {
+      break;
+    }
+    nonempty = bits != 0;
+    word /= 64;
+  }
+}
 
-BlobFile BlobFile::create(const std::string& filename) {
-  return BlobFile(filename, true /* create_new */);
+PageId PageFile::usedPageBefore(const PageId page_number) const {
+  if (page_number <= 1) {
+    return Page::INVALID_NUMBER;
+  }
+  const std::int64_t page = highestSetBit(header_->used_pages, header_->used_summary,
+                                          0, page_number - 1);
+  return page < 0 ? Page::INVALID_NUMBER : PageId(page);
 }
 
-BlobFile BlobFile::open(const std::string& filename) {
-  return BlobFile(filename, false /* create_new */);
+
+
+
+BlobFile BlobFile::create(const std::string& filename, const FileIoType io_type) {
+  return BlobFile(filename, true /* create_new */, io_type);
 }
 
-BlobFile::BlobFile(const std::string& name, const bool create_new)
-: File(name, create_new) {
+BlobFile BlobFile::open(const std::string& filename, const FileIoType io_type) {
+  return BlobFile(filename, false /* create_new */, io_type);
+}
+
+BlobFile::BlobFile(const std::string& name, const bool create_new,
+                   const FileIoType io_type)
+: File(name, create_new, io_type) {
 }
 
 BlobFile::~BlobFile() {
@@ -367,8 +742,15 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
 }
 
 Page BlobFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
 	Page new_page;
+	allocatePage(new_page_number, new_page);
+	return new_page;
+}
+
+void BlobFile::allocatePage(PageId &new_page_number, Page& new_page) {
+  std::lock_guard<std::recursive_mutex> lock(*latch_);
+  FileHeader header = readHeader();
+	new_page.initialize();
 
 	new_page_number = header.num_pages;
 
@@ -380,21 +762,87 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 
 	writePage(new_page_number, new_page);
 	writeHeader(header);
-
-	return new_page;
 }
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readPage(page_number, page);
 	return page;
 }
 
+void BlobFile::readPage(const PageId page_number, Page& page) const {
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+	if (stream_->read(pagePosition(page_number), reinterpret_cast<char*>(&page),
+	                  Page::SIZE) != Page::SIZE)
+	{
+		// past the end of the file
+		throw InvalidPageException(page_number, filename_);
+	}
+}
+
+void BlobFile::readPages(const PageId first_page_number,
+                         const std::vector<Page*>& pages) const {
+	if (pages.empty()) {
+		return;
+	}
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+	std::vector<struct iovec> iov(pages.size());
+	for (std::size_t i = 0; i < pages.size(); ++i) {
+		iov[i].iov_base = pages[i];
+		iov[i].iov_len = Page::SIZE;
+	}
+	const std::size_t read = stream_->readv(pagePosition(first_page_number),
+	                                        &iov[0], iov.size());
+	if (read != pages.size() * Page::SIZE)
+	{
+		// past the end of the file
+		throw InvalidPageException(first_page_number + read / Page::SIZE, filename_);
+	}
+}
+
+void BlobFile::queueReadPages(IoRing& ring, const std::uint64_t tag,
+                              const PageId first_page_number,
+                              const std::vector<Page*>& pages) const {
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+	std::vector<struct iovec> iov(pages.size());
+	for (std::size_t i = 0; i < pages.size(); ++i) {
+		iov[i].iov_base = pages[i];
+		iov[i].iov_len = Page::SIZE;
+	}
+	stream_->queueReadv(ring, tag, pagePosition(first_page_number),
+	                    &iov[0], iov.size());
+}
+
+void BlobFile::finishReadPages(const PageId first_page_number,
+                               const std::vector<Page*>& pages,
+                               const std::int64_t result) const {
+	if (result != static_cast<std::int64_t>(pages.size() * Page::SIZE))
+	{
+		// past the end of the file
+		throw InvalidPageException(
+		    first_page_number + std::max<std::int64_t>(result, 0) / Page::SIZE,
+		    filename_);
+	}
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+	stream_->write(pagePosition(new_page_number),
+	               reinterpret_cast<const char*>(&new_page), Page::SIZE);
+}
+
+void BlobFile::writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) {
+	if (pages.empty()) {
+		return;
+	}
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+	std::vector<struct iovec> iov(pages.size());
+	for (std::size_t i = 0; i < pages.size(); ++i) {
+		iov[i].iov_base = const_cast<Page*>(pages[i]);
+		iov[i].iov_len = Page::SIZE;
+	}
+	stream_->writev(pagePosition(first_page_number), &iov[0], iov.size());
 }
 
 // added by yanqi CS564
@@ -404,9 +852,156 @@ void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
 //   stream_->flush();
 // }
 
+void BlobFile::queueWritePages(IoRing& ring, const std::uint64_t tag,
+                               const PageId first_page_number,
+                               const std::vector<const Page*>& pages) {
+  std::unique_lock<std::recursive_mutex> lock = ioLatch();
+	std::vector<struct iovec> iov(pages.size());
+	for (std::size_t i = 0; i < pages.size(); ++i) {
+		iov[i].iov_base = const_cast<Page*>(pages[i]);
+		iov[i].iov_len = Page::SIZE;
+	}
+	stream_->queueWritev(ring, tag, pagePosition(first_page_number),
+	                     &iov[0], iov.size());
+}
+
 //delePage should not be called for a blob_file, not supported
 void BlobFile::deletePage(const PageId page_number) {
 	throw InvalidPageException(page_number, filename_);
 }
 
+
+
+
+MmapFile MmapFile::open(const std::string& filename, const FileLayout layout) {
+  return MmapFile(filename, layout);
+}
+
+MmapFile::MmapFile(const std::string& name, const FileLayout layout)
+: File(name, false /* create_new */), layout_(layout), mapping_(NULL),
+  mapping_bytes_(0) {
+  map();
+}
+
+MmapFile::MmapFile(const MmapFile& other)
+: File(other.filename_, false /* create_new */), layout_(other.layout_),
+  mapping_(NULL), mapping_bytes_(0) {
+  map();
+}
+
+MmapFile& MmapFile::operator=(const MmapFile& rhs) {
+  if (this != &rhs) {
+    unmap();
+    close();	//close my file and associate me with the new one
+    filename_ = rhs.filename_;
+    layout_ = rhs.layout_;
+    openIfNeeded(false /* create_new */);
+    map();
+  }
+  return *this;
+}
+
+MmapFile::~MmapFile() {
+  unmap();
+}
+
+void MmapFile::map() {
+  // the mapping must see the header as it is in memory
+  sync();
+  const int fd = ::open(filename_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw FileNotFoundException(filename_);
+  }
+  struct stat st;
+  void* mapping = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(FileHeader))) {
+    mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    throw FileNotFoundException(filename_);
+  }
+  mapping_ = static_cast<char*>(mapping);
+  mapping_bytes_ = st.st_size;
+}
+
+void MmapFile::unmap() {
+  if (mapping_ != NULL) {
+    munmap(mapping_, mapping_bytes_);
+    mapping_ = NULL;
+    mapping_bytes_ = 0;
+  }
+}
+
+Page MmapFile::allocatePage(PageId &new_page_number) {
+  throw ReadOnlyFileException(filename_);
+}
+
+void MmapFile::allocatePage(PageId &new_page_number, Page& new_page) {
+  throw ReadOnlyFileException(filename_);
+}
+
+Page* MmapFile::mappedPage(const PageId page_number) const {
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(mapping_);
+  if (page_number == Page::INVALID_NUMBER || page_number >= header->num_pages ||
+      pagePosition(page_number) + Page::SIZE > mapping_bytes_) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  Page* page = reinterpret_cast<Page*>(mapping_ + pagePosition(page_number));
+  if (layout_ == PAGE_FILE_LAYOUT && !page->isUsed()) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  return page;
+}
+
+Page MmapFile::readPage(const PageId page_number) const {
+  Page page;
+  readPage(page_number, page);
+  return page;
+}
+
+void MmapFile::readPage(const PageId page_number, Page& page) const {
+  std::memcpy(&page, mappedPage(page_number), Page::SIZE);
+}
+
+void MmapFile::readPages(const PageId first_page_number,
+                         const std::vector<Page*>& pages) const {
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    readPage(first_page_number + i, *pages[i]);
+  }
+}
+
+void MmapFile::writePage(const PageId page_number, const Page& new_page) {
+  throw ReadOnlyFileException(filename_);
+}
+
+void MmapFile::writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) {
+  throw ReadOnlyFileException(filename_);
+}
+
+void MmapFile::deletePage(const PageId page_number) {
+  throw ReadOnlyFileException(filename_);
+}
+
+FileIterator MmapFile::begin() {
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(mapping_);
+  return FileIterator(this, header->first_used_page);
+}
+
+FileIterator MmapFile::end() {
+  return FileIterator(this, Page::INVALID_NUMBER);
+}
+
+PageHeader MmapFile::readPageHeader(const PageId page_number) const {
+  if (pagePosition(page_number) + sizeof(PageHeader) > mapping_bytes_) {
+    // past the end of the mapping, which would fault
+    throw InvalidPageException(page_number, filename_);
+  }
+  PageHeader header;
+  std::memcpy(&header, mapping_ + pagePosition(page_number), sizeof(PageHeader));
+  return header;
+}
+
 }
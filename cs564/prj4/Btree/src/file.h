@@ -7,11 +7,14 @@
 
 #pragma once
 
-#include <fstream>
+#include <cstdint>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
+#include "file_io.h"
 #include "page.h"
 
 namespace badgerdb {
@@ -56,6 +59,41 @@ struct FileHeader {
   }
 };
 
+/**
+ * @brief Header of the space map of a PageFile, stored right after its last
+ *        page and followed by the bitmap of its used pages.
+ *
+ * Files written before there was a space map have none; it is built from
+ * the used list the first time it is needed, see PageFile::loadSpaceMap().
+ */
+struct SpaceMapHeader {
+  /**
+   * Marks the start of a space map.
+   */
+  std::uint32_t magic;
+
+  /**
+   * Number of 64-bit words in the bitmap which follows.
+   */
+  std::uint32_t num_words;
+
+  /**
+   * Copy of the file header as it was when the map was written.  The map
+   * is only trusted if the file header still matches it.
+   */
+  FileHeader file_header;
+
+  /**
+   * Checksum of the bitmap.
+   */
+  std::uint64_t checksum;
+
+  /**
+   * Value of magic.
+   */
+  static const std::uint32_t MAGIC = 0x5053504dU;
+};
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
@@ -68,7 +106,20 @@ struct FileHeader {
  * detects this (by looking in the open_streams_ map) and just returns a file object with
  * the already created stream for the file without actually opening the UNIX file again. 
  *
- * @warning This class is not threadsafe.
+ * The stream is a FileIo, by default a file descriptor read and written with
+ * pread() and pwrite(); the FileIoType given to whoever opens the file first
+ * decides.  Operations which change the layout of the file, such as
+ * allocating or deleting a page, hold a latch which is shared the same way as
+ * the stream, so File objects for the same file may be used from different
+ * threads.  Plain reads and writes of pages take the latch only if the stream
+ * has a shared position, see ioLatch().  A single File object must not be
+ * assigned to while another thread is using it.
+ *
+ * The file header is read once, when the file is opened, and kept in memory
+ * alongside the stream.  Changes to it reach the disk when sync() is called
+ * or the file is closed.  So does the space map of a PageFile, a bitmap of
+ * its used pages stored after the last page, which older versions of the
+ * file format ignore.
  */
 
 
@@ -80,12 +131,14 @@ class File {
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param io_type     How to do I/O, if the file is not open already.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const FileIoType io_type = POSIX_IO);
 
   /**
    * Deletes an existing file.
@@ -124,6 +177,15 @@ class File {
    */
   virtual Page allocatePage(PageId &new_page_number) = 0;
 
+  /**
+   * Allocates a new page in the file, building it directly in the given page
+   * object instead of returning a copy.
+   *
+   * @param new_page_number Number of the new page is returned here.
+   * @param new_page        Set to the new page.
+   */
+  virtual void allocatePage(PageId &new_page_number, Page& new_page) = 0;
+
   /**
    * Reads an existing page from the file.
    *
@@ -134,6 +196,32 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file directly into the given page object,
+   * such as a buffer pool frame, without an intermediate copy.  The contents
+   * of page are undefined if an exception is thrown.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page object to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPage(const PageId page_number, Page& page) const = 0;
+
+  /**
+   * Reads pages with consecutive numbers from the file in a single read, as
+   * the buffer manager does for a batch of misses.  The contents of the pages
+   * are undefined if an exception is thrown.
+   *
+   * @param first_page_number Number of the page to read into pages[0]; the
+   *                          others follow in order.
+   * @param pages             Page objects to read into.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  virtual void readPages(const PageId first_page_number,
+                         const std::vector<Page*>& pages) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -143,6 +231,70 @@ class File {
    */
   virtual void writePage(const PageId page_number, const Page& new_page) = 0;
 
+  /**
+   * Writes pages with consecutive numbers into the file in a single write,
+   * as the buffer manager does when flushing a run of dirty pages.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of the page to write pages[0] to; the
+   *                          others follow in order.
+   * @param pages             Pages to write.
+   */
+  virtual void writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) = 0;
+
+  /**
+   * Queues a read of pages with consecutive numbers on a ring, as the buffer
+   * manager does to have several batches of misses in flight at once.  Once
+   * the ring reports the read with tag, finishReadPages() must be called with
+   * its result before the pages are used.  Files which cannot be read through
+   * the ring read the pages at once and post the result.
+   *
+   * @param ring              Ring to queue on, which must not be full.
+   * @param tag               Reported along with the completion.
+   * @param first_page_number Number of the page to read into pages[0]; the
+   *                          others follow in order.
+   * @param pages             Page objects to read into, which must remain
+   *                          until the read is completed.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file.
+   */
+  virtual void queueReadPages(IoRing& ring, const std::uint64_t tag,
+                              const PageId first_page_number,
+                              const std::vector<Page*>& pages) const;
+
+  /**
+   * Checks the pages of a read queued with queueReadPages(), once the ring
+   * has reported it.
+   *
+   * @param first_page_number Number of the page read into pages[0].
+   * @param pages             Page objects read into.
+   * @param result            Result reported by the ring.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  virtual void finishReadPages(const PageId first_page_number,
+                               const std::vector<Page*>& pages,
+                               const std::int64_t result) const;
+
+  /**
+   * Queues a write of pages with consecutive numbers on a ring, as the
+   * buffer manager does to have several runs of dirty pages in flight at
+   * once.  Files which cannot be written through the ring write the pages at
+   * once and post the result.
+   * No bounds checking is performed.
+   *
+   * @param ring              Ring to queue on, which must not be full.
+   * @param tag               Reported along with the completion.
+   * @param first_page_number Number of the page to write pages[0] to; the
+   *                          others follow in order.
+   * @param pages             Pages to write, which must remain unchanged
+   *                          until the write is completed.
+   */
+  virtual void queueWritePages(IoRing& ring, const std::uint64_t tag,
+                               const PageId first_page_number,
+                               const std::vector<const Page*>& pages);
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -160,6 +312,14 @@ class File {
    */
   virtual void deletePage(const PageId page_number) = 0;
 
+  /**
+   * Writes the file header back to disk if it changed since it was last
+   * written.  The header is kept in memory while the file is open, see
+   * readHeader(), and otherwise only written when the last File object for
+   * the file is closed.
+   */
+  void sync() const;
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -167,6 +327,20 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns how the file does its I/O.
+   *
+   * @return Backend of the stream.
+   */
+  FileIoType ioType() const { return stream_->type(); }
+
+  /**
+   * Returns true if pages of the file are used in place, straight from a
+   * mapping of the file, see MmapFile.  The buffer manager reads no frames
+   * for such files.
+   */
+  virtual bool mapped() const { return false; }
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -182,7 +356,7 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
+  static std::uint64_t pagePosition(const PageId page_number) {
     return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
   }
 
@@ -192,12 +366,13 @@ class File {
    * the same filesystem file; otherwise, it reuses the existing stream.
    *
    * @param create_new  Whether to create a new file.
+   * @param io_type     How to do I/O, if the file is not open already.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new, const FileIoType io_type = POSIX_IO);
 
   /**
    * Closes the underlying file stream in <stream_>.
@@ -207,32 +382,114 @@ class File {
   void close();
 
   /**
-   * Reads the header for this file from disk.
+   * Returns the header for this file, as kept in memory.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Replaces the header for this file in memory.  It is written to disk by
+   * sync(), or when the file is closed.
    *
-   * @param header  File header to write.
+   * @param header  New file header.
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+  /**
+   * @brief Header of an open file as kept in memory, shared by all File
+   *        objects for the file like the stream.
+   */
+  struct CachedHeader {
+    /**
+     * Guards header and dirty.  Changes to the header are also made under
+     * the latch of the file, so a read-modify-write of it is never lost.
+     */
+    std::mutex latch;
+
+    /**
+     * The header.
+     */
+    FileHeader header;
+
+    /**
+     * True if header differs from the header on disk.
+     */
+    bool dirty;
+
+    /**
+     * Space map of a PageFile: bit n is set if page n is in use.  Unlike the
+     * header it is only used under the latch of the file.
+     */
+    std::vector<std::uint64_t> used_pages;
+
+    /**
+     * Summary of used_pages, so that a search for the used page before
+     * another takes a word per level rather than a scan: bit n of level 0
+     * is set if word n of used_pages is not zero, bit n of each level above
+     * if word n of the level below is not zero.  The top level is one word.
+     * Only kept in memory.
+     */
+    std::vector<std::vector<std::uint64_t> > used_summary;
+
+    /**
+     * True once used_pages has been loaded, see PageFile::loadSpaceMap().
+     */
+    bool map_loaded;
+
+    /**
+     * True if used_pages differs from the space map on disk.
+     */
+    bool map_dirty;
+  };
+
+  /**
+   * Reads only the header of the given page from disk (not the record data
+   * or slot table).  No bounds checking is performed.
+   *
+   * @param page_number   Number of page whose header is to be read.
+   * @return  Header of page.
+   */
+  virtual PageHeader readPageHeader(const PageId page_number) const;
+
+  /**
+   * Latch to hold for a single read or write of the stream: latch_ if the
+   * stream has a position shared by all its users, none otherwise.
+   *
+   * @return  Lock on latch_, or a lock holding nothing.
+   */
+  std::unique_lock<std::recursive_mutex> ioLatch() const;
+
+  typedef std::map<std::string, std::shared_ptr<FileIo> > StreamMap;
+  typedef std::map<std::string, std::shared_ptr<std::recursive_mutex> > LatchMap;
   typedef std::map<std::string, int> CountMap;
+  typedef std::map<std::string, std::shared_ptr<CachedHeader> > HeaderMap;
 
   /**
    * Streams for opened files.
    */
   static StreamMap open_streams_;
 
+  /**
+   * Latches serializing access to the streams of opened files.
+   */
+  static LatchMap open_latches_;
+
   /**
    * Counts for opened files.
    */
   static CountMap open_counts_;
 
+  /**
+   * Headers of opened files.
+   */
+  static HeaderMap open_headers_;
+
+  /**
+   * Guards open_streams_, open_latches_, open_counts_ and open_headers_.
+   */
+  static std::mutex open_files_latch_;
+
   /**
    * Name of the file this object represents.
    */
@@ -241,7 +498,25 @@ class File {
   /**
    * Stream for underlying filesystem object.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<FileIo> stream_;
+
+  /**
+   * Latch held while changing the layout of the file, and while using stream_
+   * if it is not positional.  Recursive since compound operations such as
+   * PageFile::allocatePage() call into other stream operations.
+   */
+  std::shared_ptr<std::recursive_mutex> latch_;
+
+  /**
+   * Header of the file, shared like stream_.
+   */
+  std::shared_ptr<CachedHeader> header_;
+
+  /**
+   * Writes the space map after the last page, if it was loaded and changed.
+   * The caller holds latch_.
+   */
+  void writeSpaceMap() const;
 
   friend class FileIterator;
 };
@@ -253,9 +528,11 @@ class PageFile : public File {
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param io_type   How to do I/O.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static PageFile create(const std::string& filename);
+  static PageFile create(const std::string& filename,
+                         const FileIoType io_type = POSIX_IO);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
@@ -265,21 +542,25 @@ class PageFile : public File {
 	 * open_streams_ map.
    *
    * @param filename  Name of the file.
+   * @param io_type   How to do I/O, if the file is not open already.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static PageFile open(const std::string& filename);
+  static PageFile open(const std::string& filename,
+                       const FileIoType io_type = POSIX_IO);
 
   /**
    * Constructs a file object representing a file on the filesystem.
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param io_type     How to do I/O, if the file is not open already.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  PageFile(const std::string& name, const bool create_new);
+  PageFile(const std::string& name, const bool create_new,
+           const FileIoType io_type = POSIX_IO);
 
   /**
    * Copy constructor.
@@ -310,6 +591,14 @@ class PageFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, building it in new_page.
+   *
+   * @param new_page_number Number of the new page is returned here.
+   * @param new_page        Set to the new page.
+   */
+  void allocatePage(PageId &new_page_number, Page& new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -320,6 +609,27 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file into page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page object to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page& page) const;
+
+  /**
+   * Reads pages with consecutive numbers from the file in a single read.
+   *
+   * @param first_page_number Number of the page to read into pages[0].
+   * @param pages             Page objects to read into.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPages(const PageId first_page_number,
+                 const std::vector<Page*>& pages) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -329,6 +639,34 @@ class PageFile : public File {
    */
   void writePage(const PageId page_number, const Page& new_page);
 
+  /**
+   * Writes pages with consecutive numbers into the file in a single write.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of the page to write pages[0] to.
+   * @param pages             Pages to write.
+   */
+  void writePages(const PageId first_page_number,
+                  const std::vector<const Page*>& pages);
+
+  /**
+   * Queues a read of pages with consecutive numbers on a ring.
+   *
+   * @see File::queueReadPages()
+   */
+  void queueReadPages(IoRing& ring, const std::uint64_t tag,
+                      const PageId first_page_number,
+                      const std::vector<Page*>& pages) const;
+
+  /**
+   * Checks the pages of a read queued with queueReadPages().
+   *
+   * @see File::finishReadPages()
+   */
+  void finishReadPages(const PageId first_page_number,
+                       const std::vector<Page*>& pages,
+                       const std::int64_t result) const;
+
   /**
    * Deletes a page from the file.
    *
@@ -362,11 +700,11 @@ class PageFile : public File {
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
-   * @return  The page.
+   * @param page          Page object to read into.
    * @throws  InvalidPageException  If the page is free (unused) and
    *                                allow_free is false.
    */
-  Page readPage(const PageId page_number, const bool allow_free) const;
+  void readPage(const PageId page_number, const bool allow_free, Page& page) const;
 
   /**
    * Writes a page into the file at the given page number with the given header.
@@ -381,13 +719,39 @@ class PageFile : public File {
                  const Page& new_page);
 
   /**
-   * Reads only the header of the given page from disk (not the record data
-   * or slot table).  No bounds checking is performed.
+   * Writes only the header of the given page to disk, leaving the record data
+   * and slot table untouched.  No bounds checking is performed.
    *
-   * @param page_number   Number of page whose header is to be read.
-   * @return  Header of page.
+   * @param page_number Number of page whose header is to be replaced.
+   * @param header      Header to write.
    */
-  PageHeader readPageHeader(const PageId page_number) const;
+  void writePageHeader(const PageId page_number, const PageHeader& header);
+
+  /**
+   * Loads the space map into memory if it is not loaded yet: from disk if the
+   * map there matches the file header, otherwise by walking the used list
+   * once, as for files written before there was a space map.  The caller
+   * holds latch_.
+   */
+  void loadSpaceMap() const;
+
+  /**
+   * Marks a page as used or free in the space map.  The caller holds latch_.
+   *
+   * @param page_number   Number of page.
+   * @param used          Whether the page is now in use.
+   */
+  void markUsed(const PageId page_number, const bool used);
+
+  /**
+   * Finds the used page which precedes the given page in the used list.
+   * The caller holds latch_.
+   *
+   * @param page_number   Number of page.
+   * @return  Number of the highest used page below page_number, or
+   *          Page::INVALID_NUMBER if there is none.
+   */
+  PageId usedPageBefore(const PageId page_number) const;
 
   friend class FileIterator;
 };
@@ -399,9 +763,11 @@ class BlobFile : public File {
    * Creates a new BlobFile.
    *
    * @param filename  Name of the file.
+   * @param io_type   How to do I/O.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static BlobFile create(const std::string& filename);
+  static BlobFile create(const std::string& filename,
+                         const FileIoType io_type = POSIX_IO);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
@@ -411,9 +777,11 @@ class BlobFile : public File {
 	 * open_streams_ map.
    *
    * @param filename  Name of the file.
+   * @param io_type   How to do I/O, if the file is not open already.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static BlobFile open(const std::string& filename);
+  static BlobFile open(const std::string& filename,
+                       const FileIoType io_type = POSIX_IO);
 
   /**
    * Constructs a file object representing a file on the filesystem.
@@ -422,12 +790,14 @@ class BlobFile : public File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param io_type     How to do I/O, if the file is not open already.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  BlobFile(const std::string& name, const bool create_new);
+  BlobFile(const std::string& name, const bool create_new,
+           const FileIoType io_type = POSIX_IO);
 
   /**
    * Copy constructor.
@@ -458,6 +828,14 @@ class BlobFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, building it in new_page.
+   *
+   * @param new_page_number Number of the new page is returned here.
+   * @param new_page        Set to the new page.
+   */
+  void allocatePage(PageId &new_page_number, Page& new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -468,6 +846,26 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file into page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page object to read into.
+   * @throws  InvalidPageException  If the page lies past the end of the file.
+   */
+  void readPage(const PageId page_number, Page& page) const;
+
+  /**
+   * Reads pages with consecutive numbers from the file in a single read.
+   *
+   * @param first_page_number Number of the page to read into pages[0].
+   * @param pages             Page objects to read into.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPages(const PageId first_page_number,
+                 const std::vector<Page*>& pages) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -477,6 +875,43 @@ class BlobFile : public File {
    */
   void writePage(const PageId page_number, const Page& new_page);
 
+  /**
+   * Writes pages with consecutive numbers into the file in a single write.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of the page to write pages[0] to.
+   * @param pages             Pages to write.
+   */
+  void writePages(const PageId first_page_number,
+                  const std::vector<const Page*>& pages);
+
+  /**
+   * Queues a read of pages with consecutive numbers on a ring.
+   *
+   * @see File::queueReadPages()
+   */
+  void queueReadPages(IoRing& ring, const std::uint64_t tag,
+                      const PageId first_page_number,
+                      const std::vector<Page*>& pages) const;
+
+  /**
+   * Checks the pages of a read queued with queueReadPages().
+   *
+   * @see File::finishReadPages()
+   */
+  void finishReadPages(const PageId first_page_number,
+                       const std::vector<Page*>& pages,
+                       const std::int64_t result) const;
+
+  /**
+   * Queues a write of pages with consecutive numbers on a ring.
+   *
+   * @see File::queueWritePages()
+   */
+  void queueWritePages(IoRing& ring, const std::uint64_t tag,
+                       const PageId first_page_number,
+                       const std::vector<const Page*>& pages);
+
   /**
    * Deletes a page from the file.
    *
@@ -485,4 +920,208 @@ class BlobFile : public File {
   void deletePage(const PageId page_number);
 };
 
+/**
+ * @brief Layouts of files on disk, see MmapFile.
+ */
+enum FileLayout {
+  PAGE_FILE_LAYOUT = 0,   /* PageFile: pages in use are linked, free ones are cleared */
+  BLOB_FILE_LAYOUT = 1    /* BlobFile: every page is raw data */
+};
+
+/**
+ * @brief A file written as a PageFile or BlobFile, opened read only and mapped
+ *        into memory.
+ *
+ * Pages are read straight from the mapping: readPage() copies them without
+ * any I/O, and the buffer manager hands out pointers into the mapping instead
+ * of reading pages into frames, see BufMgr::readPage().  Such pages must not
+ * be modified, and everything which would change the file throws a
+ * ReadOnlyFileException.
+ *
+ * The file is mapped when the object is constructed.  Writes made meanwhile
+ * through other File objects for the same file show through the mapping, but
+ * pages allocated after it was made do not.
+ */
+class MmapFile : public File {
+ public:
+  /**
+   * Opens the file named fileName and maps it.
+   *
+   * @param filename  Name of the file.
+   * @param layout    Layout the file was written with.
+   * @throws  FileNotFoundException   If the requested file doesn't exist or
+   *                                  can't be mapped.
+   */
+  static MmapFile open(const std::string& filename,
+                       const FileLayout layout = PAGE_FILE_LAYOUT);
+
+  /**
+   * Constructs a file object representing an existing file and maps it.
+   *
+   * @param name    Name of file.
+   * @param layout  Layout the file was written with.
+   * @throws  FileNotFoundException   If the underlying file doesn't exist or
+   *                                  can't be mapped.
+   */
+  MmapFile(const std::string& name, const FileLayout layout = PAGE_FILE_LAYOUT);
+
+  /**
+   * Copy constructor, mapping the file again.
+   *
+   * @param other File object to copy.
+   */
+  MmapFile(const MmapFile& other);
+
+  /**
+   * Assignment operator.
+   *
+   * @param rhs File object to assign.
+   * @return    Newly assigned file object.
+   */
+  MmapFile& operator=(const MmapFile& rhs);
+
+  /**
+   * Destructor that unmaps the file, and closes it if no other File objects
+   * are using it.
+   */
+  ~MmapFile();
+
+  /**
+   * Not supported, the file is read only.
+   *
+   * @throws  ReadOnlyFileException
+   */
+  Page allocatePage(PageId &new_page_number);
+
+  /**
+   * Not supported, the file is read only.
+   *
+   * @throws  ReadOnlyFileException
+   */
+  void allocatePage(PageId &new_page_number, Page& new_page);
+
+  /**
+   * Reads an existing page from the mapping.
+   *
+   * @param page_number   Number of page to read.
+   * @return  The page.
+   * @throws  InvalidPageException  If the page doesn't exist in the mapping or
+   *                                is not currently used.
+   */
+  Page readPage(const PageId page_number) const;
+
+  /**
+   * Reads an existing page from the mapping into page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page object to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the mapping or
+   *                                is not currently used.
+   */
+  void readPage(const PageId page_number, Page& page) const;
+
+  /**
+   * Reads pages with consecutive numbers from the mapping.
+   *
+   * @param first_page_number Number of the page to read into pages[0].
+   * @param pages             Page objects to read into.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                mapping or is not currently used.
+   */
+  void readPages(const PageId first_page_number,
+                 const std::vector<Page*>& pages) const;
+
+  /**
+   * Not supported, the file is read only.
+   *
+   * @throws  ReadOnlyFileException
+   */
+  void writePage(const PageId page_number, const Page& new_page);
+
+  /**
+   * Not supported, the file is read only.
+   *
+   * @throws  ReadOnlyFileException
+   */
+  void writePages(const PageId first_page_number,
+                  const std::vector<const Page*>& pages);
+
+  /**
+   * Not supported, the file is read only.
+   *
+   * @throws  ReadOnlyFileException
+   */
+  void deletePage(const PageId page_number);
+
+  bool mapped() const { return true; }
+
+  /**
+   * Returns the page in place in the mapping.  It must not be modified; the
+   * mapping is read only.
+   *
+   * @param page_number   Number of page.
+   * @return  The page.
+   * @throws  InvalidPageException  If the page doesn't exist in the mapping or
+   *                                is not currently used.
+   */
+  Page* mappedPage(const PageId page_number) const;
+
+  /**
+   * Returns an iterator at the first page in the file, for the PageFile
+   * layout.
+   *
+   * @return  Iterator at first page of file.
+   */
+  FileIterator begin();
+
+  /**
+   * Returns an iterator representing the page after the last page in the file.
+   * This iterator should not be dereferenced.
+   *
+   * @return  Iterator representing page after the last page in the file.
+   */
+  FileIterator end();
+
+ private:
+  /**
+   * Reads the header of the given page from the mapping.
+   *
+   * @param page_number   Number of page whose header is to be read.
+   * @return  Header of page.
+   * @throws  InvalidPageException  If the page lies past the end of the
+   *                                mapping.
+   */
+  PageHeader readPageHeader(const PageId page_number) const;
+
+  /**
+   * Maps the file named in filename_.
+   *
+   * @throws  FileNotFoundException   If the file can't be mapped.
+   */
+  void map();
+
+  /**
+   * Unmaps the file, if mapped.
+   */
+  void unmap();
+
+  /**
+   * Layout the file was written with.
+   */
+  FileLayout layout_;
+
+  /**
+   * Start of the mapping of the whole file, at the file header.  NULL if
+   * not mapped.
+   */
+  char* mapping_;
+
+  /**
+   * Size of the mapping in bytes.
+   */
+  std::size_t mapping_bytes_;
+
+  friend class FileIterator;
+};
+
 }
@@ -0,0 +1,396 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io_ring.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/io_error_exception.h"
+
+namespace badgerdb {
+
+FileIo* FileIo::open(const FileIoType type, const std::string& filename,
+                     const bool truncate) {
+  switch (type) {
+    case STREAM_IO:
+      return new StreamFileIo(filename, truncate);
+    case DIRECT_IO:
+      return new DirectFileIo(filename, truncate);
+    case POSIX_IO:
+    default:
+      return new PosixFileIo(filename, truncate);
+  }
+}
+
+void FileIo::queueReadv(IoRing& ring, const std::uint64_t tag,
+                        const std::uint64_t offset, const struct iovec* iov,
+                        const int count) {
+  ring.post(tag, readv(offset, iov, count));
+}
+
+void FileIo::queueWritev(IoRing& ring, const std::uint64_t tag,
+                         const std::uint64_t offset, const struct iovec* iov,
+                         const int count) {
+  std::size_t length = 0;
+  for (int i = 0; i < count; ++i) {
+    length += iov[i].iov_len;
+  }
+  try {
+    writev(offset, iov, count);
+  } catch (const IoErrorException& e) {
+    ring.post(tag, -e.error());
+    return;
+  }
+  ring.post(tag, length);
+}
+
+//----------------------------------------
+// File descriptor
+//----------------------------------------
+
+/**
+ * Transfers all the bytes described by iov with preadv() or pwritev(), going
+ * on after partial transfers.  Stops early at the end of the file or on an
+ * error.
+ *
+ * @param transfer  Calls preadv() or pwritev() on the file.
+ * @param offset    Position in the file of the first byte.
+ * @param iov       Buffers to transfer.
+ * @param count     Number of buffers.
+ * @param error     Set to errno if a transfer failed, 0 otherwise.
+ * @return  Number of bytes transferred.
+ */
+template <typename Transfer>
+static std::size_t transferAll(const Transfer& transfer, const std::uint64_t offset,
+                               const struct iovec* iov, const int count, int& error) {
+  std::vector<struct iovec> rest(iov, iov + count);
+  std::size_t done = 0;
+  std::size_t first = 0;
+  error = 0;
+  while (first < rest.size()) {
+    const int batch = std::min<std::size_t>(rest.size() - first, IOV_MAX);
+    const ssize_t n = transfer(&rest[first], batch, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      error = errno;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+    // skip the buffers transferred, and what was of the next one
+    std::size_t left = n;
+    while (first < rest.size() && left >= rest[first].iov_len) {
+      left -= rest[first].iov_len;
+      ++first;
+    }
+    if (left > 0) {
+      rest[first].iov_base = static_cast<char*>(rest[first].iov_base) + left;
+      rest[first].iov_len -= left;
+    }
+  }
+  return done;
+}
+
+PosixFileIo::PosixFileIo(const std::string& filename, const bool truncate)
+  : PosixFileIo(filename, truncate, 0) {
+}
+
+PosixFileIo::PosixFileIo(const std::string& filename, const bool truncate,
+                         const int flags)
+  : filename_(filename) {
+  int mode = O_RDWR;
+  if (truncate) {
+    mode |= O_CREAT | O_TRUNC;
+  }
+  fd_ = ::open(filename.c_str(), mode | flags, 0644);
+  if (fd_ < 0 && flags != 0 && errno == EINVAL) {
+    fd_ = ::open(filename.c_str(), mode, 0644);
+  }
+  if (fd_ < 0) {
+    throw FileNotFoundException(filename);
+  }
+}
+
+PosixFileIo::~PosixFileIo() {
+  ::close(fd_);
+}
+
+std::size_t PosixFileIo::read(const std::uint64_t offset, char* buffer,
+                              const std::size_t length) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = ::pread(fd_, buffer + done, length - done, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+  }
+  return done;
+}
+
+std::size_t PosixFileIo::readv(const std::uint64_t offset, const struct iovec* iov,
+                               const int count) {
+  const int fd = fd_;
+  int error;
+  return transferAll([fd](const struct iovec* v, int n, std::uint64_t pos) {
+    return ::preadv(fd, v, n, pos);
+  }, offset, iov, count, error);
+}
+
+void PosixFileIo::write(const std::uint64_t offset, const char* buffer,
+                        const std::size_t length) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = ::pwrite(fd_, buffer + done, length - done, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      throw IoErrorException(filename_, errno);
+    }
+    // no progress on a regular file means there is no room for more
+    if (n == 0) {
+      throw IoErrorException(filename_, ENOSPC);
+    }
+    done += n;
+  }
+}
+
+void PosixFileIo::writev(const std::uint64_t offset, const struct iovec* iov,
+                         const int count) {
+  std::size_t length = 0;
+  for (int i = 0; i < count; ++i) {
+    length += iov[i].iov_len;
+  }
+  const int fd = fd_;
+  int error;
+  const std::size_t done = transferAll([fd](const struct iovec* v, int n, std::uint64_t pos) {
+    return ::pwritev(fd, v, n, pos);
+  }, offset, iov, count, error);
+  if (done != length) {
+    throw IoErrorException(filename_, error != 0 ? error : ENOSPC);
+  }
+}
+
+void PosixFileIo::queueReadv(IoRing& ring, const std::uint64_t tag,
+                             const std::uint64_t offset, const struct iovec* iov,
+                             const int count) {
+  ring.queueRead(fd_, offset, iov, count, tag);
+}
+
+//----------------------------------------
+// Direct
+//----------------------------------------
+
+const std::size_t DirectFileIo::BLOCK_SIZE;
+
+/**
+ * Buffer aligned for O_DIRECT, freed when it goes out of scope.
+ */
+typedef std::unique_ptr<char, void (*)(void*)> BlockBuffer;
+
+/**
+ * Allocates a buffer for the blocks holding some bytes of the file.
+ *
+ * @param offset  Position in the file of the first byte.
+ * @param length  Number of bytes.
+ * @param start   Set to the position of the first block.
+ * @param span    Set to the length of the blocks.
+ * @return  The buffer.
+ */
+static BlockBuffer blocksFor(const std::uint64_t offset, const std::size_t length,
+                             std::uint64_t& start, std::size_t& span) {
+  const std::size_t block = DirectFileIo::BLOCK_SIZE;
+  start = offset / block * block;
+  span = (offset + length + block - 1) / block * block - start;
+  void* buffer = NULL;
+  if (posix_memalign(&buffer, block, span) != 0) {
+    throw std::bad_alloc();
+  }
+  return BlockBuffer(static_cast<char*>(buffer), free);
+}
+
+DirectFileIo::DirectFileIo(const std::string& filename, const bool truncate)
+  : PosixFileIo(filename, truncate, O_DIRECT) {
+}
+
+std::size_t DirectFileIo::read(const std::uint64_t offset, char* buffer,
+                               const std::size_t length) {
+  const struct iovec iov = {buffer, length};
+  return readv(offset, &iov, 1);
+}
+
+std::size_t DirectFileIo::readv(const std::uint64_t offset, const struct iovec* iov,
+                                const int count) {
+  std::size_t length = 0;
+  for (int i = 0; i < count; ++i) {
+    length += iov[i].iov_len;
+  }
+  std::uint64_t start;
+  std::size_t span;
+  BlockBuffer blocks = blocksFor(offset, length, start, span);
+  const std::size_t read = PosixFileIo::read(start, blocks.get(), span);
+
+  // hand out the bytes asked for, as far as the file went
+  std::size_t left = read > offset - start ? std::min<std::size_t>(read - (offset - start), length) : 0;
+  const std::size_t done = left;
+  const char* from = blocks.get() + (offset - start);
+  for (int i = 0; i < count && left > 0; ++i) {
+    const std::size_t n = std::min(left, iov[i].iov_len);
+    std::memcpy(iov[i].iov_base, from, n);
+    from += n;
+    left -= n;
+  }
+  return done;
+}
+
+void DirectFileIo::write(const std::uint64_t offset, const char* buffer,
+                         const std::size_t length) {
+  const struct iovec iov = {const_cast<char*>(buffer), length};
+  writev(offset, &iov, 1);
+}
+
+void DirectFileIo::writev(const std::uint64_t offset, const struct iovec* iov,
+                          const int count) {
+  std::size_t length = 0;
+  for (int i = 0; i < count; ++i) {
+    length += iov[i].iov_len;
+  }
+  std::uint64_t start;
+  std::size_t span;
+  BlockBuffer blocks = blocksFor(offset, length, start, span);
+
+  std::lock_guard<std::mutex> lock(write_latch_);
+  struct stat st;
+  if (fstat(fd_, &st) != 0) {
+    throw IoErrorException(filename_, errno);
+  }
+  // keep what the first and last blocks hold outside the bytes written;
+  // past the end of the file they hold zeros
+  const std::uint64_t end = offset + length;
+  if (offset != start) {
+    const std::size_t read = PosixFileIo::read(start, blocks.get(), BLOCK_SIZE);
+    std::memset(blocks.get() + read, 0, BLOCK_SIZE - read);
+  }
+  if (end != start + span && (span > BLOCK_SIZE || offset == start)) {
+    char* last = blocks.get() + span - BLOCK_SIZE;
+    const std::size_t read = PosixFileIo::read(start + span - BLOCK_SIZE, last, BLOCK_SIZE);
+    std::memset(last + read, 0, BLOCK_SIZE - read);
+  }
+  char* to = blocks.get() + (offset - start);
+  for (int i = 0; i < count; ++i) {
+    std::memcpy(to, iov[i].iov_base, iov[i].iov_len);
+    to += iov[i].iov_len;
+  }
+  PosixFileIo::write(start, blocks.get(), span);
+
+  // the zeros written past the last byte are not part of the file, so that
+  // reads still stop short where the file ends
+  const std::uint64_t size = std::max<std::uint64_t>(st.st_size, end);
+  if (start + span > size && ftruncate(fd_, size) != 0) {
+    throw IoErrorException(filename_, errno);
+  }
+}
+
+void DirectFileIo::queueReadv(IoRing& ring, const std::uint64_t tag,
+                              const std::uint64_t offset, const struct iovec* iov,
+                              const int count) {
+  ring.queueRead(fd_, offset, iov, count, tag, BLOCK_SIZE);
+}
+
+//----------------------------------------
+// Stream
+//----------------------------------------
+
+StreamFileIo::StreamFileIo(const std::string& filename, const bool truncate)
+  : filename_(filename) {
+  std::ios_base::openmode mode =
+      std::fstream::in | std::fstream::out | std::fstream::binary;
+  if (truncate) {
+    mode = mode | std::fstream::trunc;
+  }
+  stream_.open(filename, mode);
+  if (!stream_) {
+    throw FileNotFoundException(filename);
+  }
+}
+
+std::size_t StreamFileIo::read(const std::uint64_t offset, char* buffer,
+                               const std::size_t length) {
+  stream_.seekg(offset, std::ios::beg);
+  stream_.read(buffer, length);
+  const std::size_t done = stream_.gcount();
+  if (done != length) {
+    // past the end of the file; keep the stream usable for later calls
+    stream_.clear();
+  }
+  return done;
+}
+
+std::size_t StreamFileIo::readv(const std::uint64_t offset, const struct iovec* iov,
+                                const int count) {
+  stream_.seekg(offset, std::ios::beg);
+  std::size_t done = 0;
+  for (int i = 0; i < count; ++i) {
+    stream_.read(static_cast<char*>(iov[i].iov_base), iov[i].iov_len);
+    done += stream_.gcount();
+    if (static_cast<std::size_t>(stream_.gcount()) != iov[i].iov_len) {
+      stream_.clear();
+      break;
+    }
+  }
+  return done;
+}
+
+void StreamFileIo::write(const std::uint64_t offset, const char* buffer,
+                         const std::size_t length) {
+  errno = 0;
+  stream_.seekp(offset, std::ios::beg);
+  stream_.write(buffer, length);
+  stream_.flush();
+  checkWritten();
+}
+
+void StreamFileIo::writev(const std::uint64_t offset, const struct iovec* iov,
+                          const int count) {
+  errno = 0;
+  stream_.seekp(offset, std::ios::beg);
+  for (int i = 0; i < count; ++i) {
+    stream_.write(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+  }
+  stream_.flush();
+  checkWritten();
+}
+
+void StreamFileIo::checkWritten() {
+  if (!stream_) {
+    // the stream does not say why; errno is left by the failed write
+    const int error = errno != 0 ? errno : EIO;
+    stream_.clear();
+    throw IoErrorException(filename_, error);
+  }
+}
+
+}
@@ -0,0 +1,275 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <sys/uio.h>
+
+namespace badgerdb {
+
+class IoRing;
+
+/**
+ * @brief Ways a File can do its I/O, chosen when the file is first opened.
+ */
+enum FileIoType {
+  POSIX_IO = 0,   /* file descriptor with pread and pwrite, no shared position */
+  STREAM_IO = 1,  /* std::fstream, seeking before every read or write */
+  DIRECT_IO = 2   /* file descriptor opened with O_DIRECT, bypassing the page cache */
+};
+
+/**
+ * @brief Reads and writes bytes at given offsets of one open file.
+ *
+ * All File objects for the same file share one FileIo, see
+ * File::open_streams_.  Backends which keep a file position shared by all
+ * users (see positional()) must be used under the file's latch; the others
+ * may be used by several threads at once.
+ */
+class FileIo {
+ public:
+  /**
+   * Opens a file for reading and writing.
+   *
+   * @param type      Backend to use.
+   * @param filename  Name of the file.
+   * @param truncate  Whether to create the file, or empty it if it exists.
+   * @return  The open file, to be deleted by the caller.
+   * @throws  FileNotFoundException   If the file could not be opened.
+   */
+  static FileIo* open(const FileIoType type, const std::string& filename,
+                      const bool truncate);
+
+  virtual ~FileIo() {}
+
+  /**
+   * Reads bytes from the file.
+   *
+   * @param offset  Position in the file to read from.
+   * @param buffer  Buffer to read into.
+   * @param length  Number of bytes to read.
+   * @return  Number of bytes read, less than length at the end of the file.
+   */
+  virtual std::size_t read(const std::uint64_t offset, char* buffer,
+                           const std::size_t length) = 0;
+
+  /**
+   * Reads consecutive bytes of the file into several buffers, filling them
+   * in order.
+   *
+   * @param offset  Position in the file to read from.
+   * @param iov     Buffers to read into.
+   * @param count   Number of buffers.
+   * @return  Number of bytes read, less than requested at the end of the file.
+   */
+  virtual std::size_t readv(const std::uint64_t offset, const struct iovec* iov,
+                            const int count) = 0;
+
+  /**
+   * Writes bytes to the file.
+   *
+   * @param offset  Position in the file to write to.
+   * @param buffer  Bytes to write.
+   * @param length  Number of bytes to write.
+   * @throws  IoErrorException  If not all the bytes could be written.
+   */
+  virtual void write(const std::uint64_t offset, const char* buffer,
+                     const std::size_t length) = 0;
+
+  /**
+   * Writes the contents of several buffers to consecutive bytes of the file,
+   * in order.
+   *
+   * @param offset  Position in the file to write to.
+   * @param iov     Buffers to write.
+   * @param count   Number of buffers.
+   * @throws  IoErrorException  If not all the bytes could be written.
+   */
+  virtual void writev(const std::uint64_t offset, const struct iovec* iov,
+                      const int count) = 0;
+
+  /**
+   * Queues a read of consecutive bytes of the file into several buffers on a
+   * ring, like readv().  Backends the ring cannot drive read at once and post
+   * the number of bytes read.
+   *
+   * @param ring    Ring to queue on, which must not be full.
+   * @param tag     Reported along with the completion.
+   * @param offset  Position in the file to read from.
+   * @param iov     Buffers to read into, valid until the read is completed.
+   * @param count   Number of buffers.
+   */
+  virtual void queueReadv(IoRing& ring, const std::uint64_t tag,
+                          const std::uint64_t offset, const struct iovec* iov,
+                          const int count);
+
+  /**
+   * Queues a write of several buffers to consecutive bytes of the file on a
+   * ring, like writev().  Backends the ring cannot drive write at once and
+   * post the number of bytes written, or the negated errno value if the write
+   * failed.
+   *
+   * @param ring    Ring to queue on, which must not be full.
+   * @param tag     Reported along with the completion.
+   * @param offset  Position in the file to write to.
+   * @param iov     Buffers to write, unchanged until the write is completed.
+   * @param count   Number of buffers.
+   */
+  virtual void queueWritev(IoRing& ring, const std::uint64_t tag,
+                           const std::uint64_t offset, const struct iovec* iov,
+                           const int count);
+
+  /**
+   * Returns true if reads and writes carry their own offset, so that several
+   * threads may use the file at once without a latch.
+   */
+  virtual bool positional() const = 0;
+
+  /**
+   * Returns the backend of this file.
+   */
+  virtual FileIoType type() const = 0;
+};
+
+/**
+ * @brief I/O through a file descriptor with pread() and pwrite().
+ *
+ * Reads queued on a ring go through the kernel.  Writes queued on a ring are
+ * written at once: they only copy into the page cache, which takes longer
+ * through io_uring, as the kernel hands buffered writes to worker threads.
+ */
+class PosixFileIo : public FileIo {
+ public:
+  /**
+   * Opens the file.
+   *
+   * @see FileIo::open()
+   */
+  PosixFileIo(const std::string& filename, const bool truncate);
+
+  /**
+   * Closes the file descriptor.
+   */
+  ~PosixFileIo();
+
+  std::size_t read(const std::uint64_t offset, char* buffer, const std::size_t length);
+  std::size_t readv(const std::uint64_t offset, const struct iovec* iov, const int count);
+  void write(const std::uint64_t offset, const char* buffer, const std::size_t length);
+  void writev(const std::uint64_t offset, const struct iovec* iov, const int count);
+  void queueReadv(IoRing& ring, const std::uint64_t tag, const std::uint64_t offset,
+                  const struct iovec* iov, const int count);
+  bool positional() const { return true; }
+  FileIoType type() const { return POSIX_IO; }
+
+ protected:
+  /**
+   * Opens the file with extra flags for open().
+   *
+   * @param filename  Name of the file.
+   * @param truncate  Whether to create the file, or empty it if it exists.
+   * @param flags     Extra flags, left out again if the file system refuses
+   *                  them.
+   */
+  PosixFileIo(const std::string& filename, const bool truncate, const int flags);
+
+  /**
+   * Name of the file, for errors.
+   */
+  const std::string filename_;
+
+  /**
+   * File descriptor of the open file.
+   */
+  int fd_;
+};
+
+/**
+ * @brief I/O through a file descriptor opened with O_DIRECT, so that pages
+ *        are cached by the buffer pool alone.
+ *
+ * O_DIRECT transfers whole blocks between aligned memory and aligned file
+ * positions, while pages are stored right after the file header.  Every
+ * transfer therefore goes through an aligned buffer covering the blocks
+ * involved.  A write which covers only part of its first or last block reads
+ * that block first, and one which extends the file cuts off the rest of its
+ * last block again; writes are serialised so that two writes sharing a block
+ * do not undo each other, and are therefore done at once when queued on a
+ * ring.  On file systems without O_DIRECT the file is opened normally.
+ */
+class DirectFileIo : public PosixFileIo {
+ public:
+  /**
+   * Size and alignment of the blocks transferred.
+   */
+  static const std::size_t BLOCK_SIZE = 4096;
+
+  /**
+   * Opens the file.
+   *
+   * @see FileIo::open()
+   */
+  DirectFileIo(const std::string& filename, const bool truncate);
+
+  std::size_t read(const std::uint64_t offset, char* buffer, const std::size_t length);
+  std::size_t readv(const std::uint64_t offset, const struct iovec* iov, const int count);
+  void write(const std::uint64_t offset, const char* buffer, const std::size_t length);
+  void writev(const std::uint64_t offset, const struct iovec* iov, const int count);
+  void queueReadv(IoRing& ring, const std::uint64_t tag, const std::uint64_t offset,
+                  const struct iovec* iov, const int count);
+  FileIoType type() const { return DIRECT_IO; }
+
+ private:
+  /**
+   * Serialises writes, which may read and write back blocks shared with
+   * other writes.
+   */
+  std::mutex write_latch_;
+};
+
+/**
+ * @brief I/O through a std::fstream, which seeks before every operation and
+ *        flushes after every write.
+ */
+class StreamFileIo : public FileIo {
+ public:
+  /**
+   * Opens the file.
+   *
+   * @see FileIo::open()
+   */
+  StreamFileIo(const std::string& filename, const bool truncate);
+
+  std::size_t read(const std::uint64_t offset, char* buffer, const std::size_t length);
+  std::size_t readv(const std::uint64_t offset, const struct iovec* iov, const int count);
+  void write(const std::uint64_t offset, const char* buffer, const std::size_t length);
+  void writev(const std::uint64_t offset, const struct iovec* iov, const int count);
+  bool positional() const { return false; }
+  FileIoType type() const { return STREAM_IO; }
+
+ private:
+  /**
+   * Throws IoErrorException if the last write or flush failed, and makes the
+   * stream usable again.
+   */
+  void checkWritten();
+
+  /**
+   * Name of the file, for errors.
+   */
+  const std::string filename_;
+
+  /**
+   * Stream for the open file.
+   */
+  std::fstream stream_;
+};
+
+}
@@ -36,7 +36,7 @@ class FileIterator {
    *
    * @param file  File to iterate over.
    */
-  FileIterator(PageFile* file)
+  FileIterator(File* file)
       : file_(file) {
     assert(file_ != NULL);
     const FileHeader& header = file_->readHeader();
@@ -50,7 +50,7 @@ class FileIterator {
    * @param file        File to iterate over.
    * @param page_number Number of page to start iterator at.
    */
-  FileIterator(PageFile* file, PageId page_number)
+  FileIterator(File* file, PageId page_number)
       : file_(file),
         current_page_number_(page_number) {
   }
@@ -94,9 +94,19 @@ class FileIterator {
         (current_page_number_ != rhs.current_page_number_);
   }
 
+  /**
+   * Returns the number of the page the iterator is currently pointing to,
+   * without reading the page itself.
+   *
+   * @return  Number of current page.
+   */
+	inline PageId page_number() const
+  { return current_page_number_; }
+
   /**
    * Dereferences the iterator, returning a copy of the current page in the
-   * file.
+   * file.  This reads the whole page from disk; use page_number() when only
+   * the page number is needed.
    *
    * @return  Page in file.
    */
@@ -107,7 +117,7 @@ class FileIterator {
   /**
    * File we're iterating over.
    */
-  PageFile* file_;
+  File* file_;
 
   /**
    * Number of page in file iterator is currently pointing to.
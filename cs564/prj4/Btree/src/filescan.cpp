@@ -7,54 +7,60 @@
 
 #include "filescan.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/read_only_file_exception.h"
 
 namespace badgerdb { 
 
-FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
+FileScan::FileScan(const std::string &name, BufMgr *bufferMgr,
+                   const BufferAccessStrategy strategy)
 {
-  file = new PageFile(name, false);	//dont create new file
+  if (strategy == MAPPED_READ)
+    file = new MmapFile(name, PAGE_FILE_LAYOUT);
+  else
+    file = new PageFile(name, false);	//dont create new file
 	bufMgr = bufferMgr;
-	curDirtyFlag = false;
-  curPage = NULL;
-	filePageIter = file->begin();
+  ring = (strategy == BULK_READ) ? new BufferRing() : NULL;
+	filePageIter = FileIterator(file);
 }
 
 FileScan::~FileScan()
 {
   // generally must unpin last page of the scan
-  if (curPage != NULL)
-  {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-		curDirtyFlag = false;
-    filePageIter = file->begin();
-  }
+  curPage.release();
   bufMgr->flushFile(file);
   delete file;
+  delete ring;
 }
 
 void FileScan::scanNext(RecordId& outRid)
+{
+  if (!tryScanNext(outRid))
+	{
+		throw EndOfFileException();
+	}
+}
+
+bool FileScan::tryScanNext(RecordId& outRid)
 {
   std::string rec;
 
-  if (filePageIter == file->end())
+  if (filePageIter == fileEnd())
 	{
-		throw EndOfFileException();
+		return false;
 	}
 
   // special case of the first record of the first page of the file
-  if (curPage == NULL)
+  if (!curPage)
   {
     // need to get the first page of the file
-		filePageIter = file->begin();
-    if(filePageIter == file->end())
+		filePageIter = FileIterator(file);
+    if(filePageIter == fileEnd())
 		{
-			throw EndOfFileException();
+			return false;
 		}
 	 
 		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
-		curDirtyFlag = false;
+    curPage = bufMgr->fetchPage(file, filePageIter.page_number(), ring);
 
 		// get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -65,7 +71,7 @@ void FileScan::scanNext(RecordId& outRid)
 		  rec = *pageRecordIter;
 
 			outRid = pageRecordIter.getCurrentRecord();
-			return;
+			return true;
 		}
   }
 
@@ -76,19 +82,16 @@ void FileScan::scanNext(RecordId& outRid)
   while (pageRecordIter == curPage->end())
   {
     // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-    curDirtyFlag = false;
+    curPage.release();
 
     filePageIter++;
-    if (filePageIter == file->end())
+    if (filePageIter == fileEnd())
     {
-      curPage = NULL;
-			throw EndOfFileException();
+			return false;
     }
 
     // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    curPage = bufMgr->fetchPage(file, filePageIter.page_number(), ring);
 
     // get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -101,7 +104,7 @@ void FileScan::scanNext(RecordId& outRid)
 
 	// return rid of the record
 	outRid = pageRecordIter.getCurrentRecord();
-	return;
+	return true;
 }
 
 // returns pointer to the current record.  page is left pinned
@@ -114,7 +117,14 @@ std::string FileScan::getRecord()
 // mark current page of scan dirty
 void FileScan::markDirty()
 {
-  curDirtyFlag = true;
+  if (file->mapped())
+    throw ReadOnlyFileException(file->filename());
+  curPage.markDirty();
+}
+
+FileIterator FileScan::fileEnd()
+{
+  return FileIterator(file, Page::INVALID_NUMBER);
 }
 
 }
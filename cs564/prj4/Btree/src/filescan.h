@@ -24,24 +24,34 @@ class FileScan
 {
  public:
 
-  FileScan(const std::string &name, BufMgr *bufMgr);
+  //strategy BULK_READ reads the relation through a private BufferRing, so that
+  //a scan of a large relation does not push everything else out of the pool;
+  //MAPPED_READ reads it in place from a read-only mapping of the file
+  FileScan(const std::string &name, BufMgr *bufMgr,
+           const BufferAccessStrategy strategy = NORMAL_ACCESS);
 
   ~FileScan();
 
   //return RecordId of next record that satisfies the scan 
+  //throws EndOfFileException once the relation is exhausted
   void scanNext(RecordId& outRid);
 
+  //same as scanNext, but returns false instead of throwing at end of file
+  bool tryScanNext(RecordId& outRid);
+
   //read current record, returning pointer and length
   std::string getRecord();
 
   //marks current page of scan dirty
+  //throws ReadOnlyFileException for a scan with strategy MAPPED_READ
   void markDirty();
 
  private:
   /**
-   * File which is being scanned.
+   * File which is being scanned, an MmapFile for strategy MAPPED_READ and a
+   * PageFile otherwise.
    */
-  PageFile      *file;
+  File          *file;
 
   /**
    * Buffer Manager instance used to read/write pages into/from buffer pool.
@@ -49,17 +59,23 @@ class FileScan
 	BufMgr				*bufMgr;
 
   /**
-   * Current page being scanned.
+   * Ring pages are read through, NULL for normal access.
+   */
+  BufferRing    *ring;
+
+  /**
+   * Current page being scanned, pinned until the scan moves off it.  Marked
+   * dirty by markDirty().
    */
-  Page*         curPage;
+  PageHandle    curPage;
 
   FileIterator  filePageIter;
   PageIterator  pageRecordIter;
 
   /**
-   * True if page has been updated
+   * Iterator past the last page of the file.
    */
-  bool  	      curDirtyFlag;
+  FileIterator  fileEnd();
 };
 
 }
@@ -0,0 +1,286 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "heapfile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+#include <sys/stat.h>
+#include "file_iterator.h"
+#include "exceptions/insufficient_space_exception.h"
+
+namespace badgerdb {
+
+const std::uint32_t HeapFile::NUM_CATEGORIES;
+const std::uint32_t HeapFile::CATEGORY_BYTES;
+
+/**
+ * Header of a saved free-space map, followed by the category of every page.
+ */
+struct FreeSpaceMapHeader {
+  /**
+   * Marks the start of a free-space map.
+   */
+  std::uint32_t magic;
+
+  /**
+   * Number of pages with a category, one byte each after the header.
+   */
+  std::uint32_t num_pages;
+
+  /**
+   * Size and modification time in nanoseconds of the file of the relation
+   * when the map was saved.  The map is only trusted if they still match.
+   */
+  std::int64_t file_size;
+  std::int64_t file_mtime;
+
+  /**
+   * Value of magic.
+   */
+  static const std::uint32_t MAGIC = 0x4d534648U;
+};
+
+/**
+ * Looks up the size and modification time of a file.
+ *
+ * @return  False if it cannot be looked up.
+ */
+static bool fileStamp(const std::string& name, std::int64_t& size, std::int64_t& mtime)
+{
+  struct stat st;
+  if (::stat(name.c_str(), &st) != 0)
+    return false;
+  size = st.st_size;
+  mtime = std::int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  return true;
+}
+
+HeapFile::HeapFile(const std::string& name, BufMgr* bufferMgr,
+                   const bool create_new)
+  : file(new PageFile(name, create_new)), bufMgr(bufferMgr),
+    mapLoaded(create_new), pagesInCategory(NUM_CATEGORIES)
+{
+  // a map left by a relation of the same name that went before
+  if (create_new)
+    std::remove(mapName(name).c_str());
+}
+
+HeapFile::~HeapFile()
+{
+  try
+  {
+    close();
+  }
+  catch (...)
+  {
+    // nowhere to report it from a destructor; the frames still holding
+    // pages of the relation point at the file, so it is not deleted
+  }
+}
+
+void HeapFile::close()
+{
+  std::lock_guard<std::mutex> lock(latch);
+  if (file == NULL)
+    return;
+  current.release();
+  bufMgr->flushFile(file);
+  const std::string name = file->filename();
+  delete file;
+  file = NULL;
+  if (mapLoaded)
+    writeFreeSpaceMap(name);
+}
+
+void HeapFile::remove(const std::string& name)
+{
+  File::remove(name);
+  std::remove(mapName(name).c_str());
+}
+
+std::string HeapFile::mapName(const std::string& name)
+{
+  return name + ".fsm";
+}
+
+std::uint32_t HeapFile::categoryOf(const std::size_t free_space)
+{
+  return std::min<std::size_t>(free_space / CATEGORY_BYTES, NUM_CATEGORIES - 1);
+}
+
+RecordId HeapFile::insertRecord(const std::string& record_data)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  loadFreeSpaceMap();
+
+  // the record may need a new slot as well
+  const std::size_t needed = record_data.length() + sizeof(PageSlot);
+  if (needed > Page::DATA_SIZE)
+    throw InsufficientSpaceException(Page::INVALID_NUMBER, record_data.length(),
+                                     Page::DATA_SIZE - sizeof(PageSlot));
+
+  // the current page first, down to its last byte
+  if (current && current->hasSpaceForRecord(record_data))
+    return insertOn(current, record_data);
+
+  // Every page from the lowest category which is sure to have room will do;
+  // taking the fullest such page keeps the relation dense.
+  for (std::uint32_t c = (needed + CATEGORY_BYTES - 1) / CATEGORY_BYTES;
+       c < NUM_CATEGORIES; c++)
+  {
+    while (!pagesInCategory[c].empty())
+    {
+      const PageId pageNo = pagesInCategory[c].back();
+      PageHandle page = bufMgr->fetchPage(file, pageNo);
+      if (page->hasSpaceForRecord(record_data))
+        return insertOn(page, record_data);
+      // the page was changed behind our back; this moves it to a lower
+      // category
+      updateFreeSpace(pageNo, *page);
+    }
+  }
+
+  PageId pageNo;
+  PageHandle page = bufMgr->newPage(file, pageNo);
+  return insertOn(page, record_data);
+}
+
+RecordId HeapFile::insertOn(PageHandle& page, const std::string& record_data)
+{
+  const RecordId rid = page->insertRecord(record_data);
+  page.markDirty();
+  updateFreeSpace(page.pageNumber(), *page);
+  if (&page != &current)
+    current = std::move(page);
+  return rid;
+}
+
+void HeapFile::deleteRecord(const RecordId& rid)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  loadFreeSpaceMap();
+
+  PageHandle page = bufMgr->fetchPage(file, rid.page_number);
+  page->deleteRecord(rid);
+  page.markDirty();
+  updateFreeSpace(rid.page_number, *page);
+}
+
+std::string HeapFile::getRecord(const RecordId& rid)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  PageHandle page = bufMgr->fetchPage(file, rid.page_number);
+  return page->getRecord(rid);
+}
+
+void HeapFile::loadFreeSpaceMap()
+{
+  if (mapLoaded)
+    return;
+  if (readFreeSpaceMap())
+  {
+    mapLoaded = true;
+    return;
+  }
+
+  // one pass over the relation, through a ring so the pool is not flooded
+  for (FileIterator iter = file->begin(); iter != file->end(); ++iter)
+  {
+    PageHandle page = bufMgr->fetchPage(file, iter.page_number(), &ring);
+    updateFreeSpace(iter.page_number(), *page);
+  }
+  mapLoaded = true;
+}
+
+bool HeapFile::readFreeSpaceMap()
+{
+  const std::string path = mapName(file->filename());
+  FreeSpaceMapHeader header;
+  std::vector<std::uint8_t> saved;
+  {
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+      return false;
+    saved.resize(header.num_pages);
+    if (header.magic != FreeSpaceMapHeader::MAGIC
+        || !in.read(reinterpret_cast<char*>(saved.data()), saved.size()))
+      return false;
+  }
+
+  // from now on the file changes, and the map with it, until close() saves
+  // the map again
+  std::int64_t size, mtime;
+  const bool current = fileStamp(file->filename(), size, mtime)
+    && size == header.file_size && mtime == header.file_mtime;
+  std::remove(path.c_str());
+  if (!current)
+    return false;
+  for (PageId pageNo = 0; pageNo < saved.size(); pageNo++)
+  {
+    if (saved[pageNo] > NUM_CATEGORIES)
+      return false;
+  }
+
+  category.assign(saved.begin(), saved.end());
+  positionInCategory.assign(saved.size(), 0);
+  for (PageId pageNo = 0; pageNo < saved.size(); pageNo++)
+  {
+    if (saved[pageNo] == NUM_CATEGORIES)
+      continue;
+    pagesInCategory[saved[pageNo]].push_back(pageNo);
+    positionInCategory[pageNo] = pagesInCategory[saved[pageNo]].size() - 1;
+  }
+  return true;
+}
+
+void HeapFile::writeFreeSpaceMap(const std::string& name) const
+{
+  FreeSpaceMapHeader header;
+  header.magic = FreeSpaceMapHeader::MAGIC;
+  header.num_pages = category.size();
+  if (!fileStamp(name, header.file_size, header.file_mtime))
+    return;
+
+  const std::string path = mapName(name);
+  std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(category.data()), category.size());
+  out.close();
+  if (!out)
+    std::remove(path.c_str());
+}
+
+void HeapFile::updateFreeSpace(const PageId pageNo, const Page& page)
+{
+  if (pageNo >= category.size())
+  {
+    category.resize(pageNo + 1, NUM_CATEGORIES);
+    positionInCategory.resize(pageNo + 1, 0);
+  }
+  const std::uint32_t newCategory = categoryOf(page.getFreeSpace());
+  const std::uint32_t oldCategory = category[pageNo];
+  if (newCategory == oldCategory)
+    return;
+
+  if (oldCategory != NUM_CATEGORIES)
+  {
+    // the last page of the old list takes its place
+    std::vector<PageId>& pages = pagesInCategory[oldCategory];
+    const PageId last = pages.back();
+    pages[positionInCategory[pageNo]] = last;
+    positionInCategory[last] = positionInCategory[pageNo];
+    pages.pop_back();
+  }
+  pagesInCategory[newCategory].push_back(pageNo);
+  positionInCategory[pageNo] = pagesInCategory[newCategory].size() - 1;
+  category[pageNo] = newCategory;
+}
+
+}
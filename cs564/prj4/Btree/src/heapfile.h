@@ -0,0 +1,236 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+ * @brief A relation stored as an unordered heap of records in a PageFile,
+ *        read and written through the buffer manager.
+ *
+ * insertRecord() keeps filling the page it inserted on last, which it keeps
+ * pinned, so loading a relation costs no buffer manager call per record.
+ * Once that page is full it moves to any page with room for the record,
+ * found through a free-space map which keeps a coarse category of the free
+ * space of every page, so no page is read to find one.  Space freed by
+ * deleteRecord() is reused this way.  The map is only a hint, checked
+ * against the page before a record goes on it.
+ *
+ * close() saves the map next to the relation, in a file named after it, see
+ * mapName(), and the first insertRecord() or deleteRecord() after the
+ * relation is opened again reads it back.  Only if there is no saved map,
+ * or it is older than the last change to the file, as after a crash or a
+ * change through something other than the HeapFile, is the map built again:
+ * with one pass over the relation, through a BufferRing, which reads every
+ * page of the relation once.
+ *
+ * A HeapFile may be used from several threads; its operations are
+ * serialized.
+ */
+class HeapFile
+{
+ public:
+  /**
+   * Number of free-space categories.  A page in category c has at least
+   * c * CATEGORY_BYTES bytes free.
+   */
+  static const std::uint32_t NUM_CATEGORIES = 16;
+
+  /**
+   * Width in bytes of a free-space category.
+   */
+  static const std::uint32_t CATEGORY_BYTES = Page::DATA_SIZE / NUM_CATEGORIES;
+
+  /**
+   * Opens or creates the relation.
+   *
+   * @param name        Name of the file of the relation.
+   * @param bufMgr      Buffer manager to read and write pages through.
+   * @param create_new  Whether to create a new file.
+   * @throws  FileExistsException     If the file exists and create_new is
+   *                                  true.
+   * @throws  FileNotFoundException   If the file doesn't exist and
+   *                                  create_new is false.
+   */
+  HeapFile(const std::string& name, BufMgr* bufMgr, const bool create_new = false);
+
+  /**
+   * Closes the relation if close() has not, see there.  Errors cannot be
+   * reported from here; if the pages cannot be written out, the file is left
+   * open, as pages of it are still in the pool.
+   */
+  ~HeapFile();
+
+  /**
+   * Writes out the pages of the relation and closes its file.  Nothing but
+   * the destructor may be called afterwards.
+   *
+   * @throws  PagePinnedException If a page of the relation is pinned other
+   *                              than by the HeapFile itself; the relation
+   *                              stays open and may be closed again once it
+   *                              is unpinned.
+   * @throws  IoErrorException    If a page could not be written.
+   */
+  void close();
+
+  /**
+   * Deletes the file of a closed relation and its saved free-space map.
+   *
+   * @param name  Name of the file of the relation.
+   * @throws  FileNotFoundException   If the file doesn't exist.
+   * @throws  FileOpenException       If the file is still open.
+   */
+  static void remove(const std::string& name);
+
+  /**
+   * Returns the name of the file the free-space map of a relation is saved
+   * in.
+   *
+   * @param name  Name of the file of the relation.
+   */
+  static std::string mapName(const std::string& name);
+
+  HeapFile(const HeapFile&) = delete;
+  HeapFile& operator=(const HeapFile&) = delete;
+
+  /**
+   * Inserts a record on a page with room for it, or on a new page if there
+   * is none.
+   *
+   * @param record_data Bytes that compose the record.
+   * @return  ID of the new record.
+   * @throws  InsufficientSpaceException  If the record does not fit on an
+   *                                      empty page.
+   */
+  RecordId insertRecord(const std::string& record_data);
+
+  /**
+   * Deletes a record, making its space available to insertRecord().
+   *
+   * @param rid   ID of the record.
+   * @throws  InvalidPageException    If there is no such page.
+   * @throws  InvalidRecordException  If there is no such record on the page.
+   */
+  void deleteRecord(const RecordId& rid);
+
+  /**
+   * Returns a copy of a record.
+   *
+   * @param rid   ID of the record.
+   * @return  The record.
+   * @throws  InvalidPageException    If there is no such page.
+   * @throws  InvalidRecordException  If there is no such record on the page.
+   */
+  std::string getRecord(const RecordId& rid);
+
+  /**
+   * Returns the file of the relation, for scans and indexes over it.
+   */
+  File* getFile() { return file; }
+
+ private:
+  /**
+   * Returns the category of a page with the given free space.
+   */
+  static std::uint32_t categoryOf(const std::size_t free_space);
+
+  /**
+   * Reads the saved free-space map, or builds it, if neither has been done
+   * yet.
+   */
+  void loadFreeSpaceMap();
+
+  /**
+   * Reads the free-space map saved by close() and deletes its file, which
+   * only a later close() writes again.
+   *
+   * @return  False if there is none, or it does not match the relation.
+   */
+  bool readFreeSpaceMap();
+
+  /**
+   * Saves the free-space map for the next time the relation is opened.  The
+   * file of the relation must be closed, so that the map is newer than every
+   * write to it.  Errors are not reported; the map is built again instead.
+   *
+   * @param name  Name of the file of the relation.
+   */
+  void writeFreeSpaceMap(const std::string& name) const;
+
+  /**
+   * Inserts a record on a page and makes it the current one.
+   *
+   * @param page        The page, which has room for the record.
+   * @param record_data Bytes that compose the record.
+   * @return  ID of the new record.
+   */
+  RecordId insertOn(PageHandle& page, const std::string& record_data);
+
+  /**
+   * Records the free space of a page in the map.
+   *
+   * @param pageNo  Number of the page.
+   * @param page    The page, as it is now.
+   */
+  void updateFreeSpace(const PageId pageNo, const Page& page);
+
+  /**
+   * File of the relation, NULL once closed.
+   */
+  PageFile* file;
+
+  /**
+   * Buffer manager pages are read and written through.
+   */
+  BufMgr* bufMgr;
+
+  /**
+   * Page records were last inserted on, kept pinned.
+   */
+  PageHandle current;
+
+  /**
+   * Ring the free-space map is built through.  Read-ahead may still use it
+   * until the file is flushed, so it lives as long as the HeapFile.
+   */
+  BufferRing ring;
+
+  /**
+   * True once the free-space map has been built.
+   */
+  bool mapLoaded;
+
+  /**
+   * Category of every page by page number, or NUM_CATEGORIES for pages not
+   * in the map.
+   */
+  std::vector<std::uint8_t> category;
+
+  /**
+   * Pages of each category, and the position of every page in its list, so
+   * that a page moves between lists in constant time.
+   */
+  std::vector<std::vector<PageId> > pagesInCategory;
+  std::vector<std::uint32_t> positionInCategory;
+
+  /**
+   * Serializes the operations.
+   */
+  std::mutex latch;
+};
+
+}
@@ -0,0 +1,273 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "io_ring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace badgerdb {
+
+/**
+ * Largest depth asked of the kernel; it refuses rings much larger than this.
+ */
+static const unsigned MAX_DEPTH = 4096;
+
+IoRing* IoRing::create(const unsigned depth) {
+  const unsigned entries = std::max(1u, std::min(depth, MAX_DEPTH));
+  struct io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  const int fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (fd < 0) {
+    return NULL;
+  }
+  IoRing* ring = new IoRing(fd, entries);
+  if (!ring->map(params)) {
+    delete ring;
+    return NULL;
+  }
+  return ring;
+}
+
+bool IoRing::supported() {
+  static const bool available = [] {
+    IoRing* ring = create(1);
+    delete ring;
+    return ring != NULL;
+  }();
+  return available;
+}
+
+IoRing::IoRing(const int fd, const unsigned depth)
+  : fd_(fd), depth_(depth), unsubmitted_(0),
+    sq_ring_(MAP_FAILED), sq_ring_bytes_(0), cq_ring_(MAP_FAILED), cq_ring_bytes_(0),
+    sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)), sqes_bytes_(0),
+    sq_head_(NULL), sq_tail_(NULL), sq_mask_(0), sq_array_(NULL),
+    cq_head_(NULL), cq_tail_(NULL), cq_mask_(0), cqes_(NULL),
+    slots_(depth) {
+  for (unsigned i = depth; i > 0; --i) {
+    slots_[i - 1].bounce = NULL;
+    free_slots_.push_back(i - 1);
+  }
+}
+
+IoRing::~IoRing() {
+  // the kernel may still be filling or reading buffers of the caller
+  if (cqes_ != NULL) {
+    IoCompletion completion;
+    try {
+      while (outstanding() > 0 && complete(completion, true)) {
+      }
+    } catch (const std::system_error&) {
+      // closing the ring cancels what is left
+    }
+  }
+  if (sqes_ != MAP_FAILED) {
+    munmap(sqes_, sqes_bytes_);
+  }
+  if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_bytes_);
+  }
+  if (sq_ring_ != MAP_FAILED) {
+    munmap(sq_ring_, sq_ring_bytes_);
+  }
+  ::close(fd_);
+}
+
+bool IoRing::map(const struct io_uring_params& params) {
+  sq_ring_bytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_bytes_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sq_ring_bytes_ = cq_ring_bytes_ = std::max(sq_ring_bytes_, cq_ring_bytes_);
+  }
+  sq_ring_ = mmap(NULL, sq_ring_bytes_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    return false;
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(NULL, cq_ring_bytes_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      return false;
+    }
+  }
+  sqes_bytes_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqes_ = static_cast<struct io_uring_sqe*>(
+      mmap(NULL, sqes_bytes_, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+  if (sqes_ == MAP_FAILED) {
+    return false;
+  }
+
+  char* sq = static_cast<char*>(sq_ring_);
+  sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  char* cq = static_cast<char*>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+  return true;
+}
+
+unsigned IoRing::takeSlot(const std::uint64_t tag) {
+  const unsigned slot_number = free_slots_.back();
+  free_slots_.pop_back();
+  slots_[slot_number].tag = tag;
+  return slot_number;
+}
+
+void IoRing::push(const std::uint8_t opcode, const int fd, const std::uint64_t offset,
+                  const void* addr, const unsigned length, const unsigned slot_number) {
+  // only we move the tail; the kernel moves the head as it takes entries
+  const unsigned tail = *sq_tail_;
+  const unsigned index = tail & sq_mask_;
+  struct io_uring_sqe* sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->off = offset;
+  sqe->addr = reinterpret_cast<std::uint64_t>(addr);
+  sqe->len = length;
+  sqe->user_data = slot_number;
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  ++unsubmitted_;
+}
+
+void IoRing::queueRead(const int fd, const std::uint64_t offset,
+                       const struct iovec* iov, const int count,
+                       const std::uint64_t tag, const std::size_t align) {
+  const unsigned slot_number = takeSlot(tag);
+  Slot& slot = slots_[slot_number];
+  slot.iov.assign(iov, iov + count);
+  if (align <= 1) {
+    push(IORING_OP_READV, fd, offset, &slot.iov[0], count, slot_number);
+    return;
+  }
+
+  // read whole blocks into a buffer of our own, see finish()
+  std::size_t length = 0;
+  for (int i = 0; i < count; ++i) {
+    length += iov[i].iov_len;
+  }
+  const std::uint64_t start = offset / align * align;
+  const std::uint64_t end = (offset + length + align - 1) / align * align;
+  void* bounce = NULL;
+  if (posix_memalign(&bounce, align, end - start) != 0) {
+    slot.iov.clear();
+    free_slots_.push_back(slot_number);
+    throw std::bad_alloc();
+  }
+  slot.bounce = static_cast<char*>(bounce);
+  slot.skip = offset - start;
+  push(IORING_OP_READ, fd, start, bounce, end - start, slot_number);
+}
+
+void IoRing::queueWrite(const int fd, const std::uint64_t offset,
+                        const struct iovec* iov, const int count,
+                        const std::uint64_t tag) {
+  const unsigned slot_number = takeSlot(tag);
+  Slot& slot = slots_[slot_number];
+  slot.iov.assign(iov, iov + count);
+  push(IORING_OP_WRITEV, fd, offset, &slot.iov[0], count, slot_number);
+}
+
+void IoRing::post(const std::uint64_t tag, const std::int64_t result) {
+  posted_.push_back(std::make_pair(takeSlot(tag), result));
+}
+
+void IoRing::enter(const unsigned min_complete) {
+  while (true) {
+    const int submitted = syscall(__NR_io_uring_enter, fd_, unsubmitted_, min_complete,
+                                  min_complete > 0 ? IORING_ENTER_GETEVENTS : 0,
+                                  NULL, 0);
+    if (submitted >= 0) {
+      unsubmitted_ -= submitted;
+      return;
+    }
+    if (errno == EAGAIN || errno == EBUSY) {
+      // the kernel is short of memory for requests; give it time
+      std::this_thread::yield();
+    } else if (errno != EINTR) {
+      throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+    }
+  }
+}
+
+void IoRing::submit() {
+  if (unsubmitted_ > 0) {
+    enter(0);
+  }
+}
+
+bool IoRing::complete(IoCompletion& completion, const bool wait) {
+  if (!posted_.empty()) {
+    const std::pair<unsigned, std::int64_t> posted = posted_.front();
+    posted_.pop_front();
+    finish(posted.first, posted.second, completion);
+    return true;
+  }
+  submit();
+  while (true) {
+    const unsigned head = *cq_head_;
+    if (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+      const unsigned slot_number = cqe.user_data;
+      const std::int64_t result = cqe.res;
+      __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+      finish(slot_number, result, completion);
+      return true;
+    }
+    if (!wait || outstanding() == 0) {
+      return false;
+    }
+    enter(1);
+  }
+}
+
+void IoRing::finish(const unsigned slot_number, const std::int64_t result,
+                    IoCompletion& completion) {
+  Slot& slot = slots_[slot_number];
+  completion.tag = slot.tag;
+  completion.result = result;
+  if (slot.bounce != NULL) {
+    // hand out the bytes asked for, as far as the file went
+    std::size_t left = result > static_cast<std::int64_t>(slot.skip) ? result - slot.skip : 0;
+    const char* from = slot.bounce + slot.skip;
+    std::size_t copied = 0;
+    for (std::size_t i = 0; i < slot.iov.size() && left > 0; ++i) {
+      const std::size_t n = std::min(left, slot.iov[i].iov_len);
+      std::memcpy(slot.iov[i].iov_base, from + copied, n);
+      copied += n;
+      left -= n;
+    }
+    if (result >= 0) {
+      completion.result = copied;
+    }
+    free(slot.bounce);
+    slot.bounce = NULL;
+  }
+  slot.iov.clear();
+  free_slots_.push_back(slot_number);
+}
+
+}
@@ -0,0 +1,280 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_params;
+
+namespace badgerdb {
+
+/**
+ * @brief Outcome of a request queued on an IoRing.
+ */
+struct IoCompletion {
+  /**
+   * Tag the request was queued with.
+   */
+  std::uint64_t tag;
+
+  /**
+   * Number of bytes transferred, or a negated errno value.
+   */
+  std::int64_t result;
+};
+
+/**
+ * @brief Asynchronous reads and writes through a Linux io_uring, set up with
+ *        raw system calls.
+ *
+ * Requests are queued with queueRead() or queueWrite(), each with a tag of the
+ * caller's choosing, and handed to the kernel together by the next call to
+ * submit() or complete().  complete() then reports them one at a time, in the
+ * order they finish.  At most depth() requests may be outstanding: queued and
+ * not yet reported.
+ *
+ * A ring must be used by one thread at a time.
+ */
+class IoRing {
+ public:
+  /**
+   * Sets up a ring.
+   *
+   * @param depth   Number of requests which may be outstanding at once.
+   * @return  The ring, to be deleted by the caller, or NULL if the kernel
+   *          does not offer io_uring.
+   */
+  static IoRing* create(const unsigned depth);
+
+  /**
+   * Returns true if rings can be set up on this system.
+   */
+  static bool supported();
+
+  /**
+   * Waits for the outstanding requests, then tears the ring down.
+   */
+  ~IoRing();
+
+  IoRing(const IoRing&) = delete;
+  IoRing& operator=(const IoRing&) = delete;
+
+  /**
+   * Returns the number of requests which may be outstanding at once.
+   */
+  unsigned depth() const { return depth_; }
+
+  /**
+   * Returns the number of requests queued and not yet reported by complete().
+   */
+  unsigned outstanding() const { return depth_ - free_slots_.size(); }
+
+  /**
+   * Returns true if no more requests may be queued until one is completed.
+   */
+  bool full() const { return free_slots_.empty(); }
+
+  /**
+   * Queues a read of consecutive bytes of a file into several buffers.
+   *
+   * With an alignment above one, as O_DIRECT needs, the bytes are read into
+   * an aligned buffer covering whole blocks and copied into the buffers once
+   * the read completes.  The result then counts only bytes asked for.
+   *
+   * @param fd      File descriptor to read from.
+   * @param offset  Position in the file of the first byte.
+   * @param iov     Buffers to read into, which must remain valid until the
+   *                request is completed.
+   * @param count   Number of buffers.
+   * @param tag     Reported along with the completion.
+   * @param align   Alignment of file positions, lengths and memory, or 1.
+   */
+  void queueRead(const int fd, const std::uint64_t offset,
+                 const struct iovec* iov, const int count,
+                 const std::uint64_t tag, const std::size_t align = 1);
+
+  /**
+   * Queues a write of several buffers to consecutive bytes of a file.
+   *
+   * @param fd      File descriptor to write to.
+   * @param offset  Position in the file of the first byte.
+   * @param iov     Buffers to write, which must remain unchanged until the
+   *                request is completed.
+   * @param count   Number of buffers.
+   * @param tag     Reported along with the completion.
+   */
+  void queueWrite(const int fd, const std::uint64_t offset,
+                  const struct iovec* iov, const int count,
+                  const std::uint64_t tag);
+
+  /**
+   * Reports a request which was carried out at once instead of through the
+   * kernel, so that the caller handles it like the others.  It counts as
+   * outstanding until completed.
+   *
+   * @param tag     Reported along with the completion.
+   * @param result  Number of bytes transferred, or a negated errno value.
+   */
+  void post(const std::uint64_t tag, const std::int64_t result);
+
+  /**
+   * Hands the queued requests to the kernel.
+   */
+  void submit();
+
+  /**
+   * Submits the queued requests, then reports one which has finished.
+   *
+   * @param completion  Filled in with the request reported.
+   * @param wait        Whether to wait for a request to finish if none has.
+   * @return  False if no request was reported.
+   */
+  bool complete(IoCompletion& completion, const bool wait);
+
+ private:
+  /**
+   * @brief Bookkeeping for one outstanding request.
+   */
+  struct Slot {
+    /**
+     * Tag of the request.
+     */
+    std::uint64_t tag;
+
+    /**
+     * Copy of the buffers of the request, which the kernel may read after it
+     * was queued.
+     */
+    std::vector<struct iovec> iov;
+
+    /**
+     * Aligned buffer the file is read into instead, or NULL.
+     */
+    char* bounce;
+
+    /**
+     * Bytes of bounce before the first byte asked for.
+     */
+    std::size_t skip;
+  };
+
+  IoRing(const int fd, const unsigned depth);
+
+  /**
+   * Maps the rings shared with the kernel.
+   *
+   * @return  False if they could not be mapped.
+   */
+  bool map(const struct io_uring_params& params);
+
+  /**
+   * Takes a free slot for a request.
+   *
+   * @param tag     Tag of the request.
+   * @return  Number of the slot.
+   */
+  unsigned takeSlot(const std::uint64_t tag);
+
+  /**
+   * Adds an entry to the submission ring.
+   *
+   * @param opcode      Operation of the request.
+   * @param fd          File descriptor of the request.
+   * @param offset      Position in the file.
+   * @param addr        Buffer, or array of buffers, of the request.
+   * @param length      Length of the buffer, or number of buffers.
+   * @param slot_number Slot of the request.
+   */
+  void push(const std::uint8_t opcode, const int fd, const std::uint64_t offset,
+            const void* addr, const unsigned length, const unsigned slot_number);
+
+  /**
+   * Calls io_uring_enter(), submitting what is queued and possibly waiting.
+   *
+   * @param min_complete  Number of completions to wait for.
+   */
+  void enter(const unsigned min_complete);
+
+  /**
+   * Hands a finished slot back, filling in the completion of its request.
+   *
+   * @param slot_number Number of the slot.
+   * @param result      Result from the kernel.
+   * @param completion  Filled in with the completion.
+   */
+  void finish(const unsigned slot_number, const std::int64_t result,
+              IoCompletion& completion);
+
+  /**
+   * File descriptor of the ring.
+   */
+  int fd_;
+
+  /**
+   * Number of requests which may be outstanding at once.
+   */
+  unsigned depth_;
+
+  /**
+   * Submission queue entries queued since the last io_uring_enter().
+   */
+  unsigned unsubmitted_;
+
+  /**
+   * Mapping of the submission ring, and its length.
+   */
+  void* sq_ring_;
+  std::size_t sq_ring_bytes_;
+
+  /**
+   * Mapping of the completion ring, and its length.  The same as sq_ring_ if
+   * the kernel maps both at once.
+   */
+  void* cq_ring_;
+  std::size_t cq_ring_bytes_;
+
+  /**
+   * Submission queue entries, and the length of their mapping.
+   */
+  struct io_uring_sqe* sqes_;
+  std::size_t sqes_bytes_;
+
+  /**
+   * Fields of the submission ring.
+   */
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned* sq_array_;
+
+  /**
+   * Fields of the completion ring.
+   */
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  struct io_uring_cqe* cqes_;
+
+  /**
+   * One slot per outstanding request, and the numbers of the free ones.
+   */
+  std::vector<Slot> slots_;
+  std::vector<unsigned> free_slots_;
+
+  /**
+   * Requests given to post() and not yet reported, by slot number.
+   */
+  std::deque<std::pair<unsigned, std::int64_t> > posted_;
+};
+
+}
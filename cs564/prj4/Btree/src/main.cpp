@@ -43,6 +43,8 @@ int testNum = 1;
 const std::string relationName = "relA";
 //If the relation size is changed then the second parameter 2 chechPassFail may need to be changed to number of record that are expected to be found during the scan, else tests will erroneously be reported to have failed.
 const int	relationSize = 5000;
+//Number of index matches whose records intScan fetches from the relation at once
+const std::size_t scanBatchSize = 32;
 std::string intIndexName, doubleIndexName, stringIndexName;
 
 // This is the structure for tuples in the base relation
@@ -216,7 +218,7 @@ void createRelationForward()
 			catch(InsufficientSpaceException e)
 			{
 				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
+  			file1->allocatePage(new_page_number, new_page);
 			}
 		}
   }
@@ -266,7 +268,7 @@ void createRelationBackward()
 			catch(InsufficientSpaceException e)
 			{
 				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
+  			file1->allocatePage(new_page_number, new_page);
 			}
 		}
   }
@@ -326,7 +328,7 @@ void createRelationRandom()
 			catch(InsufficientSpaceException e)
 			{
       	file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
+  			file1->allocatePage(new_page_number, new_page);
 			}
 		}
 
@@ -385,7 +387,9 @@ void intTests()
 int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
 {
   RecordId scanRid;
-	Page *curPage;
+	std::vector<RecordId> scanRids;
+	std::vector<PageId> scanPageIds;
+	std::vector<Page*> scanPages;
 
   std::cout << "Scan for ";
   if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
@@ -405,32 +409,46 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 		return 0;
 	}
 
-	while(1)
+	bool scanCompleted = false;
+	while(!scanCompleted)
 	{
-		try
+		// collect a batch of matches, then read the pages holding them at once
+		scanRids.clear();
+		scanPageIds.clear();
+		while(scanRids.size() < scanBatchSize)
+		{
+			try
+			{
+				index->scanNext(scanRid);
+			}
+			catch(IndexScanCompletedException e)
+			{
+				scanCompleted = true;
+				break;
+			}
+			scanRids.push_back(scanRid);
+			scanPageIds.push_back(scanRid.page_number);
+		}
+
+		bufMgr->readPages(file1, scanPageIds, scanPages);
+		for(std::size_t i = 0; i < scanRids.size(); i++)
 		{
-			index->scanNext(scanRid);
-			bufMgr->readPage(file1, scanRid.page_number, curPage);
-			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(scanPages[i]->getRecord(scanRids[i]).data()));
 			// std::cout << "before unPinPage in intScan" << std::endl;
-			bufMgr->unPinPage(file1, scanRid.page_number, false);
+			bufMgr->unPinPage(file1, scanPageIds[i], false);
 
 			if( numResults < 5 )
 			{
-				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << "at:" << scanRids[i].page_number << "," << scanRids[i].slot_number;
 				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
 			}
 			else if( numResults == 5 )
 			{
 				std::cout << "..." << std::endl;
 			}
-		}
-		catch(IndexScanCompletedException e)
-		{
-			break;
-		}
 
-		numResults++;
+			numResults++;
+		}
 	}
 
   if( numResults >= 5 )
@@ -487,7 +505,7 @@ void errorTests()
 			catch(InsufficientSpaceException e)
 			{
 				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
+  			file1->allocatePage(new_page_number, new_page);
 			}
 		}
   }
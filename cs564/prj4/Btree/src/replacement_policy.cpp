@@ -0,0 +1,825 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "replacement_policy.h"
+
+namespace badgerdb {
+
+ReplacementPolicy* ReplacementPolicy::create(const ReplacementPolicyType type, const std::uint32_t numBufs)
+{
+  switch (type)
+  {
+    case LRU_K:
+      return new LruKPolicy(numBufs);
+    case TWO_Q:
+      return new TwoQPolicy(numBufs);
+    case ARC:
+      return new ArcPolicy(numBufs);
+    case CLOCK_PRO:
+      return new ClockProPolicy(numBufs);
+    case CLOCK:
+    default:
+      return new ClockPolicy(numBufs);
+  }
+}
+
+//----------------------------------------
+// CLOCK
+//----------------------------------------
+
+const std::uint32_t ClockPolicy::WORD_BITS;
+
+/**
+ * Mask of the bits lo to hi - 1 of a word of reference bits
+ */
+static std::uint64_t bitRange(const std::uint32_t lo, const std::uint32_t hi)
+{
+  const std::uint64_t below = hi == ClockPolicy::WORD_BITS ? ~std::uint64_t(0) : (std::uint64_t(1) << hi) - 1;
+  return below & ~((std::uint64_t(1) << lo) - 1);
+}
+
+ClockPolicy::ClockPolicy(const std::uint32_t numBufs)
+  : numBufs(numBufs), refbitsSize((numBufs + WORD_BITS - 1) / WORD_BITS * WORD_BITS)
+{
+  const std::uint32_t words = refbitsSize / WORD_BITS;
+  std::atomic<std::uint64_t>* bits = new std::atomic<std::uint64_t>[words];
+  for (std::uint32_t i = 0; i < words; i++)
+    bits[i] = 0;
+  refbits = bits;
+
+  clockHand = numBufs - 1;
+}
+
+ClockPolicy::~ClockPolicy()
+{
+  delete [] refbits.load();
+  for (std::size_t i = 0; i < oldRefbits.size(); i++)
+    delete [] oldRefbits[i];
+}
+
+void ClockPolicy::pageAccessed(const FrameId frame)
+{
+  std::atomic<std::uint64_t>& word = refbits.load()[frame / WORD_BITS];
+  const std::uint64_t mask = std::uint64_t(1) << (frame % WORD_BITS);
+  // avoid dirtying the cache line of frames that are hit over and over
+  if (!(word.load(std::memory_order_relaxed) & mask))
+    word.fetch_or(mask);
+}
+
+void ClockPolicy::pageLoaded(const FrameId frame, const File* file, const PageId pageNo)
+{
+  refbits.load()[frame / WORD_BITS].fetch_or(std::uint64_t(1) << (frame % WORD_BITS));
+}
+
+void ClockPolicy::pageRemoved(const FrameId frame, const bool evicted)
+{
+  refbits.load()[frame / WORD_BITS].fetch_and(~(std::uint64_t(1) << (frame % WORD_BITS)));
+}
+
+void ClockPolicy::frameFreed(const FrameId frame)
+{
+  refbits.load()[frame / WORD_BITS].fetch_and(~(std::uint64_t(1) << (frame % WORD_BITS)));
+}
+
+bool ClockPolicy::pickVictim(const ClaimFunction& claim, FrameId& frame, std::uint32_t& scanned)
+{
+  // the bits are replaced before the pool grows, so they cover every frame
+  const std::uint32_t count = numBufs;
+  std::atomic<std::uint64_t>* bits = refbits;
+
+  // Each step moves the hand past the referenced frames ahead of it within one
+  // word, up to the first unreferenced one, clearing their bits on the way.
+  // Other threads sweep at the same time; the hand only moves by compare and
+  // swap, so each thread passes over different frames.
+  scanned = 0;
+  while (scanned < 2*count)	//Need to scan twice
+  {
+    FrameId hand = clockHand;
+    const FrameId next = (hand + 1) % count;
+    const std::uint32_t word = next / WORD_BITS;
+    const std::uint32_t lo = next % WORD_BITS;
+    const std::uint32_t hi = std::min(WORD_BITS, count - word * WORD_BITS);
+
+    const std::uint64_t refs = bits[word].load(std::memory_order_relaxed);
+    const std::uint64_t unref = ~refs & bitRange(lo, hi);
+    const std::uint32_t stop = unref ? __builtin_ctzll(unref) : hi - 1;
+    if (!clockHand.compare_exchange_weak(hand, word * WORD_BITS + stop))
+      continue;
+
+    // has been referenced, the bit is now cleared
+    const std::uint64_t passed = refs & bitRange(lo, stop + 1);
+    if (passed)
+      bits[word].fetch_and(~passed);
+    scanned += stop + 1 - lo;
+
+    if (unref && claim(word * WORD_BITS + stop))
+    {
+      frame = word * WORD_BITS + stop;
+      scanned = std::min(scanned, 2*count);
+      return true;
+    }
+  }
+  scanned = 2*count;
+  return false;
+}
+
+void ClockPolicy::nextVictims(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+  const std::uint32_t frameCount = numBufs;
+  std::atomic<std::uint64_t>* bits = refbits;
+  FrameId frameNo = (clockHand + 1) % frameCount;
+  for (std::uint32_t seen = 0; seen < frameCount && frames.size() < count; )
+  {
+    const std::uint32_t word = frameNo / WORD_BITS;
+    const std::uint32_t lo = frameNo % WORD_BITS;
+    const std::uint32_t hi = std::min(std::min(WORD_BITS, frameCount - word * WORD_BITS),
+                                      lo + frameCount - seen);
+    std::uint64_t unref = ~bits[word].load(std::memory_order_relaxed) & bitRange(lo, hi);
+    for (; unref != 0 && frames.size() < count; unref &= unref - 1)
+      frames.push_back(word * WORD_BITS + __builtin_ctzll(unref));
+    seen += hi - lo;
+    frameNo = (word * WORD_BITS + hi) % frameCount;
+  }
+}
+
+void ClockPolicy::resize(const std::uint32_t newBufs)
+{
+  std::atomic<std::uint64_t>* bits = refbits;
+  if (newBufs > refbitsSize)
+  {
+    const std::uint32_t size = (newBufs + WORD_BITS - 1) / WORD_BITS * WORD_BITS;
+    std::atomic<std::uint64_t>* grown = new std::atomic<std::uint64_t>[size / WORD_BITS];
+    for (std::uint32_t i = 0; i < size / WORD_BITS; i++)
+      grown[i] = i < refbitsSize / WORD_BITS ? bits[i].load() : 0;
+    refbits = grown;
+    oldRefbits.push_back(bits);
+    refbitsSize = size;
+    bits = grown;
+  }
+  for (FrameId i = numBufs; i < newBufs; i++)
+    bits[i / WORD_BITS].fetch_and(~(std::uint64_t(1) << (i % WORD_BITS)));
+  numBufs = newBufs;
+}
+
+//----------------------------------------
+// Common part of the latched policies
+//----------------------------------------
+
+LatchedPolicy::LatchedPolicy(const std::uint32_t numBufs)
+  : numBufs(numBufs), states(numBufs, FREE), keys(numBufs), freePos(numBufs)
+{
+  for (FrameId i = 0; i < numBufs; i++)
+  {
+    keys[i].file = NULL;
+    keys[i].pageNo = Page::INVALID_NUMBER;
+    freePos[i] = freeFrames.insert(freeFrames.end(), i);
+  }
+}
+
+void LatchedPolicy::pageAccessed(const FrameId frame)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  // the page may have been dropped while the caller was waiting for its read
+  if (states[frame] == RESIDENT)
+    accessed(frame);
+}
+
+void LatchedPolicy::pageLoaded(const FrameId frame, const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  if (states[frame] == RESIDENT)
+    removed(frame, false);
+  else if (states[frame] == FREE)
+    freeFrames.erase(freePos[frame]);
+
+  keys[frame].file = file;
+  keys[frame].pageNo = pageNo;
+  states[frame] = RESIDENT;
+  loaded(frame);
+}
+
+void LatchedPolicy::pageRemoved(const FrameId frame, const bool evicted)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  if (states[frame] != RESIDENT)
+    return;
+
+  removed(frame, evicted);
+  states[frame] = TAKEN;
+}
+
+void LatchedPolicy::frameFreed(const FrameId frame)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  if (states[frame] == FREE)
+    return;
+
+  if (states[frame] == RESIDENT)
+    removed(frame, false);
+  states[frame] = FREE;
+  freePos[frame] = freeFrames.insert(freeFrames.end(), frame);
+}
+
+void LatchedPolicy::fileDropped(const File* file)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  dropped(file);
+}
+
+bool LatchedPolicy::pickVictim(const ClaimFunction& claimFrame, FrameId& frame, std::uint32_t& scanned)
+{
+  std::lock_guard<std::mutex> lock(latch);
+
+  // every frame offered has been looked at
+  scanned = 0;
+  ClaimFunction claim = [&claimFrame, &scanned](FrameId frameNo) {
+    scanned++;
+    return claimFrame(frameNo);
+  };
+
+  // empty frames go before any page is evicted
+  for (std::list<FrameId>::iterator it = freeFrames.begin(); it != freeFrames.end(); ++it)
+  {
+    if (claim(*it))
+    {
+      frame = *it;
+      states[frame] = TAKEN;
+      freeFrames.erase(it);
+      return true;
+    }
+  }
+
+  return pickResident(claim, frame);
+}
+
+void LatchedPolicy::nextVictims(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  listResident(frames, count);
+}
+
+void LatchedPolicy::resize(const std::uint32_t newBufs)
+{
+  std::lock_guard<std::mutex> lock(latch);
+  for (FrameId i = newBufs; i < numBufs; i++)
+  {
+    if (states[i] == RESIDENT)
+      removed(i, false);
+    else if (states[i] == FREE)
+      freeFrames.erase(freePos[i]);
+  }
+
+  states.resize(newBufs, FREE);
+  keys.resize(newBufs);
+  freePos.resize(newBufs);
+  for (FrameId i = numBufs; i < newBufs; i++)
+  {
+    keys[i].file = NULL;
+    keys[i].pageNo = Page::INVALID_NUMBER;
+    freePos[i] = freeFrames.insert(freeFrames.end(), i);
+  }
+  numBufs = newBufs;
+  resized();
+}
+
+template <typename Map>
+void LatchedPolicy::dropPages(std::list<PageKey>& pages, Map& index, const File* file)
+{
+  for (std::list<PageKey>::iterator it = pages.begin(); it != pages.end(); )
+  {
+    if (it->file == file)
+    {
+      index.erase(*it);
+      it = pages.erase(it);
+    }
+    else
+      ++it;
+  }
+}
+
+bool LatchedPolicy::claimOldest(const std::list<FrameId>& queue, const ClaimFunction& claim, FrameId& frame)
+{
+  for (std::list<FrameId>::const_reverse_iterator it = queue.rbegin(); it != queue.rend(); ++it)
+  {
+    if (claim(*it))
+    {
+      frame = *it;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LatchedPolicy::listOldest(const std::list<FrameId>& queue, std::vector<FrameId>& frames, const std::uint32_t count)
+{
+  for (std::list<FrameId>::const_reverse_iterator it = queue.rbegin(); it != queue.rend() && frames.size() < count; ++it)
+    frames.push_back(*it);
+}
+
+//----------------------------------------
+// LRU-K
+//----------------------------------------
+
+LruKPolicy::LruKPolicy(const std::uint32_t numBufs)
+  : LatchedPolicy(numBufs), now(0), history(numBufs)
+{
+}
+
+void LruKPolicy::reference(const FrameId frame, const bool inOrder)
+{
+  History& h = history[frame];
+  if (inOrder)
+    order.erase(std::make_pair(std::make_pair(h.times[K - 1], h.times[0]), frame));
+
+  for (int i = K - 1; i > 0; i--)
+    h.times[i] = h.times[i - 1];
+  h.times[0] = ++now;
+
+  order.insert(std::make_pair(std::make_pair(h.times[K - 1], h.times[0]), frame));
+}
+
+void LruKPolicy::accessed(const FrameId frame)
+{
+  reference(frame, true);
+}
+
+void LruKPolicy::loaded(const FrameId frame)
+{
+  std::unordered_map<PageKey, Retained, PageKeyHash>::iterator it = retained.find(keys[frame]);
+  if (it != retained.end())
+  {
+    // the page was here before, continue its history
+    history[frame] = it->second.history;
+    retainedOrder.erase(it->second.pos);
+    retained.erase(it);
+  }
+  else
+  {
+    for (int i = 0; i < K; i++)
+      history[frame].times[i] = 0;
+  }
+
+  reference(frame, false);
+}
+
+void LruKPolicy::removed(const FrameId frame, const bool evicted)
+{
+  const History& h = history[frame];
+  order.erase(std::make_pair(std::make_pair(h.times[K - 1], h.times[0]), frame));
+
+  if (!evicted)
+    return;
+
+  Retained& r = retained[keys[frame]];
+  r.history = h;
+  r.pos = retainedOrder.insert(retainedOrder.begin(), keys[frame]);
+
+  if (retainedOrder.size() > numBufs)
+  {
+    retained.erase(retainedOrder.back());
+    retainedOrder.pop_back();
+  }
+}
+
+void LruKPolicy::dropped(const File* file)
+{
+  dropPages(retainedOrder, retained, file);
+}
+
+void LruKPolicy::resized()
+{
+  history.resize(numBufs);
+  while (retainedOrder.size() > numBufs)
+  {
+    retained.erase(retainedOrder.back());
+    retainedOrder.pop_back();
+  }
+}
+
+bool LruKPolicy::pickResident(const ClaimFunction& claim, FrameId& frame)
+{
+  // pages with fewer than K references have a K-th reference time of 0 and
+  // sort first, by their last reference
+  for (Order::iterator it = order.begin(); it != order.end(); ++it)
+  {
+    if (claim(it->second))
+    {
+      frame = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LruKPolicy::listResident(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+  for (Order::iterator it = order.begin(); it != order.end() && frames.size() < count; ++it)
+    frames.push_back(it->second);
+}
+
+//----------------------------------------
+// 2Q
+//----------------------------------------
+
+TwoQPolicy::TwoQPolicy(const std::uint32_t numBufs)
+  : LatchedPolicy(numBufs), inAm(numBufs, false), pos(numBufs)
+{
+  // sizes recommended by Johnson and Shasha
+  kin = std::max<std::uint32_t>(numBufs / 4, 1);
+  kout = std::max<std::uint32_t>(numBufs / 2, 1);
+}
+
+void TwoQPolicy::accessed(const FrameId frame)
+{
+  // A1in is a FIFO, only Am is kept in LRU order
+  if (inAm[frame])
+    am.splice(am.begin(), am, pos[frame]);
+}
+
+void TwoQPolicy::loaded(const FrameId frame)
+{
+  std::unordered_map<PageKey, std::list<PageKey>::iterator, PageKeyHash>::iterator it = a1outPos.find(keys[frame]);
+  if (it != a1outPos.end())
+  {
+    // referenced again after leaving A1in, so it is a hot page
+    a1out.erase(it->second);
+    a1outPos.erase(it);
+    inAm[frame] = true;
+    pos[frame] = am.insert(am.begin(), frame);
+  }
+  else
+  {
+    inAm[frame] = false;
+    pos[frame] = a1in.insert(a1in.begin(), frame);
+  }
+}
+
+void TwoQPolicy::removed(const FrameId frame, const bool evicted)
+{
+  if (inAm[frame])
+  {
+    am.erase(pos[frame]);
+    return;
+  }
+
+  a1in.erase(pos[frame]);
+  if (!evicted)
+    return;
+
+  a1outPos[keys[frame]] = a1out.insert(a1out.begin(), keys[frame]);
+  if (a1out.size() > kout)
+  {
+    a1outPos.erase(a1out.back());
+    a1out.pop_back();
+  }
+}
+
+void TwoQPolicy::dropped(const File* file)
+{
+  dropPages(a1out, a1outPos, file);
+}
+
+void TwoQPolicy::resized()
+{
+  inAm.resize(numBufs, false);
+  pos.resize(numBufs);
+  kin = std::max<std::uint32_t>(numBufs / 4, 1);
+  kout = std::max<std::uint32_t>(numBufs / 2, 1);
+  while (a1out.size() > kout)
+  {
+    a1outPos.erase(a1out.back());
+    a1out.pop_back();
+  }
+}
+
+void TwoQPolicy::evictionOrder(std::list<FrameId>*& first, std::list<FrameId>*& second)
+{
+  first = &am;
+  second = &a1in;
+  if (a1in.size() > kin || am.empty())
+    std::swap(first, second);
+}
+
+bool TwoQPolicy::pickResident(const ClaimFunction& claim, FrameId& frame)
+{
+  std::list<FrameId>* first;
+  std::list<FrameId>* second;
+  evictionOrder(first, second);
+  return claimOldest(*first, claim, frame) || claimOldest(*second, claim, frame);
+}
+
+void TwoQPolicy::listResident(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+  std::list<FrameId>* first;
+  std::list<FrameId>* second;
+  evictionOrder(first, second);
+  listOldest(*first, frames, count);
+  listOldest(*second, frames, count);
+}
+
+//----------------------------------------
+// ARC
+//----------------------------------------
+
+ArcPolicy::ArcPolicy(const std::uint32_t numBufs)
+  : LatchedPolicy(numBufs), p(0), inT2(numBufs, false), pos(numBufs)
+{
+}
+
+void ArcPolicy::trimGhosts()
+{
+  while (t1.size() + b1.size() > numBufs && !b1.empty())
+  {
+    b1Pos.erase(b1.back());
+    b1.pop_back();
+  }
+  while (t1.size() + t2.size() + b1.size() + b2.size() > 2*numBufs)
+  {
+    GhostList& victims = b2.empty() ? b1 : b2;
+    GhostMap& victimPos = b2.empty() ? b1Pos : b2Pos;
+    victimPos.erase(victims.back());
+    victims.pop_back();
+  }
+}
+
+void ArcPolicy::accessed(const FrameId frame)
+{
+  if (inT2[frame])
+  {
+    t2.splice(t2.begin(), t2, pos[frame]);
+  }
+  else
+  {
+    t2.splice(t2.begin(), t1, pos[frame]);
+    inT2[frame] = true;
+  }
+}
+
+void ArcPolicy::loaded(const FrameId frame)
+{
+  GhostMap::iterator it;
+  if ((it = b1Pos.find(keys[frame])) != b1Pos.end())
+  {
+    // recency list was too small, grow its target
+    std::uint32_t delta = std::max<std::uint32_t>(b2.size() / b1.size(), 1);
+    p = std::min(p + delta, numBufs);
+    b1.erase(it->second);
+    b1Pos.erase(it);
+    inT2[frame] = true;
+    pos[frame] = t2.insert(t2.begin(), frame);
+  }
+  else if ((it = b2Pos.find(keys[frame])) != b2Pos.end())
+  {
+    // frequency list was too small, shrink the recency target
+    std::uint32_t delta = std::max<std::uint32_t>(b1.size() / b2.size(), 1);
+    p = p > delta ? p - delta : 0;
+    b2.erase(it->second);
+    b2Pos.erase(it);
+    inT2[frame] = true;
+    pos[frame] = t2.insert(t2.begin(), frame);
+  }
+  else
+  {
+    inT2[frame] = false;
+    pos[frame] = t1.insert(t1.begin(), frame);
+  }
+  trimGhosts();
+}
+
+void ArcPolicy::removed(const FrameId frame, const bool evicted)
+{
+  if (inT2[frame])
+  {
+    t2.erase(pos[frame]);
+    if (evicted)
+      b2Pos[keys[frame]] = b2.insert(b2.begin(), keys[frame]);
+  }
+  else
+  {
+    t1.erase(pos[frame]);
+    if (evicted)
+      b1Pos[keys[frame]] = b1.insert(b1.begin(), keys[frame]);
+  }
+  trimGhosts();
+}
+
+void ArcPolicy::dropped(const File* file)
+{
+  dropPages(b1, b1Pos, file);
+  dropPages(b2, b2Pos, file);
+}
+
+void ArcPolicy::resized()
+{
+  inT2.resize(numBufs, false);
+  pos.resize(numBufs);
+  p = std::min(p, numBufs);
+  trimGhosts();
+}
+
+void ArcPolicy::evictionOrder(std::list<FrameId>*& first, std::list<FrameId>*& second)
+{
+  // REPLACE() of ARC; the incoming page is not known yet, so a page coming
+  // back from B2 does not get the tie break towards T1
+  first = &t2;
+  second = &t1;
+  if (!t1.empty() && (t1.size() > p || t2.empty()))
+    std::swap(first, second);
+}
+
+bool ArcPolicy::pickResident(const ClaimFunction& claim, FrameId& frame)
+{
+  std::list<FrameId>* first;
+  std::list<FrameId>* second;
+  evictionOrder(first, second);
+  return claimOldest(*first, claim, frame) || claimOldest(*second, claim, frame);
+}
+
+void ArcPolicy::listResident(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+  std::list<FrameId>* first;
+  std::list<FrameId>* second;
+  evictionOrder(first, second);
+  listOldest(*first, frames, count);
+  listOldest(*second, frames, count);
+}
+
+//----------------------------------------
+// CLOCK-Pro
+//----------------------------------------
+
+ClockProPolicy::ClockProPolicy(const std::uint32_t numBufs)
+  : LatchedPolicy(numBufs), hotCount(0), coldHand(0), hotHand(0),
+    hot(numBufs, false), ref(numBufs, false), inTest(numBufs, false)
+{
+  coldTarget = std::max<std::uint32_t>(numBufs / 4, 1);
+}
+
+void ClockProPolicy::remember(const PageKey& key)
+{
+  testPos[key] = tests.insert(tests.begin(), key);
+  if (tests.size() > numBufs)
+  {
+    // the oldest test period ran out without the page coming back
+    testPos.erase(tests.back());
+    tests.pop_back();
+    if (coldTarget > 1)
+      coldTarget--;
+  }
+}
+
+void ClockProPolicy::runHotHand()
+{
+  std::uint32_t maxHot = numBufs > coldTarget ? numBufs - coldTarget : 0;
+
+  for (std::uint32_t numScanned = 0; hotCount > maxHot && numScanned < 2*numBufs; numScanned++)
+  {
+    FrameId frame = hotHand;
+    hotHand = (hotHand + 1) % numBufs;
+    if (states[frame] != RESIDENT)
+      continue;
+
+    if (hot[frame])
+    {
+      if (ref[frame])
+      {
+        ref[frame] = false;
+      }
+      else
+      {
+        hot[frame] = false;
+        hotCount--;
+      }
+    }
+    else if (!ref[frame])
+    {
+      // the hot hand ends the test period of cold pages it passes
+      inTest[frame] = false;
+    }
+  }
+}
+
+void ClockProPolicy::accessed(const FrameId frame)
+{
+  ref[frame] = true;
+}
+
+void ClockProPolicy::loaded(const FrameId frame)
+{
+  ref[frame] = false;
+
+  std::unordered_map<PageKey, std::list<PageKey>::iterator, PageKeyHash>::iterator it = testPos.find(keys[frame]);
+  if (it != testPos.end())
+  {
+    // came back within its test period, there should be more room for cold pages
+    tests.erase(it->second);
+    testPos.erase(it);
+    if (coldTarget < numBufs - 1)
+      coldTarget++;
+
+    hot[frame] = true;
+    inTest[frame] = false;
+    hotCount++;
+    runHotHand();
+  }
+  else
+  {
+    hot[frame] = false;
+    inTest[frame] = true;
+  }
+}
+
+void ClockProPolicy::removed(const FrameId frame, const bool evicted)
+{
+  if (hot[frame])
+    hotCount--;
+  else if (evicted && inTest[frame])
+    remember(keys[frame]);
+
+  hot[frame] = ref[frame] = inTest[frame] = false;
+}
+
+void ClockProPolicy::dropped(const File* file)
+{
+  dropPages(tests, testPos, file);
+}
+
+void ClockProPolicy::resized()
+{
+  hot.resize(numBufs, false);
+  ref.resize(numBufs, false);
+  inTest.resize(numBufs, false);
+  coldTarget = std::max<std::uint32_t>(std::min(coldTarget, numBufs - 1), 1);
+  coldHand %= numBufs;
+  hotHand %= numBufs;
+  while (tests.size() > numBufs)
+  {
+    testPos.erase(tests.back());
+    tests.pop_back();
+  }
+}
+
+bool ClockProPolicy::pickResident(const ClaimFunction& claim, FrameId& frame)
+{
+  // the cold hand only looks at cold pages
+  for (std::uint32_t numScanned = 0; numScanned < 2*numBufs; numScanned++)
+  {
+    FrameId frameNo = coldHand;
+    coldHand = (coldHand + 1) % numBufs;
+    if (states[frameNo] != RESIDENT || hot[frameNo])
+      continue;
+
+    if (ref[frameNo])
+    {
+      ref[frameNo] = false;
+      if (inTest[frameNo])
+      {
+        // reused within its test period
+        hot[frameNo] = true;
+        inTest[frameNo] = false;
+        hotCount++;
+        runHotHand();
+      }
+      else
+      {
+        inTest[frameNo] = true;
+      }
+      continue;
+    }
+
+    if (claim(frameNo))
+    {
+      frame = frameNo;
+      return true;
+    }
+  }
+
+  // every cold page is pinned, fall back to any unpinned page
+  for (FrameId frameNo = 0; frameNo < numBufs; frameNo++)
+  {
+    if (states[frameNo] == RESIDENT && claim(frameNo))
+    {
+      frame = frameNo;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClockProPolicy::listResident(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+  // cold pages the cold hand would evict on its next pass
+  for (std::uint32_t i = 0; i < numBufs && frames.size() < count; i++)
+  {
+    FrameId frameNo = (coldHand + i) % numBufs;
+    if (states[frameNo] == RESIDENT && !hot[frameNo] && !ref[frameNo])
+      frames.push_back(frameNo);
+  }
+}
+
+}
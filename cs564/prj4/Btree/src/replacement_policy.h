@@ -0,0 +1,613 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "file.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Page replacement algorithms the buffer manager can be constructed with.
+ */
+enum ReplacementPolicyType
+{
+	CLOCK = 0,			/* single reference bit clock */
+	LRU_K = 1,			/* LRU-2, evicts the page with the oldest second to last reference */
+	TWO_Q = 2,			/* full 2Q with A1in, A1out and Am queues */
+	ARC = 3,				/* adaptive replacement cache */
+	CLOCK_PRO = 4		/* CLOCK-Pro with hot and cold hands */
+};
+
+/**
+ * @brief Identifies a page of a file, used by policies which remember pages after their eviction.
+ */
+struct PageKey {
+  /**
+   * File the page belongs to
+   */
+  const File* file;
+
+  /**
+   * Page number within the file
+   */
+  PageId pageNo;
+
+  bool operator==(const PageKey& rhs) const {
+    return file == rhs.file && pageNo == rhs.pageNo;
+  }
+};
+
+/**
+ * @brief Hash functor for PageKey.
+ */
+struct PageKeyHash {
+  std::size_t operator()(const PageKey& key) const {
+    std::uint64_t h = reinterpret_cast<std::uintptr_t>(key.file) ^ key.pageNo;
+    h *= 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 32);
+  }
+};
+
+/**
+ * @brief Interface through which BufMgr asks which frame to evict.
+ *
+ * Every frame is, from the policy's point of view, either free (holds no
+ * page), taken (handed out by pickVictim() or stripped of its page, and now
+ * owned by one thread) or resident (holds a page).  The buffer manager reports
+ * every transition.  Per frame state is kept in arrays indexed by FrameId,
+ * side by side with the BufDesc table.
+ *
+ * A policy never pins frames itself.  pickVictim() offers candidates in order
+ * of preference to a claim function supplied by the buffer manager, which
+ * atomically takes the first pin on the frame if it is unpinned.  The claim
+ * function must not block, since policies may call it with their latch held.
+ *
+ * The number of frames can change while the pool is in use, see resize().
+ */
+class ReplacementPolicy {
+ public:
+  /**
+   * Called with a candidate frame, returns true if the frame was claimed.
+   */
+  typedef std::function<bool(FrameId)> ClaimFunction;
+
+  /**
+   * Creates a policy of the given type for a pool of numBufs frames.
+   *
+   * @param type      Replacement algorithm
+   * @param numBufs   Number of frames in the buffer pool
+   * @return  Newly allocated policy, owned by the caller.
+   */
+  static ReplacementPolicy* create(const ReplacementPolicyType type, const std::uint32_t numBufs);
+
+  virtual ~ReplacementPolicy() {}
+
+  /**
+   * Called on every buffer hit of the page held in frame.
+   */
+  virtual void pageAccessed(const FrameId frame) = 0;
+
+  /**
+   * Called once a taken frame has been assigned the page (file, pageNo).
+   */
+  virtual void pageLoaded(const FrameId frame, const File* file, const PageId pageNo) = 0;
+
+  /**
+   * Called when the page in a resident frame leaves the pool.  The frame stays
+   * taken by the caller.
+   *
+   * @param frame     Frame number
+   * @param evicted   True if the page was chosen for replacement, false if it
+   *                  was flushed, disposed or failed to load
+   */
+  virtual void pageRemoved(const FrameId frame, const bool evicted) = 0;
+
+  /**
+   * Called when a taken frame is given back without a page in it.
+   */
+  virtual void frameFreed(const FrameId frame) = 0;
+
+  /**
+   * Called once the pages of a file have all left the pool, before the File
+   * object may go away.  Forgets the evicted pages of the file, which a File
+   * created later at the same address would otherwise be taken for.
+   */
+  virtual void fileDropped(const File* file) = 0;
+
+  /**
+   * Offers frames to claim in order of preference until one is claimed.
+   * Free frames which are claimed become taken; resident frames stay resident
+   * until the caller reports pageRemoved(), since the eviction may still be
+   * abandoned if the page gets pinned again.
+   *
+   * @param claim     Function which tries to claim a frame
+   * @param frame     Claimed frame is returned via this variable
+   * @param scanned   Number of frames looked at is returned via this variable
+   * @return  False if no frame could be claimed
+   */
+  virtual bool pickVictim(const ClaimFunction& claim, FrameId& frame, std::uint32_t& scanned) = 0;
+
+  /**
+   * Lists resident frames the policy would evict next, best candidate first,
+   * without changing any of its state.  Used to clean pages ahead of eviction.
+   *
+   * @param frames    Candidates are appended to this vector
+   * @param count     Maximum number of candidates
+   */
+  virtual void nextVictims(std::vector<FrameId>& frames, const std::uint32_t count) = 0;
+
+  /**
+   * Changes the number of frames.  Frames added are free.  Frames removed
+   * must hold no page and be taken by the caller, who keeps them from being
+   * claimed until they are added again.  Calls to resize() must not overlap.
+   *
+   * @param numBufs   New number of frames in the buffer pool
+   */
+  virtual void resize(const std::uint32_t numBufs) = 0;
+
+  /**
+   * Returns a short name of the algorithm.
+   */
+  virtual const char* name() const = 0;
+};
+
+/**
+ * @brief The classic single reference bit clock.
+ *
+ * Reference bits are atomic and packed 64 to a word, and the hand is advanced
+ * with a compare and swap, so neither hits nor sweeps take a latch.  A sweep
+ * moves past a whole run of referenced frames in one step, see pickVictim().
+ * Growing the pool replaces the array of reference bits; arrays replaced are
+ * kept until the policy is destroyed, since sweeps running meanwhile may still
+ * use them.
+ */
+class ClockPolicy : public ReplacementPolicy {
+ public:
+  /**
+   * Number of reference bits per word
+   */
+  static const std::uint32_t WORD_BITS = 64;
+
+  ClockPolicy(const std::uint32_t numBufs);
+  ~ClockPolicy();
+
+  void pageAccessed(const FrameId frame);
+  void pageLoaded(const FrameId frame, const File* file, const PageId pageNo);
+  void pageRemoved(const FrameId frame, const bool evicted);
+  void frameFreed(const FrameId frame);
+  void fileDropped(const File* file) {}
+  bool pickVictim(const ClaimFunction& claim, FrameId& frame, std::uint32_t& scanned);
+  void nextVictims(std::vector<FrameId>& frames, const std::uint32_t count);
+  void resize(const std::uint32_t numBufs);
+  const char* name() const { return "CLOCK"; }
+
+ private:
+  /**
+   * Number of frames in the buffer pool
+   */
+  std::atomic<std::uint32_t> numBufs;
+
+  /**
+   * Current position of clockhand in our buffer pool
+   */
+  std::atomic<FrameId> clockHand;
+
+  /**
+   * Has this buffer frame been reference recently, one bit per frame: frame i
+   * is bit i % WORD_BITS of word i / WORD_BITS
+   */
+  std::atomic<std::atomic<std::uint64_t>*> refbits;
+
+  /**
+   * Number of frames refbits has bits for, a multiple of WORD_BITS at least
+   * numBufs
+   */
+  std::uint32_t refbitsSize;
+
+  /**
+   * Arrays of reference bits replaced by growing the pool
+   */
+  std::vector<std::atomic<std::uint64_t>*> oldRefbits;
+};
+
+/**
+ * @brief Base class for the policies which keep their state under a latch.
+ *
+ * Keeps track of the state of every frame and of a list of free frames, which
+ * are always handed out before any page is evicted.
+ */
+class LatchedPolicy : public ReplacementPolicy {
+ public:
+  LatchedPolicy(const std::uint32_t numBufs);
+
+  void pageAccessed(const FrameId frame);
+  void pageLoaded(const FrameId frame, const File* file, const PageId pageNo);
+  void pageRemoved(const FrameId frame, const bool evicted);
+  void frameFreed(const FrameId frame);
+  void fileDropped(const File* file);
+  bool pickVictim(const ClaimFunction& claim, FrameId& frame, std::uint32_t& scanned);
+  void nextVictims(std::vector<FrameId>& frames, const std::uint32_t count);
+  void resize(const std::uint32_t numBufs);
+
+ protected:
+  /**
+   * State of a frame as seen by the policy
+   */
+  enum FrameState { FREE, TAKEN, RESIDENT };
+
+  /**
+   * Policy specific part of pageAccessed(), called with the latch held
+   */
+  virtual void accessed(const FrameId frame) = 0;
+
+  /**
+   * Policy specific part of pageLoaded(), called with the latch held
+   */
+  virtual void loaded(const FrameId frame) = 0;
+
+  /**
+   * Policy specific part of pageRemoved(), called with the latch held
+   */
+  virtual void removed(const FrameId frame, const bool evicted) = 0;
+
+  /**
+   * Policy specific part of fileDropped(), called with the latch held
+   */
+  virtual void dropped(const File* file) = 0;
+
+  /**
+   * Policy specific part of pickVictim() for resident frames, called with the latch held
+   */
+  virtual bool pickResident(const ClaimFunction& claim, FrameId& frame) = 0;
+
+  /**
+   * Policy specific part of nextVictims(), called with the latch held
+   */
+  virtual void listResident(std::vector<FrameId>& frames, const std::uint32_t count) = 0;
+
+  /**
+   * Policy specific part of resize(), called with the latch held once numBufs
+   * and the common per frame state have changed
+   */
+  virtual void resized() = 0;
+
+  /**
+   * Removes the pages of a file from a list of evicted pages and from the map
+   * which indexes it
+   */
+  template <typename Map>
+  static void dropPages(std::list<PageKey>& pages, Map& index, const File* file);
+
+  /**
+   * Offers the frames of a queue to claim, least recently used (back) first
+   */
+  static bool claimOldest(const std::list<FrameId>& queue, const ClaimFunction& claim, FrameId& frame);
+
+  /**
+   * Appends frames of a queue to frames, least recently used (back) first,
+   * until it holds count entries
+   */
+  static void listOldest(const std::list<FrameId>& queue, std::vector<FrameId>& frames, const std::uint32_t count);
+
+  /**
+   * Number of frames in the buffer pool
+   */
+  std::uint32_t numBufs;
+
+  /**
+   * Latch guarding all policy state
+   */
+  std::mutex latch;
+
+  /**
+   * State of every frame
+   */
+  std::vector<FrameState> states;
+
+  /**
+   * Page held by every resident frame
+   */
+  std::vector<PageKey> keys;
+
+  /**
+   * Frames in state FREE
+   */
+  std::list<FrameId> freeFrames;
+
+  /**
+   * Position of every free frame in freeFrames
+   */
+  std::vector<std::list<FrameId>::iterator> freePos;
+};
+
+/**
+ * @brief LRU-K with K = 2.
+ *
+ * Evicts the page whose second most recent reference lies furthest back;
+ * pages referenced only once go first, oldest first.  Reference history of
+ * evicted pages is kept for as many pages as there are frames, so a page
+ * coming back is not treated as new.
+ */
+class LruKPolicy : public LatchedPolicy {
+ public:
+  LruKPolicy(const std::uint32_t numBufs);
+  const char* name() const { return "LRU-K"; }
+
+  /**
+   * Number of references remembered per page
+   */
+  static const int K = 2;
+
+ protected:
+  void accessed(const FrameId frame);
+  void loaded(const FrameId frame);
+  void removed(const FrameId frame, const bool evicted);
+  void dropped(const File* file);
+  bool pickResident(const ClaimFunction& claim, FrameId& frame);
+  void listResident(std::vector<FrameId>& frames, const std::uint32_t count);
+  void resized();
+
+ private:
+  /**
+   * Reference times of a page, most recent first, 0 if unknown
+   */
+  struct History {
+    std::uint64_t times[K];
+  };
+
+  /**
+   * Eviction order, key is (K-th most recent reference, most recent reference)
+   */
+  typedef std::set<std::pair<std::pair<std::uint64_t, std::uint64_t>, FrameId> > Order;
+
+  /**
+   * Removes frame from order, records a reference and reinserts it
+   */
+  void reference(const FrameId frame, const bool inOrder);
+
+  /**
+   * Logical clock, advanced on every reference
+   */
+  std::uint64_t now;
+
+  /**
+   * Reference history of every resident frame
+   */
+  std::vector<History> history;
+
+  /**
+   * Resident frames in eviction order
+   */
+  Order order;
+
+  /**
+   * History of an evicted page and its position in retainedOrder
+   */
+  struct Retained {
+    History history;
+    std::list<PageKey>::iterator pos;
+  };
+
+  /**
+   * History of evicted pages
+   */
+  std::unordered_map<PageKey, Retained, PageKeyHash> retained;
+
+  /**
+   * Evicted pages, most recently evicted at the front, to bound retained
+   */
+  std::list<PageKey> retainedOrder;
+};
+
+/**
+ * @brief Full 2Q.
+ *
+ * Pages seen for the first time enter the FIFO queue A1in.  Pages evicted from
+ * A1in are remembered in A1out; if they come back they enter the LRU queue Am,
+ * which is where pages referenced repeatedly over a longer period live.  A scan
+ * therefore only cycles through A1in.
+ */
+class TwoQPolicy : public LatchedPolicy {
+ public:
+  TwoQPolicy(const std::uint32_t numBufs);
+  const char* name() const { return "2Q"; }
+
+ protected:
+  void accessed(const FrameId frame);
+  void loaded(const FrameId frame);
+  void removed(const FrameId frame, const bool evicted);
+  void dropped(const File* file);
+  bool pickResident(const ClaimFunction& claim, FrameId& frame);
+  void listResident(std::vector<FrameId>& frames, const std::uint32_t count);
+  void resized();
+
+ private:
+  /**
+   * Returns the queue to evict from and the one to fall back to
+   */
+  void evictionOrder(std::list<FrameId>*& first, std::list<FrameId>*& second);
+
+  /**
+   * Target size of A1in
+   */
+  std::uint32_t kin;
+
+  /**
+   * Maximum size of A1out
+   */
+  std::uint32_t kout;
+
+  /**
+   * Resident queues, most recent at the front
+   */
+  std::list<FrameId> a1in, am;
+
+  /**
+   * True if the frame is in Am, false if in A1in
+   */
+  std::vector<bool> inAm;
+
+  /**
+   * Position of every resident frame in its queue
+   */
+  std::vector<std::list<FrameId>::iterator> pos;
+
+  /**
+   * Ghost queue of pages evicted from A1in, most recent at the front
+   */
+  std::list<PageKey> a1out;
+
+  /**
+   * Position of every page in a1out
+   */
+  std::unordered_map<PageKey, std::list<PageKey>::iterator, PageKeyHash> a1outPos;
+};
+
+/**
+ * @brief Adaptive replacement cache (Megiddo and Modha).
+ *
+ * T1 holds pages seen once recently and T2 pages seen at least twice; B1 and
+ * B2 remember pages evicted from each.  A hit in B1 grows the target size p of
+ * T1, a hit in B2 shrinks it.
+ */
+class ArcPolicy : public LatchedPolicy {
+ public:
+  ArcPolicy(const std::uint32_t numBufs);
+  const char* name() const { return "ARC"; }
+
+ protected:
+  void accessed(const FrameId frame);
+  void loaded(const FrameId frame);
+  void removed(const FrameId frame, const bool evicted);
+  void dropped(const File* file);
+  bool pickResident(const ClaimFunction& claim, FrameId& frame);
+  void listResident(std::vector<FrameId>& frames, const std::uint32_t count);
+  void resized();
+
+ private:
+  typedef std::list<PageKey> GhostList;
+  typedef std::unordered_map<PageKey, GhostList::iterator, PageKeyHash> GhostMap;
+
+  /**
+   * Returns the list to evict from and the one to fall back to
+   */
+  void evictionOrder(std::list<FrameId>*& first, std::list<FrameId>*& second);
+
+  /**
+   * Drops ghost entries until the lists are within the bounds of ARC
+   */
+  void trimGhosts();
+
+  /**
+   * Target size of T1
+   */
+  std::uint32_t p;
+
+  /**
+   * Resident lists, most recent at the front
+   */
+  std::list<FrameId> t1, t2;
+
+  /**
+   * True if the frame is in T2, false if in T1
+   */
+  std::vector<bool> inT2;
+
+  /**
+   * Position of every resident frame in its list
+   */
+  std::vector<std::list<FrameId>::iterator> pos;
+
+  /**
+   * Ghost lists, most recent at the front
+   */
+  GhostList b1, b2;
+
+  /**
+   * Position of every page in b1 and b2
+   */
+  GhostMap b1Pos, b2Pos;
+};
+
+/**
+ * @brief CLOCK-Pro (Jiang, Chen and Zhang).
+ *
+ * Resident pages are hot or cold.  A newly loaded cold page gets a test
+ * period; if it is referenced again during the test period it becomes hot.
+ * Cold pages evicted during their test period are remembered, and a page which
+ * comes back while remembered is loaded hot.  The cold hand evicts cold pages,
+ * the hot hand demotes hot pages whose reference bit is clear, and the target
+ * number of cold pages adapts to how often remembered pages come back.
+ */
+class ClockProPolicy : public LatchedPolicy {
+ public:
+  ClockProPolicy(const std::uint32_t numBufs);
+  const char* name() const { return "CLOCK-Pro"; }
+
+ protected:
+  void accessed(const FrameId frame);
+  void loaded(const FrameId frame);
+  void removed(const FrameId frame, const bool evicted);
+  void dropped(const File* file);
+  bool pickResident(const ClaimFunction& claim, FrameId& frame);
+  void listResident(std::vector<FrameId>& frames, const std::uint32_t count);
+  void resized();
+
+ private:
+  /**
+   * Demotes hot pages until there are no more than allowed
+   */
+  void runHotHand();
+
+  /**
+   * Remembers a cold page evicted during its test period
+   */
+  void remember(const PageKey& key);
+
+  /**
+   * Target number of resident cold pages
+   */
+  std::uint32_t coldTarget;
+
+  /**
+   * Number of resident hot pages
+   */
+  std::uint32_t hotCount;
+
+  /**
+   * Positions of the two hands
+   */
+  FrameId coldHand, hotHand;
+
+  /**
+   * Per frame flags
+   */
+  std::vector<bool> hot, ref, inTest;
+
+  /**
+   * Non-resident cold pages still in their test period, oldest at the back
+   */
+  std::list<PageKey> tests;
+
+  /**
+   * Position of every page in tests
+   */
+  std::unordered_map<PageKey, std::list<PageKey>::iterator, PageKeyHash> testPos;
+};
+
+}
@@ -0,0 +1,132 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks the background writer: once more pages are dirty than its high
+ * watermark it writes them out by itself, and flushFile() keeps working on
+ * the same pages while it does, leaving every update on disk.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "test_util.h"
+#include "buffer.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+static const std::uint32_t NUM_FRAMES = 64;
+static const std::uint32_t LOW_WATERMARK = 8;
+static const std::uint32_t HIGH_WATERMARK = 16;
+static const int NUM_PAGES = 48;
+static const int ROUNDS = 200;
+
+static std::string makeRecord(const PageId pageNo, const std::uint32_t count)
+{
+  std::string record(8, '\0');
+  std::memcpy(&record[0], &pageNo, 4);
+  std::memcpy(&record[4], &count, 4);
+  return record;
+}
+
+/**
+ * Waits up to a few seconds for the writer to have written pages.
+ */
+static bool waitForWrites(BufMgr* bufMgr, const std::uint64_t before)
+{
+  for (int i = 0; i < 500; i++)
+  {
+    if (bufMgr->getStatsSnapshot().bgwrites > before)
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+static void updatePages(BufMgr* bufMgr, File* file, const std::vector<PageId>& pageIds,
+                        const std::uint32_t count)
+{
+  for (std::size_t i = 0; i < pageIds.size(); i++)
+  {
+    Page* page;
+    bufMgr->readPage(file, pageIds[i], page);
+    const RecordId rid = {pageIds[i], 1};
+    page->updateRecord(rid, makeRecord(pageIds[i], count));
+    bufMgr->unPinPage(file, pageIds[i], true);
+  }
+}
+
+int main()
+{
+  removeFile("bg_writer_file");
+  PageFile* file = new PageFile("bg_writer_file", true);
+  BufMgr* bufMgr = new BufMgr(NUM_FRAMES);
+
+  // below the high watermark nothing is written
+  bufMgr->startBackgroundWriter(LOW_WATERMARK, HIGH_WATERMARK);
+  std::vector<PageId> pageIds;
+  for (std::uint32_t i = 0; i < HIGH_WATERMARK - 1; i++)
+  {
+    PageId pageNo;
+    Page* page;
+    bufMgr->allocPage(file, pageNo, page);
+    page->insertRecord(makeRecord(pageNo, 0));
+    bufMgr->unPinPage(file, pageNo, true);
+    pageIds.push_back(pageNo);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  checkTrue(bufMgr->getStatsSnapshot().bgwrites == 0);
+
+  // past it the writer cleans the pages without being asked
+  for (int i = HIGH_WATERMARK - 1; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    Page* page;
+    bufMgr->allocPage(file, pageNo, page);
+    page->insertRecord(makeRecord(pageNo, 0));
+    bufMgr->unPinPage(file, pageNo, true);
+    pageIds.push_back(pageNo);
+  }
+  checkTrue(waitForWrites(bufMgr, 0));
+
+  // flushing the pages the writer is cleaning at the same time
+  std::uint32_t count = 0;
+  for (int round = 0; round < ROUNDS; round++)
+  {
+    updatePages(bufMgr, file, pageIds, ++count);
+    try
+    {
+      bufMgr->flushFile(file);
+    }
+    catch (const BadgerDbException& e)
+    {
+      std::cout << "Test FAILS: flushFile: " << e.message() << "\n";
+      testFailures++;
+    }
+  }
+  const std::uint64_t bgwrites = bufMgr->getStatsSnapshot().bgwrites;
+  updatePages(bufMgr, file, pageIds, ++count);
+  checkTrue(waitForWrites(bufMgr, bgwrites));
+  bufMgr->stopBackgroundWriter();
+  bufMgr->flushFile(file);
+
+  // every page holds its last update on disk
+  delete bufMgr;
+  delete file;
+  {
+    PageFile check = PageFile::open("bg_writer_file");
+    for (std::size_t i = 0; i < pageIds.size(); i++)
+    {
+      const RecordId rid = {pageIds[i], 1};
+      checkTrue(check.readPage(pageIds[i]).getRecord(rid) == makeRecord(pageIds[i], count));
+    }
+  }
+  File::remove("bg_writer_file");
+  return testResult("background_writer_test");
+}
@@ -0,0 +1,388 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks the buffer pool statistics: a known mix of hits and misses, also
+ * counted from several threads at once, the split of evictions into clean
+ * and dirty ones, and the per-file counts, which survive flushFile() and the
+ * File object going away.  print() and printJson() are checked as well, the
+ * JSON by parsing it back, with a file name holding quotes and a backslash.
+ */
+
+#include <cctype>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "test_util.h"
+#include "buffer.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+static const char* const QUOTED = "stats_test \"quoted\" \\ file";
+static const char* const PLAIN = "stats_test_plain";
+static const std::uint32_t NUM_FRAMES = 10;
+static const PageId NUM_PAGES = 40;
+
+/**
+ * A parsed JSON value, enough of JSON for printJson()
+ */
+struct JsonValue
+{
+  enum Type { NUMBER, STRING, ARRAY, OBJECT } type;
+  std::uint64_t number;
+  std::string string;
+  std::vector<JsonValue> items;
+  std::vector<std::pair<std::string, JsonValue> > members;
+
+  JsonValue() : type(NUMBER), number(0) {}
+
+  /**
+   * Member of an object by name, NULL if there is none
+   */
+  const JsonValue* member(const std::string& name) const
+  {
+    for (std::size_t i = 0; i < members.size(); i++)
+    {
+      if (members[i].first == name)
+        return &members[i].second;
+    }
+    return NULL;
+  }
+};
+
+/**
+ * Recursive descent JSON parser which fails on anything it does not expect
+ */
+class JsonParser
+{
+ public:
+  JsonParser(const std::string& text) : text(text), pos(0), ok(true) {}
+
+  /**
+   * Parse the whole text as one value.
+   *
+   * @return  False if it is not valid JSON
+   */
+  bool parse(JsonValue& value)
+  {
+    parseValue(value);
+    skipSpace();
+    return ok && pos == text.size();
+  }
+
+ private:
+  void skipSpace()
+  {
+    while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+      pos++;
+  }
+
+  bool expect(const char c)
+  {
+    skipSpace();
+    if (pos < text.size() && text[pos] == c)
+    {
+      pos++;
+      return true;
+    }
+    ok = false;
+    return false;
+  }
+
+  void parseString(std::string& out)
+  {
+    if (!expect('"'))
+      return;
+    while (ok && pos < text.size() && text[pos] != '"')
+    {
+      char c = text[pos++];
+      if (static_cast<unsigned char>(c) < 0x20)
+        ok = false;
+      else if (c != '\\')
+        out += c;
+      else if (pos >= text.size())
+        ok = false;
+      else
+      {
+        c = text[pos++];
+        if (c == '"' || c == '\\' || c == '/')
+          out += c;
+        else if (c == 'n')
+          out += '\n';
+        else if (c == 't')
+          out += '\t';
+        else if (c == 'u' && pos + 4 <= text.size())
+        {
+          out += char(std::stoi(text.substr(pos, 4), NULL, 16));
+          pos += 4;
+        }
+        else
+          ok = false;
+      }
+    }
+    expect('"');
+  }
+
+  void parseValue(JsonValue& value)
+  {
+    skipSpace();
+    if (!ok || pos >= text.size())
+    {
+      ok = false;
+      return;
+    }
+    const char c = text[pos];
+    if (c == '"')
+    {
+      value.type = JsonValue::STRING;
+      parseString(value.string);
+    }
+    else if (std::isdigit(static_cast<unsigned char>(c)))
+    {
+      value.type = JsonValue::NUMBER;
+      while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos])))
+        value.number = value.number * 10 + (text[pos++] - '0');
+    }
+    else if (c == '[')
+    {
+      value.type = JsonValue::ARRAY;
+      pos++;
+      skipSpace();
+      if (pos < text.size() && text[pos] == ']')
+      {
+        pos++;
+        return;
+      }
+      do
+      {
+        value.items.push_back(JsonValue());
+        parseValue(value.items.back());
+        skipSpace();
+      } while (ok && pos < text.size() && text[pos] == ',' && ++pos);
+      expect(']');
+    }
+    else if (c == '{')
+    {
+      value.type = JsonValue::OBJECT;
+      pos++;
+      skipSpace();
+      if (pos < text.size() && text[pos] == '}')
+      {
+        pos++;
+        return;
+      }
+      do
+      {
+        value.members.push_back(std::make_pair(std::string(), JsonValue()));
+        parseString(value.members.back().first);
+        expect(':');
+        parseValue(value.members.back().second);
+        skipSpace();
+      } while (ok && pos < text.size() && text[pos] == ',' && ++pos);
+      expect('}');
+    }
+    else
+      ok = false;
+  }
+
+  const std::string& text;
+  std::size_t pos;
+  bool ok;
+};
+
+static void createFile(const std::string& name)
+{
+  removeFile(name);
+  PageFile file(name, true);
+  for (PageId i = 0; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    Page page = file.allocatePage(pageNo);
+    file.writePage(pageNo, page);
+  }
+}
+
+static void touch(BufMgr* bufMgr, File* file, const PageId pageNo, const bool dirty)
+{
+  Page* page;
+  bufMgr->readPage(file, pageNo, page);
+  bufMgr->unPinPage(file, pageNo, dirty);
+}
+
+/**
+ * Counts of the named file in the snapshot, zero if it has none.
+ */
+static FileStats fileCounts(const BufStatsSnapshot& stats, const std::string& name)
+{
+  for (std::size_t i = 0; i < stats.files.size(); i++)
+  {
+    if (stats.files[i].filename == name)
+      return stats.files[i];
+  }
+  return FileStats();
+}
+
+static void testCounts(BufMgr* bufMgr, File* quoted, File* plain)
+{
+  bufMgr->clearBufStats();
+
+  // 5 misses then 5 hits, 3 misses then 1 hit
+  for (PageId pageNo = 1; pageNo <= 5; pageNo++)
+    touch(bufMgr, quoted, pageNo, false);
+  for (PageId pageNo = 1; pageNo <= 5; pageNo++)
+    touch(bufMgr, quoted, pageNo, false);
+  for (PageId pageNo = 1; pageNo <= 5; pageNo += 2)
+    touch(bufMgr, plain, pageNo, true);
+  touch(bufMgr, plain, 1, false);
+
+  BufStatsSnapshot stats = bufMgr->getStatsSnapshot();
+  checkTrue(stats.accesses == 14 && stats.hits == 6 && stats.misses == 8);
+  checkTrue(stats.diskreads == 8 && stats.diskwrites == 0);
+  checkTrue(stats.cleanEvictions == 0 && stats.dirtyEvictions == 0);
+  FileStats counts = fileCounts(stats, QUOTED);
+  checkTrue(counts.hits == 5 && counts.misses == 5);
+  counts = fileCounts(stats, PLAIN);
+  checkTrue(counts.hits == 1 && counts.misses == 3);
+
+  // two more pages fill the pool; ten new ones evict every page there, the
+  // three dirty ones after writing them.  They are apart, as an eviction
+  // writes dirty neighbours along with its page, which then go clean.
+  touch(bufMgr, quoted, 6, false);
+  touch(bufMgr, quoted, 7, false);
+  for (PageId pageNo = 11; pageNo <= 20; pageNo++)
+    touch(bufMgr, quoted, pageNo, false);
+  stats = bufMgr->getStatsSnapshot();
+  checkTrue(stats.cleanEvictions == 7 && stats.dirtyEvictions == 3);
+  checkTrue(stats.diskwrites == 3 && stats.misses == 20);
+
+  // hits from several threads at once, each on a stripe of its own or not
+  const int threads = 6;
+  const int reads = 5000;
+  std::vector<std::thread> readers;
+  for (int t = 0; t < threads; t++)
+  {
+    readers.push_back(std::thread([bufMgr, quoted, t]() {
+      for (int i = 0; i < reads; i++)
+        touch(bufMgr, quoted, 11 + (i + t) % 10, false);
+    }));
+  }
+  for (int t = 0; t < threads; t++)
+    readers[t].join();
+  stats = bufMgr->getStatsSnapshot();
+  checkTrue(stats.hits == 6 + std::uint64_t(threads) * reads);
+  checkTrue(stats.accesses == stats.hits + stats.misses);
+
+  // clearing drops every count
+  bufMgr->clearBufStats();
+  stats = bufMgr->getStatsSnapshot();
+  checkTrue(stats.accesses == 0 && stats.hits == 0 && stats.misses == 0);
+  checkTrue(stats.files.empty());
+}
+
+static void testFileTotals(BufMgr* bufMgr, File* plain)
+{
+  bufMgr->clearBufStats();
+  PageFile* quoted = new PageFile(QUOTED, false);
+  touch(bufMgr, quoted, 30, false);
+  touch(bufMgr, quoted, 30, false);
+  touch(bufMgr, plain, 30, false);
+
+  // the counts of a flushed file are kept under its name
+  bufMgr->flushFile(quoted);
+  delete quoted;
+  BufStatsSnapshot stats = bufMgr->getStatsSnapshot();
+  FileStats counts = fileCounts(stats, QUOTED);
+  checkTrue(counts.hits == 1 && counts.misses == 1);
+
+  // and added to by a File object opened on it later
+  quoted = new PageFile(QUOTED, false);
+  touch(bufMgr, quoted, 30, false);
+  touch(bufMgr, quoted, 31, false);
+  touch(bufMgr, quoted, 31, false);
+  stats = bufMgr->getStatsSnapshot();
+  counts = fileCounts(stats, QUOTED);
+  checkTrue(counts.hits == 2 && counts.misses == 3);
+  counts = fileCounts(stats, PLAIN);
+  checkTrue(counts.hits == 0 && counts.misses == 1);
+  checkTrue(stats.files.size() == 2);
+
+  // over the same totals as the pool's
+  checkTrue(stats.hits == 2 && stats.misses == 4);
+  bufMgr->flushFile(quoted);
+  delete quoted;
+}
+
+static void testPrint(BufMgr* bufMgr)
+{
+  const BufStatsSnapshot stats = bufMgr->getStatsSnapshot();
+  std::ostringstream text;
+  stats.print(text);
+  checkTrue(text.str().find("accesses: 6  hits: 2  misses: 4") != std::string::npos);
+  checkTrue(text.str().find("file " + std::string(QUOTED) + ": hits 2  misses 3\n")
+            != std::string::npos);
+
+  std::ostringstream json;
+  stats.printJson(json);
+  JsonValue root;
+  checkTrue(JsonParser(json.str()).parse(root));
+  checkTrue(root.type == JsonValue::OBJECT);
+  const JsonValue* value = root.member("accesses");
+  checkTrue(value != NULL && value->type == JsonValue::NUMBER && value->number == 6);
+  value = root.member("dirtyEvictions");
+  checkTrue(value != NULL && value->number == stats.dirtyEvictions);
+  value = root.member("readPageLatencyNs");
+  checkTrue(value != NULL && value->type == JsonValue::OBJECT && value->member("buckets") != NULL);
+
+  // the file name comes back as it was
+  const JsonValue* files = root.member("files");
+  checkTrue(files != NULL && files->type == JsonValue::ARRAY && files->items.size() == 2);
+  bool found = false;
+  for (std::size_t i = 0; files != NULL && i < files->items.size(); i++)
+  {
+    const JsonValue* name = files->items[i].member("filename");
+    if (name != NULL && name->string == QUOTED)
+    {
+      found = true;
+      checkTrue(files->items[i].member("hits")->number == 2);
+      checkTrue(files->items[i].member("misses")->number == 3);
+    }
+  }
+  checkTrue(found);
+  const JsonValue* pools = root.member("pools");
+  checkTrue(pools != NULL && pools->type == JsonValue::ARRAY && !pools->items.empty());
+
+  // and the parser does not take everything
+  JsonValue bad;
+  checkTrue(!JsonParser("{\"a\":\"b\"c\"}").parse(bad));
+  checkTrue(!JsonParser("{\"a\":1,}").parse(bad));
+}
+
+int main()
+{
+  createFile(QUOTED);
+  createFile(PLAIN);
+  BufMgr* bufMgr = new BufMgr(NUM_FRAMES);
+  bufMgr->setReadahead(0);
+  PageFile* quoted = new PageFile(QUOTED, false);
+  PageFile* plain = new PageFile(PLAIN, false);
+
+  testCounts(bufMgr, quoted, plain);
+  bufMgr->flushFile(quoted);
+  delete quoted;
+  testFileTotals(bufMgr, plain);
+  testPrint(bufMgr);
+
+  bufMgr->flushFile(plain);
+  delete plain;
+  delete bufMgr;
+  File::remove(QUOTED);
+  File::remove(PLAIN);
+  return testResult("buf_stats_test");
+}
@@ -0,0 +1,148 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks named pools: files bound to a pool, by name or by File object, hold
+ * no more frames than its maximum however many of their pages are read, and
+ * keep their minimum while other files take the rest.  Pools of sizes which
+ * cannot be, and bindings to pools which do not exist, are refused.
+ */
+
+#include <string>
+#include "test_util.h"
+#include "buffer.h"
+#include "page.h"
+#include "exceptions/bad_pool_exception.h"
+
+using namespace badgerdb;
+
+static const std::uint32_t NUM_FRAMES = 64;
+static const PageId NUM_PAGES = 100;
+
+static void createFile(const char* name)
+{
+  removeFile(name);
+  PageFile file = PageFile::create(name);
+  for (PageId i = 0; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    file.allocatePage(pageNo);
+  }
+}
+
+static void readAll(BufMgr* bufMgr, File* file)
+{
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+  {
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    bufMgr->unPinPage(file, pageNo, false);
+  }
+}
+
+/**
+ * Frames held by the pool of the given name.
+ */
+static std::uint32_t resident(BufMgr* bufMgr, const std::string& name)
+{
+  const BufStatsSnapshot stats = bufMgr->getStatsSnapshot();
+  for (std::size_t i = 0; i < stats.pools.size(); i++)
+  {
+    if (stats.pools[i].name == name)
+      return stats.pools[i].resident;
+  }
+  checkTrue(false);
+  return 0;
+}
+
+static void testLimits(BufMgr* bufMgr)
+{
+  bufMgr->createPool("small", 4, 8);
+  bufMgr->createPool("fixed", 16, 16);
+
+  // bound before the file is opened, and after
+  bufMgr->bindFile("pools_test_small", "small");
+  PageFile small = PageFile::open("pools_test_small");
+  PageFile fixed = PageFile::open("pools_test_fixed");
+  PageFile other = PageFile::open("pools_test_other");
+  bufMgr->bindFile(&fixed, "fixed");
+
+  readAll(bufMgr, &small);
+  checkTrue(resident(bufMgr, "small") == 8);
+
+  // a pool below its minimum may take pages of one above its own
+  readAll(bufMgr, &fixed);
+  checkTrue(resident(bufMgr, "fixed") == 16);
+  checkTrue(resident(bufMgr, "small") >= 4 && resident(bufMgr, "small") <= 8);
+
+  // a file of the default pool takes what the others do not keep
+  readAll(bufMgr, &other);
+  checkTrue(resident(bufMgr, "small") >= 4 && resident(bufMgr, "small") <= 8);
+  checkTrue(resident(bufMgr, "fixed") == 16);
+  checkTrue(resident(bufMgr, BufMgr::DEFAULT_POOL) <= NUM_FRAMES - 4 - 16);
+  checkTrue(resident(bufMgr, BufMgr::DEFAULT_POOL) + resident(bufMgr, "small")
+            + resident(bufMgr, "fixed") <= NUM_FRAMES);
+
+  // and the pools keep to their limits while both are read again
+  readAll(bufMgr, &fixed);
+  readAll(bufMgr, &small);
+  checkTrue(resident(bufMgr, "small") >= 4 && resident(bufMgr, "small") <= 8);
+  checkTrue(resident(bufMgr, "fixed") == 16);
+
+  // bound back to the default pool, a file can take more
+  bufMgr->bindFile(&small, BufMgr::DEFAULT_POOL);
+  bufMgr->flushFile(&small);
+  readAll(bufMgr, &small);
+  checkTrue(resident(bufMgr, "small") == 0);
+  checkTrue(resident(bufMgr, BufMgr::DEFAULT_POOL) > 8);
+  checkTrue(resident(bufMgr, "fixed") == 16);
+
+  bufMgr->flushFile(&small);
+  bufMgr->flushFile(&fixed);
+  bufMgr->flushFile(&other);
+}
+
+static void testBadSizes(BufMgr* bufMgr)
+{
+  const std::size_t pools = bufMgr->getStatsSnapshot().pools.size();
+  checkThrows(bufMgr->createPool("small", 1, 2), BadPoolException);
+  checkThrows(bufMgr->createPool(BufMgr::DEFAULT_POOL, 1, 2), BadPoolException);
+  checkThrows(bufMgr->createPool("inverted", 4, 2), BadPoolException);
+  checkThrows(bufMgr->createPool("empty", 0, 0), BadPoolException);
+  checkThrows(bufMgr->createPool("greedy", NUM_FRAMES - 4 - 16 + 1, NUM_FRAMES), BadPoolException);
+  checkThrows(bufMgr->bindFile("pools_test_other", "missing"), BadPoolException);
+  checkTrue(bufMgr->getStatsSnapshot().pools.size() == pools);
+
+  // what the others leave may still be kept
+  bufMgr->createPool("rest", NUM_FRAMES - 4 - 16, NUM_FRAMES);
+
+  // and there are only so many pools
+  std::size_t count = pools + 1;
+  for (; count < 16; count++)
+    bufMgr->createPool("pool " + std::to_string(count), 0, 1);
+  checkThrows(bufMgr->createPool("one too many", 0, 1), BadPoolException);
+  checkTrue(bufMgr->getStatsSnapshot().pools.size() == count);
+}
+
+int main()
+{
+  createFile("pools_test_small");
+  createFile("pools_test_fixed");
+  createFile("pools_test_other");
+
+  // without readahead, which would read past the pages asked for
+  BufMgr* bufMgr = new BufMgr(NUM_FRAMES);
+  bufMgr->setReadahead(0);
+  testLimits(bufMgr);
+  testBadSizes(bufMgr);
+  delete bufMgr;
+
+  File::remove("pools_test_small");
+  File::remove("pools_test_fixed");
+  File::remove("pools_test_other");
+  return testResult("buffer_pools_test");
+}
@@ -0,0 +1,194 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks BufferRing: a scan of a file five times the pool read through a
+ * ring displaces only as many pages as the ring has frames, where a plain
+ * scan displaces them all, and a ring takes no more than an eighth of the
+ * pool however large it is made.  Pages read through a ring are ordinary
+ * pool pages, found by other readers, and a page still pinned is not reused
+ * by the ring.  A BULK_READ FileScan leaves the pool much as it found it.
+ */
+
+#include <fstream>
+#include <string>
+#include "test_util.h"
+#include "buffer.h"
+#include "filescan.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+static const char* const HOT = "ring_test_hot";
+static const char* const BIG = "ring_test_big";
+static const char* const SNAPSHOT = "ring_test_snapshot";
+static const std::uint32_t NUM_FRAMES = 200;
+static const PageId BIG_PAGES = 5 * NUM_FRAMES;
+
+static void createFile(const char* name, const PageId pages)
+{
+  removeFile(name);
+  PageFile file(name, true);
+  for (PageId i = 0; i < pages; i++)
+  {
+    PageId pageNo;
+    Page page = file.allocatePage(pageNo);
+    page.insertRecord(name + std::string(" ") + std::to_string(pageNo));
+    file.writePage(pageNo, page);
+  }
+}
+
+/**
+ * Counts the pages of a file in the pool, without touching them, from a
+ * residency snapshot.
+ */
+static std::uint32_t residentPages(BufMgr* bufMgr, const std::string& name)
+{
+  bufMgr->saveResidency(SNAPSHOT);
+  std::ifstream in(SNAPSHOT);
+  std::string line;
+  std::getline(in, line);
+  std::uint32_t count = 0;
+  PageId pageNo;
+  while (in >> pageNo && std::getline(in, line))
+  {
+    if (line == " " + name)
+      count++;
+  }
+  return count;
+}
+
+/**
+ * Fills the pool with the pages of the hot file.
+ */
+static void warmUp(BufMgr* bufMgr, File* hot)
+{
+  Page* page;
+  for (PageId pageNo = 1; pageNo <= NUM_FRAMES; pageNo++)
+  {
+    bufMgr->readPage(hot, pageNo, page);
+    bufMgr->unPinPage(hot, pageNo, false);
+  }
+  checkTrue(residentPages(bufMgr, HOT) == NUM_FRAMES);
+}
+
+/**
+ * Reads every page of the big file, through the ring if there is one.
+ */
+static void scan(BufMgr* bufMgr, File* big, BufferRing* ring)
+{
+  Page* page;
+  for (PageId pageNo = 1; pageNo <= BIG_PAGES; pageNo++)
+  {
+    bufMgr->readPage(big, pageNo, page, ring);
+    checkTrue(page->page_number() == pageNo);
+    bufMgr->unPinPage(big, pageNo, false);
+  }
+}
+
+static void testRingScan(BufMgr* bufMgr, File* hot, File* big)
+{
+  // a plain scan pushes every hot page out
+  warmUp(bufMgr, hot);
+  scan(bufMgr, big, NULL);
+  checkTrue(residentPages(bufMgr, HOT) == 0);
+  bufMgr->flushFile(big);
+  bufMgr->flushFile(hot);
+
+  // one through a ring only as many as the ring has frames
+  warmUp(bufMgr, hot);
+  {
+    BufferRing ring(16);
+    scan(bufMgr, big, &ring);
+    checkTrue(residentPages(bufMgr, HOT) == NUM_FRAMES - 16);
+    checkTrue(residentPages(bufMgr, BIG) == 16);
+    bufMgr->flushFile(big);
+  }
+  bufMgr->flushFile(hot);
+
+  // a ring larger than an eighth of the pool is cut down to that
+  warmUp(bufMgr, hot);
+  {
+    BufferRing ring(NUM_FRAMES);
+    scan(bufMgr, big, &ring);
+    checkTrue(residentPages(bufMgr, HOT) == NUM_FRAMES - NUM_FRAMES / 8);
+    bufMgr->flushFile(big);
+  }
+  bufMgr->flushFile(hot);
+}
+
+static void testSharing(BufMgr* bufMgr, File* big)
+{
+  BufferRing ring(8);
+  Page* page;
+  bufMgr->readPage(big, 1, page, &ring);
+
+  // a reader without the ring finds the page the ring read
+  bufMgr->clearBufStats();
+  Page* again;
+  bufMgr->readPage(big, 1, again);
+  checkTrue(again == page && bufMgr->getStatsSnapshot().hits == 1);
+  bufMgr->unPinPage(big, 1, false);
+
+  // the ring goes round many times without taking the frame still pinned
+  for (PageId pageNo = 2; pageNo <= 100; pageNo++)
+  {
+    Page* other;
+    bufMgr->readPage(big, pageNo, other, &ring);
+    checkTrue(other != page);
+    bufMgr->unPinPage(big, pageNo, false);
+  }
+  checkTrue(page->page_number() == 1);
+  bufMgr->unPinPage(big, 1, false);
+  bufMgr->flushFile(big);
+}
+
+static void testBulkFileScan(BufMgr* bufMgr, File* hot)
+{
+  warmUp(bufMgr, hot);
+  bufMgr->setReadahead(16);
+  {
+    FileScan scan(BIG, bufMgr, BULK_READ);
+    RecordId rid;
+    PageId pages = 0;
+    while (scan.tryScanNext(rid))
+    {
+      checkTrue(scan.getRecord() == BIG + std::string(" ") + std::to_string(rid.page_number));
+      pages++;
+    }
+    checkTrue(pages == BIG_PAGES);
+  }
+
+  // the pages read ahead went through the ring as well; a slot whose frame
+  // was still pinned by the scan or a read ahead when the ring came round
+  // took a fresh frame, which a window's worth of pages bounds
+  checkTrue(residentPages(bufMgr, HOT) >= NUM_FRAMES - NUM_FRAMES / 8 - 16);
+  bufMgr->flushFile(hot);
+}
+
+int main()
+{
+  createFile(HOT, NUM_FRAMES);
+  createFile(BIG, BIG_PAGES);
+  BufMgr* bufMgr = new BufMgr(NUM_FRAMES);
+  PageFile* hot = new PageFile(HOT, false);
+  PageFile* big = new PageFile(BIG, false);
+
+  // pages read ahead would take frames from the rings as well
+  bufMgr->setReadahead(0);
+  testRingScan(bufMgr, hot, big);
+  testSharing(bufMgr, big);
+  delete big;
+  testBulkFileScan(bufMgr, hot);
+
+  delete hot;
+  delete bufMgr;
+  File::remove(HOT);
+  File::remove(BIG);
+  removeFile(SNAPSHOT);
+  return testResult("buffer_ring_test");
+}
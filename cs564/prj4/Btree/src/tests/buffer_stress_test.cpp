@@ -0,0 +1,446 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Several threads read, update, allocate, dispose and flush pages through one
+ * small buffer pool, so that pages are evicted all the time, and check that
+ * every page they pin holds what they expect.  Another thread keeps flushing
+ * the shared file meanwhile, which must leave pinned pages alone.  At the end
+ * no page may be left pinned.  The pool is also grown and shrunk while
+ * threads update pages in it, which may lose no update, and a shrink which
+ * would remove a pinned page has to fail without changing the pool.  How
+ * far a pool may grow is limited by the address space reserved for it, which
+ * shrinks to what the system allows.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "buffer.h"
+#include "page.h"
+#include "exceptions/bad_pool_exception.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/page_pinned_exception.h"
+
+using namespace badgerdb;
+
+static const int NUM_THREADS = 8;
+static const int NUM_PAGES = 200;
+static const int NUM_FRAMES = 32;
+static const int ITERATIONS = 4000;
+
+/**
+ * A record holding the number of the page it is on and a counter.
+ */
+static std::string makeRecord(const PageId pageNo, const std::uint32_t count)
+{
+  std::string record(8, '\0');
+  std::memcpy(&record[0], &pageNo, 4);
+  std::memcpy(&record[4], &count, 4);
+  return record;
+}
+
+static void readRecord(Page* page, PageId& pageNo, std::uint32_t& count)
+{
+  const RecordId rid = {page->page_number(), 1};
+  const std::string record = page->getRecord(rid);
+  std::memcpy(&pageNo, &record[0], 4);
+  std::memcpy(&count, &record[4], 4);
+}
+
+/**
+ * Shared pages are read and updated under a latch of their own, as the
+ * buffer manager only keeps them in place while they are pinned.
+ */
+struct SharedPages
+{
+  PageFile* file;
+  std::mutex latches[NUM_PAGES + 1];
+  std::atomic<std::uint32_t> updates[NUM_PAGES + 1];
+};
+
+/**
+ * Reads and updates shared pages, and allocates, rereads and disposes pages
+ * of a file of its own, which it flushes now and then.
+ */
+static void worker(BufMgr* bufMgr, SharedPages* shared, const int threadNo)
+{
+  unsigned int seed = threadNo * 7919 + 1;
+  std::ostringstream name;
+  name << "stress_test_" << threadNo;
+  removeFile(name.str());
+  PageFile* own = new PageFile(name.str(), true);
+  std::vector<PageId> ownPages;
+
+  for (int i = 0; i < ITERATIONS; i++)
+  {
+    const int op = rand_r(&seed) % 10;
+    try
+    {
+      if (op < 6)
+      {
+        const PageId pageNo = 1 + rand_r(&seed) % NUM_PAGES;
+        const bool update = op == 0;
+        std::lock_guard<std::mutex> latch(shared->latches[pageNo]);
+        Page* page;
+        bufMgr->readPage(shared->file, pageNo, page);
+        PageId recordPage;
+        std::uint32_t count;
+        readRecord(page, recordPage, count);
+        checkTrue(recordPage == pageNo);
+        if (update)
+        {
+          const RecordId rid = {pageNo, 1};
+          page->updateRecord(rid, makeRecord(pageNo, count + 1));
+          shared->updates[pageNo]++;
+        }
+        bufMgr->unPinPage(shared->file, pageNo, update);
+      }
+      else if (op < 8 || ownPages.empty())
+      {
+        PageId pageNo;
+        Page* page;
+        bufMgr->allocPage(own, pageNo, page);
+        page->insertRecord(makeRecord(pageNo, threadNo));
+        bufMgr->unPinPage(own, pageNo, true);
+        ownPages.push_back(pageNo);
+      }
+      else if (op == 8)
+      {
+        const std::size_t n = rand_r(&seed) % ownPages.size();
+        const PageId pageNo = ownPages[n];
+        Page* page;
+        bufMgr->readPage(own, pageNo, page);
+        PageId recordPage;
+        std::uint32_t owner;
+        readRecord(page, recordPage, owner);
+        checkTrue(recordPage == pageNo && owner == std::uint32_t(threadNo));
+
+        // a pinned page may not be disposed of
+        checkThrows(bufMgr->disposePage(own, pageNo), PagePinnedException);
+        bufMgr->unPinPage(own, pageNo, false);
+        bufMgr->disposePage(own, pageNo);
+        ownPages[n] = ownPages.back();
+        ownPages.pop_back();
+      }
+      else
+      {
+        bufMgr->flushFile(own);
+      }
+    }
+    catch (const BadgerDbException& e)
+    {
+      std::cout << "Test FAILS: thread " << threadNo << ": " << e.message() << "\n";
+      testFailures++;
+    }
+  }
+
+  // the pages left were written and can be read back
+  bufMgr->flushFile(own);
+  for (std::size_t n = 0; n < ownPages.size(); n++)
+  {
+    Page* page;
+    bufMgr->readPage(own, ownPages[n], page);
+    PageId recordPage;
+    std::uint32_t owner;
+    readRecord(page, recordPage, owner);
+    checkTrue(recordPage == ownPages[n] && owner == std::uint32_t(threadNo));
+    bufMgr->unPinPage(own, ownPages[n], false);
+  }
+  bufMgr->flushFile(own);
+  delete own;
+  File::remove(name.str());
+}
+
+/**
+ * Flushes the shared file until the workers are done.  Pages the workers have
+ * pinned make it throw, but it may not take them away.
+ */
+static void flusher(BufMgr* bufMgr, SharedPages* shared, std::atomic<bool>* done)
+{
+  while (!*done)
+  {
+    try
+    {
+      bufMgr->flushFile(shared->file);
+    }
+    catch (const PagePinnedException&)
+    {
+    }
+    std::this_thread::yield();
+  }
+}
+
+static void stressPolicy(const ReplacementPolicyType policyType)
+{
+  removeFile("stress_test_shared");
+  SharedPages shared;
+  shared.file = new PageFile("stress_test_shared", true);
+  BufMgr* bufMgr = new BufMgr(NUM_FRAMES, policyType);
+
+  for (int i = 0; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    Page* page;
+    bufMgr->allocPage(shared.file, pageNo, page);
+    page->insertRecord(makeRecord(pageNo, 0));
+    bufMgr->unPinPage(shared.file, pageNo, true);
+  }
+  for (int i = 0; i <= NUM_PAGES; i++)
+    shared.updates[i] = 0;
+
+  std::atomic<bool> done(false);
+  std::thread flushing(flusher, bufMgr, &shared, &done);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < NUM_THREADS; t++)
+    threads.push_back(std::thread(worker, bufMgr, &shared, t));
+  for (std::size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+  done = true;
+  flushing.join();
+
+  // every pin was dropped: none can be dropped again
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+  {
+    Page* page;
+    bufMgr->readPage(shared.file, pageNo, page);
+    PageId recordPage;
+    std::uint32_t count;
+    readRecord(page, recordPage, count);
+    checkTrue(recordPage == pageNo && count == shared.updates[pageNo]);
+    bufMgr->unPinPage(shared.file, pageNo, false);
+    checkThrows(bufMgr->unPinPage(shared.file, pageNo, false), PageNotPinnedException);
+  }
+  bufMgr->flushFile(shared.file);
+
+  // a failed unpin leaves the page clean
+  Page* page;
+  bufMgr->readPage(shared.file, 1, page);
+  bufMgr->unPinPage(shared.file, 1, false);
+  const std::uint64_t writes = bufMgr->getStatsSnapshot().diskwrites;
+  checkThrows(bufMgr->unPinPage(shared.file, 1, true), PageNotPinnedException);
+  bufMgr->flushFile(shared.file);
+  checkTrue(bufMgr->getStatsSnapshot().diskwrites == writes);
+
+  // and everything made it to disk
+  {
+    PageFile check = PageFile::open("stress_test_shared");
+    for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+    {
+      Page onDisk = check.readPage(pageNo);
+      PageId recordPage;
+      std::uint32_t count;
+      readRecord(&onDisk, recordPage, count);
+      checkTrue(recordPage == pageNo && count == shared.updates[pageNo]);
+    }
+  }
+
+  delete bufMgr;
+  delete shared.file;
+  File::remove("stress_test_shared");
+}
+
+/**
+ * Reads and updates shared pages while the pool is resized under it.
+ */
+static void resizeWorker(BufMgr* bufMgr, SharedPages* shared, const int threadNo,
+                         std::atomic<bool>* done)
+{
+  unsigned int seed = threadNo * 7919 + 1;
+  while (!*done)
+  {
+    const PageId pageNo = 1 + rand_r(&seed) % NUM_PAGES;
+    const bool update = rand_r(&seed) % 3 == 0;
+    std::lock_guard<std::mutex> latch(shared->latches[pageNo]);
+    try
+    {
+      Page* page;
+      bufMgr->readPage(shared->file, pageNo, page);
+      PageId recordPage;
+      std::uint32_t count;
+      readRecord(page, recordPage, count);
+      checkTrue(recordPage == pageNo && count == shared->updates[pageNo]);
+      if (update)
+      {
+        const RecordId rid = {pageNo, 1};
+        page->updateRecord(rid, makeRecord(pageNo, count + 1));
+        shared->updates[pageNo]++;
+      }
+      bufMgr->unPinPage(shared->file, pageNo, update);
+    }
+    catch (const BadgerDbException& e)
+    {
+      std::cout << "Test FAILS: thread " << threadNo << ": " << e.message() << "\n";
+      testFailures++;
+    }
+  }
+}
+
+static void stressResize()
+{
+  removeFile("stress_test_shared");
+  SharedPages shared;
+  shared.file = new PageFile("stress_test_shared", true);
+  BufMgr* bufMgr = new BufMgr(NUM_FRAMES, CLOCK, 512);
+  bufMgr->setAllocWaitTimeout(1000000);
+
+  for (int i = 0; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    Page* page;
+    bufMgr->allocPage(shared.file, pageNo, page);
+    page->insertRecord(makeRecord(pageNo, 0));
+    bufMgr->unPinPage(shared.file, pageNo, true);
+  }
+  for (int i = 0; i <= NUM_PAGES; i++)
+    shared.updates[i] = 0;
+
+  // sizes both below and above the number of pages, dirty pages going with
+  // the frames removed
+  std::atomic<bool> done(false);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < NUM_THREADS; t++)
+    threads.push_back(std::thread(resizeWorker, bufMgr, &shared, t, &done));
+  const std::uint32_t sizes[] = {64, 16, 256, 24, 96, 16, 300, 32, 128, 20};
+  int resized = 0;
+  for (int round = 0; round < 20; round++)
+  {
+    for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+      const std::uint32_t before = bufMgr->getNumFrames();
+      try
+      {
+        bufMgr->resize(sizes[i]);
+        checkTrue(bufMgr->getNumFrames() == sizes[i]);
+        resized++;
+      }
+      catch (const PagePinnedException&)
+      {
+        checkTrue(bufMgr->getNumFrames() == before);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+  }
+  done = true;
+  for (std::size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+  checkTrue(resized > 0);
+
+  // a shrink which would take a pinned page away throws and removes nothing
+  Page* pinned;
+  PageId pinnedNo = 0;
+  FrameId frame = 0;
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES && frame == 0; pageNo++)
+  {
+    bufMgr->readPage(shared.file, pageNo, pinned);
+    frame = pinned - bufMgr->bufPool;
+    pinnedNo = pageNo;
+    if (frame == 0)
+      bufMgr->unPinPage(shared.file, pageNo, false);
+  }
+  const std::uint32_t before = bufMgr->getNumFrames();
+  checkThrows(bufMgr->resize(frame), PagePinnedException);
+  checkTrue(bufMgr->getNumFrames() == before);
+  PageId recordPage;
+  std::uint32_t count;
+  readRecord(pinned, recordPage, count);
+  checkTrue(recordPage == pinnedNo && count == shared.updates[pinnedNo]);
+  bufMgr->unPinPage(shared.file, pinnedNo, false);
+  bufMgr->resize(frame);
+  checkTrue(bufMgr->getNumFrames() == frame);
+
+  // no update was lost, in the pool or on disk
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+  {
+    Page* page;
+    bufMgr->readPage(shared.file, pageNo, page);
+    readRecord(page, recordPage, count);
+    checkTrue(recordPage == pageNo && count == shared.updates[pageNo]);
+    bufMgr->unPinPage(shared.file, pageNo, false);
+  }
+  bufMgr->flushFile(shared.file);
+  {
+    PageFile check = PageFile::open("stress_test_shared");
+    for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+    {
+      Page onDisk = check.readPage(pageNo);
+      readRecord(&onDisk, recordPage, count);
+      checkTrue(recordPage == pageNo && count == shared.updates[pageNo]);
+    }
+  }
+
+  delete bufMgr;
+  delete shared.file;
+  File::remove("stress_test_shared");
+}
+
+/**
+ * The address space reserved for growing the pool: DEFAULT_GROWTH times its
+ * size unless given, and less if the system will not reserve that much.
+ */
+static void checkReservation()
+{
+  {
+    BufMgr bufMgr(NUM_FRAMES);
+    checkTrue(bufMgr.getMaxFrames() == NUM_FRAMES * BufMgr::DEFAULT_GROWTH);
+    bufMgr.resize(bufMgr.getMaxFrames());
+    checkTrue(bufMgr.getNumFrames() == NUM_FRAMES * BufMgr::DEFAULT_GROWTH);
+    checkThrows(bufMgr.resize(bufMgr.getMaxFrames() + 1), BadPoolException);
+    bufMgr.resize(NUM_FRAMES);
+  }
+  {
+    BufMgr bufMgr(NUM_FRAMES, CLOCK, 1000);
+    checkTrue(bufMgr.getMaxFrames() == 1000);
+    checkThrows(bufMgr.resize(1001), BadPoolException);
+  }
+
+  // below the size of the pool, the pool size wins
+  {
+    BufMgr bufMgr(NUM_FRAMES, CLOCK, 4);
+    checkTrue(bufMgr.getMaxFrames() == NUM_FRAMES);
+  }
+
+  // with 1GB of address space to spare, 32GB cannot be had
+  struct rlimit before;
+  getrlimit(RLIMIT_AS, &before);
+  long pages = 0;
+  {
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages;
+  }
+  struct rlimit limited = before;
+  limited.rlim_cur = std::size_t(pages) * sysconf(_SC_PAGESIZE) + (std::size_t(1) << 30);
+  if (before.rlim_cur != RLIM_INFINITY && before.rlim_cur < limited.rlim_cur)
+    limited.rlim_cur = before.rlim_cur;
+  checkTrue(setrlimit(RLIMIT_AS, &limited) == 0);
+  {
+    BufMgr bufMgr(NUM_FRAMES, CLOCK, BufMgr::MAX_FRAMES);
+    checkTrue(bufMgr.getMaxFrames() < BufMgr::MAX_FRAMES / 16);
+    checkTrue(bufMgr.getMaxFrames() >= std::uint32_t(NUM_FRAMES));
+    bufMgr.resize(NUM_FRAMES * 2);
+    checkTrue(bufMgr.getNumFrames() == NUM_FRAMES * 2);
+  }
+  setrlimit(RLIMIT_AS, &before);
+}
+
+int main()
+{
+  const ReplacementPolicyType policies[] = {CLOCK, LRU_K, TWO_Q, ARC, CLOCK_PRO};
+  for (std::size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+    stressPolicy(policies[i]);
+  stressResize();
+  checkReservation();
+  return testResult("buffer_stress_test");
+}
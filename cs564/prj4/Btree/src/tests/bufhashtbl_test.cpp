@@ -0,0 +1,203 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks BufHashTbl against a std::map while partitions keep growing, so that
+ * inserts, lookups and removes run on partitions which are half way through
+ * moving their entries into a larger slot array, and removes shift entries
+ * back in both arrays.
+ */
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "test_util.h"
+#include "bufHashTbl.h"
+#include "exceptions/hash_already_present_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+
+using namespace badgerdb;
+
+typedef std::map<std::pair<const File*, PageId>, FrameId> Model;
+
+static const int NUM_FILES = 3;
+
+/**
+ * Looks up every entry of the model, and a few which are not in it.
+ */
+static void checkAll(BufHashTbl& table, const Model& model, File* const* files)
+{
+  for (Model::const_iterator it = model.begin(); it != model.end(); ++it)
+  {
+    FrameId frameNo;
+    if (!table.tryLookup(it->first.first, it->first.second, frameNo) || frameNo != it->second)
+    {
+      checkTrue(false);
+      return;
+    }
+  }
+  for (PageId pageNo = 1000000; pageNo < 1000100; pageNo++)
+  {
+    FrameId frameNo;
+    checkTrue(!table.tryLookup(files[pageNo % NUM_FILES], pageNo, frameNo));
+  }
+}
+
+/**
+ * Random inserts, lookups and removes on a table sized for ten entries, which
+ * has to grow every partition many times over.
+ */
+static void testGrowing(File* const* files)
+{
+  BufHashTbl table(10);
+  Model model;
+  unsigned int seed = 1;
+
+  // mostly inserts at first, so partitions keep growing, then mostly
+  // removes, so entries are shifted back while later ones migrate
+  for (int round = 0; round < 2; round++)
+  {
+    for (int i = 0; i < 200000; i++)
+    {
+      File* file = files[rand_r(&seed) % NUM_FILES];
+      const PageId pageNo = rand_r(&seed) % 40000;
+      const std::pair<const File*, PageId> key(file, pageNo);
+      const int op = rand_r(&seed) % 10;
+      const bool present = model.count(key) > 0;
+
+      if (op < (round == 0 ? 6 : 2))
+      {
+        if (present)
+        {
+          checkThrows(table.insert(file, pageNo, i), HashAlreadyPresentException);
+        }
+        else
+        {
+          table.insert(file, pageNo, i);
+          model[key] = i;
+        }
+      }
+      else if (op < 8)
+      {
+        if (present)
+        {
+          table.remove(file, pageNo);
+          model.erase(key);
+        }
+        else
+        {
+          checkThrows(table.remove(file, pageNo), HashNotFoundException);
+        }
+      }
+      else
+      {
+        FrameId frameNo = 0;
+        if (present)
+        {
+          table.lookup(file, pageNo, frameNo);
+          checkTrue(frameNo == model[key]);
+        }
+        else
+        {
+          checkThrows(table.lookup(file, pageNo, frameNo), HashNotFoundException);
+        }
+      }
+      if (i % 50000 == 0)
+        checkAll(table, model, files);
+    }
+    checkAll(table, model, files);
+  }
+
+  // reserve() starts growing every partition at once, with entries in them
+  table.reserve(model.size() * 8);
+  for (PageId pageNo = 50000; pageNo < 60000; pageNo++)
+  {
+    table.insert(files[0], pageNo, pageNo);
+    model[std::make_pair(files[0], pageNo)] = pageNo;
+    if (pageNo % 1000 == 500)
+    {
+      table.remove(files[0], pageNo - 1);
+      model.erase(std::make_pair(files[0], pageNo - 1));
+    }
+  }
+  checkAll(table, model, files);
+
+  // and everything can be removed again
+  for (Model::const_iterator it = model.begin(); it != model.end(); ++it)
+    table.remove(it->first.first, it->first.second);
+  Model empty;
+  checkAll(table, empty, files);
+}
+
+/**
+ * Threads insert, look up and remove pages of their own file under the
+ * partition latches, as the buffer manager does, while the table grows.
+ */
+static void testConcurrent(File* const* files)
+{
+  BufHashTbl table(10);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < NUM_FILES; t++)
+  {
+    threads.push_back(std::thread([&table, files, t]() {
+      File* file = files[t];
+      std::vector<FrameId> frames(20000, 0);
+      unsigned int seed = t + 1;
+      for (int i = 0; i < 100000; i++)
+      {
+        const PageId pageNo = 1 + rand_r(&seed) % (frames.size() - 1);
+        std::lock_guard<std::mutex> lock(table.partitionLatch(file, pageNo));
+        FrameId frameNo;
+        const bool found = table.tryLookup(file, pageNo, frameNo);
+        checkTrue(found == (frames[pageNo] != 0));
+        if (found)
+        {
+          checkTrue(frameNo == frames[pageNo]);
+          if (rand_r(&seed) % 3 == 0)
+          {
+            table.remove(file, pageNo);
+            frames[pageNo] = 0;
+          }
+        }
+        else
+        {
+          frames[pageNo] = i + 1;
+          table.insert(file, pageNo, frames[pageNo]);
+        }
+      }
+    }));
+  }
+  for (std::size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+}
+
+int main()
+{
+  File* files[NUM_FILES];
+  for (int i = 0; i < NUM_FILES; i++)
+  {
+    std::ostringstream name;
+    name << "hashtbl_test_" << i;
+    removeFile(name.str());
+    files[i] = new BlobFile(name.str(), true);
+  }
+
+  testGrowing(files);
+  testConcurrent(files);
+
+  for (int i = 0; i < NUM_FILES; i++)
+  {
+    const std::string name = files[i]->filename();
+    delete files[i];
+    File::remove(name);
+  }
+  return testResult("bufhashtbl_test");
+}
@@ -0,0 +1,154 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks that ClockPolicy, which sweeps its packed reference bits a word at a
+ * time, picks the same victims as a clock which looks at one frame after the
+ * other, with pinned frames skipped, for pools which are not a multiple of
+ * 64 frames and while the pool grows and shrinks.
+ */
+
+#include <cstdlib>
+#include <vector>
+#include "test_util.h"
+#include "replacement_policy.h"
+
+using namespace badgerdb;
+
+/**
+ * The textbook clock: the hand moves one frame at a time, clears the bit of a
+ * referenced frame and takes the first unreferenced frame it can claim.
+ */
+struct ModelClock
+{
+  std::vector<bool> refs;
+  FrameId hand;
+
+  ModelClock(const std::uint32_t numBufs) : refs(numBufs, false), hand(numBufs - 1) {}
+
+  bool pick(const std::vector<int>& pins, FrameId& frame)
+  {
+    const std::uint32_t count = refs.size();
+    for (std::uint32_t scanned = 0; scanned < 2*count; scanned++)
+    {
+      hand = (hand + 1) % count;
+      if (refs[hand])
+        refs[hand] = false;
+      else if (pins[hand] == 0)
+      {
+        frame = hand;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void next(std::vector<FrameId>& frames, const std::uint32_t count) const
+  {
+    const std::uint32_t frameCount = refs.size();
+    for (std::uint32_t i = 1; i <= frameCount && frames.size() < count; i++)
+    {
+      const FrameId frameNo = (hand + i) % frameCount;
+      if (!refs[frameNo])
+        frames.push_back(frameNo);
+    }
+  }
+
+  void resize(const std::uint32_t numBufs)
+  {
+    refs.resize(numBufs, false);
+  }
+};
+
+static void run(const std::uint32_t numBufs, const std::uint32_t grownBufs)
+{
+  ReplacementPolicy* policy = ReplacementPolicy::create(CLOCK, numBufs);
+  ModelClock model(numBufs);
+  std::vector<int> pins(grownBufs, 0);
+  ReplacementPolicy::ClaimFunction claim = [&pins](FrameId frame) {
+    if (pins[frame] != 0)
+      return false;
+    pins[frame] = 1;
+    return true;
+  };
+
+  for (FrameId i = 0; i < numBufs; i++)
+  {
+    policy->pageLoaded(i, NULL, i);
+    model.refs[i] = true;
+  }
+
+  unsigned int seed = numBufs;
+  std::uint32_t count = numBufs;
+  for (int i = 0; i < 50000; i++)
+  {
+    if (i == 20000 || i == 40000)
+    {
+      count = i == 20000 ? grownBufs : numBufs;
+      for (FrameId f = count; f < pins.size(); f++)
+        pins[f] = 0;
+      policy->resize(count);
+      model.resize(count);
+    }
+
+    const int op = rand_r(&seed) % 10;
+    const FrameId frameNo = rand_r(&seed) % count;
+    if (op < 4)
+    {
+      policy->pageAccessed(frameNo);
+      model.refs[frameNo] = true;
+    }
+    else if (op < 6)
+    {
+      pins[frameNo] = pins[frameNo] ? 0 : 1;
+    }
+    else if (op < 7)
+    {
+      std::vector<FrameId> frames, expected;
+      const std::uint32_t n = 1 + rand_r(&seed) % 100;
+      policy->nextVictims(frames, n);
+      model.next(expected, n);
+      checkTrue(frames == expected);
+    }
+    else
+    {
+      // evict the victim and load a page into it, as BufMgr does
+      FrameId frame = 0, expected = 0;
+      std::uint32_t scanned;
+      const bool picked = policy->pickVictim(claim, frame, scanned);
+      if (picked)
+        pins[frame] = 0;
+      checkTrue(picked == model.pick(pins, expected));
+      checkTrue(!picked || frame == expected);
+      checkTrue(scanned <= 2*count);
+      if (picked)
+      {
+        policy->pageRemoved(frame, true);
+        policy->pageLoaded(frame, NULL, i);
+        model.refs[frame] = true;
+      }
+    }
+  }
+
+  // with every frame pinned there is no victim, after two sweeps
+  for (FrameId f = 0; f < count; f++)
+    pins[f] = 1;
+  FrameId frame;
+  std::uint32_t scanned;
+  checkTrue(!policy->pickVictim(claim, frame, scanned));
+  checkTrue(scanned == 2*count);
+  delete policy;
+}
+
+int main()
+{
+  run(1, 3);
+  run(63, 64);
+  run(200, 1000);
+  run(1000, 4096);
+  return testResult("clock_policy_test");
+}
@@ -0,0 +1,143 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks the file header kept in memory: two File objects on one file see
+ * each other's page allocations and deletions at once, through the one
+ * cached header, and the header reaches the disk on sync(), on flushFile()
+ * and when the last File object is closed, but not before.  A file opened
+ * again after its last close reads its header from disk afresh.
+ */
+
+#include <fstream>
+#include <string>
+#include "test_util.h"
+#include "buffer.h"
+#include "file_iterator.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+static const char* const NAME = "header_test_file";
+
+/**
+ * Reads the file header as it is on disk.  Its num_pages counts the header
+ * as a page.
+ */
+static FileHeader diskHeader()
+{
+  FileHeader header;
+  std::ifstream in(NAME, std::ios::binary);
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  checkTrue(bool(in));
+  return header;
+}
+
+/**
+ * Counts the used pages of a file by walking them.
+ */
+static PageId usedPages(PageFile* file)
+{
+  PageId count = 0;
+  for (FileIterator it = file->begin(); it != file->end(); ++it)
+    count++;
+  return count;
+}
+
+static void allocate(PageFile* file, const PageId pages)
+{
+  for (PageId i = 0; i < pages; i++)
+  {
+    PageId pageNo;
+    Page page = file->allocatePage(pageNo);
+    page.insertRecord("page " + std::to_string(pageNo));
+    file->writePage(pageNo, page);
+  }
+}
+
+static void testShared()
+{
+  removeFile(NAME);
+  PageFile* a = new PageFile(NAME, true);
+  PageFile* b = new PageFile(NAME, false);
+
+  // pages allocated through one object are there for the other
+  allocate(a, 5);
+  checkTrue(usedPages(b) == 5 && b->getFirstPageNo() == a->getFirstPageNo());
+  const RecordId rid = {3, 1};
+  checkTrue(b->readPage(3).getRecord(rid) == "page 3");
+  b->deletePage(2);
+  checkTrue(usedPages(a) == 4);
+
+  // and a page freed through one is reused through the other
+  allocate(a, 1);
+  checkTrue(usedPages(b) == 5);
+
+  // nothing is written until asked for: the pages are on disk, the header
+  // in front of them is still zeros
+  checkTrue(diskHeader().num_pages == 0);
+  b->sync();
+  FileHeader header = diskHeader();
+  checkTrue(header.num_pages == 6 && header.first_used_page == a->getFirstPageNo());
+
+  // not when one of two objects is closed, but when the last one is
+  allocate(b, 3);
+  delete b;
+  checkTrue(diskHeader().num_pages == 6);
+  delete a;
+  checkTrue(diskHeader().num_pages == 9);
+
+  // a file opened again reads what was written
+  PageFile c(NAME, false);
+  checkTrue(usedPages(&c) == 8);
+}
+
+static void testFlushFile()
+{
+  BufMgr* bufMgr = new BufMgr(20);
+  PageFile* a = new PageFile(NAME, false);
+  PageFile* b = new PageFile(NAME, false);
+
+  // a page allocated through the buffer manager on one object
+  PageId pageNo;
+  Page* page;
+  bufMgr->allocPage(a, pageNo, page);
+  page->insertRecord("new page");
+  bufMgr->unPinPage(a, pageNo, true);
+  checkTrue(usedPages(b) == 9);
+  checkTrue(diskHeader().num_pages == 9);
+
+  // reaches the disk with the flush, with both objects still open
+  bufMgr->flushFile(a);
+  checkTrue(diskHeader().num_pages == 10);
+  const RecordId rid = {pageNo, 1};
+  checkTrue(b->readPage(pageNo).getRecord(rid) == "new page");
+
+  delete bufMgr;
+  delete a;
+  delete b;
+}
+
+static void testReopen()
+{
+  // a file removed and made again under the same name starts out empty
+  File::remove(NAME);
+  PageFile* file = new PageFile(NAME, true);
+  checkTrue(usedPages(file) == 0);
+  delete file;
+  checkTrue(diskHeader().num_pages == 1);
+}
+
+int main()
+{
+  testShared();
+  testFlushFile();
+  testReopen();
+
+  File::remove(NAME);
+  return testResult("file_header_test");
+}
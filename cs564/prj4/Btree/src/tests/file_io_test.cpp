@@ -0,0 +1,430 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks the file backends: bytes written come back, reads stop short at the
+ * end of the file, and writes which fail throw instead of being dropped.  The
+ * buffer manager has to keep a page dirty when writing it fails, so that it
+ * is written once the file can be written again, also when the write was
+ * queued on a ring, and a batched read or a waiting allocation which fails
+ * that way has to give back what it took.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "buffer.h"
+#include "file_io.h"
+#include "io_ring.h"
+#include "page.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/io_error_exception.h"
+
+using namespace badgerdb;
+
+static void testReadWrite(const FileIoType type)
+{
+  removeFile("io_test_file");
+  FileIo* io = FileIo::open(type, "io_test_file", true);
+
+  std::string data(10000, '\0');
+  for (std::size_t i = 0; i < data.size(); i++)
+    data[i] = char(i * 7);
+  io->write(100, &data[0], 5000);
+  struct iovec iov[3] = {{&data[5000], 1}, {&data[5001], 2999}, {&data[8000], 2000}};
+  io->writev(5100, iov, 3);
+
+  std::string back(10000, 'x');
+  checkTrue(io->read(100, &back[0], 10000) == 10000 && back == data);
+  std::string head(100, 'x');
+  checkTrue(io->read(0, &head[0], 100) == 100 && head == std::string(100, '\0'));
+
+  // reads past the end of the file stop there
+  std::string tail(500, 'x');
+  checkTrue(io->read(9900, &tail[0], 500) == 200 && tail.compare(0, 200, data, 9800, 200) == 0);
+  struct iovec tailIov[2] = {{&tail[0], 150}, {&tail[150], 350}};
+  checkTrue(io->readv(9950, tailIov, 2) == 150);
+  checkTrue(io->read(20000, &tail[0], 500) == 0);
+
+  delete io;
+  File::remove("io_test_file");
+}
+
+/**
+ * Writes to /dev/full fail with ENOSPC, like writes to a full disk.
+ */
+static void testFullDisk(const FileIoType type)
+{
+  if (access("/dev/full", W_OK) != 0)
+    return;
+  FileIo* io = FileIo::open(type, "/dev/full", false);
+  std::string data(Page::SIZE, 'a');
+  struct iovec iov[2] = {{&data[0], 100}, {&data[100], data.size() - 100}};
+  try
+  {
+    io->write(0, &data[0], data.size());
+    checkTrue(false);
+  }
+  catch (const IoErrorException& e)
+  {
+    checkTrue(type == STREAM_IO || e.error() == ENOSPC);
+    checkTrue(e.filename() == "/dev/full");
+  }
+  checkThrows(io->writev(0, iov, 2), IoErrorException);
+  // and the backend can still be used
+  checkThrows(io->write(0, &data[0], 1), IoErrorException);
+  delete io;
+}
+
+/**
+ * Makes writes to a file fail with EBADF while in scope, by putting a read
+ * only descriptor for the file in place of the one the backend uses.
+ */
+class FailWrites
+{
+ public:
+  FailWrites(const std::string& name) : fd(-1), saved(-1)
+  {
+    char path[PATH_MAX];
+    if (realpath(name.c_str(), path) == NULL)
+      return;
+    DIR* dir = opendir("/proc/self/fd");
+    for (struct dirent* entry; dir != NULL && (entry = readdir(dir)) != NULL; )
+    {
+      const std::string link = std::string("/proc/self/fd/") + entry->d_name;
+      char target[PATH_MAX];
+      const ssize_t n = readlink(link.c_str(), target, sizeof(target) - 1);
+      if (n > 0 && std::string(target, n) == path)
+        fd = atoi(entry->d_name);
+    }
+    if (dir != NULL)
+      closedir(dir);
+    if (fd < 0)
+      return;
+    saved = dup(fd);
+    const int readOnly = open(path, O_RDONLY);
+    dup2(readOnly, fd);
+    close(readOnly);
+  }
+
+  ~FailWrites()
+  {
+    if (saved >= 0)
+    {
+      dup2(saved, fd);
+      close(saved);
+    }
+  }
+
+  bool active() const { return saved >= 0; }
+
+ private:
+  int fd, saved;
+};
+
+static std::string readRecord(Page* page, const PageId pageNo)
+{
+  const RecordId rid = {pageNo, 1};
+  return page->getRecord(rid);
+}
+
+static void testKeptDirty()
+{
+  removeFile("io_test_file");
+  PageFile* file = new PageFile("io_test_file", true);
+  BufMgr* bufMgr = new BufMgr(4);
+  const int numPages = 8;
+
+  for (int i = 0; i < numPages; i++)
+  {
+    PageId pageNo;
+    Page* page;
+    bufMgr->allocPage(file, pageNo, page);
+    page->insertRecord("before");
+    bufMgr->unPinPage(file, pageNo, true);
+  }
+  bufMgr->flushFile(file);
+
+  // two pages get changed while the file cannot be written
+  {
+    FailWrites failing("io_test_file");
+    checkTrue(failing.active());
+    for (PageId pageNo = 1; pageNo <= 2; pageNo++)
+    {
+      Page* page;
+      bufMgr->readPage(file, pageNo, page);
+      const RecordId rid = {pageNo, 1};
+      page->updateRecord(rid, "after");
+      bufMgr->unPinPage(file, pageNo, true);
+    }
+    checkThrows(bufMgr->checkpoint(), IoErrorException);
+    checkThrows(bufMgr->flushFile(file), IoErrorException);
+
+    // evicting the changed pages fails too, and leaves them in place
+    int failed = 0;
+    for (PageId pageNo = 3; pageNo <= numPages; pageNo++)
+    {
+      Page* page;
+      try
+      {
+        bufMgr->readPage(file, pageNo, page);
+        bufMgr->unPinPage(file, pageNo, false);
+      }
+      catch (const IoErrorException&)
+      {
+        failed++;
+      }
+    }
+    checkTrue(failed > 0);
+
+    for (PageId pageNo = 1; pageNo <= 2; pageNo++)
+    {
+      Page* page;
+      bufMgr->readPage(file, pageNo, page);
+      checkTrue(readRecord(page, pageNo) == "after");
+      bufMgr->unPinPage(file, pageNo, false);
+    }
+  }
+
+  // once the file can be written again, the changes make it to disk
+  bufMgr->flushFile(file);
+  delete bufMgr;
+  {
+    PageFile check = PageFile::open("io_test_file");
+    for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+    {
+      Page onDisk = check.readPage(pageNo);
+      checkTrue(readRecord(&onDisk, pageNo) == (pageNo <= 2 ? "after" : "before"));
+    }
+  }
+  delete file;
+  File::remove("io_test_file");
+}
+
+/**
+ * A batched read which cannot write out a dirty victim gives back the frames
+ * it had taken for the pages before it.
+ */
+static void testReadPagesFailedEviction()
+{
+  removeFile("io_test_file");
+  removeFile("io_test_other");
+  PageFile* file = new PageFile("io_test_file", true);
+  PageFile* other = new PageFile("io_test_other", true);
+  const std::uint32_t numFrames = 8;
+  BufMgr* bufMgr = new BufMgr(numFrames);
+
+  // half the pool clean pages, the other half dirty pages of another file
+  for (std::uint32_t i = 0; i < 2 * numFrames; i++)
+  {
+    PageId pageNo;
+    Page* page;
+    bufMgr->allocPage(file, pageNo, page);
+    page->insertRecord("before");
+    bufMgr->unPinPage(file, pageNo, true);
+  }
+  bufMgr->flushFile(file);
+  for (PageId pageNo = 1; pageNo <= numFrames / 2; pageNo++)
+  {
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    bufMgr->unPinPage(file, pageNo, false);
+  }
+  for (std::uint32_t i = 0; i < numFrames / 2; i++)
+  {
+    PageId pageNo;
+    Page* page;
+    bufMgr->allocPage(other, pageNo, page);
+    page->insertRecord("other");
+    bufMgr->unPinPage(other, pageNo, true);
+  }
+
+  std::vector<PageId> pageIds;
+  for (PageId pageNo = numFrames + 1; pageNo <= 2 * numFrames; pageNo++)
+    pageIds.push_back(pageNo);
+  std::vector<Page*> pages;
+  {
+    FailWrites failing("io_test_other");
+    checkTrue(failing.active());
+    checkThrows(bufMgr->readPages(file, pageIds, pages), IoErrorException);
+  }
+
+  // every frame can still be pinned at once
+  try
+  {
+    bufMgr->readPages(file, pageIds, pages);
+  }
+  catch (const BufferExceededException&)
+  {
+    std::cout << "Test FAILS: frames lost by a failed readPages()\n";
+    testFailures++;
+    return;
+  }
+  for (std::size_t i = 0; i < pageIds.size(); i++)
+  {
+    checkTrue(readRecord(pages[i], pageIds[i]) == "before");
+    bufMgr->unPinPage(file, pageIds[i], false);
+  }
+
+  // and the pages which could not be written were not lost
+  bufMgr->flushFile(other);
+  delete bufMgr;
+  {
+    PageFile check = PageFile::open("io_test_other");
+    for (PageId pageNo = 1; pageNo <= numFrames / 2; pageNo++)
+    {
+      Page onDisk = check.readPage(pageNo);
+      checkTrue(readRecord(&onDisk, pageNo) == "other");
+    }
+  }
+  delete other;
+  delete file;
+  File::remove("io_test_other");
+  File::remove("io_test_file");
+}
+
+/**
+ * An allocation which waited for a frame and then cannot write out the dirty
+ * page unpinned in it stops waiting all the same.
+ */
+static void testWaitFailedEviction()
+{
+  removeFile("io_test_file");
+  removeFile("io_test_other");
+  PageFile* file = new PageFile("io_test_file", true);
+  PageFile* other = new PageFile("io_test_other", true);
+  PageId pageNo;
+  file->allocatePage(pageNo);
+  const std::uint32_t numFrames = 4;
+  BufMgr* bufMgr = new BufMgr(numFrames);
+  bufMgr->setAllocWaitTimeout(5000000);
+
+  // every frame pinned, dirty
+  std::vector<PageId> pinned;
+  for (std::uint32_t i = 0; i < numFrames; i++)
+  {
+    Page* page;
+    bufMgr->allocPage(other, pageNo, page);
+    page->insertRecord("other");
+    pinned.push_back(pageNo);
+  }
+
+  std::atomic<bool> failed(false);
+  std::thread reader([bufMgr, file, &failed]() {
+    Page* page;
+    try
+    {
+      bufMgr->readPage(file, 1, page);
+      bufMgr->unPinPage(file, 1, false);
+    }
+    catch (const IoErrorException&)
+    {
+      failed = true;
+    }
+  });
+  while (bufMgr->getStatsSnapshot().allocWaits == 0)
+    std::this_thread::yield();
+  {
+    FailWrites failing("io_test_other");
+    checkTrue(failing.active());
+    bufMgr->unPinPage(other, pinned[0], true);
+    reader.join();
+  }
+  checkTrue(failed);
+  const BufStatsSnapshot stats = bufMgr->getStatsSnapshot();
+  checkTrue(stats.allocWaits == 1 && stats.allocWaitTime.count == 1);
+
+  for (std::size_t i = 1; i < pinned.size(); i++)
+    bufMgr->unPinPage(other, pinned[i], true);
+  bufMgr->flushFile(other);
+  delete bufMgr;
+  delete other;
+  delete file;
+  File::remove("io_test_other");
+  File::remove("io_test_file");
+}
+
+/**
+ * Checkpoints which queue their writes on a ring learn of a failed write from
+ * its completion, and have to keep the page dirty all the same.
+ */
+static void testQueuedKeptDirty()
+{
+  if (!IoRing::supported())
+    return;
+  removeFile("io_test_file");
+  BlobFile* file = new BlobFile("io_test_file", true);
+  BufMgr* bufMgr = new BufMgr(16);
+  checkTrue(bufMgr->setIoDepth(4));
+  const int numPages = 8;
+
+  for (int i = 0; i < numPages; i++)
+  {
+    PageId pageNo;
+    Page* page;
+    bufMgr->allocPage(file, pageNo, page);
+    reinterpret_cast<char*>(page)[100] = 'b';
+    bufMgr->unPinPage(file, pageNo, true);
+  }
+  bufMgr->checkpoint();
+
+  {
+    FailWrites failing("io_test_file");
+    checkTrue(failing.active());
+    for (PageId pageNo = 1; pageNo <= numPages; pageNo += 3)
+    {
+      Page* page;
+      bufMgr->readPage(file, pageNo, page);
+      reinterpret_cast<char*>(page)[100] = 'a';
+      bufMgr->unPinPage(file, pageNo, true);
+    }
+    try
+    {
+      bufMgr->checkpoint();
+      checkTrue(false);
+    }
+    catch (const IoErrorException& e)
+    {
+      checkTrue(e.filename() == "io_test_file" && e.error() == EBADF);
+    }
+  }
+
+  bufMgr->checkpoint();
+  Page onDisk;
+  for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+  {
+    file->readPage(pageNo, onDisk);
+    checkTrue(reinterpret_cast<char*>(&onDisk)[100] == ((pageNo - 1) % 3 == 0 ? 'a' : 'b'));
+  }
+  delete bufMgr;
+  delete file;
+  File::remove("io_test_file");
+}
+
+int main()
+{
+  const FileIoType types[] = {POSIX_IO, STREAM_IO};
+  for (std::size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+  {
+    testReadWrite(types[i]);
+    testFullDisk(types[i]);
+  }
+  testKeptDirty();
+  testReadPagesFailedEviction();
+  testWaitFailedEviction();
+  testQueuedKeptDirty();
+  return testResult("file_io_test");
+}
@@ -0,0 +1,27 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include "file.h"
+#include "exceptions/file_not_found_exception.h"
+
+/**
+ * Deletes a file left behind by an earlier run, if there is one.  Shared by
+ * the tests and the benchmarks.
+ */
+static inline void removeFile(const std::string& name)
+{
+  try
+  {
+    badgerdb::File::remove(name);
+  }
+  catch (const badgerdb::FileNotFoundException&)
+  {
+  }
+}
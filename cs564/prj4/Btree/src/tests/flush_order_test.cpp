@@ -0,0 +1,186 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks the per-file frame lists behind flushFile(): flushing a file writes
+ * its dirty pages only, in ascending page order with neighbouring pages in
+ * one write, whatever order they were dirtied in, and leaves the pages of
+ * other files in the pool.  Pages evicted before the flush, or dirtied again
+ * after being written, are tracked as well.
+ */
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "test_util.h"
+#include "buffer.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+static const std::uint32_t NUM_FRAMES = 40;
+static const PageId NUM_PAGES = 60;
+
+/**
+ * A page file which remembers the writes made to it, as the first page
+ * number and the number of pages of each.
+ */
+class RecordingFile : public PageFile
+{
+ public:
+  RecordingFile(const std::string& name)
+    : PageFile(name, false)
+  {
+  }
+
+  void writePage(const PageId page_number, const Page& new_page)
+  {
+    writes.push_back(std::make_pair(page_number, std::size_t(1)));
+    PageFile::writePage(page_number, new_page);
+  }
+
+  void writePages(const PageId first_page_number, const std::vector<const Page*>& pages)
+  {
+    writes.push_back(std::make_pair(first_page_number, pages.size()));
+    PageFile::writePages(first_page_number, pages);
+  }
+
+  std::vector<std::pair<PageId, std::size_t> > writes;
+};
+
+static void createFile(const std::string& name)
+{
+  removeFile(name);
+  PageFile file(name, true);
+  for (PageId i = 0; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    Page page = file.allocatePage(pageNo);
+    page.insertRecord("clean");
+    file.writePage(pageNo, page);
+  }
+}
+
+/**
+ * Reads the page and unpins it, changed if dirty is set.
+ */
+static void touch(BufMgr* bufMgr, File* file, const PageId pageNo, const bool dirty)
+{
+  Page* page;
+  bufMgr->readPage(file, pageNo, page);
+  if (dirty)
+    page->insertRecord("dirty " + std::to_string(pageNo));
+  bufMgr->unPinPage(file, pageNo, dirty);
+}
+
+/**
+ * Whether the page is in the pool, found by reading it: a hit or a miss.
+ */
+static bool resident(BufMgr* bufMgr, File* file, const PageId pageNo)
+{
+  const std::uint64_t hits = bufMgr->getStatsSnapshot().hits;
+  touch(bufMgr, file, pageNo, false);
+  return bufMgr->getStatsSnapshot().hits > hits;
+}
+
+static void testFlushOrder(BufMgr* bufMgr, RecordingFile* a, RecordingFile* b)
+{
+  // dirtied out of order, with clean pages and pages of another file between
+  const PageId dirtyPages[] = {40, 7, 23, 9, 2, 8, 31, 24};
+  for (std::size_t i = 0; i < sizeof(dirtyPages) / sizeof(dirtyPages[0]); i++)
+  {
+    touch(bufMgr, a, dirtyPages[i], true);
+    touch(bufMgr, a, dirtyPages[i] + 10, false);
+    touch(bufMgr, b, dirtyPages[i], true);
+  }
+
+  bufMgr->clearBufStats();
+  bufMgr->flushFile(a);
+
+  // runs in ascending order: 2, 7-9, 23-24, 31, 40
+  std::vector<std::pair<PageId, std::size_t> > expected;
+  expected.push_back(std::make_pair(PageId(2), std::size_t(1)));
+  expected.push_back(std::make_pair(PageId(7), std::size_t(3)));
+  expected.push_back(std::make_pair(PageId(23), std::size_t(2)));
+  expected.push_back(std::make_pair(PageId(31), std::size_t(1)));
+  expected.push_back(std::make_pair(PageId(40), std::size_t(1)));
+  checkTrue(a->writes == expected);
+  checkTrue(b->writes.empty());
+  checkTrue(bufMgr->getStatsSnapshot().diskwrites == 8);
+
+  // what was written is what was changed
+  for (std::size_t i = 0; i < sizeof(dirtyPages) / sizeof(dirtyPages[0]); i++)
+  {
+    const Page page = a->readPage(dirtyPages[i]);
+    const RecordId rid = {dirtyPages[i], 2};
+    checkTrue(page.getRecord(rid) == "dirty " + std::to_string(dirtyPages[i]));
+  }
+
+  // no page of the flushed file is left, every page of the other one is
+  checkTrue(!resident(bufMgr, a, 7) && !resident(bufMgr, a, 17));
+  for (std::size_t i = 0; i < sizeof(dirtyPages) / sizeof(dirtyPages[0]); i++)
+    checkTrue(resident(bufMgr, b, dirtyPages[i]));
+  bufMgr->flushFile(a);
+  a->writes.clear();
+
+  bufMgr->flushFile(b);
+  checkTrue(b->writes.size() == 5);
+  b->writes.clear();
+
+  // a file with nothing in the pool has nothing to write
+  bufMgr->flushFile(a);
+  checkTrue(a->writes.empty());
+}
+
+static void testEvicted(BufMgr* bufMgr, RecordingFile* a, RecordingFile* b)
+{
+  // dirty pages of a pushed out by the pages of b
+  for (PageId pageNo = 1; pageNo <= 10; pageNo++)
+    touch(bufMgr, a, pageNo, true);
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+    touch(bufMgr, b, pageNo, false);
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+    touch(bufMgr, b, pageNo, false);
+  std::size_t written = 0;
+  for (std::size_t i = 0; i < a->writes.size(); i++)
+  {
+    written += a->writes[i].second;
+    checkTrue(a->writes[i].first >= 1 && a->writes[i].first + a->writes[i].second <= 11);
+  }
+  checkTrue(written == 10);
+
+  // written back when they went, so only a page dirtied again after that
+  // goes out in the flush
+  touch(bufMgr, a, 5, true);
+  a->writes.clear();
+  bufMgr->flushFile(a);
+  checkTrue(a->writes.size() == 1 && a->writes[0].first == 5 && a->writes[0].second == 1);
+  a->writes.clear();
+
+  bufMgr->flushFile(b);
+  checkTrue(b->writes.empty());
+}
+
+int main()
+{
+  createFile("flush_order_a");
+  createFile("flush_order_b");
+  BufMgr* bufMgr = new BufMgr(NUM_FRAMES);
+  bufMgr->setReadahead(0);
+  RecordingFile* a = new RecordingFile("flush_order_a");
+  RecordingFile* b = new RecordingFile("flush_order_b");
+
+  testFlushOrder(bufMgr, a, b);
+  testEvicted(bufMgr, a, b);
+
+  delete bufMgr;
+  delete a;
+  delete b;
+  File::remove("flush_order_a");
+  File::remove("flush_order_b");
+  return testResult("flush_order_test");
+}
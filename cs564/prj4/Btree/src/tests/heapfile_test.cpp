@@ -0,0 +1,180 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks a HeapFile: records inserted can be read back, space freed by
+ * deletes is reused before the relation grows, the free-space map saved by
+ * close() spares the next insert a pass over the relation unless the file
+ * changed meanwhile, and closing the relation while a page of it is pinned
+ * throws from close() but not from the destructor.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include "test_util.h"
+#include "buffer.h"
+#include "heapfile.h"
+#include "exceptions/invalid_record_exception.h"
+#include "exceptions/page_pinned_exception.h"
+
+using namespace badgerdb;
+
+static const int NUM_RECORDS = 5000;
+
+static std::string makeRecord(const int key)
+{
+  std::string record = "record " + std::to_string(key) + " ";
+  record.resize(60 + key % 40, char('a' + key % 26));
+  return record;
+}
+
+/**
+ * Highest page number holding one of the records.
+ */
+static PageId lastPage(const std::map<int, RecordId>& records)
+{
+  PageId last = 0;
+  for (std::map<int, RecordId>::const_iterator it = records.begin(); it != records.end(); ++it)
+    last = std::max(last, it->second.page_number);
+  return last;
+}
+
+static void checkRecords(HeapFile& heap, const std::map<int, RecordId>& records)
+{
+  for (std::map<int, RecordId>::const_iterator it = records.begin(); it != records.end(); ++it)
+    checkTrue(heap.getRecord(it->second) == makeRecord(it->first));
+}
+
+static void testReuse(BufMgr* bufMgr)
+{
+  removeFile("heap_test_file");
+  std::map<int, RecordId> records;
+  PageId pages;
+  {
+    HeapFile heap("heap_test_file", bufMgr, true);
+    for (int key = 0; key < NUM_RECORDS; key++)
+      records[key] = heap.insertRecord(makeRecord(key));
+    pages = lastPage(records);
+    checkRecords(heap, records);
+
+    // every other record, so that every page gets room
+    for (int key = 0; key < NUM_RECORDS; key += 2)
+    {
+      heap.deleteRecord(records[key]);
+      checkThrows(heap.getRecord(records[key]), InvalidRecordException);
+      records.erase(key);
+    }
+    checkRecords(heap, records);
+
+    // as many records again fit on the pages there are
+    for (int key = NUM_RECORDS; key < NUM_RECORDS + NUM_RECORDS / 2; key++)
+      records[key] = heap.insertRecord(makeRecord(key));
+    checkTrue(lastPage(records) == pages);
+    checkRecords(heap, records);
+    heap.close();
+  }
+
+  // and all of it made it to disk
+  HeapFile heap("heap_test_file", bufMgr);
+  checkRecords(heap, records);
+  const RecordId rid = heap.insertRecord(makeRecord(0));
+  checkTrue(rid.page_number <= pages);
+}
+
+/**
+ * Reopens the relation and inserts a record, returning the number of pages
+ * read from disk on the way.
+ */
+static std::uint64_t readsForInsert(BufMgr* bufMgr, std::map<int, RecordId>& records, const int key)
+{
+  HeapFile heap("heap_test_file", bufMgr);
+  bufMgr->clearBufStats();
+  records[key] = heap.insertRecord(makeRecord(key));
+  const std::uint64_t reads = bufMgr->getStatsSnapshot().diskreads;
+  checkRecords(heap, records);
+  heap.close();
+  return reads;
+}
+
+static void testSavedMap(BufMgr* bufMgr)
+{
+  removeFile("heap_test_file");
+  std::map<int, RecordId> records;
+  {
+    HeapFile heap("heap_test_file", bufMgr, true);
+    for (int key = 0; key < NUM_RECORDS; key++)
+      records[key] = heap.insertRecord(makeRecord(key));
+    for (int key = 0; key < NUM_RECORDS; key += 2)
+    {
+      heap.deleteRecord(records[key]);
+      records.erase(key);
+    }
+    heap.close();
+  }
+  const PageId pages = lastPage(records);
+  const std::string map = HeapFile::mapName("heap_test_file");
+  checkTrue(File::exists(map));
+
+  // the saved map leads the insert straight to a page with room
+  checkTrue(readsForInsert(bufMgr, records, 0) == 1);
+  checkTrue(File::exists(map));
+
+  // with the file changed behind the map's back, or the map gone, it is
+  // built again with a pass over the relation
+  {
+    PageFile file = PageFile::open("heap_test_file");
+    PageId pageNo;
+    file.allocatePage(pageNo);
+  }
+  checkTrue(readsForInsert(bufMgr, records, 2) >= pages);
+  std::remove(map.c_str());
+  checkTrue(readsForInsert(bufMgr, records, 4) >= pages);
+  checkTrue(readsForInsert(bufMgr, records, 6) == 1);
+  HeapFile::remove("heap_test_file");
+  checkTrue(!File::exists(map));
+}
+
+static void testClosePinned(BufMgr* bufMgr)
+{
+  removeFile("heap_test_file");
+  HeapFile* heap = new HeapFile("heap_test_file", bufMgr, true);
+  const RecordId rid = heap->insertRecord(makeRecord(1));
+  File* file = heap->getFile();
+
+  // a page pinned by somebody else keeps the relation open
+  Page* page;
+  bufMgr->readPage(file, rid.page_number, page);
+  checkThrows(heap->close(), PagePinnedException);
+  bufMgr->unPinPage(file, rid.page_number, false);
+  heap->close();
+  heap->close();
+  delete heap;
+
+  // the destructor cannot throw, and leaves the file to the pages in the pool
+  heap = new HeapFile("heap_test_file", bufMgr);
+  checkTrue(heap->getRecord(rid) == makeRecord(1));
+  file = heap->getFile();
+  bufMgr->readPage(file, rid.page_number, page);
+  delete heap;
+  bufMgr->unPinPage(file, rid.page_number, false);
+  bufMgr->flushFile(file);
+  checkTrue(File::isOpen("heap_test_file"));
+  delete file;
+  HeapFile::remove("heap_test_file");
+}
+
+int main()
+{
+  BufMgr* bufMgr = new BufMgr(100);
+  testReuse(bufMgr);
+  testSavedMap(bufMgr);
+  testClosePinned(bufMgr);
+  delete bufMgr;
+  return testResult("heapfile_test");
+}
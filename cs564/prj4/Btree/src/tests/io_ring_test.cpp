@@ -0,0 +1,264 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks reads and writes queued on an IoRing: reads through the kernel, the
+ * aligned bounce buffers of O_DIRECT reads, reads which stop short at the end
+ * of the file, and writes done at once which report how they went.  Also
+ * checks that O_DIRECT writes of part of a block keep the rest of the block.
+ */
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "buffer.h"
+#include "file_io.h"
+#include "io_ring.h"
+#include "page.h"
+#include "exceptions/io_error_exception.h"
+
+using namespace badgerdb;
+
+static const std::size_t BLOCK = DirectFileIo::BLOCK_SIZE;
+
+/**
+ * Contents of the test file, which no two blocks share.
+ */
+static std::string pattern(const std::size_t length)
+{
+  std::string data(length, '\0');
+  for (std::size_t i = 0; i < length; i++)
+    data[i] = char(i * 7 + i / BLOCK);
+  return data;
+}
+
+/**
+ * Waits for the next request on a ring.
+ */
+static IoCompletion next(IoRing& ring)
+{
+  IoCompletion done = {0, 0};
+  checkTrue(ring.complete(done, true));
+  return done;
+}
+
+static void testQueuedReads(const FileIoType type)
+{
+  removeFile("ring_test_file");
+  FileIo* io = FileIo::open(type, "ring_test_file", true);
+  const std::string data = pattern(5 * BLOCK + 300);
+  io->write(0, &data[0], data.size());
+  IoRing* ring = IoRing::create(8);
+
+  // requests at unaligned positions, spread over several buffers and blocks,
+  // in flight at once
+  const std::uint64_t offsets[] = {16, BLOCK - 1, 2 * BLOCK, 3 * BLOCK + 100};
+  const std::size_t lengths[] = {100, 2 * BLOCK + 2, BLOCK, BLOCK + 150};
+  const int requests = sizeof(offsets) / sizeof(offsets[0]);
+  std::vector<std::string> back(requests);
+  std::vector<struct iovec> iov(2 * requests);
+  for (int i = 0; i < requests; i++)
+  {
+    back[i].assign(lengths[i], 'x');
+    iov[2 * i].iov_base = &back[i][0];
+    iov[2 * i].iov_len = lengths[i] / 3;
+    iov[2 * i + 1].iov_base = &back[i][lengths[i] / 3];
+    iov[2 * i + 1].iov_len = lengths[i] - lengths[i] / 3;
+    io->queueReadv(*ring, i, offsets[i], &iov[2 * i], 2);
+  }
+  checkTrue(ring->outstanding() == unsigned(requests));
+  std::vector<bool> seen(requests, false);
+  for (int i = 0; i < requests; i++)
+  {
+    const IoCompletion done = next(*ring);
+    checkTrue(done.tag < std::uint64_t(requests) && !seen[done.tag]);
+    seen[done.tag] = true;
+    checkTrue(done.result == std::int64_t(lengths[done.tag]));
+    checkTrue(back[done.tag] == data.substr(offsets[done.tag], lengths[done.tag]));
+  }
+  checkTrue(ring->outstanding() == 0);
+
+  // the end of the file cuts a read short, counting only bytes asked for,
+  // and a read past it transfers nothing
+  std::string tail(1000, 'x');
+  const struct iovec tailIov = {&tail[0], tail.size()};
+  io->queueReadv(*ring, 7, data.size() - 200, &tailIov, 1);
+  IoCompletion done = next(*ring);
+  checkTrue(done.tag == 7 && done.result == 200);
+  checkTrue(tail.compare(0, 200, data, data.size() - 200, 200) == 0);
+  checkTrue(tail.compare(200, 800, std::string(800, 'x')) == 0);
+  io->queueReadv(*ring, 8, data.size() + 10, &tailIov, 1);
+  done = next(*ring);
+  checkTrue(done.tag == 8 && done.result == 0);
+
+  delete ring;
+  delete io;
+  File::remove("ring_test_file");
+}
+
+static void testBounceBuffers()
+{
+  removeFile("ring_test_file");
+  FileIo* io = FileIo::open(POSIX_IO, "ring_test_file", true);
+  const std::string data = pattern(3 * BLOCK);
+  io->write(0, &data[0], data.size());
+  IoRing* ring = IoRing::create(2);
+
+  // the ring reads whole aligned blocks and copies out the bytes asked for;
+  // which it has to do for O_DIRECT, but works on any descriptor
+  std::string back(BLOCK + 10, 'x');
+  const struct iovec iov[2] = {{&back[0], 10}, {&back[10], BLOCK}};
+  int fd = ::open("ring_test_file", O_RDONLY);
+  ring->queueRead(fd, BLOCK - 5, iov, 2, 3, BLOCK);
+  IoCompletion done = next(*ring);
+  checkTrue(done.tag == 3 && done.result == std::int64_t(BLOCK + 10));
+  checkTrue(back == data.substr(BLOCK - 5, BLOCK + 10));
+
+  // past the end the result is capped at the bytes of the file asked for
+  std::string tail(BLOCK, 'x');
+  const struct iovec tailIov = {&tail[0], tail.size()};
+  ring->queueRead(fd, 2 * BLOCK + 100, &tailIov, 1, 4, BLOCK);
+  done = next(*ring);
+  checkTrue(done.tag == 4 && done.result == std::int64_t(BLOCK - 100));
+  checkTrue(tail.compare(0, BLOCK - 100, data, 2 * BLOCK + 100, BLOCK - 100) == 0);
+
+  // errors are passed on, and nothing is copied
+  close(fd);
+  fd = ::open("ring_test_file", O_WRONLY);
+  ring->queueRead(fd, 10, &tailIov, 1, 5, BLOCK);
+  tail.assign(BLOCK, 'x');
+  done = next(*ring);
+  checkTrue(done.tag == 5 && done.result == -EBADF);
+  checkTrue(tail == std::string(BLOCK, 'x'));
+  close(fd);
+
+  delete ring;
+  delete io;
+  File::remove("ring_test_file");
+}
+
+static void testDirectWrites()
+{
+  removeFile("ring_test_file");
+  FileIo* io = FileIo::open(DIRECT_IO, "ring_test_file", true);
+  std::string data = pattern(4 * BLOCK + 500);
+  io->write(0, &data[0], data.size());
+
+  // writes of part of a block, inside one block, across a block boundary,
+  // and over the partial last block
+  const std::uint64_t offsets[] = {10, BLOCK - 20, 3 * BLOCK + 4000, 4 * BLOCK + 100};
+  const std::size_t lengths[] = {30, 50, 200, 100};
+  for (std::size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++)
+  {
+    const std::string bytes(lengths[i], char('A' + i));
+    const struct iovec iov[2] = {{const_cast<char*>(&bytes[0]), 1},
+                                 {const_cast<char*>(&bytes[1]), bytes.size() - 1}};
+    io->writev(offsets[i], iov, 2);
+    data.replace(offsets[i], lengths[i], bytes);
+  }
+  std::string back(data.size() + 100, 'x');
+  checkTrue(io->read(0, &back[0], back.size()) == data.size());
+  checkTrue(back.compare(0, data.size(), data) == 0);
+
+  // a write past the end of the file leaves zeros before it
+  const std::string bytes(300, 'Z');
+  io->write(6 * BLOCK + 50, &bytes[0], bytes.size());
+  data.resize(6 * BLOCK + 50, '\0');
+  data += bytes;
+  back.assign(data.size(), 'x');
+  checkTrue(io->read(0, &back[0], back.size()) == data.size() && back == data);
+
+  // a write queued on a ring is done at once, and posts its length
+  IoRing* ring = IoRing::create(1);
+  const struct iovec iov = {const_cast<char*>(&bytes[0]), 100};
+  io->queueWritev(*ring, 9, 2 * BLOCK + 7, &iov, 1);
+  const IoCompletion done = next(*ring);
+  checkTrue(done.tag == 9 && done.result == 100);
+  data.replace(2 * BLOCK + 7, 100, bytes, 0, 100);
+  checkTrue(io->read(0, &back[0], back.size()) == data.size() && back == data);
+
+  delete ring;
+  delete io;
+  File::remove("ring_test_file");
+}
+
+/**
+ * A queued write which fails posts the negated errno value instead of the
+ * length, which is how the buffer manager learns to keep the pages dirty.
+ */
+static void testFailedQueuedWrite(const FileIoType type)
+{
+  if (access("/dev/full", W_OK) != 0)
+    return;
+  FileIo* io = FileIo::open(type, "/dev/full", false);
+  IoRing* ring = IoRing::create(1);
+  std::string data(Page::SIZE, 'a');
+  const struct iovec iov[2] = {{&data[0], 100}, {&data[100], data.size() - 100}};
+  io->queueWritev(*ring, 11, 0, iov, 2);
+  const IoCompletion done = next(*ring);
+  checkTrue(done.tag == 11 && done.result < 0);
+  checkTrue(type == STREAM_IO || done.result == -ENOSPC);
+  delete ring;
+  delete io;
+}
+
+/**
+ * Checkpoints through a ring write every dirty page of a BlobFile, which
+ * queues its writes on the ring.
+ */
+static void testCheckpoint(const FileIoType type)
+{
+  removeFile("ring_test_file");
+  BlobFile* file = new BlobFile("ring_test_file", true, type);
+  BufMgr* bufMgr = new BufMgr(64);
+  checkTrue(bufMgr->setIoDepth(4));
+  const int numPages = 48;
+
+  for (int i = 0; i < numPages; i++)
+  {
+    PageId pageNo;
+    Page* page;
+    bufMgr->allocPage(file, pageNo, page);
+    reinterpret_cast<char*>(page)[100] = char(pageNo);
+    bufMgr->unPinPage(file, pageNo, true);
+  }
+  bufMgr->checkpoint();
+  checkTrue(bufMgr->getStatsSnapshot().asyncRequests > 0);
+
+  Page onDisk;
+  for (PageId pageNo = 1; pageNo <= PageId(numPages); pageNo++)
+  {
+    file->readPage(pageNo, onDisk);
+    checkTrue(reinterpret_cast<char*>(&onDisk)[100] == char(pageNo));
+  }
+  delete bufMgr;
+  delete file;
+  File::remove("ring_test_file");
+}
+
+int main()
+{
+  if (!IoRing::supported())
+  {
+    std::cout << "io_ring_test: no io_uring, skipped\n";
+    return 0;
+  }
+  const FileIoType types[] = {POSIX_IO, DIRECT_IO, STREAM_IO};
+  for (std::size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+  {
+    testQueuedReads(types[i]);
+    testFailedQueuedWrite(types[i]);
+    testCheckpoint(types[i]);
+  }
+  testBounceBuffers();
+  testDirectWrites();
+  return testResult("io_ring_test");
+}
@@ -0,0 +1,190 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks that an MmapFile reads what a PageFile wrote, that the buffer
+ * manager hands out its pages in place without using frames, and that
+ * everything which would change the file is rejected and leaves it as it was.
+ */
+
+#include <string>
+#include <vector>
+#include "test_util.h"
+#include "buffer.h"
+#include "file.h"
+#include "filescan.h"
+#include "page.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/read_only_file_exception.h"
+
+using namespace badgerdb;
+
+static const PageId NUM_PAGES = 20;
+
+static std::string recordFor(const PageId pageNo)
+{
+  return std::string("record on page ") + std::to_string(pageNo);
+}
+
+static std::string readRecord(const Page* page, const PageId pageNo)
+{
+  const RecordId rid = {pageNo, 1};
+  return page->getRecord(rid);
+}
+
+/**
+ * Every page of the relation holds the same record as when it was written.
+ */
+static void checkUnchanged()
+{
+  PageFile file = PageFile::open("mmap_test_file");
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+  {
+    Page page = file.readPage(pageNo);
+    checkTrue(readRecord(&page, pageNo) == recordFor(pageNo));
+  }
+}
+
+static void testReads(MmapFile& mapped)
+{
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+  {
+    Page page = mapped.readPage(pageNo);
+    checkTrue(readRecord(&page, pageNo) == recordFor(pageNo));
+    checkTrue(readRecord(mapped.mappedPage(pageNo), pageNo) == recordFor(pageNo));
+  }
+
+  std::vector<Page> pages(5);
+  std::vector<Page*> pointers;
+  for (std::size_t i = 0; i < pages.size(); i++)
+    pointers.push_back(&pages[i]);
+  mapped.readPages(3, pointers);
+  for (std::size_t i = 0; i < pages.size(); i++)
+    checkTrue(readRecord(&pages[i], 3 + i) == recordFor(3 + i));
+
+  // the iterator walks the used pages in order
+  PageId expected = 1;
+  for (FileIterator it = mapped.begin(); it != mapped.end(); ++it)
+    checkTrue((*it).page_number() == expected++);
+  checkTrue(expected == NUM_PAGES + 1);
+}
+
+static void testWritesRejected(MmapFile& mapped)
+{
+  PageId pageNo;
+  Page page;
+  checkThrows(mapped.allocatePage(pageNo), ReadOnlyFileException);
+  checkThrows(mapped.allocatePage(pageNo, page), ReadOnlyFileException);
+  checkThrows(mapped.writePage(1, page), ReadOnlyFileException);
+  std::vector<const Page*> pages(2, &page);
+  checkThrows(mapped.writePages(1, pages), ReadOnlyFileException);
+  checkThrows(mapped.deletePage(1), ReadOnlyFileException);
+
+  try
+  {
+    mapped.writePage(2, page);
+  }
+  catch (const ReadOnlyFileException& e)
+  {
+    checkTrue(e.filename() == "mmap_test_file");
+  }
+  checkUnchanged();
+}
+
+static void testBufMgr(MmapFile& mapped)
+{
+  BufMgr bufMgr(4);
+
+  // more pages than frames, all of them pinned at once and in place
+  std::vector<Page*> pinned;
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+  {
+    Page* page;
+    bufMgr.readPage(&mapped, pageNo, page);
+    checkTrue(page == mapped.mappedPage(pageNo));
+    pinned.push_back(page);
+  }
+  const BufStatsSnapshot stats = bufMgr.getStatsSnapshot();
+  checkTrue(stats.mappedReads == NUM_PAGES && stats.diskreads == 0);
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+    bufMgr.unPinPage(&mapped, pageNo, false);
+
+  // a page cannot come back dirty, be allocated or be disposed of
+  Page* page;
+  bufMgr.readPage(&mapped, 1, page);
+  checkThrows(bufMgr.unPinPage(&mapped, 1, true), ReadOnlyFileException);
+  PageId pageNo;
+  checkThrows(bufMgr.allocPage(&mapped, pageNo, page), ReadOnlyFileException);
+  checkThrows(bufMgr.disposePage(&mapped, 2), ReadOnlyFileException);
+  bufMgr.flushFile(&mapped);
+  checkUnchanged();
+
+  // nor through a handle
+  {
+    PageHandle handle = bufMgr.fetchPage(&mapped, 3);
+    checkTrue(handle.page() == mapped.mappedPage(3));
+    checkThrows(handle.markDirty(), ReadOnlyFileException);
+    handle.release();
+    checkTrue(!handle);
+  }
+  checkUnchanged();
+
+  // a mapped scan reads everything but cannot mark a page dirty
+  {
+    FileScan scan("mmap_test_file", &bufMgr, MAPPED_READ);
+    RecordId rid;
+    int records = 0;
+    while (scan.tryScanNext(rid))
+    {
+      checkTrue(scan.getRecord() == recordFor(rid.page_number));
+      records++;
+    }
+    checkTrue(records == int(NUM_PAGES));
+  }
+  {
+    FileScan scan("mmap_test_file", &bufMgr, MAPPED_READ);
+    RecordId rid;
+    scan.scanNext(rid);
+    checkThrows(scan.markDirty(), ReadOnlyFileException);
+  }
+  checkUnchanged();
+}
+
+int main()
+{
+  removeFile("mmap_test_file");
+  {
+    PageFile file = PageFile::create("mmap_test_file");
+    for (PageId i = 0; i < NUM_PAGES; i++)
+    {
+      PageId pageNo;
+      Page page = file.allocatePage(pageNo);
+      page.insertRecord(recordFor(pageNo));
+      file.writePage(pageNo, page);
+    }
+  }
+
+  {
+    MmapFile mapped = MmapFile::open("mmap_test_file");
+    testReads(mapped);
+    testWritesRejected(mapped);
+    testBufMgr(mapped);
+
+    // writes to existing pages through another File object show through
+    {
+      PageFile file = PageFile::open("mmap_test_file");
+      Page page = file.readPage(5);
+      const RecordId rid = {5, 1};
+      page.updateRecord(rid, "changed");
+      file.writePage(5, page);
+    }
+    checkTrue(readRecord(mapped.mappedPage(5), 5) == "changed");
+  }
+
+  File::remove("mmap_test_file");
+  return testResult("mmap_file_test");
+}
@@ -0,0 +1,259 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks the variants which report a miss, a full pool or the end of a scan
+ * through their return value: BufHashTbl::tryLookup, BufMgr::tryReadPage,
+ * FileScan::tryScanNext and BTreeIndex::tryScanNext.  Each must agree with
+ * the throwing method it stands beside, which must still throw as before.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <set>
+#include <string>
+#include "test_util.h"
+#include "btree.h"
+#include "bufHashTbl.h"
+#include "buffer.h"
+#include "filescan.h"
+#include "page.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+
+using namespace badgerdb;
+
+static const std::string relationName = "try_test_rel";
+static const int RELATION_SIZE = 2000;
+static const std::uint32_t NUM_FRAMES = 8;
+
+typedef struct tuple {
+	int i;
+	double d;
+	char s[64];
+} RECORD;
+
+/**
+ * Writes a relation of the given number of tuples straight to its file.
+ */
+static void createRelation(const int size)
+{
+  removeFile(relationName);
+  PageFile file(relationName, true);
+  if (size == 0)
+    return;
+  RECORD record;
+  std::memset(&record, ' ', sizeof(record));
+  PageId pageNo;
+  Page page = file.allocatePage(pageNo);
+  for (int i = 0; i < size; i++)
+  {
+    record.i = i;
+    record.d = (double)i;
+    const std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+    try
+    {
+      page.insertRecord(data);
+    }
+    catch (const InsufficientSpaceException&)
+    {
+      file.writePage(pageNo, page);
+      page = file.allocatePage(pageNo);
+      page.insertRecord(data);
+    }
+  }
+  file.writePage(pageNo, page);
+}
+
+static void testHashTable()
+{
+  removeFile("nonthrowing_test_file");
+  BlobFile* file = new BlobFile("nonthrowing_test_file", true);
+  BufHashTbl table(10);
+  for (PageId pageNo = 1; pageNo <= 100; pageNo++)
+    table.insert(file, pageNo, pageNo + 1000);
+
+  for (PageId pageNo = 1; pageNo <= 100; pageNo++)
+  {
+    FrameId frameNo = 0;
+    checkTrue(table.tryLookup(file, pageNo, frameNo) && frameNo == pageNo + 1000);
+  }
+
+  // a miss leaves frameNo alone, and lookup() still throws for it
+  table.remove(file, 50);
+  FrameId frameNo = 7;
+  checkTrue(!table.tryLookup(file, 50, frameNo) && frameNo == 7);
+  checkTrue(!table.tryLookup(file, 101, frameNo) && frameNo == 7);
+  checkThrows(table.lookup(file, 50, frameNo), HashNotFoundException);
+
+  delete file;
+  File::remove("nonthrowing_test_file");
+}
+
+static void testReadPage(BufMgr* bufMgr)
+{
+  PageFile* file = new PageFile(relationName, false);
+  // no frame may go to a page read ahead
+  bufMgr->setReadahead(0);
+
+  // a miss and then a hit on the same page give the same frame
+  bufMgr->clearBufStats();
+  Page* page = NULL;
+  checkTrue(bufMgr->tryReadPage(file, 1, page) && page != NULL && page->page_number() == 1);
+  Page* again = NULL;
+  checkTrue(bufMgr->tryReadPage(file, 1, again) && again == page);
+  BufStatsSnapshot stats = bufMgr->getStatsSnapshot();
+  checkTrue(stats.misses == 1 && stats.hits == 1);
+  bufMgr->unPinPage(file, 1, false);
+  bufMgr->unPinPage(file, 1, false);
+
+  // with every frame pinned, a miss fails without touching the page pointer
+  for (PageId pageNo = 1; pageNo <= NUM_FRAMES; pageNo++)
+    checkTrue(bufMgr->tryReadPage(file, pageNo, page));
+  Page* untouched = NULL;
+  checkTrue(!bufMgr->tryReadPage(file, NUM_FRAMES + 1, untouched) && untouched == NULL);
+  checkThrows(bufMgr->readPage(file, NUM_FRAMES + 1, untouched), BufferExceededException);
+  checkTrue(bufMgr->getStatsSnapshot().allocFailures == 2);
+
+  // but a hit still succeeds
+  checkTrue(bufMgr->tryReadPage(file, 2, page) && page->page_number() == 2);
+  bufMgr->unPinPage(file, 2, false);
+
+  for (PageId pageNo = 1; pageNo <= NUM_FRAMES; pageNo++)
+    bufMgr->unPinPage(file, pageNo, false);
+  checkTrue(bufMgr->tryReadPage(file, NUM_FRAMES + 1, page) && page->page_number() == NUM_FRAMES + 1);
+  bufMgr->unPinPage(file, NUM_FRAMES + 1, false);
+
+  bufMgr->flushFile(file);
+  delete file;
+}
+
+static void testFileScan(BufMgr* bufMgr)
+{
+  // every record once, then false for as long as it is asked
+  {
+    FileScan scan(relationName, bufMgr);
+    RecordId rid;
+    std::set<int> keys;
+    while (scan.tryScanNext(rid))
+    {
+      const std::string record = scan.getRecord();
+      keys.insert(reinterpret_cast<const RECORD*>(record.data())->i);
+    }
+    checkTrue(keys.size() == std::size_t(RELATION_SIZE) && *keys.begin() == 0
+              && *keys.rbegin() == RELATION_SIZE - 1);
+    checkTrue(!scan.tryScanNext(rid));
+    checkTrue(!scan.tryScanNext(rid));
+    checkThrows(scan.scanNext(rid), EndOfFileException);
+  }
+
+  // scanNext() returns the same records, and throws at the end
+  {
+    FileScan scan(relationName, bufMgr);
+    RecordId rid;
+    int count = 0;
+    try
+    {
+      while (true)
+      {
+        scan.scanNext(rid);
+        count++;
+      }
+    }
+    catch (const EndOfFileException&)
+    {
+    }
+    checkTrue(count == RELATION_SIZE);
+  }
+}
+
+static void testIndexScan(BufMgr* bufMgr)
+{
+  std::string indexName;
+  {
+    BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+
+    // the keys in range, each once, then false
+    int lowVal = 100;
+    int highVal = 600;
+    index.startScan(&lowVal, GTE, &highVal, LT);
+    RecordId rid;
+    int found = 0;
+    while (index.tryScanNext(rid))
+      found++;
+    checkTrue(found == 500);
+    checkTrue(!index.tryScanNext(rid));
+    checkThrows(index.scanNext(rid), IndexScanCompletedException);
+    index.endScan();
+
+    // up to the last key, where the scan runs out of leaves
+    lowVal = RELATION_SIZE - 10;
+    highVal = RELATION_SIZE + 10;
+    index.startScan(&lowVal, GT, &highVal, LTE);
+    found = 0;
+    while (index.tryScanNext(rid))
+      found++;
+    checkTrue(found == 9);
+    checkThrows(index.scanNext(rid), IndexScanCompletedException);
+    index.endScan();
+
+    // scanNext() agrees with tryScanNext()
+    lowVal = 0;
+    highVal = 10;
+    index.startScan(&lowVal, GTE, &highVal, LTE);
+    found = 0;
+    try
+    {
+      while (true)
+      {
+        index.scanNext(rid);
+        found++;
+      }
+    }
+    catch (const IndexScanCompletedException&)
+    {
+    }
+    checkTrue(found == 11);
+    index.endScan();
+  }
+  removeFile(indexName);
+
+  // an index over an empty relation has nothing to return
+  createRelation(0);
+  {
+    BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+    int lowVal = 0;
+    int highVal = 10;
+    index.startScan(&lowVal, GTE, &highVal, LTE);
+    RecordId rid;
+    checkTrue(!index.tryScanNext(rid));
+    checkThrows(index.scanNext(rid), IndexScanCompletedException);
+    index.endScan();
+  }
+  removeFile(indexName);
+}
+
+int main()
+{
+  testHashTable();
+
+  createRelation(RELATION_SIZE);
+  BufMgr* bufMgr = new BufMgr(NUM_FRAMES);
+  testReadPage(bufMgr);
+  delete bufMgr;
+
+  bufMgr = new BufMgr(100);
+  testFileScan(bufMgr);
+  testIndexScan(bufMgr);
+  delete bufMgr;
+
+  File::remove(relationName);
+  return testResult("nonthrowing_lookup_test");
+}
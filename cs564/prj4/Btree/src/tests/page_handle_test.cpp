@@ -0,0 +1,225 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks the handles returned by fetchPage() and newPage(): a handle holds
+ * exactly one pin, which moves with it and is dropped by release(), by the
+ * destructor, and when an exception leaves the scope holding it, and the
+ * page is written back only if the handle marked it dirty.  A pin dropped
+ * behind a handle's back makes release() throw, but not the destructor.
+ */
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "test_util.h"
+#include "buffer.h"
+#include "page.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/page_pinned_exception.h"
+
+using namespace badgerdb;
+
+static const int NUM_PAGES = 8;
+
+static std::string recordFor(const PageId pageNo, const int version)
+{
+  return "page " + std::to_string(pageNo) + " version " + std::to_string(version);
+}
+
+static std::string readRecord(const Page& page)
+{
+  const RecordId rid = {page.page_number(), 1};
+  return page.getRecord(rid);
+}
+
+static void updateRecord(Page& page, const std::string& record)
+{
+  const RecordId rid = {page.page_number(), 1};
+  page.updateRecord(rid, record);
+}
+
+/**
+ * The page holds no pin but the one taken here: dropping another throws.
+ */
+static void checkUnpinned(BufMgr* bufMgr, File* file, const PageId pageNo)
+{
+  Page* page;
+  bufMgr->readPage(file, pageNo, page);
+  bufMgr->unPinPage(file, pageNo, false);
+  checkThrows(bufMgr->unPinPage(file, pageNo, false), PageNotPinnedException);
+}
+
+static void testNewPage(BufMgr* bufMgr, File* file)
+{
+  for (int i = 0; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    PageHandle handle = bufMgr->newPage(file, pageNo);
+    checkTrue(handle && handle.pageNumber() == pageNo && handle->page_number() == pageNo);
+    handle->insertRecord(recordFor(pageNo, 0));
+    handle.markDirty();
+    checkThrows(bufMgr->flushFile(file), PagePinnedException);
+  }
+  bufMgr->flushFile(file);
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+    checkUnpinned(bufMgr, file, pageNo);
+}
+
+static void testRelease(BufMgr* bufMgr, File* file)
+{
+  PageHandle handle = bufMgr->fetchPage(file, 1);
+  checkTrue(readRecord(*handle) == recordFor(1, 0));
+  updateRecord(*handle, recordFor(1, 1));
+  handle.markDirty();
+  handle.release();
+  checkTrue(!handle && handle.page() == NULL);
+  checkUnpinned(bufMgr, file, 1);
+
+  // an empty handle has nothing left to drop
+  handle.release();
+  PageHandle empty;
+  checkTrue(!empty);
+  empty.release();
+
+  // dirty, so flushing writes it
+  const std::uint64_t writes = bufMgr->getStatsSnapshot().diskwrites;
+  bufMgr->flushFile(file);
+  checkTrue(bufMgr->getStatsSnapshot().diskwrites == writes + 1);
+
+  // a page changed without markDirty() is not written
+  {
+    PageHandle clean = bufMgr->fetchPage(file, 2);
+    updateRecord(*clean, recordFor(2, 1));
+  }
+  checkUnpinned(bufMgr, file, 2);
+  bufMgr->flushFile(file);
+  checkTrue(bufMgr->getStatsSnapshot().diskwrites == writes + 1);
+}
+
+static void testMove(BufMgr* bufMgr, File* file)
+{
+  PageHandle first = bufMgr->fetchPage(file, 3);
+  first.markDirty();
+  updateRecord(*first, recordFor(3, 1));
+
+  // the pin and the dirty mark move along
+  PageHandle second(std::move(first));
+  checkTrue(!first && first.page() == NULL);
+  checkTrue(second && second.pageNumber() == 3);
+  first.release();
+  checkThrows(bufMgr->flushFile(file), PagePinnedException);
+
+  // assigning over a handle drops the pin it held first
+  PageHandle third = bufMgr->fetchPage(file, 4);
+  third = std::move(second);
+  checkTrue(!second && third.pageNumber() == 3);
+  checkUnpinned(bufMgr, file, 4);
+  checkThrows(bufMgr->flushFile(file), PagePinnedException);
+
+  // and to itself keeps it
+  PageHandle& alias = third;
+  third = std::move(alias);
+  checkTrue(third && third.pageNumber() == 3);
+  third.release();
+  checkUnpinned(bufMgr, file, 3);
+
+  const std::uint64_t writes = bufMgr->getStatsSnapshot().diskwrites;
+  bufMgr->flushFile(file);
+  checkTrue(bufMgr->getStatsSnapshot().diskwrites == writes + 1);
+}
+
+static void testException(BufMgr* bufMgr, File* file)
+{
+  try
+  {
+    PageHandle handle = bufMgr->fetchPage(file, 5);
+    updateRecord(*handle, recordFor(5, 1));
+    handle.markDirty();
+    PageId pageNo;
+    PageHandle fresh = bufMgr->newPage(file, pageNo);
+    fresh->insertRecord(recordFor(pageNo, 0));
+    throw std::runtime_error("failed halfway");
+  }
+  catch (const std::runtime_error&)
+  {
+  }
+
+  // both pins are gone, and the dirty page is still written
+  checkUnpinned(bufMgr, file, 5);
+  checkUnpinned(bufMgr, file, NUM_PAGES + 1);
+  bufMgr->flushFile(file);
+}
+
+/**
+ * A pin dropped through unPinPage() behind a handle's back: release()
+ * throws, the destructor only counts it.
+ */
+static void testLostPin(BufMgr* bufMgr, File* file)
+{
+  bufMgr->clearBufStats();
+  {
+    PageHandle handle = bufMgr->fetchPage(file, 6);
+    bufMgr->unPinPage(file, 6, false);
+    checkThrows(handle.release(), PageNotPinnedException);
+    checkTrue(!handle);
+  }
+  checkTrue(bufMgr->getStatsSnapshot().lostPins == 0);
+
+  {
+    PageHandle handle = bufMgr->fetchPage(file, 6);
+    bufMgr->unPinPage(file, 6, false);
+  }
+  checkTrue(bufMgr->getStatsSnapshot().lostPins == 1);
+  checkUnpinned(bufMgr, file, 6);
+
+  // also when an exception is what destroys the handle
+  try
+  {
+    PageHandle handle = bufMgr->fetchPage(file, 7);
+    bufMgr->unPinPage(file, 7, false);
+    throw std::runtime_error("failed halfway");
+  }
+  catch (const std::runtime_error&)
+  {
+  }
+  checkTrue(bufMgr->getStatsSnapshot().lostPins == 2);
+  checkUnpinned(bufMgr, file, 7);
+  bufMgr->flushFile(file);
+}
+
+/**
+ * Every page holds on disk what the handles left in it.
+ */
+static void checkOnDisk()
+{
+  PageFile file = PageFile::open("handle_test_file");
+  checkTrue(readRecord(file.readPage(1)) == recordFor(1, 1));
+  checkTrue(readRecord(file.readPage(2)) == recordFor(2, 0));
+  checkTrue(readRecord(file.readPage(3)) == recordFor(3, 1));
+  checkTrue(readRecord(file.readPage(4)) == recordFor(4, 0));
+  checkTrue(readRecord(file.readPage(5)) == recordFor(5, 1));
+}
+
+int main()
+{
+  removeFile("handle_test_file");
+  PageFile* file = new PageFile("handle_test_file", true);
+  BufMgr* bufMgr = new BufMgr(NUM_PAGES + 4);
+
+  testNewPage(bufMgr, file);
+  testRelease(bufMgr, file);
+  testMove(bufMgr, file);
+  testException(bufMgr, file);
+  testLostPin(bufMgr, file);
+
+  delete bufMgr;
+  delete file;
+  checkOnDisk();
+  File::remove("handle_test_file");
+  return testResult("page_handle_test");
+}
@@ -0,0 +1,341 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks BufMgr::prefetch() and sequential readahead.  Pages prefetched are
+ * found in the pool afterwards without another read, pages already there or
+ * past the end of the file are skipped, a reader going through a file in
+ * order finds most pages read ahead of it, and a reader racing the prefetch
+ * thread for the same pages gets every page read exactly once.  flushFile()
+ * drops what is still queued, so the File object can go right after it.
+ * disposePage() drops the queued prefetch of its page only.
+ * allocPage() of a page number a stale copy is still pinned under waits for
+ * the pin to go, and gives up once the allocation wait timeout is over.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "test_util.h"
+#include "buffer.h"
+#include "page.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/page_pinned_exception.h"
+
+using namespace badgerdb;
+
+static const int NUM_PAGES = 200;
+static const std::uint32_t NUM_FRAMES = 400;
+
+static std::string recordFor(const PageId pageNo)
+{
+  return "page " + std::to_string(pageNo);
+}
+
+/**
+ * Hands out the number of a page still in use on allocation, as a file does
+ * with the number of a page disposed of while readahead was reading it in.
+ */
+class ReusingFile : public PageFile
+{
+ public:
+  ReusingFile(const std::string& name, const PageId reusedIn)
+    : PageFile(name, false), reused(reusedIn)
+  {
+  }
+
+  void allocatePage(PageId& new_page_number, Page& new_page)
+  {
+    PageFile::readPage(reused, new_page);
+    new_page_number = reused;
+  }
+
+  void deletePage(const PageId page_number)
+  {
+    deleted.push_back(page_number);
+  }
+
+  const PageId reused;
+  std::vector<PageId> deleted;
+};
+
+/**
+ * Holds up reads of its pages until opened, which keeps the prefetch thread
+ * busy while requests queue up behind it.
+ */
+class GatedFile : public PageFile
+{
+ public:
+  GatedFile(const std::string& name)
+    : PageFile(name, false), opened(false)
+  {
+  }
+
+  void readPage(const PageId page_number, Page& page) const
+  {
+    while (!opened)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    PageFile::readPage(page_number, page);
+  }
+
+  std::atomic<bool> opened;
+};
+
+static void createFile(const std::string& name)
+{
+  removeFile(name);
+  PageFile file(name, true);
+  for (int i = 0; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    Page page = file.allocatePage(pageNo);
+    page.insertRecord(recordFor(pageNo));
+    file.writePage(pageNo, page);
+  }
+}
+
+/**
+ * Reads the page, checks what it holds and unpins it.
+ */
+static void readAndCheck(BufMgr* bufMgr, File* file, const PageId pageNo)
+{
+  Page* page;
+  bufMgr->readPage(file, pageNo, page);
+  const RecordId rid = {pageNo, 1};
+  checkTrue(page->page_number() == pageNo && page->getRecord(rid) == recordFor(pageNo));
+  bufMgr->unPinPage(file, pageNo, false);
+}
+
+/**
+ * Waits until the prefetch thread has read the given number of pages, for
+ * at most five seconds.
+ */
+static bool waitForPrefetches(BufMgr* bufMgr, const std::uint64_t count)
+{
+  const std::chrono::steady_clock::time_point deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (bufMgr->getStatsSnapshot().prefetchreads < count)
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+static void testPrefetch(BufMgr* bufMgr, File* file)
+{
+  bufMgr->setReadahead(0);
+  bufMgr->clearBufStats();
+
+  // pages 5 and 6 are in the pool already, 1000 is past the end of the file
+  readAndCheck(bufMgr, file, 5);
+  readAndCheck(bufMgr, file, 6);
+  std::vector<PageId> pageIds;
+  for (PageId pageNo = 1; pageNo <= 20; pageNo++)
+    pageIds.push_back(pageNo);
+  pageIds.push_back(1000);
+  bufMgr->prefetch(file, pageIds);
+  checkTrue(waitForPrefetches(bufMgr, 18));
+
+  // every page asked for is a hit now, and nothing was read twice
+  for (PageId pageNo = 1; pageNo <= 20; pageNo++)
+    readAndCheck(bufMgr, file, pageNo);
+  BufStatsSnapshot stats = bufMgr->getStatsSnapshot();
+  checkTrue(stats.misses == 2 && stats.hits == 20);
+
+  checkTrue(stats.prefetchreads == 18);
+
+  // prefetched pages hold no pin, so the file can be flushed
+  bufMgr->flushFile(file);
+}
+
+static void testReadahead(BufMgr* bufMgr, File* file)
+{
+  // without readahead, every page of a sequential read is a miss
+  bufMgr->setReadahead(0);
+  bufMgr->clearBufStats();
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+    readAndCheck(bufMgr, file, pageNo);
+  BufStatsSnapshot stats = bufMgr->getStatsSnapshot();
+  checkTrue(stats.misses == std::uint64_t(NUM_PAGES) && stats.prefetchreads == 0);
+  bufMgr->flushFile(file);
+
+  // with it, the reader finds most pages read already; it waits for a page
+  // being read ahead instead of reading it again
+  bufMgr->setReadahead(16);
+  bufMgr->clearBufStats();
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+  {
+    readAndCheck(bufMgr, file, pageNo);
+    if (pageNo % 8 == 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  stats = bufMgr->getStatsSnapshot();
+  checkTrue(stats.prefetchreads > 0);
+  checkTrue(stats.misses < std::uint64_t(NUM_PAGES) / 2);
+  checkTrue(stats.misses + stats.hits == std::uint64_t(NUM_PAGES));
+  checkTrue(stats.diskreads <= std::uint64_t(NUM_PAGES) + 16);
+  bufMgr->flushFile(file);
+
+  // a reader jumping about triggers none
+  bufMgr->clearBufStats();
+  for (PageId pageNo = 1; pageNo <= NUM_PAGES / 2; pageNo++)
+    readAndCheck(bufMgr, file, (pageNo * 37) % NUM_PAGES + 1);
+  checkTrue(bufMgr->getStatsSnapshot().prefetchreads == 0);
+  bufMgr->flushFile(file);
+}
+
+/**
+ * Reads every page while the prefetch thread reads the same pages.
+ */
+static void testRace(BufMgr* bufMgr, File* file)
+{
+  bufMgr->setReadahead(0);
+  for (int round = 0; round < 10; round++)
+  {
+    bufMgr->clearBufStats();
+    std::vector<PageId> pageIds;
+    for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+      pageIds.push_back(pageNo);
+    bufMgr->prefetch(file, pageIds);
+    std::thread reader([bufMgr, file]() {
+      for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+        readAndCheck(bufMgr, file, pageNo);
+    });
+    reader.join();
+
+    // pages the prefetch thread has yet to get to are skipped by it
+    bufMgr->flushFile(file);
+    const BufStatsSnapshot stats = bufMgr->getStatsSnapshot();
+    checkTrue(stats.diskreads == std::uint64_t(NUM_PAGES));
+    checkTrue(stats.misses + stats.prefetchreads == std::uint64_t(NUM_PAGES));
+  }
+}
+
+/**
+ * flushFile() drops the prefetches of the file still queued, so the File
+ * object may be deleted at once.
+ */
+static void testCancel(BufMgr* bufMgr, const std::string& name)
+{
+  for (int round = 0; round < 20; round++)
+  {
+    PageFile* file = new PageFile(name, false);
+    std::vector<PageId> pageIds;
+    for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+      pageIds.push_back(pageNo);
+    bufMgr->prefetch(file, pageIds);
+    bufMgr->flushFile(file);
+    delete file;
+  }
+
+  // nothing was left behind pinned or in the pool under the dead files
+  PageFile* file = new PageFile(name, false);
+  bufMgr->clearBufStats();
+  bufMgr->setReadahead(0);
+  readAndCheck(bufMgr, file, 1);
+  checkTrue(bufMgr->getStatsSnapshot().misses == 1);
+  bufMgr->flushFile(file);
+  delete file;
+}
+
+/**
+ * disposePage() drops a queued prefetch of the page, but not those of the
+ * other pages of the file.
+ */
+static void testDispose(BufMgr* bufMgr, const std::string& name, const std::string& gatedName)
+{
+  createFile(name);
+  createFile(gatedName);
+  PageFile file(name, false);
+  GatedFile gated(gatedName);
+  bufMgr->setReadahead(0);
+  bufMgr->clearBufStats();
+
+  // the prefetches of the file wait behind one of the gated file
+  bufMgr->prefetch(&gated, std::vector<PageId>(1, 1));
+  std::vector<PageId> pageIds;
+  for (PageId pageNo = 1; pageNo <= 40; pageNo++)
+    pageIds.push_back(pageNo);
+  bufMgr->prefetch(&file, pageIds);
+  bufMgr->disposePage(&file, 30);
+  gated.opened = true;
+
+  checkTrue(waitForPrefetches(bufMgr, 40));
+  checkTrue(bufMgr->getStatsSnapshot().prefetchreads == 40);
+  for (PageId pageNo = 1; pageNo <= 40; pageNo++)
+  {
+    if (pageNo != 30)
+      readAndCheck(bufMgr, &file, pageNo);
+  }
+  checkTrue(bufMgr->getStatsSnapshot().misses == 0);
+  Page* page;
+  checkThrows(bufMgr->readPage(&file, 30, page), InvalidPageException);
+  bufMgr->flushFile(&file);
+  bufMgr->flushFile(&gated);
+}
+
+/**
+ * allocPage() of a page number whose stale copy is pinned waits for the pin
+ * to be dropped, for as long as the allocation wait timeout allows.
+ */
+static void testStaleCopyPinned(BufMgr* bufMgr, const std::string& name)
+{
+  ReusingFile file(name, 5);
+  bufMgr->setReadahead(0);
+  bufMgr->setAllocWaitTimeout(20000);
+
+  // the pin outlasts the timeout: the page goes back to the file
+  Page* stale;
+  bufMgr->readPage(&file, 5, stale);
+  PageId pageNo;
+  Page* page;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  checkThrows(bufMgr->allocPage(&file, pageNo, page), PagePinnedException);
+  checkTrue(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+  checkTrue(file.deleted.size() == 1 && file.deleted[0] == 5);
+
+  // the pin is dropped in time: the new page takes the place of the stale one
+  bufMgr->setAllocWaitTimeout(5000000);
+  std::thread reader([bufMgr, &file]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    bufMgr->unPinPage(&file, 5, false);
+  });
+  bufMgr->allocPage(&file, pageNo, page);
+  reader.join();
+  checkTrue(pageNo == 5 && page != stale);
+  Page* again;
+  bufMgr->readPage(&file, 5, again);
+  checkTrue(again == page);
+  bufMgr->unPinPage(&file, 5, false);
+  bufMgr->unPinPage(&file, 5, false);
+  bufMgr->flushFile(&file);
+  bufMgr->setAllocWaitTimeout(0);
+}
+
+int main()
+{
+  createFile("prefetch_test_file");
+  BufMgr* bufMgr = new BufMgr(NUM_FRAMES);
+  PageFile* file = new PageFile("prefetch_test_file", false);
+
+  testPrefetch(bufMgr, file);
+  testReadahead(bufMgr, file);
+  testRace(bufMgr, file);
+  delete file;
+  testCancel(bufMgr, "prefetch_test_file");
+  testStaleCopyPinned(bufMgr, "prefetch_test_file");
+  testDispose(bufMgr, "prefetch_test_file", "prefetch_test_gated");
+
+  delete bufMgr;
+  File::remove("prefetch_test_file");
+  File::remove("prefetch_test_gated");
+  return testResult("prefetch_test");
+}
@@ -0,0 +1,178 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Runs every page replacement policy through eviction in a pool much smaller
+ * than the file: pages read back hold what was last written to them, pinned
+ * pages are never taken away, and the pool only fails an allocation once
+ * every frame is pinned.  A page coming back after its eviction is only
+ * treated as such until its file is dropped from the pool.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "test_util.h"
+#include "buffer.h"
+#include "page.h"
+#include "exceptions/buffer_exceeded_exception.h"
+
+using namespace badgerdb;
+
+static const int NUM_PAGES = 120;
+static const int NUM_FRAMES = 10;
+
+static std::string makeRecord(const PageId pageNo, const std::uint32_t count)
+{
+  std::string record(8, '\0');
+  std::memcpy(&record[0], &pageNo, 4);
+  std::memcpy(&record[4], &count, 4);
+  return record;
+}
+
+static bool holds(const Page* page, const PageId pageNo, const std::uint32_t count)
+{
+  const RecordId rid = {pageNo, 1};
+  return page->page_number() == pageNo && page->getRecord(rid) == makeRecord(pageNo, count);
+}
+
+static void testPolicy(const ReplacementPolicyType policyType)
+{
+  removeFile("policy_test");
+  PageFile* file = new PageFile("policy_test", true);
+  BufMgr* bufMgr = new BufMgr(NUM_FRAMES, policyType);
+  std::vector<std::uint32_t> counts(NUM_PAGES + 1, 0);
+
+  for (int i = 0; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    Page* page;
+    bufMgr->allocPage(file, pageNo, page);
+    page->insertRecord(makeRecord(pageNo, 0));
+    bufMgr->unPinPage(file, pageNo, true);
+  }
+
+  // a hot set, a scan and random updates, so every policy evicts both
+  // clean and dirty pages
+  unsigned int seed = 1;
+  PageId scanPos = 0;
+  for (int i = 0; i < 20000; i++)
+  {
+    const int op = rand_r(&seed) % 10;
+    const PageId pageNo = op < 5 ? 1 + rand_r(&seed) % 4
+                                 : op < 8 ? 1 + scanPos++ % NUM_PAGES
+                                          : 1 + rand_r(&seed) % NUM_PAGES;
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    checkTrue(holds(page, pageNo, counts[pageNo]));
+    const bool update = op >= 8;
+    if (update)
+    {
+      const RecordId rid = {pageNo, 1};
+      page->updateRecord(rid, makeRecord(pageNo, ++counts[pageNo]));
+    }
+    bufMgr->unPinPage(file, pageNo, update);
+  }
+  checkTrue(bufMgr->getStatsSnapshot().dirtyEvictions > 0);
+
+  // pages stay where they are for as long as they are pinned, while the one
+  // frame left is used for everything else; it may be busy for a moment,
+  // being written back or filled by readahead
+  bufMgr->setAllocWaitTimeout(200000);
+  Page* pinned[NUM_FRAMES];
+  for (PageId pageNo = 1; pageNo < NUM_FRAMES; pageNo++)
+    bufMgr->readPage(file, pageNo, pinned[pageNo]);
+  for (PageId pageNo = NUM_FRAMES; pageNo <= NUM_PAGES; pageNo++)
+  {
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    checkTrue(holds(page, pageNo, counts[pageNo]));
+    bufMgr->unPinPage(file, pageNo, false);
+  }
+  for (PageId pageNo = 1; pageNo < NUM_FRAMES; pageNo++)
+    checkTrue(holds(pinned[pageNo], pageNo, counts[pageNo]));
+
+  // and with that frame pinned as well, there is nothing left to evict
+  Page* last;
+  bufMgr->readPage(file, NUM_FRAMES, last);
+  Page* page;
+  checkThrows(bufMgr->readPage(file, NUM_FRAMES + 1, page), BufferExceededException);
+  bufMgr->unPinPage(file, NUM_FRAMES, false);
+  for (PageId pageNo = 1; pageNo < NUM_FRAMES; pageNo++)
+    bufMgr->unPinPage(file, pageNo, false);
+
+  bufMgr->flushFile(file);
+  delete bufMgr;
+  {
+    PageFile check = PageFile::open("policy_test");
+    for (PageId pageNo = 1; pageNo <= NUM_PAGES; pageNo++)
+    {
+      Page onDisk = check.readPage(pageNo);
+      checkTrue(holds(&onDisk, pageNo, counts[pageNo]));
+    }
+  }
+  delete file;
+  File::remove("policy_test");
+}
+
+/**
+ * Evicts page 1 of the file from a pool of four frames, loads it again
+ * along with three new pages, and tells whether the policy would evict page
+ * 1 first.
+ *
+ * @param drop  True to drop the file from the policy before page 1 comes back
+ */
+static bool evictsReturnedFirst(const ReplacementPolicyType policyType, const File* file, const bool drop)
+{
+  ReplacementPolicy* policy = ReplacementPolicy::create(policyType, 4);
+  FrameId frame;
+  std::uint32_t scanned;
+  const ReplacementPolicy::ClaimFunction claim = [](FrameId) { return true; };
+  policy->pickVictim(claim, frame, scanned);
+  policy->pageLoaded(frame, file, 1);
+  policy->pageRemoved(frame, true);
+  if (drop)
+    policy->fileDropped(file);
+
+  policy->pageLoaded(frame, file, 1);
+  const FrameId returned = frame;
+  for (PageId pageNo = 2; pageNo <= 4; pageNo++)
+  {
+    policy->pickVictim(claim, frame, scanned);
+    policy->pageLoaded(frame, file, pageNo);
+  }
+  std::vector<FrameId> victims;
+  policy->nextVictims(victims, 4);
+  delete policy;
+  return !victims.empty() && victims[0] == returned;
+}
+
+/**
+ * A policy remembering evicted pages favours page 1 as a page which came
+ * back, over the pages seen once, unless its file was dropped meanwhile:
+ * then it is new, and the oldest of them.
+ */
+static void testDroppedFile(const ReplacementPolicyType policyType)
+{
+  removeFile("policy_test");
+  {
+    PageFile file("policy_test", true);
+    checkTrue(!evictsReturnedFirst(policyType, &file, false));
+    checkTrue(evictsReturnedFirst(policyType, &file, true));
+  }
+  File::remove("policy_test");
+}
+
+int main()
+{
+  const ReplacementPolicyType policies[] = {CLOCK, LRU_K, TWO_Q, ARC, CLOCK_PRO};
+  for (std::size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+    testPolicy(policies[i]);
+  for (std::size_t i = 1; i < sizeof(policies) / sizeof(policies[0]); i++)
+    testDroppedFile(policies[i]);
+  return testResult("replacement_policy_test");
+}
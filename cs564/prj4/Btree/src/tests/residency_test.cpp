@@ -0,0 +1,175 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks residency snapshots: the pages a warm pool holds are saved, and a
+ * fresh buffer manager loading the snapshot prefetches the pages listed for
+ * a file on its first miss on that file, also when the file name has spaces.
+ * A snapshot with a header it does not know is not loaded, and of one cut
+ * short only the lines before the cut are.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "test_util.h"
+#include "buffer.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+static const char* const SPACED = "residency test file";
+static const char* const OTHER = "residency_other";
+static const char* const SNAPSHOT = "residency_snapshot";
+static const PageId NUM_PAGES = 40;
+
+static void createFile(const char* name)
+{
+  removeFile(name);
+  PageFile file = PageFile::create(name);
+  for (PageId i = 0; i < NUM_PAGES; i++)
+  {
+    PageId pageNo;
+    Page page = file.allocatePage(pageNo);
+    page.insertRecord(name);
+    file.writePage(pageNo, page);
+  }
+}
+
+static void readPages(BufMgr* bufMgr, File* file, const std::vector<PageId>& pageIds)
+{
+  for (std::size_t i = 0; i < pageIds.size(); i++)
+  {
+    Page* page;
+    bufMgr->readPage(file, pageIds[i], page);
+    bufMgr->unPinPage(file, pageIds[i], false);
+  }
+}
+
+/**
+ * Waits up to a few seconds for as many pages to have been prefetched.
+ */
+static bool waitForPrefetches(BufMgr* bufMgr, const std::uint64_t count)
+{
+  for (int i = 0; i < 500; i++)
+  {
+    if (bufMgr->getStatsSnapshot().prefetchreads >= count)
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+static void testRoundTrip(const std::vector<PageId>& spacedPages,
+                          const std::vector<PageId>& otherPages)
+{
+  PageFile spaced = PageFile::open(SPACED);
+  PageFile other = PageFile::open(OTHER);
+  {
+    BufMgr warm(64);
+    warm.setReadahead(0);
+    readPages(&warm, &spaced, spacedPages);
+    readPages(&warm, &other, otherPages);
+    warm.saveResidency(SNAPSHOT);
+  }
+  checkTrue(!std::ifstream(std::string(SNAPSHOT) + ".tmp"));
+
+  BufMgr fresh(64);
+  fresh.setReadahead(0);
+  checkTrue(fresh.loadResidency(SNAPSHOT));
+
+  // the first miss on a file brings in the rest of its pages
+  Page* page;
+  fresh.readPage(&spaced, spacedPages[0], page);
+  fresh.unPinPage(&spaced, spacedPages[0], false);
+  checkTrue(waitForPrefetches(&fresh, spacedPages.size() - 1));
+  const BufStatsSnapshot before = fresh.getStatsSnapshot();
+  checkTrue(before.prefetchreads == spacedPages.size() - 1);
+  readPages(&fresh, &spaced, spacedPages);
+  checkTrue(fresh.getStatsSnapshot().diskreads == before.diskreads);
+
+  // but only its own
+  checkTrue(before.prefetchreads < spacedPages.size() + otherPages.size() - 1);
+  fresh.readPage(&other, otherPages[0], page);
+  fresh.unPinPage(&other, otherPages[0], false);
+  checkTrue(waitForPrefetches(&fresh, before.prefetchreads + otherPages.size() - 1));
+  const std::uint64_t diskreads = fresh.getStatsSnapshot().diskreads;
+  readPages(&fresh, &other, otherPages);
+  checkTrue(fresh.getStatsSnapshot().diskreads == diskreads);
+}
+
+static void testWrongHeader(const std::vector<PageId>& spacedPages)
+{
+  {
+    std::ofstream out(SNAPSHOT, std::ios::out | std::ios::trunc);
+    out << "badgerdb residency 0\n";
+    for (std::size_t i = 0; i < spacedPages.size(); i++)
+      out << spacedPages[i] << ' ' << SPACED << '\n';
+  }
+  PageFile spaced = PageFile::open(SPACED);
+  BufMgr fresh(64);
+  fresh.setReadahead(0);
+  checkTrue(!fresh.loadResidency(SNAPSHOT));
+  checkTrue(!fresh.loadResidency("no_such_snapshot"));
+
+  // so a miss reads only the page asked for
+  Page* page;
+  fresh.readPage(&spaced, spacedPages[0], page);
+  fresh.unPinPage(&spaced, spacedPages[0], false);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  checkTrue(fresh.getStatsSnapshot().prefetchreads == 0);
+}
+
+static void testTruncated(const std::vector<PageId>& spacedPages)
+{
+  // three whole lines, then one cut off in the middle of the file name
+  {
+    std::ofstream out(SNAPSHOT, std::ios::out | std::ios::trunc);
+    out << "badgerdb residency 1\n";
+    for (std::size_t i = 0; i < 3; i++)
+      out << spacedPages[i] << ' ' << SPACED << '\n';
+    out << spacedPages[3] << " residency te";
+  }
+  PageFile spaced = PageFile::open(SPACED);
+  BufMgr fresh(64);
+  fresh.setReadahead(0);
+  checkTrue(fresh.loadResidency(SNAPSHOT));
+
+  Page* page;
+  fresh.readPage(&spaced, spacedPages[0], page);
+  fresh.unPinPage(&spaced, spacedPages[0], false);
+  checkTrue(waitForPrefetches(&fresh, 2));
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  checkTrue(fresh.getStatsSnapshot().prefetchreads == 2);
+}
+
+int main()
+{
+  createFile(SPACED);
+  createFile(OTHER);
+
+  // pages scattered over the file, none next to another; with readahead off
+  // as well, only the pages listed are ever read
+  std::vector<PageId> spacedPages;
+  const PageId spacedList[] = {5, 12, 17, 23, 27, 31, 40};
+  spacedPages.assign(spacedList, spacedList + sizeof(spacedList) / sizeof(spacedList[0]));
+  std::vector<PageId> otherPages;
+  const PageId otherList[] = {2, 9, 22};
+  otherPages.assign(otherList, otherList + sizeof(otherList) / sizeof(otherList[0]));
+
+  testRoundTrip(spacedPages, otherPages);
+  testWrongHeader(spacedPages);
+  testTruncated(spacedPages);
+
+  std::remove(SNAPSHOT);
+  File::remove(SPACED);
+  File::remove(OTHER);
+  return testResult("residency_test");
+}
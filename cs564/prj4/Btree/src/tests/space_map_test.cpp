@@ -0,0 +1,333 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Checks the space map of a PageFile: pages allocated and deleted keep the
+ * used list in order, the map is written back on close, and a file without a
+ * map, or with one which does not match the file, gets it rebuilt from the
+ * used list instead of trusting it.  In a file larger than the summary of
+ * the map covers in one word, whole stretches of pages deleted and allocated
+ * again in random order still leave the used list in order.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "file.h"
+#include "file_iterator.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+static const char* const PRISTINE = "space_map_pristine";
+static const char* const NAME = "space_map_file";
+static const PageId NUM_PAGES = 200;
+
+/**
+ * Position of a page in the file, as File::pagePosition().
+ */
+static std::uint64_t pagePosition(const PageId pageNo)
+{
+  return sizeof(FileHeader) + std::uint64_t(pageNo - 1) * Page::SIZE;
+}
+
+/**
+ * Checksum of a bitmap, as the file computes it.
+ */
+static std::uint64_t checksum(const std::vector<std::uint64_t>& words)
+{
+  std::uint64_t sum = 14695981039346656037ULL;
+  for (std::size_t i = 0; i < words.size(); i++)
+  {
+    sum ^= words[i];
+    sum *= 1099511628211ULL;
+  }
+  return sum;
+}
+
+/**
+ * Space map of a closed file as stored, with the file header.
+ */
+struct StoredMap
+{
+  FileHeader fileHeader;
+  SpaceMapHeader header;
+  std::vector<std::uint64_t> words;
+};
+
+static bool readMap(const char* name, StoredMap& map)
+{
+  const int fd = open(name, O_RDONLY);
+  bool read = pread(fd, &map.fileHeader, sizeof(FileHeader), 0) == ssize_t(sizeof(FileHeader));
+  const std::uint64_t at = pagePosition(map.fileHeader.num_pages);
+  read = read && pread(fd, &map.header, sizeof(SpaceMapHeader), at) == ssize_t(sizeof(SpaceMapHeader));
+  if (read)
+  {
+    map.words.assign(map.header.num_words, 0);
+    const ssize_t bytes = map.words.size() * sizeof(std::uint64_t);
+    read = pread(fd, &map.words[0], bytes, at + sizeof(SpaceMapHeader)) == bytes;
+  }
+  close(fd);
+  return read;
+}
+
+static void writeMap(const char* name, const StoredMap& map)
+{
+  const int fd = open(name, O_WRONLY);
+  const std::uint64_t at = pagePosition(map.fileHeader.num_pages);
+  checkTrue(pwrite(fd, &map.header, sizeof(SpaceMapHeader), at) == ssize_t(sizeof(SpaceMapHeader)));
+  const ssize_t bytes = map.words.size() * sizeof(std::uint64_t);
+  checkTrue(pwrite(fd, &map.words[0], bytes, at + sizeof(SpaceMapHeader)) == bytes);
+  close(fd);
+}
+
+static void copyFile(const char* from, const char* to)
+{
+  removeFile(to);
+  std::ifstream in(from, std::ios::binary);
+  std::ofstream out(to, std::ios::binary);
+  out << in.rdbuf();
+}
+
+static bool isUsed(const std::vector<std::uint64_t>& words, const PageId pageNo)
+{
+  return pageNo / 64 < words.size() && (words[pageNo / 64] >> (pageNo % 64)) & 1;
+}
+
+/**
+ * The used list holds the expected pages, in order.
+ */
+static void checkUsedList(PageFile& file, const std::set<PageId>& expected)
+{
+  std::set<PageId>::const_iterator want = expected.begin();
+  for (FileIterator it = file.begin(); it != file.end(); ++it)
+  {
+    const Page page = *it;
+    if (want == expected.end())
+    {
+      checkTrue(false);
+      return;
+    }
+    checkTrue(page.page_number() == *want);
+    ++want;
+  }
+  checkTrue(want == expected.end());
+}
+
+/**
+ * A map as written on close matches the used pages exactly.
+ */
+static void checkStoredMap(const std::set<PageId>& expected)
+{
+  StoredMap map;
+  checkTrue(readMap(NAME, map));
+  checkTrue(map.header.magic == SpaceMapHeader::MAGIC);
+  checkTrue(map.header.file_header == map.fileHeader);
+  checkTrue(map.header.checksum == checksum(map.words));
+  for (PageId pageNo = 1; pageNo < map.fileHeader.num_pages; pageNo++)
+    checkTrue(isUsed(map.words, pageNo) == (expected.count(pageNo) > 0));
+}
+
+/**
+ * Deletes and allocates pages of the file, which needs the page before each
+ * in the used list, and checks the list and the map written on close.
+ */
+static void checkOperations(std::set<PageId> expected)
+{
+  {
+    PageFile file = PageFile::open(NAME);
+    checkUsedList(file, expected);
+
+    // pages at the start, the end, across words, and in between
+    const PageId doomed[] = {1, 64, 65, 128, 199, 100};
+    for (std::size_t i = 0; i < sizeof(doomed) / sizeof(doomed[0]); i++)
+    {
+      file.deletePage(doomed[i]);
+      expected.erase(doomed[i]);
+    }
+    checkUsedList(file, expected);
+
+    // which reuses free pages before it grows the file
+    for (int i = 0; i < 20; i++)
+    {
+      PageId pageNo;
+      file.allocatePage(pageNo);
+      checkTrue(expected.count(pageNo) == 0);
+      expected.insert(pageNo);
+    }
+    checkUsedList(file, expected);
+  }
+  checkStoredMap(expected);
+
+  PageFile file = PageFile::open(NAME);
+  checkUsedList(file, expected);
+}
+
+/**
+ * Empties stretches of a file many words of the map long, most of it, in
+ * random order, so that the used page before a page is found through the
+ * summary, from pages above and below emptied words alike.
+ */
+static void checkSparse()
+{
+  const PageId pages = 9000;
+  std::set<PageId> expected;
+  removeFile(NAME);
+  {
+    PageFile file = PageFile::create(NAME);
+    for (PageId i = 0; i < pages; i++)
+    {
+      PageId pageNo;
+      file.allocatePage(pageNo);
+      expected.insert(pageNo);
+    }
+
+    // all but a few pages at the ends of words and of the file, so that the
+    // 4096 pages from 4096 on, a whole word of the summary, are emptied too
+    const PageId kept[] = {1, 63, 64, 4095, 8192, 8193, 8999, 9000};
+    std::set<PageId> keep(kept, kept + sizeof(kept) / sizeof(kept[0]));
+    std::vector<PageId> doomed;
+    for (PageId pageNo = 1; pageNo <= pages; pageNo++)
+    {
+      if (keep.count(pageNo) == 0)
+        doomed.push_back(pageNo);
+    }
+    unsigned int seed = 1;
+    for (std::size_t i = 0; i < doomed.size(); i++)
+      std::swap(doomed[i], doomed[i + rand_r(&seed) % (doomed.size() - i)]);
+    for (std::size_t i = 0; i < doomed.size(); i++)
+    {
+      file.deletePage(doomed[i]);
+      expected.erase(doomed[i]);
+      if (i == doomed.size() / 2)
+        checkUsedList(file, expected);
+    }
+    checkUsedList(file, expected);
+
+    // the pages above the emptied stretch find theirs below it
+    const PageId above[] = {8193, 8192, 8999};
+    for (std::size_t i = 0; i < sizeof(above) / sizeof(above[0]); i++)
+    {
+      file.deletePage(above[i]);
+      expected.erase(above[i]);
+    }
+    checkUsedList(file, expected);
+
+    // the pages come back last deleted first, all over the file
+    for (int i = 0; i < 200; i++)
+    {
+      PageId pageNo;
+      file.allocatePage(pageNo);
+      checkTrue(expected.count(pageNo) == 0);
+      expected.insert(pageNo);
+    }
+    checkUsedList(file, expected);
+
+    // and the last page, with the stretch partly refilled, finds its in it
+    const PageId last[] = {1, 9000};
+    for (std::size_t i = 0; i < sizeof(last) / sizeof(last[0]); i++)
+    {
+      file.deletePage(last[i]);
+      expected.erase(last[i]);
+    }
+    checkUsedList(file, expected);
+  }
+  checkStoredMap(expected);
+
+  // and a summary made from the map read back finds them as well
+  PageFile file = PageFile::open(NAME);
+  for (PageId pageNo = 4096; pageNo < 8192; pageNo++)
+  {
+    if (expected.count(pageNo))
+    {
+      file.deletePage(pageNo);
+      expected.erase(pageNo);
+    }
+  }
+  checkUsedList(file, expected);
+}
+
+int main()
+{
+  // every third page deleted, so that the free list and used list interleave
+  std::set<PageId> expected;
+  removeFile(PRISTINE);
+  {
+    PageFile file = PageFile::create(PRISTINE);
+    for (PageId i = 0; i < NUM_PAGES; i++)
+    {
+      PageId pageNo;
+      file.allocatePage(pageNo);
+      expected.insert(pageNo);
+    }
+    for (PageId pageNo = 3; pageNo <= NUM_PAGES; pageNo += 3)
+    {
+      file.deletePage(pageNo);
+      expected.erase(pageNo);
+    }
+  }
+  StoredMap pristine;
+  checkTrue(readMap(PRISTINE, pristine));
+
+  // a map which matches the file is used as it is
+  copyFile(PRISTINE, NAME);
+  checkOperations(expected);
+
+  // files written before there was a map have none
+  copyFile(PRISTINE, NAME);
+  checkTrue(truncate(NAME, pagePosition(pristine.fileHeader.num_pages)) == 0);
+  checkOperations(expected);
+
+  // maps which do not match claim a deleted page is used and a used one is
+  // not, which would link the used list wrongly if they were trusted
+  StoredMap wrong = pristine;
+  wrong.words[0] ^= (1ULL << 3) | (1ULL << 4);
+  wrong.words[1] ^= (1ULL << (66 % 64)) | (1ULL << (67 % 64));
+  wrong.header.checksum = checksum(wrong.words);
+
+  // with a bad checksum
+  StoredMap map = wrong;
+  map.header.checksum++;
+  copyFile(PRISTINE, NAME);
+  writeMap(NAME, map);
+  checkOperations(expected);
+
+  // left behind by an older header
+  map = wrong;
+  map.header.file_header.num_free_pages++;
+  copyFile(PRISTINE, NAME);
+  writeMap(NAME, map);
+  checkOperations(expected);
+
+  // of another length
+  map = wrong;
+  map.header.num_words++;
+  map.words.push_back(0);
+  copyFile(PRISTINE, NAME);
+  writeMap(NAME, map);
+  checkOperations(expected);
+
+  // or not a map at all
+  map = wrong;
+  map.header.magic = 0;
+  copyFile(PRISTINE, NAME);
+  writeMap(NAME, map);
+  checkOperations(expected);
+
+  checkSparse();
+
+  File::remove(NAME);
+  File::remove(PRISTINE);
+  return testResult("space_map_test");
+}
@@ -0,0 +1,62 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include "file_util.h"
+
+/**
+ * Number of failed checks so far; the test exits with a nonzero status if
+ * any failed.
+ */
+static std::atomic<int> testFailures(0);
+
+#define checkTrue(cond)                                                   \
+{                                                                         \
+  if (!(cond))                                                            \
+  {                                                                       \
+    std::cout << "Test FAILS at " << __FILE__ << ":" << __LINE__          \
+              << ": " #cond "\n";                                         \
+    testFailures++;                                                       \
+  }                                                                       \
+}
+
+#define checkThrows(stmt, exception)                                      \
+{                                                                         \
+  bool thrown = false;                                                    \
+  try                                                                     \
+  {                                                                       \
+    stmt;                                                                 \
+  }                                                                       \
+  catch (const exception&)                                                \
+  {                                                                       \
+    thrown = true;                                                        \
+  }                                                                       \
+  if (!thrown)                                                            \
+  {                                                                       \
+    std::cout << "Test FAILS at " << __FILE__ << ":" << __LINE__          \
+              << ": " #stmt " did not throw " #exception "\n";            \
+    testFailures++;                                                       \
+  }                                                                       \
+}
+
+/**
+ * Reports the outcome of a test program, returning its exit status.
+ */
+static inline int testResult(const char* name)
+{
+  if (testFailures == 0)
+  {
+    std::cout << name << ": all tests passed\n";
+    return 0;
+  }
+  std::cout << name << ": " << testFailures << " checks FAILED\n";
+  return 1;
+}